@@ -22,11 +22,13 @@
 
 bool CER_Odometry::reset_odometry()
 {
-    ienc->getEncoder(0,&encL_offset);
-    ienc->getEncoder(1,&encR_offset);
+    double timestamp = 0;
+    read_encoders(timestamp);
+    encL_offset = axes_enc[0];
+    encR_offset = axes_enc[1];
     odom_x=0;
     odom_y=0;
-    encvel_estimator->reset();
+    odometry.reset();
     yInfo("Odometry reset done");
     return true;
 }
@@ -67,8 +69,6 @@ CER_Odometry::CER_Odometry(PolyDriver* _driver) : OdometryHandler(_driver)
 
     traveled_distance=0;
     traveled_angle=0;
-    encvel_estimator =new iCub::ctrl::AWLinEstimator(2,1.0);
-    encw_estimator = new iCub::ctrl::AWLinEstimator(1, 1.0);
     enc.resize(2);
     encv.resize(2);
     rosMsgCounter=0;
@@ -98,6 +98,10 @@ bool CER_Odometry::open(const Property& _options)
         yError("one or more devices has not been viewed");
         return false;
     }
+    if (!open_encoders(2))
+    {
+        return false;
+    }
     // open control input ports
     bool ret = true;
     ret &= port_odometry.open((localName+"/odometry:o").c_str());
@@ -137,6 +141,19 @@ bool CER_Odometry::open(const Property& _options)
     }
     geom_r = geometry_group.find("geom_r").asDouble();
     geom_L = geometry_group.find("geom_L").asDouble();
+    odometry.setGeometry(geom_r, geom_L);
+
+    //integration of the position: euler (from the estimated velocity), arc or rk4 (from the encoder deltas)
+    Bottle general_group = ctrl_options.findGroup("GENERAL");
+    std::string integration_name = general_group.check("odometry_integration", Value("euler")).asString();
+    OdometryIntegrator::integration_t integration;
+    if (!OdometryIntegrator::parse(integration_name, integration))
+    {
+        yError() << "Invalid odometry_integration:" << integration_name << ", valid values are: euler, arc, rk4";
+        return false;
+    }
+    odometry.setIntegration(integration);
+    yInfo() << "Odometry integration:" << OdometryIntegrator::name(integration);
 
     return true;
 }
@@ -145,78 +162,41 @@ void CER_Odometry::compute()
 {
     mutex.wait();
 
-    //read the encoders (deg)
-    ienc->getEncoder(0,&encL);
-    ienc->getEncoder(1,&encR);
-        
-    //read the speeds (deg/s)
-    ienc->getEncoderSpeed(0,&velL);
-    ienc->getEncoderSpeed(1,&velR);
-        
+    //read the encoders (deg) and the speeds (deg/s) at once, with the time of the acquisition
+    double sample_time = 0;
+    if (!read_encoders(sample_time) || sample_time <= last_time)
+    {
+        //no new sample since the last cycle: nothing to integrate
+        mutex.post();
+        return;
+    }
+    encL = axes_enc[0];
+    encR = axes_enc[1];
+    velL = axes_encv[0];
+    velR = axes_encv[1];
+
     //remove the offset and convert in radians
     enc[0]= (encL - encL_offset) * 0.0174532925; 
     enc[1]= (encR - encR_offset) * 0.0174532925;
        
-    //estimate the speeds
-    iCub::ctrl::AWPolyElement el;
-    el.data=enc;
-    el.time=Time::now();
-    encv= encvel_estimator->estimate(el);
-
-    //compute the orientation.
-    odom_theta = (geom_r / geom_L) * (-enc[0] + enc[1]);
-
-    iCub::ctrl::AWPolyElement el2;
-    el2.data = yarp::sig::Vector(1,odom_theta);
-    el2.time = Time::now();
-    yarp::sig::Vector vvv;
-    vvv.resize(1, 0.0);
-    vvv = encw_estimator->estimate(el2);
-
-    //build the kinematics matrix
-    /*yarp::sig::Matrix kin;
-    kin.resize(3,2);
-    kin.zero();
-    kin(0, 0) = cos(odom_theta) / 2;
-    kin(0, 1) = cos(odom_theta) / 2;
-    kin(0, 2) = sin(odom_theta) / 2;
-    kin(1, 0) = sin(odom_theta) / 2;
-    kin(1, 1) = 1 / (2 * geom_L);
-    kin(1, 2) = 1 / (2 * geom_L);
-
-    yarp::sig::Vector odom_cart_vels;  //velocities expressed in the world reference frame
-    yarp::sig::Vector base_cart_vels; //velocities expressed in the base reference frame
-    odom_cart_vels  = kin*encv;
-    base_cart_vels = kin*encv; //@@@
-
-    base_vel_x     = base_cart_vels[1];
-    base_vel_y     = base_cart_vels[0];
-    base_vel_lin   = sqrt(base_vel_x*base_vel_x + base_vel_y*base_vel_y);
-    base_vel_theta = base_cart_vels[2];
-    
-    odom_vel_x      = odom_cart_vels[1];
-    odom_vel_y      = odom_cart_vels[0];
-    odom_vel_theta  = odom_cart_vels[2];
-    */
-
-
-    base_vel_x = geom_r / 2 * encv[0] + geom_r / 2 * encv[1]; 
+    //the heading, the speeds and the integration step, over the time elapsed between the two samples
+    double period = (last_time > 0) ? sample_time - last_time : 0;
+    odometry.update(enc[0], enc[1], sample_time, period);
+    encv = odometry.encv();
+    odom_theta = odometry.theta();
+    odom_x = odometry.x();
+    odom_y = odometry.y();
+
+    base_vel_x = odometry.velX();
     base_vel_y = 0;
     base_vel_lin = fabs(base_vel_x);
-    base_vel_theta = vvv[0];///-(geom_r / geom_L) * encv[0] + (geom_r / geom_L) * encv[1];
-    //yDebug() << base_vel_theta << vvv[0];
+    base_vel_theta = odometry.velTheta();
 
-    
     odom_vel_x = base_vel_x * cos(odom_theta);
     odom_vel_y = base_vel_x * sin(odom_theta);
     odom_vel_lin = base_vel_lin;
     odom_vel_theta = base_vel_theta;
 
-    //the integration step
-    double period=el.time-last_time;
-    odom_x=odom_x + (odom_vel_x * period);
-    odom_y=odom_y + (odom_vel_y * period);
-
     //compute traveled distance (odometer)
     traveled_distance = traveled_distance + fabs(base_vel_lin   * period);
     traveled_angle    = traveled_angle    + fabs(base_vel_theta * period);
@@ -227,8 +207,9 @@ void CER_Odometry::compute()
     odom_vel_theta   *= RAD2DEG;
     traveled_angle   *= RAD2DEG;
 
+    last_time = sample_time;
+    timeStamp.update(sample_time);
     mutex.post();
-    last_time = yarp::os::Time::now();
 }
 
 double CER_Odometry::get_vlin_coeff()
@@ -39,6 +39,8 @@
 #include <yarp/os/Node.h>
 #include <yarp/os/Publisher.h>
 #include "../odometryHandler.h"
+#include "../odometryIntegrator.h"
+#include "../diffDriveOdometry.h"
 
 using namespace std;
 using namespace yarp::os;
@@ -62,13 +64,14 @@ private:
     //estimated motor velocity
     double              velL_est;
     double              velR_est;
-    iCub::ctrl::AWLinEstimator      *encvel_estimator;
-    iCub::ctrl::AWLinEstimator      *encw_estimator;
 
     //robot geometry
     double              geom_r;
     double              geom_L;
 
+    //heading, speeds and position computed from the encoders
+    DiffDriveOdometry   odometry;
+
     yarp::sig::Vector enc;
     yarp::sig::Vector encv;
 
@@ -367,7 +367,13 @@ void ControlThread::run()
     {
         yError ("Unknown control mode!");
         this->m_motor_handler->execute_none();
-}
+    }
+
+    double command_source_time = 0;
+    if (this->m_input_handler->get_command_source_time(command_source_time))
+    {
+        command_latency.record_since(command_source_time);
+    }
 }
 
 void ControlThread::printStats()
@@ -376,6 +382,12 @@ void ControlThread::printStats()
     yInfo ("Input command: %+5.2f %+5.2f %+5.2f  %+5.2f      ", input_linear_speed, input_angular_speed, input_desired_direction, input_pwm_gain);
 }
 
+void ControlThread::getLatencyStats(Bottle& b)
+{
+    command_latency.addToBottle("command_to_actuation", b);
+    if (m_odometry_handler) m_odometry_handler->get_broadcast_latency().addToBottle("odometry_broadcast", b);
+}
+
 bool ControlThread::set_control_type (string s)
 {
     if      (s == "none")            base_control_type = BASE_CONTROL_NONE;
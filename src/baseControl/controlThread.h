@@ -115,6 +115,9 @@ protected:
     string               localName;
     bool                 odometry_enabled;
 
+    //time elapsed from the timestamp of the received command (i.e. the sensor data used by the navigation to compute it) to its actuation
+    latency_stats        command_latency;
+
 public:
     //Odometry, MotorControl and Input are instantiated by ControlThread.
     OdometryHandler* const      get_odometry_handler() { return m_odometry_handler;}
@@ -157,6 +160,12 @@ public:
     */
     void printStats();
 
+    /**
+    * Appends to a bottle the latency statistics of the control thread and of the odometry broadcast, as (stage count p50 p99 max) lists (ms).
+    * @param b the bottle to be filled
+    */
+    void getLatencyStats(Bottle& b);
+
     /**
     * Sets the PID control gains if the current control mode is: velocity_pid, openloop_pid.
     */
@@ -0,0 +1,91 @@
+/*
+ * Copyright (C) 2020 Istituto Italiano di Tecnologia (IIT)
+ * All rights reserved.
+ *
+ * This software may be modified and distributed under the terms of the
+ * GPL-2+ license. See the accompanying LICENSE file for details.
+ */
+
+#include "diffDriveOdometry.h"
+#include <cmath>
+
+DiffDriveOdometry::DiffDriveOdometry() :
+    m_encvel_estimator(2, 1.0),
+    m_encw_estimator(1, 1.0)
+{
+    m_geom_r = 0;
+    m_geom_L = 0;
+    m_integration = OdometryIntegrator::INTEGRATION_EULER;
+    m_encvel_element.data.resize(2, 0.0);
+    m_encw_element.data.resize(1, 0.0);
+    m_enc.resize(2, 0.0);
+    m_encv.resize(2, 0.0);
+    m_prev_enc_valid = false;
+    m_prev_enc[0] = 0;
+    m_prev_enc[1] = 0;
+    m_prev_theta = 0;
+    m_x = 0;
+    m_y = 0;
+    m_theta = 0;
+    m_vel_x = 0;
+    m_vel_theta = 0;
+}
+
+void DiffDriveOdometry::setGeometry(double r, double L)
+{
+    m_geom_r = r;
+    m_geom_L = L;
+}
+
+void DiffDriveOdometry::setIntegration(OdometryIntegrator::integration_t type)
+{
+    m_integration = type;
+}
+
+void DiffDriveOdometry::reset()
+{
+    m_x = 0;
+    m_y = 0;
+    m_encvel_estimator.reset();
+    m_encw_estimator.reset();
+    m_prev_enc_valid = false;
+}
+
+void DiffDriveOdometry::update(double encL, double encR, double time, double period)
+{
+    m_enc[0] = encL;
+    m_enc[1] = encR;
+
+    //estimate the speeds
+    m_encvel_element.data[0] = encL;
+    m_encvel_element.data[1] = encR;
+    m_encvel_element.time = time;
+    m_encv = m_encvel_estimator.estimate(m_encvel_element);
+
+    //compute the orientation
+    m_theta = (m_geom_r / m_geom_L) * (-encL + encR);
+
+    m_encw_element.data[0] = m_theta;
+    m_encw_element.time = time;
+    yarp::sig::Vector w = m_encw_estimator.estimate(m_encw_element);
+
+    m_vel_x = m_geom_r / 2 * m_encv[0] + m_geom_r / 2 * m_encv[1];
+    m_vel_theta = w[0];
+
+    //the integration step
+    if (m_integration == OdometryIntegrator::INTEGRATION_EULER)
+    {
+        m_x += m_vel_x * cos(m_theta) * period;
+        m_y += m_vel_x * sin(m_theta) * period;
+    }
+    else if (m_prev_enc_valid)
+    {
+        //the displacement measured by the encoders since the previous sample
+        double ds = m_geom_r / 2 * ((encL - m_prev_enc[0]) + (encR - m_prev_enc[1]));
+        OdometryIntegrator::integrate(m_integration, ds, m_prev_theta, m_theta - m_prev_theta, m_x, m_y);
+    }
+    m_prev_enc[0] = encL;
+    m_prev_enc[1] = encR;
+    m_prev_theta = m_theta;
+    m_prev_enc_valid = true;
+}
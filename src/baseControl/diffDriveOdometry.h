@@ -0,0 +1,86 @@
+/*
+ * Copyright (C) 2020 Istituto Italiano di Tecnologia (IIT)
+ * All rights reserved.
+ *
+ * This software may be modified and distributed under the terms of the
+ * GPL-2+ license. See the accompanying LICENSE file for details.
+ */
+
+#ifndef DIFF_DRIVE_ODOMETRY_H
+#define DIFF_DRIVE_ODOMETRY_H
+
+#include <yarp/sig/Vector.h>
+#include <iCub/ctrl/adaptWinPolyEstimator.h>
+#include "odometryIntegrator.h"
+
+/**
+* The odometry of a differential drive base computed from the angles of its two wheels.
+* The heading is computed from the difference of the wheel angles, the speeds are estimated from the
+* encoder samples and the position is integrated with one of the OdometryIntegrator methods.
+* It does not depend on the control board, so that the same computation is run by CER_Odometry and by the offline tools.
+*/
+class DiffDriveOdometry
+{
+public:
+    DiffDriveOdometry();
+
+    /**
+    * Sets the geometry of the base.
+    * @param r the radius of the wheels (m)
+    * @param L the distance between the wheels (m)
+    */
+    void setGeometry(double r, double L);
+    void setIntegration(OdometryIntegrator::integration_t type);
+    OdometryIntegrator::integration_t getIntegration() const { return m_integration; }
+
+    /**
+    * Restarts from the origin: the estimators are cleared and the next sample is integrated from the origin.
+    */
+    void reset();
+
+    /**
+    * Integrates a new encoder sample.
+    * @param encL, encR the angles of the wheels, offset removed (rad)
+    * @param time the acquisition time of the sample (s)
+    * @param period the time elapsed since the previous sample, used by the euler integration (s)
+    */
+    void update(double encL, double encR, double time, double period);
+
+    //the pose (m, m, rad)
+    double x() const { return m_x; }
+    double y() const { return m_y; }
+    double theta() const { return m_theta; }
+
+    //the estimated velocity of the base, in the robot frame (m/s, rad/s)
+    double velX() const { return m_vel_x; }
+    double velTheta() const { return m_vel_theta; }
+
+    //the last encoder sample and the estimated wheel speeds (rad, rad/s)
+    const yarp::sig::Vector& enc() const { return m_enc; }
+    const yarp::sig::Vector& encv() const { return m_encv; }
+
+private:
+    double m_geom_r;
+    double m_geom_L;
+    OdometryIntegrator::integration_t m_integration;
+
+    iCub::ctrl::AWLinEstimator m_encvel_estimator;
+    iCub::ctrl::AWLinEstimator m_encw_estimator;
+    //inputs of the estimators, preallocated
+    iCub::ctrl::AWPolyElement  m_encvel_element;
+    iCub::ctrl::AWPolyElement  m_encw_element;
+
+    yarp::sig::Vector m_enc;
+    yarp::sig::Vector m_encv;
+    bool   m_prev_enc_valid;
+    double m_prev_enc[2];
+    double m_prev_theta;
+
+    double m_x;
+    double m_y;
+    double m_theta;
+    double m_vel_x;
+    double m_vel_theta;
+};
+
+#endif
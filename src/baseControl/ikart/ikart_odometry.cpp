@@ -21,9 +21,11 @@
 
 bool iKart_Odometry::reset_odometry()
 {
-    ienc->getEncoder(0,&encA_offset);
-    ienc->getEncoder(1,&encB_offset);
-    ienc->getEncoder(2,&encC_offset);
+    double timestamp = 0;
+    read_encoders(timestamp);
+    encA_offset = axes_enc[0];
+    encB_offset = axes_enc[1];
+    encC_offset = axes_enc[2];
     odom_x=0;
     odom_y=0;
     encvel_estimator->reset();
@@ -71,6 +73,7 @@ iKart_Odometry::iKart_Odometry(PolyDriver* _driver) : OdometryHandler(_driver)
     encvel_estimator =new iCub::ctrl::AWLinEstimator(3,1.0);
     enc.resize(3);
     encv.resize(3);
+    encvel_element.data.resize(3, 0.0);
 }
 
 bool iKart_Odometry::open(const Property &_options)
@@ -95,6 +98,10 @@ bool iKart_Odometry::open(const Property &_options)
         yError("one or more devices has not been viewed");
         return false;
     }
+    if (!open_encoders(3))
+    {
+        return false;
+    }
     // open control input ports
     bool ret= true;
     ret &= port_odometry.open((localName+"/odometry:o").c_str());
@@ -149,42 +156,12 @@ bool iKart_Odometry::open(const Property &_options)
     geom_L = geometry_group.find("geom_L").asDouble();
     g_angle = geometry_group.find("g_angle").asDouble();
     geometry_group.toString();
-    return true;
-}
-
-void iKart_Odometry::compute()
-{
-    mutex.wait();
-
-    //read the encoders (deg)
-    ienc->getEncoder(0,&encA);
-    ienc->getEncoder(1,&encB);
-    ienc->getEncoder(2,&encC);
-        
-    //read the speeds (deg/s)
-    ienc->getEncoderSpeed(0,&velA);
-    ienc->getEncoderSpeed(1,&velB);
-    ienc->getEncoderSpeed(2,&velC);
-        
-    //remove the offset and convert in radians
-    enc[0]= -(encA - encA_offset) * 0.0174532925; 
-    enc[1]= -(encB - encB_offset) * 0.0174532925;
-    enc[2]= -(encC - encC_offset) * 0.0174532925;
-       
-    //estimate the speeds
-    iCub::ctrl::AWPolyElement el;
-    el.data=enc;
-    el.time=Time::now();
-    encv= encvel_estimator->estimate(el);
 
     // -------------------------------------------------------------------------------------
     // The following formulas are adapted from:
     // "A New Odometry System to reduce asymmetric Errors for Omnidirectional Mobile Robots"
     // -------------------------------------------------------------------------------------
 
-    //compute the orientation. odom_theta is expressed in radians
-    odom_theta = geom_r*(enc[0]+enc[1]+enc[2])/(3*geom_L);
-
     //build the kinematics matrix
     yarp::sig::Matrix kin;
     kin.resize(3,3);
@@ -209,41 +186,63 @@ void iKart_Odometry::compute()
     m_gangle(1,1) = cos (g_angle);
     m_gangle(2,2) = 1;
 
-    yarp::sig::Matrix ikin = luinv(kin);
-    ikin=m_gangle*ikin;
+    ikin = m_gangle*luinv(kin);
+    return true;
+}
+
+void iKart_Odometry::compute()
+{
+    mutex.wait();
+
+    //read the encoders (deg) and the speeds (deg/s) at once, with the time of the acquisition
+    double sample_time = 0;
+    if (!read_encoders(sample_time) || sample_time <= last_time)
+    {
+        //no new sample since the last cycle: nothing to integrate
+        mutex.post();
+        return;
+    }
+    encA = axes_enc[0];
+    encB = axes_enc[1];
+    encC = axes_enc[2];
+    velA = axes_encv[0];
+    velB = axes_encv[1];
+    velC = axes_encv[2];
+
+    //remove the offset and convert in radians
+    enc[0]= -(encA - encA_offset) * 0.0174532925; 
+    enc[1]= -(encB - encB_offset) * 0.0174532925;
+    enc[2]= -(encC - encC_offset) * 0.0174532925;
+       
+    //estimate the speeds
+    encvel_element.data[0] = enc[0];
+    encvel_element.data[1] = enc[1];
+    encvel_element.data[2] = enc[2];
+    encvel_element.time = sample_time;
+    encv= encvel_estimator->estimate(encvel_element);
 
-    //build the rotation matrix
-    yarp::sig::Matrix m1;
-    m1.resize(3,3);
-    m1.zero();
-    m1(0,0) = cos (odom_theta);
-    m1(0,1) = -sin (odom_theta);
-    m1(1,0) = sin (odom_theta);
-    m1(1,1) = cos (odom_theta);
-    m1(2,2) = 1;
+    //compute the orientation. odom_theta is expressed in radians
+    odom_theta = geom_r*(enc[0]+enc[1]+enc[2])/(3*geom_L);
 
-    yarp::sig::Matrix m2;
-    m2.resize(3,3);
-    m2.zero();
-    m2(0,0) = cos (0.0);
-    m2(0,1) = -sin (0.0);
-    m2(1,0) = sin (0.0);
-    m2(1,1) = cos (0.0);
-    m2(2,2) = 1;
+    //velocities expressed in the ikart reference frame
+    double ikart_cart_vels[3];
+    for (size_t r = 0; r < 3; r++)
+    {
+        ikart_cart_vels[r] = ikin(r, 0) * encv[0] + ikin(r, 1) * encv[1] + ikin(r, 2) * encv[2];
+    }
 
-    yarp::sig::Vector odom_cart_vels;  //velocities expressed in the world reference frame
-    yarp::sig::Vector ikart_cart_vels; //velocities expressed in the ikart reference frame
-    odom_cart_vels  = m1*ikin*encv;
-    ikart_cart_vels = m2*ikin*encv;
+    //velocities expressed in the world reference frame (rotation by odom_theta)
+    double cos_theta = cos(odom_theta);
+    double sin_theta = sin(odom_theta);
 
     base_vel_x     = ikart_cart_vels[0];
     base_vel_y     = ikart_cart_vels[1];
     base_vel_theta = ikart_cart_vels[2];
     base_vel_lin   = sqrt(odom_vel_x*odom_vel_x + odom_vel_y*odom_vel_y);
     
-    odom_vel_x      = odom_cart_vels[0];
-    odom_vel_y      = odom_cart_vels[1];
-    odom_vel_theta  = odom_cart_vels[2];
+    odom_vel_x      = cos_theta * ikart_cart_vels[0] - sin_theta * ikart_cart_vels[1];
+    odom_vel_y      = sin_theta * ikart_cart_vels[0] + cos_theta * ikart_cart_vels[1];
+    odom_vel_theta  = ikart_cart_vels[2];
   
     //these are not currently used
     if (base_vel_lin<0.001)
@@ -260,8 +259,8 @@ void iKart_Odometry::compute()
     odom_theta       *= RAD2DEG;
     traveled_angle   *= RAD2DEG;
 
-    //the integration step
-    double period=el.time-last_time;
+    //the integration step, over the time elapsed between the two samples
+    double period = (last_time > 0) ? sample_time - last_time : 0;
     odom_x=odom_x + (odom_vel_x * period);
     odom_y=odom_y + (odom_vel_y * period);
 
@@ -290,8 +289,9 @@ void iKart_Odometry::compute()
                 (sin(odom_theta)-si3m)*encC
                 );
     */  
+    last_time = sample_time;
+    timeStamp.update(sample_time);
     mutex.post();
-    last_time = yarp::os::Time::now();
 }
 
 double iKart_Odometry::get_vlin_coeff()
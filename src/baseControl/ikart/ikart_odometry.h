@@ -67,6 +67,12 @@ private:
     double              velC_est;
     iCub::ctrl::AWLinEstimator      *encvel_estimator;
 
+    //input of the estimator, preallocated
+    iCub::ctrl::AWPolyElement       encvel_element;
+
+    //inverse kinematics (wheel speeds to base velocity), computed once from the robot geometry
+    yarp::sig::Matrix               ikin;
+
     //robot geometry
     double              geom_r;
     double              geom_L;
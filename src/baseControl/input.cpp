@@ -47,6 +47,14 @@ void Input::printStats()
         yInfo( "Under joystick2 control (%d)\n", joystick_received[1]);
 }
 
+bool Input::get_command_source_time(double& source_time)
+{
+    if (cmd_source_time_new == false) return false;
+    source_time = cmd_source_time;
+    cmd_source_time_new = false;
+    return true;
+}
+
 void Input::close()
 {
     port_movement_control.interrupt();
@@ -325,6 +333,8 @@ Input::Input()
     joystick_received[0]   = 0;
     joystick_received[1]   = 0;
     auxiliary_received     = 0;
+    cmd_source_time        = 0;
+    cmd_source_time_new    = false;
                            
     port_joystick_control[0] =0;
     port_joystick_control[1] =0;
@@ -538,6 +548,12 @@ void Input::read_inputs(double& linear_speed,double& angular_speed,double& desir
     //- - - read command port - - -
     if (Bottle *b = port_movement_control.read(false))
     {
+        Stamp stamp;
+        if (port_movement_control.getEnvelope(stamp) && stamp.isValid())
+        {
+            cmd_source_time = stamp.getTime();
+            cmd_source_time_new = true;
+        }
         if (b->get(0).asInt()== BASECONTROL_COMMAND_PERCENT_POLAR)
         {
             read_percent_polar(b, cmd_desired_direction,cmd_linear_speed,cmd_angular_speed,cmd_pwm_gain);
@@ -106,6 +106,8 @@ private:
     double              cmd_angular_speed;
     double              cmd_desired_direction;
     double              cmd_pwm_gain;
+    double              cmd_source_time;      //the timestamp of the last command (the envelope of port_movement_control)
+    bool                cmd_source_time_new;
 
     //aux input via YARP port
     double              aux_linear_speed;
@@ -173,6 +175,13 @@ public:
     * @param pwm_gain the pwm gain (0-100). Joypad emergency button typically sets this value to zero to stop the robot. User modules, instead, do not use this value (always set to 100)/
     */
     void   read_inputs        (double& linear_speed, double& angular_speed, double& desired_direction, double& pwm_gain);
+
+    /**
+    * Returns the timestamp of the last command received on the movement control port, if not already returned.
+    * @param source_time the timestamp attached by the sender to the command
+    * @return true if a new command has been received since the last call
+    */
+    bool   get_command_source_time(double& source_time);
     
 private:
 
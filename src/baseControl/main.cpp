@@ -55,12 +55,15 @@ protected:
     ControlThread  *control_thr;
     Port            rpcPort;
     bool            verbose_print;
+    bool            latency_port_enabled;
+    BufferedPort<Bottle> latencyPort;
 
 public:
     CtrlModule() 
     {
         control_thr=0;
         verbose_print=true;
+        latency_port_enabled=false;
     }
 
     //Module initialization and configuration
@@ -237,6 +240,12 @@ public:
         rpcPort.open((localName+"/rpc").c_str());
         attach(rpcPort);
 
+        //optional port streaming the latency statistics
+        if (rf.check("publish_latency_stats"))
+        {
+            latency_port_enabled = latencyPort.open((localName+"/latency:o").c_str());
+        }
+
         return true;
     }
 
@@ -256,6 +265,15 @@ public:
             reply.addString("change_pid <identif> <kp> <ki> <kd>");
             reply.addString("change_ctrl_mode <type_string>");
             reply.addString("set_debug_mode 0/1");
+            reply.addString("stats");
+            return true;
+        }
+        else if (command.get(0).asString()=="stats")
+        {
+            if (control_thr)
+                {control_thr->getLatencyStats(reply);}
+            else
+                {reply.addString("Control thread not running.");}
             return true;
         }
         else if (command.get(0).asString()=="set_debug_mode")
@@ -378,6 +396,8 @@ public:
 
         rpcPort.interrupt();
         rpcPort.close();
+        latencyPort.interrupt();
+        latencyPort.close();
 
         return true;
     }
@@ -396,6 +416,13 @@ public:
             if (pOdometry) { if (verbose_print) pOdometry->printStats(); }
             if (verbose_print) control_thr->get_motor_handler()->printStats();
             if (verbose_print) control_thr->get_input_handler()->printStats();
+            if (latency_port_enabled && latencyPort.getOutputCount() > 0)
+            {
+                Bottle& b = latencyPort.prepare();
+                b.clear();
+                control_thr->getLatencyStats(b);
+                latencyPort.write();
+            }
         }
         else
         {
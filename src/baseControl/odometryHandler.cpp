@@ -19,6 +19,11 @@
 #include "odometryHandler.h"
 #include <yarp/os/LogStream.h>
 #include <limits>
+#if defined(__linux__)
+#include <sys/resource.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#endif
 
 #define RAD2DEG 180.0/M_PI
 #define DEG2RAD M_PI/180.0
@@ -64,6 +69,54 @@ OdometryHandler::OdometryHandler(PolyDriver* _driver)
     traveled_distance    = 0;
     traveled_angle       = 0;
     rosMsgCounter        = 0;
+    last_time            = 0;
+    ienc                 = 0;
+    ienc_timed           = 0;
+    enable_ROS           = false;
+    publisher_pending    = false;
+    publisher_stop       = false;
+    footprint_period     = 1.0;
+    footprint_last_time  = 0;
+}
+
+bool OdometryHandler::open_encoders(int wheels)
+{
+    int axes = 0;
+    if (ienc == 0 || ienc->getAxes(&axes) == false || axes < wheels)
+    {
+        yError() << "The control board has" << axes << "axes," << wheels << "are required by the odometry";
+        return false;
+    }
+    axes_enc.resize(axes, 0.0);
+    axes_encv.resize(axes, 0.0);
+    axes_time.resize(axes, 0.0);
+
+    if (control_board_driver->view(ienc_timed) == false)
+    {
+        ienc_timed = 0;
+        yWarning() << "IEncodersTimed interface not available, the encoders will be timestamped with the local clock";
+    }
+    return true;
+}
+
+bool OdometryHandler::read_encoders(double& timestamp)
+{
+    bool ret = true;
+    if (ienc_timed)
+    {
+        ret &= ienc_timed->getEncodersTimed(axes_enc.data(), axes_time.data());
+        ret &= ienc_timed->getEncoderSpeeds(axes_encv.data());
+        timestamp = axes_time[0];
+        //some devices do not fill the timestamps
+        if (timestamp <= 0) timestamp = yarp::os::Time::now();
+    }
+    else
+    {
+        ret &= ienc->getEncoders(axes_enc.data());
+        ret &= ienc->getEncoderSpeeds(axes_encv.data());
+        timestamp = yarp::os::Time::now();
+    }
+    return ret;
 }
 
 bool OdometryHandler::open(const Property &options)
@@ -107,6 +160,7 @@ bool OdometryHandler::open(const Property &options)
         footprint_frame_id = rf_group.find("footprint_frame").asString();
         rosTopicName_footprint = rf_group.find("topic_name").asString();
         footprint_diameter = rf_group.find("footprint_diameter").asDouble();
+        footprint_period = rf_group.check("footprint_period", Value(1.0)).asDouble();
     }
     else
     {
@@ -145,11 +199,28 @@ bool OdometryHandler::open(const Property &options)
             footprint.polygon.points[i].z = 0;
         }
     }
+
+    //start the publisher
+    if (!publisher_thread.joinable())
+    {
+        publisher_stop = false;
+        publisher_thread = std::thread(&OdometryHandler::publisher_loop, this);
+    }
     return true;
 }
 
 void OdometryHandler::close()
 {
+    if (publisher_thread.joinable())
+    {
+        {
+            std::lock_guard<std::mutex> lock(publisher_mutex);
+            publisher_stop = true;
+        }
+        publisher_cv.notify_one();
+        publisher_thread.join();
+    }
+
     port_odometry.interrupt();
     port_odometry.close();
     port_odometer.interrupt();
@@ -170,118 +241,157 @@ void OdometryHandler::close()
 
 void OdometryHandler::broadcast()
 {
+    //copy the state (timeStamp holds the time of the encoder acquisition, set by compute())
+    odometry_snapshot_t s;
     mutex.wait();
-    timeStamp.update();
+    s.stamp = timeStamp;
+    s.odom_x = odom_x;
+    s.odom_y = odom_y;
+    s.odom_z = odom_z;
+    s.odom_theta = odom_theta;
+    s.odom_vel_x = odom_vel_x;
+    s.odom_vel_y = odom_vel_y;
+    s.odom_vel_theta = odom_vel_theta;
+    s.base_vel_x = base_vel_x;
+    s.base_vel_y = base_vel_y;
+    s.base_vel_lin = base_vel_lin;
+    s.base_vel_theta = base_vel_theta;
+    s.traveled_distance = traveled_distance;
+    s.traveled_angle = traveled_angle;
+    mutex.post();
+    //the encoder timestamp may come from the device clock: the latency is measured with the local clock only
+    s.handoff_time = yarp::os::Time::now();
+
+    //and hand it over to the publisher thread
+    {
+        std::lock_guard<std::mutex> lock(publisher_mutex);
+        publisher_snapshot = s;
+        publisher_pending = true;
+    }
+    publisher_cv.notify_one();
+}
+
+void OdometryHandler::publisher_loop()
+{
+#if defined(__linux__)
+    //the publisher must not compete with the control thread
+    setpriority(PRIO_PROCESS, (id_t)syscall(SYS_gettid), 10);
+#endif
+    odometry_snapshot_t s;
+    while (true)
+    {
+        {
+            std::unique_lock<std::mutex> lock(publisher_mutex);
+            publisher_cv.wait(lock, [this] { return publisher_pending || publisher_stop; });
+            if (publisher_stop) break;
+            s = publisher_snapshot;
+            publisher_pending = false;
+        }
+        publish(s);
+    }
+}
+
+void OdometryHandler::publish(odometry_snapshot_t& s)
+{
     if (port_odometry.getOutputCount()>0)
     {
-        port_odometry.setEnvelope(timeStamp);
+        port_odometry.setEnvelope(s.stamp);
         yarp::dev::OdometryData &b = port_odometry.prepare();
-        b.odom_x=odom_x; //position in the odom reference frame
-        b.odom_y=odom_y;
-        b.odom_theta=odom_theta;
-        b.base_vel_x=base_vel_x; //velocity in the robot reference frame
-        b.base_vel_y=base_vel_y;
-        b.base_vel_theta=base_vel_theta;
-        b.odom_vel_x=odom_vel_x; //velocity in the odom reference frame
-        b.odom_vel_y=odom_vel_y;
-        b.odom_vel_theta=odom_vel_theta;
+        b.odom_x=s.odom_x; //position in the odom reference frame
+        b.odom_y=s.odom_y;
+        b.odom_theta=s.odom_theta;
+        b.base_vel_x=s.base_vel_x; //velocity in the robot reference frame
+        b.base_vel_y=s.base_vel_y;
+        b.base_vel_theta=s.base_vel_theta;
+        b.odom_vel_x=s.odom_vel_x; //velocity in the odom reference frame
+        b.odom_vel_y=s.odom_vel_y;
+        b.odom_vel_theta=s.odom_vel_theta;
         port_odometry.write();
     }
 
     if (port_odometer.getOutputCount()>0)
     {
-        port_odometer.setEnvelope(timeStamp);
+        port_odometer.setEnvelope(s.stamp);
         Bottle &t = port_odometer.prepare();
         t.clear();
-        t.addDouble(traveled_distance);
-        t.addDouble(traveled_angle);
+        t.addDouble(s.traveled_distance);
+        t.addDouble(s.traveled_angle);
         port_odometer.write();
     }
 
     if (port_vels.getOutputCount()>0)
     {
-        port_vels.setEnvelope(timeStamp);
+        port_vels.setEnvelope(s.stamp);
         Bottle &v = port_vels.prepare();
         v.clear();
-        v.addDouble(base_vel_lin);
-        v.addDouble(base_vel_theta);
+        v.addDouble(s.base_vel_lin);
+        v.addDouble(s.base_vel_theta);
         port_vels.write();
     }
 
     if (enable_ROS)
     {
+        double halfYaw = s.odom_theta / 180.0*M_PI * 0.5;
+        double cosYaw = cos(halfYaw);
+        double sinYaw = sin(halfYaw);
+        yarp::rosmsg::TickTime stamp = normalizeSecNSec(s.stamp.getTime());
+
         yarp::rosmsg::nav_msgs::Odometry &rosData = rosPublisherPort_odometry.prepare();
         rosData.header.seq = rosMsgCounter;
-        rosData.header.stamp = normalizeSecNSec(yarp::os::Time::now());
+        rosData.header.stamp = stamp;
         rosData.header.frame_id = odometry_frame_id;
         rosData.child_frame_id = child_frame_id;
 
-        rosData.pose.pose.position.x = odom_x;
-        rosData.pose.pose.position.y = odom_y;
+        rosData.pose.pose.position.x = s.odom_x;
+        rosData.pose.pose.position.y = s.odom_y;
         rosData.pose.pose.position.z = 0.0;
-        yarp::rosmsg::geometry_msgs::Quaternion odom_quat;
-        double halfYaw = odom_theta / 180.0*M_PI * 0.5;
-        double cosYaw = cos(halfYaw);
-        double sinYaw = sin(halfYaw);
-        odom_quat.x = 0;
-        odom_quat.y = 0;
-        odom_quat.z = sinYaw;
-        odom_quat.w = cosYaw;
-        rosData.pose.pose.orientation = odom_quat;
-        rosData.twist.twist.linear.x = base_vel_x;
-        rosData.twist.twist.linear.y = base_vel_y;
+        rosData.pose.pose.orientation.x = 0;
+        rosData.pose.pose.orientation.y = 0;
+        rosData.pose.pose.orientation.z = sinYaw;
+        rosData.pose.pose.orientation.w = cosYaw;
+        rosData.twist.twist.linear.x = s.base_vel_x;
+        rosData.twist.twist.linear.y = s.base_vel_y;
         rosData.twist.twist.linear.z = 0;
         rosData.twist.twist.angular.x = 0;
         rosData.twist.twist.angular.y = 0;
-        rosData.twist.twist.angular.z = base_vel_theta / 180.0*M_PI;
+        rosData.twist.twist.angular.z = s.base_vel_theta / 180.0*M_PI;
 
         rosPublisherPort_odometry.write();
-    }
 
-    if (enable_ROS)
-    {
-        yarp::rosmsg::geometry_msgs::PolygonStamped &rosData = rosPublisherPort_footprint.prepare();
-        rosData = footprint;
-        rosData.header.seq = rosMsgCounter;
-        rosData.header.stamp = normalizeSecNSec(yarp::os::Time::now());
-        rosData.header.frame_id = footprint_frame_id;
-        rosPublisherPort_footprint.write();
-    }
+        //the footprint is static, it is published at a slow rate
+        if (s.stamp.getTime() - footprint_last_time >= footprint_period)
+        {
+            yarp::rosmsg::geometry_msgs::PolygonStamped &rosFootprint = rosPublisherPort_footprint.prepare();
+            rosFootprint = footprint;
+            rosFootprint.header.seq = rosMsgCounter;
+            rosFootprint.header.stamp = stamp;
+            rosFootprint.header.frame_id = footprint_frame_id;
+            rosPublisherPort_footprint.write();
+            footprint_last_time = s.stamp.getTime();
+        }
 
-    if (enable_ROS)
-    {
-        yarp::rosmsg::tf2_msgs::TFMessage &rosData = rosPublisherPort_tf.prepare();
-        yarp::rosmsg::geometry_msgs::TransformStamped transform;
+        //prepare() may return a message already written in a previous cycle, if the port is done with it:
+        //every field is set again
+        yarp::rosmsg::tf2_msgs::TFMessage &rosTf = rosPublisherPort_tf.prepare();
+        rosTf.transforms.resize(1);
+        yarp::rosmsg::geometry_msgs::TransformStamped& transform = rosTf.transforms[0];
         transform.child_frame_id = child_frame_id;
         transform.header.frame_id = odometry_frame_id;
         transform.header.seq = rosMsgCounter;
-        transform.header.stamp = normalizeSecNSec(yarp::os::Time::now());
-        double halfYaw = odom_theta / 180.0*M_PI * 0.5;
-        double cosYaw = cos(halfYaw);
-        double sinYaw = sin(halfYaw);
+        transform.header.stamp = stamp;
         transform.transform.rotation.x = 0;
         transform.transform.rotation.y = 0;
         transform.transform.rotation.z = sinYaw;
         transform.transform.rotation.w = cosYaw;
-        transform.transform.translation.x = odom_x;
-        transform.transform.translation.y = odom_y;
-        transform.transform.translation.z = odom_z;
-        if (rosData.transforms.size() == 0)
-        {
-            rosData.transforms.push_back(transform);
-        }
-        else
-        {
-            rosData.transforms[0] = transform;
-        }
-
-
+        transform.transform.translation.x = s.odom_x;
+        transform.transform.translation.y = s.odom_y;
+        transform.transform.translation.z = s.odom_z;
         rosPublisherPort_tf.write();
     }
 
     rosMsgCounter++;
 
-    mutex.post();
+    broadcast_latency.record_since(s.handoff_time);
 }
 
 double OdometryHandler::get_base_vel_lin()
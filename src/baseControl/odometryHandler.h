@@ -43,6 +43,10 @@
 #include <yarp/rosmsg/geometry_msgs/TransformStamped.h>
 #include <yarp/rosmsg/tf2_msgs/TFMessage.h>
 #include <yarp/dev/OdometryData.h>
+#include <latency_stats.h>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
 
 #define _USE_MATH_DEFINES
 #include <math.h>
@@ -84,6 +88,45 @@ protected:
 
     yarp::os::Publisher<yarp::rosmsg::tf2_msgs::TFMessage>                    rosPublisherPort_tf;
 
+    //time spent to publish the odometry, from the (local) time at which broadcast() hands it to the publisher thread
+    latency_stats         broadcast_latency;
+
+    //the odometry data to be published
+    struct odometry_snapshot_t
+    {
+        yarp::os::Stamp   stamp;
+        double            handoff_time;  //local time at which broadcast() copied the state
+        double            odom_x;
+        double            odom_y;
+        double            odom_z;
+        double            odom_theta;
+        double            odom_vel_x;
+        double            odom_vel_y;
+        double            odom_vel_theta;
+        double            base_vel_x;
+        double            base_vel_y;
+        double            base_vel_lin;
+        double            base_vel_theta;
+        double            traveled_distance;
+        double            traveled_angle;
+    };
+
+    //the data is published by a separate, low priority, thread: broadcast() only copies the state.
+    //If the publisher is late, the pending snapshot is replaced by the newest one.
+    std::thread             publisher_thread;
+    std::mutex              publisher_mutex;
+    std::condition_variable publisher_cv;
+    bool                    publisher_pending;
+    bool                    publisher_stop;
+    odometry_snapshot_t     publisher_snapshot;
+
+    //the footprint does not change: it is published at a slow rate
+    double                  footprint_period;
+    double                  footprint_last_time;
+
+    void   publisher_loop();
+    void   publish(odometry_snapshot_t& s);
+
 protected:
     //estimated cartesian velocity in the fixed odometry reference frame (world)
     double              odom_vel_x;
@@ -116,6 +159,28 @@ protected:
     //motor control interfaces 
     PolyDriver                      *control_board_driver;
     IEncoders                       *ienc;
+    IEncodersTimed                  *ienc_timed;
+
+    //positions (deg), speeds (deg/s) and timestamps of all the axes of the control board
+    yarp::sig::Vector               axes_enc;
+    yarp::sig::Vector               axes_encv;
+    yarp::sig::Vector               axes_time;
+
+    /**
+    * Allocates the encoder buffers. To be called once ienc has been viewed.
+    * If the control board provides the IEncodersTimed interface, it is used to get the time of the acquisition.
+    * @param wheels the number of axes used by the odometry.
+    * @return true if the control board has enough axes.
+    */
+    bool   open_encoders(int wheels);
+
+    /**
+    * Reads the positions and the speeds of all the axes of the control board (one call each)
+    * into axes_enc and axes_encv.
+    * @param timestamp the time of the acquisition: the timestamp given by the device if available, the current time otherwise.
+    * @return true/false if the encoders have been read.
+    */
+    bool   read_encoders(double& timestamp);
 
 public:
     /**
@@ -148,7 +213,8 @@ public:
     virtual void   compute() = 0;
 
     /**
-    * Broadcast odometry data over YARP ports (or ROS topics)
+    * Broadcast odometry data over YARP ports (or ROS topics).
+    * The data is copied and published asynchronously, so this method never waits on the network.
     */
     virtual void   broadcast();
 
@@ -185,6 +251,12 @@ public:
     * @return the coefficient
     */
     virtual double get_vang_coeff() = 0;
+
+    /**
+    * Returns the statistics about the time spent to broadcast the odometry data
+    * @return the latency statistics
+    */
+    const latency_stats& get_broadcast_latency() { return broadcast_latency; }
 };
 
 #endif
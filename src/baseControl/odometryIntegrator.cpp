@@ -0,0 +1,68 @@
+/*
+ * Copyright (C) 2020 Istituto Italiano di Tecnologia (IIT)
+ * All rights reserved.
+ *
+ * This software may be modified and distributed under the terms of the
+ * GPL-2+ license. See the accompanying LICENSE file for details.
+ */
+
+#include "odometryIntegrator.h"
+#include <cmath>
+
+//below this rotation (rad) the arc is computed as a straight segment
+#define ARC_MIN_DTHETA 1e-6
+
+bool OdometryIntegrator::parse(const std::string& name, integration_t& type)
+{
+    if      (name == "euler") { type = INTEGRATION_EULER; return true; }
+    else if (name == "arc")   { type = INTEGRATION_ARC;   return true; }
+    else if (name == "rk4")   { type = INTEGRATION_RK4;   return true; }
+    return false;
+}
+
+std::string OdometryIntegrator::name(integration_t type)
+{
+    switch (type)
+    {
+        case INTEGRATION_EULER: return "euler";
+        case INTEGRATION_ARC:   return "arc";
+        case INTEGRATION_RK4:   return "rk4";
+    }
+    return "unknown";
+}
+
+void OdometryIntegrator::integrate(integration_t type, double ds, double theta0, double dtheta, double& x, double& y)
+{
+    double theta1 = theta0 + dtheta;
+    switch (type)
+    {
+        case INTEGRATION_EULER:
+            x += ds * cos(theta1);
+            y += ds * sin(theta1);
+        break;
+
+        case INTEGRATION_ARC:
+            if (fabs(dtheta) < ARC_MIN_DTHETA)
+            {
+                //the chord of a (almost) straight arc, along the mean heading
+                x += ds * cos(theta0 + dtheta / 2);
+                y += ds * sin(theta0 + dtheta / 2);
+            }
+            else
+            {
+                double radius = ds / dtheta;
+                x += radius * (sin(theta1) - sin(theta0));
+                y -= radius * (cos(theta1) - cos(theta0));
+            }
+        break;
+
+        case INTEGRATION_RK4:
+        {
+            //the four stages: k1 at theta0, k2 and k3 at the midpoint, k4 at theta1
+            double theta_mid = theta0 + dtheta / 2;
+            x += ds / 6 * (cos(theta0) + 4 * cos(theta_mid) + cos(theta1));
+            y += ds / 6 * (sin(theta0) + 4 * sin(theta_mid) + sin(theta1));
+        }
+        break;
+    }
+}
@@ -0,0 +1,56 @@
+/*
+ * Copyright (C) 2020 Istituto Italiano di Tecnologia (IIT)
+ * All rights reserved.
+ *
+ * This software may be modified and distributed under the terms of the
+ * GPL-2+ license. See the accompanying LICENSE file for details.
+ */
+
+#ifndef ODOMETRY_INTEGRATOR_H
+#define ODOMETRY_INTEGRATOR_H
+
+#include <string>
+
+/**
+* Integration of the planar motion of the base between two encoder samples.
+* The input is the displacement measured by the encoders in the interval: the distance ds traveled
+* along the heading and the rotation dtheta. Both are assumed to grow at a constant rate (i.e. the
+* base moves along an arc of constant curvature).
+* It does not depend on YARP, so that it can be used by the offline tools too.
+*/
+class OdometryIntegrator
+{
+public:
+    enum integration_t
+    {
+        //x += ds * cos(theta0 + dtheta): first order, same as integrating the velocity with the heading at the end of the interval
+        INTEGRATION_EULER = 0,
+        //exact integral along the arc of constant curvature
+        INTEGRATION_ARC = 1,
+        //Runge-Kutta 4th order (with constant wheel speeds it reduces to the Simpson rule on the heading)
+        INTEGRATION_RK4 = 2
+    };
+
+    /**
+    * Converts the name of the integration method (euler, arc, rk4).
+    * @return false if the name is unknown.
+    */
+    static bool parse(const std::string& name, integration_t& type);
+
+    /**
+    * Returns the name of the integration method.
+    */
+    static std::string name(integration_t type);
+
+    /**
+    * Integrates the motion of the base.
+    * @param type the integration method
+    * @param ds the distance traveled along the heading (m)
+    * @param theta0 the heading at the beginning of the interval (rad)
+    * @param dtheta the rotation in the interval (rad)
+    * @param x, y the position, updated with the displacement (m)
+    */
+    static void integrate(integration_t type, double ds, double theta0, double dtheta, double& x, double& y);
+};
+
+#endif
@@ -0,0 +1,92 @@
+/*
+ * Copyright (C) 2020 Istituto Italiano di Tecnologia (IIT)
+ * All rights reserved.
+ *
+ * This software may be modified and distributed under the terms of the
+ * GPL-2+ license. See the accompanying LICENSE file for details.
+ */
+
+#ifndef LATENCY_STATS_H
+#define LATENCY_STATS_H
+
+#include <yarp/os/Bottle.h>
+#include <yarp/os/Time.h>
+#include <atomic>
+#include <vector>
+#include <string>
+#include <algorithm>
+
+//! Collects the most recent latency samples of a processing stage in a fixed size ring buffer.
+//! record() never blocks and must be called by a single writer thread. The percentiles can be computed
+//! at any time by any other thread (e.g. the one serving the RPC port): a sample being overwritten
+//! during the copy only affects the statistics, never the writer.
+class latency_stats
+{
+public:
+    static const size_t capacity = 1024;
+
+private:
+    std::atomic<double>  m_samples[capacity];
+    std::atomic<size_t>  m_written;
+
+public:
+    latency_stats() : m_written(0)
+    {
+        for (size_t i = 0; i < capacity; i++) m_samples[i].store(0, std::memory_order_relaxed);
+    }
+
+    //adds a sample, expressed in seconds
+    void record(double latency)
+    {
+        size_t n = m_written.load(std::memory_order_relaxed);
+        m_samples[n % capacity].store(latency, std::memory_order_relaxed);
+        m_written.store(n + 1, std::memory_order_release);
+    }
+
+    //adds the time elapsed since source_time, typically the timestamp of the sensor data which originated the computation.
+    //Invalid timestamps (<=0) are ignored.
+    void record_since(double source_time)
+    {
+        if (source_time <= 0) return;
+        record(yarp::os::Time::now() - source_time);
+    }
+
+    //total number of samples recorded since the beginning
+    size_t count() const
+    {
+        return m_written.load(std::memory_order_acquire);
+    }
+
+    //computes the statistics of the samples currently stored in the buffer. Returns false if no sample is available.
+    bool percentiles(double& p50, double& p99, double& max) const
+    {
+        size_t n = count();
+        if (n > capacity) n = capacity;
+        p50 = p99 = max = 0;
+        if (n == 0) return false;
+        std::vector<double> v(n);
+        for (size_t i = 0; i < n; i++) v[i] = m_samples[i].load(std::memory_order_relaxed);
+        std::nth_element(v.begin(), v.begin() + n / 2, v.end());
+        p50 = v[n / 2];
+        size_t i99 = std::min(n - 1, (n * 99) / 100);
+        std::nth_element(v.begin(), v.begin() + i99, v.end());
+        p99 = v[i99];
+        max = *std::max_element(v.begin() + i99, v.end());
+        return true;
+    }
+
+    //appends to b a list: (stage count p50 p99 max), where the latencies are expressed in milliseconds
+    void addToBottle(const std::string& stage, yarp::os::Bottle& b) const
+    {
+        double p50, p99, max;
+        percentiles(p50, p99, max);
+        yarp::os::Bottle& l = b.addList();
+        l.addString(stage);
+        l.addInt64((int64_t)count());
+        l.addFloat64(p50 * 1000.0);
+        l.addFloat64(p99 * 1000.0);
+        l.addFloat64(max * 1000.0);
+    }
+};
+
+#endif
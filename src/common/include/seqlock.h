@@ -0,0 +1,56 @@
+/*
+ * Copyright (C) 2020 Istituto Italiano di Tecnologia (IIT)
+ * All rights reserved.
+ *
+ * This software may be modified and distributed under the terms of the
+ * GPL-2+ license. See the accompanying LICENSE file for details.
+ */
+
+#ifndef SEQLOCK_H
+#define SEQLOCK_H
+
+#include <atomic>
+#include <cstring>
+#include <type_traits>
+
+//! A single-writer / multiple-readers slot protected by a sequence lock.
+//! The writer never waits for the readers. The readers never block the writer: if the data is
+//! modified while it is being copied, the copy is simply repeated.
+//! T must be trivially copyable (e.g. a struct of doubles, without strings or virtual methods).
+template <typename T>
+class seqlock_slot
+{
+    static_assert(std::is_trivially_copyable<T>::value, "seqlock_slot requires a trivially copyable type");
+
+    std::atomic<unsigned int> m_sequence;
+    T                         m_data;
+
+public:
+    seqlock_slot() : m_sequence(0), m_data() {}
+
+    //must be called by a single writer thread
+    void write(const T& data)
+    {
+        unsigned int seq = m_sequence.load(std::memory_order_relaxed);
+        m_sequence.store(seq + 1, std::memory_order_relaxed);
+        std::atomic_thread_fence(std::memory_order_release);
+        std::memcpy(&m_data, &data, sizeof(T));
+        m_sequence.store(seq + 2, std::memory_order_release);
+    }
+
+    //can be called by any number of threads. Returns the version of the data (incremented at each write).
+    unsigned int read(T& data) const
+    {
+        unsigned int seq1, seq2;
+        do
+        {
+            seq1 = m_sequence.load(std::memory_order_acquire);
+            std::memcpy(&data, &m_data, sizeof(T));
+            std::atomic_thread_fence(std::memory_order_acquire);
+            seq2 = m_sequence.load(std::memory_order_relaxed);
+        } while ((seq1 & 1) || seq1 != seq2);
+        return seq1 / 2;
+    }
+};
+
+#endif
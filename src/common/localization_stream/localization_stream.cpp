@@ -0,0 +1,196 @@
+/*
+ * Copyright (C) 2020 Istituto Italiano di Tecnologia (IIT)
+ * All rights reserved.
+ *
+ * This software may be modified and distributed under the terms of the
+ * GPL-2+ license. See the accompanying LICENSE file for details.
+ */
+
+#include "localization_stream.h"
+#include <yarp/os/Network.h>
+#include <yarp/os/Time.h>
+#include <yarp/os/LogStream.h>
+#include <cstring>
+
+using namespace yarp::os;
+using namespace yarp::dev::Nav2D;
+
+localization_stream_publisher::localization_stream_publisher()
+{
+    m_open = false;
+}
+
+localization_stream_publisher::~localization_stream_publisher()
+{
+    close();
+}
+
+bool localization_stream_publisher::open(const std::string& port_name)
+{
+    if (!m_port.open(port_name))
+    {
+        yError() << "localization_stream_publisher: unable to open port" << port_name;
+        return false;
+    }
+    m_open = true;
+    return true;
+}
+
+void localization_stream_publisher::close()
+{
+    if (!m_open) return;
+    m_port.interrupt();
+    m_port.close();
+    m_open = false;
+}
+
+void localization_stream_publisher::publish(const Map2DLocation& loc, const yarp::sig::Matrix& cov, double timestamp)
+{
+    if (!m_open) return;
+
+    Bottle& b = m_port.prepare();
+    b.clear();
+    Bottle& pose = b.addList();
+    pose.addString(loc.map_id);
+    pose.addDouble(loc.x);
+    pose.addDouble(loc.y);
+    pose.addDouble(loc.theta);
+    Bottle& c = b.addList();
+    if (cov.rows() == 3 && cov.cols() == 3)
+    {
+        for (size_t r = 0; r < 3; r++)
+            for (size_t k = 0; k < 3; k++)
+                c.addDouble(cov[r][k]);
+    }
+
+    if (timestamp > 0) m_stamp.update(timestamp);
+    else m_stamp.update();
+    m_port.setEnvelope(m_stamp);
+    m_port.write();
+}
+
+localization_stream_reader::localization_stream_reader()
+{
+    m_timeout = 0.1;
+    m_open = false;
+    m_last_connect_attempt = 0;
+}
+
+localization_stream_reader::~localization_stream_reader()
+{
+    close();
+}
+
+bool localization_stream_reader::open(const std::string& local_port_name, const std::string& remote_port_name, double timeout)
+{
+    m_timeout = timeout;
+    if (!m_port.open(local_port_name))
+    {
+        yError() << "localization_stream_reader: unable to open port" << local_port_name;
+        return false;
+    }
+    m_port.useCallback(*this);
+    m_open = true;
+    m_local_port_name = local_port_name;
+    m_remote_port_name = remote_port_name;
+
+    m_last_connect_attempt = yarp::os::Time::now();
+    if (!Network::connect(remote_port_name, local_port_name))
+    {
+        yWarning() << "localization_stream_reader: unable to connect to" << remote_port_name << ", the localization will be read through the rpc interface until it is available";
+    }
+    return true;
+}
+
+void localization_stream_reader::retryConnect()
+{
+    //the caller is not blocked by a retry in progress in another thread
+    std::unique_lock<std::mutex> lock(m_connect_mutex, std::try_to_lock);
+    if (!lock.owns_lock()) return;
+    double now = yarp::os::Time::now();
+    if (now - m_last_connect_attempt < 1.0) return;
+    m_last_connect_attempt = now;
+    if (m_port.getInputCount() > 0) return;
+    if (Network::connect(m_remote_port_name, m_local_port_name))
+    {
+        yInfo() << "localization_stream_reader: connected to" << m_remote_port_name;
+    }
+}
+
+void localization_stream_reader::close()
+{
+    if (!m_open) return;
+    m_port.interrupt();
+    m_port.disableCallback();
+    m_port.close();
+    m_open = false;
+}
+
+void localization_stream_reader::onRead(Bottle& b)
+{
+    //called by the port thread only, which is the single writer of m_data
+    Bottle* pose = b.get(0).asList();
+    Bottle* cov = b.get(1).asList();
+    if (pose == nullptr || pose->size() != 4)
+    {
+        yError() << "localization_stream_reader: invalid message" << b.toString();
+        return;
+    }
+
+    localization_stream_data data;
+    std::memset(&data, 0, sizeof(data));
+    std::strncpy(data.map_id, pose->get(0).asString().c_str(), sizeof(data.map_id) - 1);
+    data.x = pose->get(1).asDouble();
+    data.y = pose->get(2).asDouble();
+    data.theta = pose->get(3).asDouble();
+    if (cov && cov->size() == 9)
+    {
+        for (size_t i = 0; i < 9; i++) data.cov[i] = cov->get(i).asDouble();
+    }
+    data.received_time = yarp::os::Time::now();
+    Stamp stamp;
+    data.timestamp = (m_port.getEnvelope(stamp) && stamp.isValid()) ? stamp.getTime() : data.received_time;
+
+    m_data.write(data);
+}
+
+bool localization_stream_reader::getLatest(localization_stream_data& data)
+{
+    if (!m_open) return false;
+    //version 0: nothing received yet
+    if (m_data.read(data) != 0 &&
+        (m_timeout <= 0 || yarp::os::Time::now() - data.received_time <= m_timeout))
+    {
+        return true;
+    }
+    //no valid estimate: the remote port may have been opened (or restarted) after the connection attempt
+    retryConnect();
+    return false;
+}
+
+bool localization_stream_reader::getCurrentPosition(Map2DLocation& loc)
+{
+    localization_stream_data data;
+    if (!getLatest(data)) return false;
+    loc.map_id = data.map_id;
+    loc.x = data.x;
+    loc.y = data.y;
+    loc.theta = data.theta;
+    return true;
+}
+
+bool localization_stream_reader::getCurrentPosition(Map2DLocation& loc, yarp::sig::Matrix& cov, double& timestamp)
+{
+    localization_stream_data data;
+    if (!getLatest(data)) return false;
+    loc.map_id = data.map_id;
+    loc.x = data.x;
+    loc.y = data.y;
+    loc.theta = data.theta;
+    cov.resize(3, 3);
+    for (size_t r = 0; r < 3; r++)
+        for (size_t k = 0; k < 3; k++)
+            cov[r][k] = data.cov[r * 3 + k];
+    timestamp = data.timestamp;
+    return true;
+}
@@ -0,0 +1,91 @@
+/*
+ * Copyright (C) 2020 Istituto Italiano di Tecnologia (IIT)
+ * All rights reserved.
+ *
+ * This software may be modified and distributed under the terms of the
+ * GPL-2+ license. See the accompanying LICENSE file for details.
+ */
+
+#ifndef LOCALIZATION_STREAM_H
+#define LOCALIZATION_STREAM_H
+
+#include <yarp/os/Bottle.h>
+#include <yarp/os/BufferedPort.h>
+#include <yarp/os/TypedReaderCallback.h>
+#include <yarp/dev/Map2DLocation.h>
+#include <yarp/sig/Matrix.h>
+#include <seqlock.h>
+#include <mutex>
+#include <string>
+
+//! A streamed version of ILocalization2D::getCurrentPosition().
+//! The localization device publishes each new estimate on a port, the clients (robotGoto, robotPathPlanner)
+//! keep the latest one and read it without blocking, instead of doing an RPC at each cycle.
+//! Message format: (map_id x y theta) (cov00 cov01 ... cov22), with the timestamp of the estimate in the envelope.
+
+//the latest received estimate. Fixed size, so that it can be stored in a seqlock_slot.
+struct localization_stream_data
+{
+    char   map_id[64];
+    double x;
+    double y;
+    double theta;
+    double cov[9];
+    double timestamp;      //time of the estimate, from the envelope
+    double received_time;  //local time of reception
+};
+
+class localization_stream_publisher
+{
+    yarp::os::BufferedPort<yarp::os::Bottle> m_port;
+    yarp::os::Stamp                          m_stamp;
+    bool                                     m_open;
+
+public:
+    localization_stream_publisher();
+    ~localization_stream_publisher();
+
+    bool open(const std::string& port_name);
+    void close();
+    bool isOpen() const { return m_open; }
+
+    //cov can be empty. timestamp <=0 means now.
+    void publish(const yarp::dev::Nav2D::Map2DLocation& loc, const yarp::sig::Matrix& cov, double timestamp = 0);
+};
+
+class localization_stream_reader : public yarp::os::TypedReaderCallback<yarp::os::Bottle>
+{
+    yarp::os::BufferedPort<yarp::os::Bottle> m_port;
+    seqlock_slot<localization_stream_data>   m_data;
+    double                                   m_timeout;
+    bool                                     m_open;
+    std::string                              m_local_port_name;
+    std::string                              m_remote_port_name;
+    std::mutex                               m_connect_mutex;
+    double                                   m_last_connect_attempt;
+
+public:
+    localization_stream_reader();
+    ~localization_stream_reader();
+
+    //opens the local port and connects it to the remote one. If the connection fails, the clients use
+    //the rpc interface until the remote port is connected: getCurrentPosition() retries the connection,
+    //at most once per second, while the local port is not connected. An estimate older than timeout seconds
+    //is not used, timeout <= 0 means that the latest estimate is always valid.
+    bool open(const std::string& local_port_name, const std::string& remote_port_name, double timeout);
+    void close();
+    bool isOpen() const { return m_open; }
+
+    //returns false if no estimate has been received yet or if the latest one is too old
+    bool getCurrentPosition(yarp::dev::Nav2D::Map2DLocation& loc);
+    bool getCurrentPosition(yarp::dev::Nav2D::Map2DLocation& loc, yarp::sig::Matrix& cov, double& timestamp);
+
+    using yarp::os::TypedReaderCallback<yarp::os::Bottle>::onRead;
+    void onRead(yarp::os::Bottle& b) override;
+
+private:
+    bool getLatest(localization_stream_data& data);
+    void retryConnect();
+};
+
+#endif
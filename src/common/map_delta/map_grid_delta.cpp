@@ -0,0 +1,246 @@
+/*
+ * Copyright (C) 2020 Istituto Italiano di Tecnologia (IIT)
+ * All rights reserved.
+ *
+ * This software may be modified and distributed under the terms of the
+ * GPL-2+ license. See the accompanying LICENSE file for details.
+ */
+
+#include "map_grid_delta.h"
+#include <yarp/os/LogStream.h>
+#include <vector>
+#include <algorithm>
+#include <utility>
+
+using namespace yarp::os;
+using namespace yarp::dev::Nav2D;
+
+void map_grid_delta::cell_rect::include(size_t x, size_t y)
+{
+    if (empty())
+    {
+        x0 = x; y0 = y; w = 1; h = 1;
+        return;
+    }
+    size_t x1 = std::max(x0 + w, x + 1);
+    size_t y1 = std::max(y0 + h, y + 1);
+    x0 = std::min(x0, x);
+    y0 = std::min(y0, y);
+    w = x1 - x0;
+    h = y1 - y0;
+}
+
+void map_grid_delta::cell_rect::include(const cell_rect& other)
+{
+    if (other.empty()) return;
+    include(other.x0, other.y0);
+    include(other.x0 + other.w - 1, other.y0 + other.h - 1);
+}
+
+map_grid_delta::cell_rect map_grid_delta::changed_region(const MapGrid2D& old_map, const MapGrid2D& new_map)
+{
+    cell_rect all;
+    all.w = new_map.width();
+    all.h = new_map.height();
+    return changed_region(old_map, new_map, all);
+}
+
+map_grid_delta::cell_rect map_grid_delta::changed_region(const MapGrid2D& old_map, const MapGrid2D& new_map, const cell_rect& within)
+{
+    cell_rect rect;
+    if (old_map.width() != new_map.width() ||
+        old_map.height() != new_map.height())
+    {
+        rect.w = new_map.width();
+        rect.h = new_map.height();
+        return rect;
+    }
+    size_t x1 = std::min(within.x0 + within.w, new_map.width());
+    size_t y1 = std::min(within.y0 + within.h, new_map.height());
+    for (size_t y = within.y0; y < y1; y++)
+        for (size_t x = within.x0; x < x1; x++)
+        {
+            MapGrid2D::map_flags flag_old;
+            MapGrid2D::map_flags flag_new;
+            old_map.getMapFlag(XYCell(x, y), flag_old);
+            new_map.getMapFlag(XYCell(x, y), flag_new);
+            if (flag_old != flag_new) rect.include(x, y);
+        }
+    return rect;
+}
+
+map_grid_delta::cell_rect map_grid_delta::roi_around(const MapGrid2D& map, double x, double y, double radius_m)
+{
+    cell_rect rect;
+    double resolution = 0;
+    map.getResolution(resolution);
+    if (resolution <= 0 || map.isInsideMap(XYWorld(x, y)) == false)
+    {
+        return rect;
+    }
+    XYCell center = map.world2Cell(XYWorld(x, y));
+    long radius_cells = (long)(radius_m / resolution);
+    long xmin = std::max(0L, (long)center.x - radius_cells);
+    long ymin = std::max(0L, (long)center.y - radius_cells);
+    long xmax = std::min((long)map.width() - 1, (long)center.x + radius_cells);
+    long ymax = std::min((long)map.height() - 1, (long)center.y + radius_cells);
+    rect.x0 = xmin;
+    rect.y0 = ymin;
+    rect.w = xmax - xmin + 1;
+    rect.h = ymax - ymin + 1;
+    return rect;
+}
+
+void map_grid_delta::encode(const MapGrid2D& map, const cell_rect& rect, bool pack_as_blob, Bottle& data)
+{
+    data.addInt32((int)rect.x0);
+    data.addInt32((int)rect.y0);
+    data.addInt32((int)rect.w);
+    data.addInt32((int)rect.h);
+
+    std::vector<unsigned char> blob;
+    Bottle* runs = nullptr;
+    if (!pack_as_blob) runs = &data.addList();
+
+    auto add_run = [&](MapGrid2D::map_flags flag, size_t count)
+    {
+        if (pack_as_blob)
+        {
+            blob.push_back((unsigned char)flag);
+            do
+            {
+                unsigned char byte = count & 0x7F;
+                count >>= 7;
+                if (count) byte |= 0x80;
+                blob.push_back(byte);
+            } while (count);
+        }
+        else
+        {
+            runs->addInt32((int)flag);
+            runs->addInt32((int)count);
+        }
+    };
+
+    MapGrid2D::map_flags run_flag = MapGrid2D::MAP_CELL_UNKNOWN;
+    size_t run_length = 0;
+    for (size_t y = rect.y0; y < rect.y0 + rect.h; y++)
+        for (size_t x = rect.x0; x < rect.x0 + rect.w; x++)
+        {
+            MapGrid2D::map_flags flag;
+            map.getMapFlag(XYCell(x, y), flag);
+            if (run_length > 0 && flag == run_flag)
+            {
+                run_length++;
+            }
+            else
+            {
+                if (run_length > 0) add_run(run_flag, run_length);
+                run_flag = flag;
+                run_length = 1;
+            }
+        }
+    if (run_length > 0) add_run(run_flag, run_length);
+
+    if (pack_as_blob)
+    {
+        data.add(Value(blob.data(), (int)blob.size()));
+    }
+}
+
+bool map_grid_delta::decode(const Bottle& data, MapGrid2D& map)
+{
+    if (data.size() != 5)
+    {
+        yError() << "map_grid_delta::decode() invalid data size";
+        return false;
+    }
+    int x0 = data.get(0).asInt32();
+    int y0 = data.get(1).asInt32();
+    int w = data.get(2).asInt32();
+    int h = data.get(3).asInt32();
+    if (x0 < 0 || y0 < 0 || w < 0 || h < 0)
+    {
+        yError() << "map_grid_delta::decode() invalid region";
+        return false;
+    }
+    cell_rect rect;
+    rect.x0 = x0;
+    rect.y0 = y0;
+    rect.w = w;
+    rect.h = h;
+    if (rect.x0 + rect.w > map.width() || rect.y0 + rect.h > map.height())
+    {
+        yError() << "map_grid_delta::decode() region exceeds the map size";
+        return false;
+    }
+
+    //the runs are parsed and validated first, so that the map is left untouched if data is malformed
+    std::vector<std::pair<MapGrid2D::map_flags, size_t>> run_list;
+    size_t total = rect.w * rect.h;
+    size_t cells = 0;
+    auto add_run = [&](long long flag, long long count) -> bool
+    {
+        if (flag < 0 || flag > (long long)MapGrid2D::MAP_CELL_UNKNOWN ||
+            count < 0 || (size_t)count > total - cells)
+        {
+            return false;
+        }
+        cells += (size_t)count;
+        run_list.push_back(std::make_pair((MapGrid2D::map_flags)flag, (size_t)count));
+        return true;
+    };
+
+    bool valid = true;
+    const Value& runs = data.get(4);
+    if (runs.isBlob())
+    {
+        const unsigned char* p = (const unsigned char*)runs.asBlob();
+        const unsigned char* end = p + runs.asBlobLength();
+        while (valid && p < end)
+        {
+            int flag = *p++;
+            unsigned long long count = 0;
+            int shift = 0;
+            bool last = false;
+            while (p < end && shift < 63)
+            {
+                unsigned char byte = *p++;
+                count |= (unsigned long long)(byte & 0x7F) << shift;
+                shift += 7;
+                if ((byte & 0x80) == 0) { last = true; break; }
+            }
+            //a truncated or too long varint, or a count which does not fit the region
+            valid = last && count <= total && add_run(flag, (long long)count);
+        }
+    }
+    else if (runs.isList())
+    {
+        const Bottle* l = runs.asList();
+        valid = (l->size() % 2 == 0);
+        for (size_t i = 0; valid && i + 1 < l->size(); i += 2)
+        {
+            valid = add_run(l->get(i).asInt32(), l->get(i + 1).asInt32());
+        }
+    }
+    else
+    {
+        valid = false;
+    }
+
+    if (!valid || cells != total)
+    {
+        yError() << "map_grid_delta::decode() the encoded runs do not match the region size";
+        return false;
+    }
+
+    size_t cell = 0;
+    for (const auto& run : run_list)
+    {
+        for (size_t i = 0; i < run.second; i++, cell++)
+        {
+            map.setMapFlag(XYCell(rect.x0 + cell % rect.w, rect.y0 + cell / rect.w), run.first);
+        }
+    }
+    return true;
+}
@@ -0,0 +1,56 @@
+/*
+ * Copyright (C) 2020 Istituto Italiano di Tecnologia (IIT)
+ * All rights reserved.
+ *
+ * This software may be modified and distributed under the terms of the
+ * GPL-2+ license. See the accompanying LICENSE file for details.
+ */
+
+#ifndef MAP_GRID_DELTA_H
+#define MAP_GRID_DELTA_H
+
+#include <yarp/os/Bottle.h>
+#include <yarp/dev/MapGrid2D.h>
+#include <string>
+
+//! Helper functions to transmit a rectangular portion of the flags layer of a MapGrid2D, run-length encoded.
+//! Used by the navigation devices to send only the changed region of the local (obstacles) map to the clients.
+namespace map_grid_delta
+{
+    //a rectangular region of a map, expressed in cells
+    struct cell_rect
+    {
+        size_t x0 = 0;
+        size_t y0 = 0;
+        size_t w = 0;
+        size_t h = 0;
+
+        bool   empty() const { return w == 0 || h == 0; }
+
+        //extends the rectangle to include the cell (x,y)
+        void   include(size_t x, size_t y);
+
+        //extends the rectangle to include another rectangle
+        void   include(const cell_rect& other);
+    };
+
+    //returns the bounding box of the cells which have a different flag in the two maps.
+    //The two maps must have the same size, otherwise the whole map is returned.
+    cell_rect changed_region(const yarp::dev::Nav2D::MapGrid2D& old_map, const yarp::dev::Nav2D::MapGrid2D& new_map);
+
+    //as above, but only the cells inside the region within are compared
+    cell_rect changed_region(const yarp::dev::Nav2D::MapGrid2D& old_map, const yarp::dev::Nav2D::MapGrid2D& new_map, const cell_rect& within);
+
+    //returns the region of radius_m meters around the world position (x,y), clipped to the map size
+    cell_rect roi_around(const yarp::dev::Nav2D::MapGrid2D& map, double x, double y, double radius_m);
+
+    //appends to data the encoded region: x0 y0 w h (runs).
+    //runs is a list of (flag count) pairs or, if pack_as_blob is true, a binary blob made of
+    //a one-byte flag followed by a varint count, for each run.
+    void encode(const yarp::dev::Nav2D::MapGrid2D& map, const cell_rect& rect, bool pack_as_blob, yarp::os::Bottle& data);
+
+    //applies to map a region previously encoded by encode(). Returns false, leaving map unchanged, if data is malformed.
+    bool decode(const yarp::os::Bottle& data, yarp::dev::Nav2D::MapGrid2D& map);
+}
+
+#endif
@@ -0,0 +1,164 @@
+/*
+ * Copyright (C) 2020 Istituto Italiano di Tecnologia (IIT)
+ * All rights reserved.
+ *
+ * This software may be modified and distributed under the terms of the
+ * GPL-2+ license. See the accompanying LICENSE file for details.
+ */
+
+#include "map_layers.h"
+#include <yarp/sig/Image.h>
+#include <yarp/os/LogStream.h>
+#include <cstring>
+
+using namespace yarp::dev::Nav2D;
+
+namespace map_layers
+{
+    bool get_occupancy(const MapGrid2D& map, grid_layer& occupancy)
+    {
+        yarp::sig::ImageOf<yarp::sig::PixelMono> image;
+        if (!map.getOccupancyGrid(image)) return false;
+        occupancy.resize(image.width(), image.height());
+        //the rows of the image can be padded
+        for (size_t y = 0; y < occupancy.height; y++)
+        {
+            std::memcpy(occupancy.row(y), image.getRow(y), occupancy.width);
+        }
+        return true;
+    }
+
+    bool set_occupancy(MapGrid2D& map, const grid_layer& occupancy)
+    {
+        if (occupancy.width != map.width() || occupancy.height != map.height())
+        {
+            yError() << "map_layers::set_occupancy: the layer and the map must have the same size";
+            return false;
+        }
+        yarp::sig::ImageOf<yarp::sig::PixelMono> image;
+        image.setQuantum(1);
+        image.resize(occupancy.width, occupancy.height);
+        for (size_t y = 0; y < occupancy.height; y++)
+        {
+            std::memcpy(image.getRow(y), occupancy.row(y), occupancy.width);
+        }
+        return map.setOccupancyGrid(image);
+    }
+
+    bool get_flags(const MapGrid2D& map, grid_layer& flags)
+    {
+        flags.resize(map.width(), map.height());
+        XYCell cell;
+        for (cell.y = 0; cell.y < flags.height; cell.y++)
+        {
+            unsigned char* r = flags.row(cell.y);
+            for (cell.x = 0; cell.x < flags.width; cell.x++)
+            {
+                MapGrid2D::map_flags flag = MapGrid2D::MAP_CELL_UNKNOWN;
+                map.getMapFlag(cell, flag);
+                r[cell.x] = (unsigned char)flag;
+            }
+        }
+        return true;
+    }
+
+    bool set_flags(MapGrid2D& map, const grid_layer& flags)
+    {
+        if (flags.width != map.width() || flags.height != map.height())
+        {
+            yError() << "map_layers::set_flags: the layer and the map must have the same size";
+            return false;
+        }
+        XYCell cell;
+        for (cell.y = 0; cell.y < flags.height; cell.y++)
+        {
+            const unsigned char* r = flags.row(cell.y);
+            for (cell.x = 0; cell.x < flags.width; cell.x++)
+            {
+                map.setMapFlag(cell, (MapGrid2D::map_flags)r[cell.x]);
+            }
+        }
+        return true;
+    }
+
+    void flags_to_mask(const grid_layer& flags, unsigned int flag_set, unsigned char value_in, unsigned char value_out,
+                       unsigned char* out, size_t stride)
+    {
+        unsigned char lut[256];
+        for (int v = 0; v < 256; v++)
+        {
+            lut[v] = (v < 32 && (flag_set & (1u << v))) ? value_in : value_out;
+        }
+        for (size_t y = 0; y < flags.height; y++)
+        {
+            const unsigned char* src = flags.row(y);
+            unsigned char* dst = out + y * stride;
+            for (size_t x = 0; x < flags.width; x++)
+            {
+                dst[x] = lut[src[x]];
+            }
+        }
+    }
+
+    void to_ros_occupancy(const grid_layer& occupancy, std::vector<std::int8_t>& data)
+    {
+        std::int8_t lut[256];
+        for (int v = 0; v < 256; v++)
+        {
+            lut[v] = (std::int8_t)(int)occupancy_percent((unsigned char)v);
+        }
+        data.resize(occupancy.size());
+        std::int8_t* dst = data.data();
+        for (size_t y = occupancy.height; y-- > 0;)
+        {
+            const unsigned char* src = occupancy.row(y);
+            for (size_t x = 0; x < occupancy.width; x++)
+            {
+                *dst++ = lut[src[x]];
+            }
+        }
+    }
+
+    void from_ros_occupancy(const std::vector<std::int8_t>& data, size_t width, size_t height, int free_threshold,
+                            grid_layer& occupancy, grid_layer& flags)
+    {
+        //same encoding of MapGrid2D::setOccupancyData()
+        unsigned char occ_lut[256];
+        unsigned char flag_lut[256];
+        for (int v = -128; v < 128; v++)
+        {
+            unsigned char i = (unsigned char)(std::int8_t)v;
+            if (v < 0 || v > 100)
+            {
+                occ_lut[i] = 255;
+                flag_lut[i] = MapGrid2D::MAP_CELL_UNKNOWN;
+            }
+            else
+            {
+                occ_lut[i] = (unsigned char)(v / 100.0 * 254);
+                flag_lut[i] = (v <= free_threshold) ? MapGrid2D::MAP_CELL_FREE : MapGrid2D::MAP_CELL_WALL;
+            }
+        }
+        occupancy.resize(width, height);
+        flags.resize(width, height);
+        if (data.size() < width * height)
+        {
+            yError() << "map_layers::from_ros_occupancy: invalid data size";
+            std::memset(occupancy.data.data(), 255, occupancy.size());
+            std::memset(flags.data.data(), MapGrid2D::MAP_CELL_UNKNOWN, flags.size());
+            return;
+        }
+        const std::int8_t* src = data.data();
+        for (size_t y = height; y-- > 0;)
+        {
+            unsigned char* occ = occupancy.row(y);
+            unsigned char* flg = flags.row(y);
+            for (size_t x = 0; x < width; x++)
+            {
+                unsigned char i = (unsigned char)*src++;
+                occ[x] = occ_lut[i];
+                flg[x] = flag_lut[i];
+            }
+        }
+    }
+}
@@ -0,0 +1,94 @@
+/*
+ * Copyright (C) 2020 Istituto Italiano di Tecnologia (IIT)
+ * All rights reserved.
+ *
+ * This software may be modified and distributed under the terms of the
+ * GPL-2+ license. See the accompanying LICENSE file for details.
+ */
+
+#ifndef MAP_LAYERS_H
+#define MAP_LAYERS_H
+
+#include <yarp/dev/MapGrid2D.h>
+#include <cstdint>
+#include <vector>
+
+//! Bulk access to the layers of a MapGrid2D, and conversions to the map formats used by the other modules
+//! (AMCL map_t, the planner grid, ROS OccupancyGrid, OpenCV images).
+//! The converters work on a contiguous copy of a layer instead of calling getOccupancyData()/getMapFlag()
+//! for each cell.
+namespace map_layers
+{
+    //a layer of a MapGrid2D, row major: the cell (x,y) is data[y*width+x]
+    struct grid_layer
+    {
+        size_t width = 0;
+        size_t height = 0;
+        std::vector<unsigned char> data;
+
+        void                 resize(size_t w, size_t h) { width = w; height = h; data.resize(w * h); }
+        size_t               size() const { return data.size(); }
+        unsigned char*       row(size_t y) { return data.data() + y * width; }
+        const unsigned char* row(size_t y) const { return data.data() + y * width; }
+    };
+
+    //the occupancy layer, with the MapGrid2D encoding: 0..254 (0..100%), 255 unknown. A single bulk copy.
+    bool get_occupancy(const yarp::dev::Nav2D::MapGrid2D& map, grid_layer& occupancy);
+    bool set_occupancy(yarp::dev::Nav2D::MapGrid2D& map, const grid_layer& occupancy);
+
+    //the flags layer, one MapGrid2D::map_flags per cell.
+    //MapGrid2D does not expose its flags buffer, so this is a single getMapFlag() pass, made once per map.
+    bool get_flags(const yarp::dev::Nav2D::MapGrid2D& map, grid_layer& flags);
+    bool set_flags(yarp::dev::Nav2D::MapGrid2D& map, const grid_layer& flags);
+
+    //a set of flags, e.g. flag_bit(MAP_CELL_WALL) | flag_bit(MAP_CELL_UNKNOWN)
+    inline unsigned int flag_bit(yarp::dev::Nav2D::MapGrid2D::map_flags flag) { return 1u << flag; }
+
+    //the occupancy in percent (0..100, -1 unknown), the same value returned by MapGrid2D::getOccupancyData()
+    inline double occupancy_percent(unsigned char v) { return (v == 255) ? -1.0 : v / 254.0 * 100.0; }
+
+    //AMCL occupancy state: -1 free, 0 unknown, +1 occupied (occupancy > occupied_threshold percent).
+    //cells is an array of occupancy.size() structures with an occ_state member (e.g. AMCL map_cell_t).
+    //The indices of the free cells are stored in free_cells, if not null.
+    template <typename cell_t>
+    void to_occ_state(const grid_layer& occupancy, double occupied_threshold, cell_t* cells, std::vector<int>* free_cells)
+    {
+        signed char lut[256];
+        for (int v = 0; v < 256; v++)
+        {
+            double occ = occupancy_percent((unsigned char)v);
+            lut[v] = (occ < 0) ? 0 : ((occ > occupied_threshold) ? +1 : -1);
+        }
+        const unsigned char* src = occupancy.data.data();
+        size_t n = occupancy.size();
+        if (free_cells)
+        {
+            //counting the free cells first is cheaper than growing the vector
+            size_t free_count = 0;
+            for (size_t i = 0; i < n; i++) free_count += (lut[src[i]] < 0);
+            free_cells->clear();
+            free_cells->reserve(free_count);
+        }
+        for (size_t i = 0; i < n; i++)
+        {
+            signed char state = lut[src[i]];
+            cells[i].occ_state = state;
+            if (state < 0 && free_cells) free_cells->push_back((int)i);
+        }
+    }
+
+    //writes value_in in the cells whose flag is in flag_set, value_out in the others.
+    //out is a buffer of height rows, stride bytes each (e.g. a planner grid, or a cv::Mat/IplImage of one channel).
+    void flags_to_mask(const grid_layer& flags, unsigned int flag_set, unsigned char value_in, unsigned char value_out,
+                       unsigned char* out, size_t stride);
+
+    //ROS nav_msgs/OccupancyGrid data: percent, -1 unknown. The ROS grid starts from the bottom row (y = height-1).
+    void to_ros_occupancy(const grid_layer& occupancy, std::vector<std::int8_t>& data);
+
+    //the inverse of to_ros_occupancy(). The flags are computed from the occupancy as well:
+    //FREE if 0 <= occupancy <= free_threshold, WALL if > free_threshold, UNKNOWN otherwise.
+    void from_ros_occupancy(const std::vector<std::int8_t>& data, size_t width, size_t height, int free_threshold,
+                            grid_layer& occupancy, grid_layer& flags);
+}
+
+#endif
@@ -0,0 +1,209 @@
+/*
+ * Copyright (C) 2020 Istituto Italiano di Tecnologia (IIT)
+ * All rights reserved.
+ *
+ * This software may be modified and distributed under the terms of the
+ * GPL-2+ license. See the accompanying LICENSE file for details.
+ */
+
+#include "map_odom_stream.h"
+#include <yarp/os/Network.h>
+#include <yarp/os/Time.h>
+#include <yarp/os/LogStream.h>
+#include <cmath>
+
+using namespace yarp::os;
+using namespace yarp::dev;
+using namespace yarp::dev::Nav2D;
+
+#ifndef M_PI
+#define M_PI 3.14159265358979323846
+#endif
+
+#define DEG2RAD M_PI/180
+
+namespace map_odom
+{
+    Map2DLocation correction(const Map2DLocation& map_pose, const Map2DLocation& odom_pose)
+    {
+        Map2DLocation c;
+        c.map_id = map_pose.map_id;
+        c.theta = map_pose.theta - odom_pose.theta;
+        double ct = cos(c.theta * DEG2RAD);
+        double st = sin(c.theta * DEG2RAD);
+        c.x = map_pose.x - (ct * odom_pose.x - st * odom_pose.y);
+        c.y = map_pose.y - (st * odom_pose.x + ct * odom_pose.y);
+        return c;
+    }
+
+    Map2DLocation compose(const Map2DLocation& correction, const Map2DLocation& odom_pose)
+    {
+        Map2DLocation loc;
+        loc.map_id = correction.map_id;
+        double ct = cos(correction.theta * DEG2RAD);
+        double st = sin(correction.theta * DEG2RAD);
+        loc.x = correction.x + ct * odom_pose.x - st * odom_pose.y;
+        loc.y = correction.y + st * odom_pose.x + ct * odom_pose.y;
+        loc.theta = correction.theta + odom_pose.theta;
+        return loc;
+    }
+}
+
+map_odom_stream_publisher::map_odom_stream_publisher()
+{
+    m_last_timestamp = 0;
+    m_last_published = 0;
+    m_valid = false;
+}
+
+bool map_odom_stream_publisher::open(const std::string& port_name)
+{
+    return m_stream.open(port_name);
+}
+
+void map_odom_stream_publisher::close()
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+    m_stream.close();
+    m_valid = false;
+}
+
+void map_odom_stream_publisher::publish(const Map2DLocation& correction, double timestamp)
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+    if (!m_stream.isOpen()) return;
+    if (m_valid &&
+        correction.map_id == m_last_correction.map_id &&
+        correction.x == m_last_correction.x &&
+        correction.y == m_last_correction.y &&
+        correction.theta == m_last_correction.theta)
+    {
+        return;
+    }
+    m_last_correction = correction;
+    m_last_timestamp = timestamp > 0 ? timestamp : Time::now();
+    m_last_published = Time::now();
+    m_valid = true;
+    m_stream.publish(m_last_correction, yarp::sig::Matrix(), m_last_timestamp);
+}
+
+void map_odom_stream_publisher::refresh(double period)
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+    if (!m_stream.isOpen() || !m_valid) return;
+    double now = Time::now();
+    if (now - m_last_published < period) return;
+    m_last_published = now;
+    m_stream.publish(m_last_correction, yarp::sig::Matrix(), m_last_timestamp);
+}
+
+map_odom_stream_reader::map_odom_stream_reader()
+{
+    m_timeout = 0.1;
+    m_open = false;
+    m_last_connect_attempt = 0;
+}
+
+map_odom_stream_reader::~map_odom_stream_reader()
+{
+    close();
+}
+
+bool map_odom_stream_reader::open(const std::string& local_prefix, const std::string& remote_correction_port, const std::string& remote_odometry_port, double timeout)
+{
+    m_timeout = timeout;
+    //the correction changes only when the filter corrects the odometry, hence it never expires
+    if (!m_correction.open(local_prefix + "/map_odom:i", remote_correction_port, 0))
+    {
+        return false;
+    }
+    std::string odometry_port_name = local_prefix + "/odometry:i";
+    if (!m_odometry_port.open(odometry_port_name))
+    {
+        yError() << "map_odom_stream_reader: unable to open port" << odometry_port_name;
+        m_correction.close();
+        return false;
+    }
+    m_odometry_port.useCallback(*this);
+    m_open = true;
+    m_odometry_port_name = odometry_port_name;
+    m_remote_odometry_port_name = remote_odometry_port;
+
+    m_last_connect_attempt = Time::now();
+    if (!Network::connect(remote_odometry_port, odometry_port_name))
+    {
+        yWarning() << "map_odom_stream_reader: unable to connect to" << remote_odometry_port << ", the localization will be read through the rpc interface until it is available";
+    }
+    return true;
+}
+
+void map_odom_stream_reader::retryConnect()
+{
+    //the caller is not blocked by a retry in progress in another thread
+    std::unique_lock<std::mutex> lock(m_connect_mutex, std::try_to_lock);
+    if (!lock.owns_lock()) return;
+    double now = Time::now();
+    if (now - m_last_connect_attempt < 1.0) return;
+    m_last_connect_attempt = now;
+    if (m_odometry_port.getInputCount() > 0) return;
+    if (Network::connect(m_remote_odometry_port_name, m_odometry_port_name))
+    {
+        yInfo() << "map_odom_stream_reader: connected to" << m_remote_odometry_port_name;
+    }
+}
+
+void map_odom_stream_reader::close()
+{
+    if (!m_open) return;
+    m_odometry_port.interrupt();
+    m_odometry_port.disableCallback();
+    m_odometry_port.close();
+    m_correction.close();
+    m_open = false;
+}
+
+void map_odom_stream_reader::onRead(OdometryData& odom)
+{
+    //called by the port thread only, which is the single writer of m_odometry
+    map_odom_odometry_data data;
+    data.x = odom.odom_x;
+    data.y = odom.odom_y;
+    data.theta = odom.odom_theta;
+    data.received_time = Time::now();
+    Stamp stamp;
+    data.timestamp = (m_odometry_port.getEnvelope(stamp) && stamp.isValid()) ? stamp.getTime() : data.received_time;
+    m_odometry.write(data);
+}
+
+bool map_odom_stream_reader::getCurrentPosition(Map2DLocation& loc)
+{
+    double timestamp;
+    return getCurrentPosition(loc, timestamp);
+}
+
+bool map_odom_stream_reader::getCurrentPosition(Map2DLocation& loc, double& timestamp)
+{
+    if (!m_open) return false;
+
+    map_odom_odometry_data odom;
+    //version 0: nothing received yet
+    if (m_odometry.read(odom) == 0 || Time::now() - odom.received_time > m_timeout)
+    {
+        //the remote port may have been opened (or restarted) after the connection attempt
+        retryConnect();
+        return false;
+    }
+
+    Map2DLocation correction;
+    yarp::sig::Matrix cov;
+    double correction_timestamp;
+    if (!m_correction.getCurrentPosition(correction, cov, correction_timestamp)) return false;
+
+    Map2DLocation odom_pose;
+    odom_pose.x = odom.x;
+    odom_pose.y = odom.y;
+    odom_pose.theta = odom.theta;
+    loc = map_odom::compose(correction, odom_pose);
+    timestamp = odom.timestamp;
+    return true;
+}
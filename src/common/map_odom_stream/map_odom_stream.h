@@ -0,0 +1,102 @@
+/*
+ * Copyright (C) 2020 Istituto Italiano di Tecnologia (IIT)
+ * All rights reserved.
+ *
+ * This software may be modified and distributed under the terms of the
+ * GPL-2+ license. See the accompanying LICENSE file for details.
+ */
+
+#ifndef MAP_ODOM_STREAM_H
+#define MAP_ODOM_STREAM_H
+
+#include <yarp/os/BufferedPort.h>
+#include <yarp/os/TypedReaderCallback.h>
+#include <yarp/dev/Map2DLocation.h>
+#include <yarp/dev/OdometryData.h>
+#include <localization_stream.h>
+#include <seqlock.h>
+#include <mutex>
+#include <string>
+
+//! The map->odom correction of a localization device, i.e. the transform such that map_pose = correction * odom_pose.
+//! The device publishes the correction when it changes (at the rate of the filter corrections, not at the odometry rate),
+//! with the message format of localization_stream. The clients (robotGoto, navigationGUI) compose it with the odometry
+//! of the robot, so they compute the current pose locally at the odometry rate, without any RPC to the localization device.
+
+namespace map_odom
+{
+    //x, y [m], theta [deg]
+    yarp::dev::Nav2D::Map2DLocation correction(const yarp::dev::Nav2D::Map2DLocation& map_pose, const yarp::dev::Nav2D::Map2DLocation& odom_pose);
+    yarp::dev::Nav2D::Map2DLocation compose(const yarp::dev::Nav2D::Map2DLocation& correction, const yarp::dev::Nav2D::Map2DLocation& odom_pose);
+}
+
+class map_odom_stream_publisher
+{
+    localization_stream_publisher    m_stream;
+    std::mutex                       m_mutex;
+    yarp::dev::Nav2D::Map2DLocation  m_last_correction;
+    double                           m_last_timestamp;
+    double                           m_last_published;
+    bool                             m_valid;
+
+public:
+    map_odom_stream_publisher();
+
+    bool open(const std::string& port_name);
+    void close();
+    bool isOpen() const { return m_stream.isOpen(); }
+
+    //publishes the correction, if it is different from the last one. timestamp <= 0 means now.
+    void publish(const yarp::dev::Nav2D::Map2DLocation& correction, double timestamp = 0);
+
+    //publishes again the last correction if it has not been published in the last period seconds, so that
+    //a client connected after the last change receives it. To be called by the periodic thread of the device.
+    void refresh(double period);
+};
+
+//the latest received odometry. Fixed size, so that it can be stored in a seqlock_slot.
+struct map_odom_odometry_data
+{
+    double x;
+    double y;
+    double theta;
+    double timestamp;      //time of the odometry, from the envelope
+    double received_time;  //local time of reception
+};
+
+class map_odom_stream_reader : public yarp::os::TypedReaderCallback<yarp::dev::OdometryData>
+{
+    localization_stream_reader                       m_correction;
+    yarp::os::BufferedPort<yarp::dev::OdometryData>  m_odometry_port;
+    seqlock_slot<map_odom_odometry_data>             m_odometry;
+    double                                           m_timeout;
+    bool                                             m_open;
+    std::string                                      m_odometry_port_name;
+    std::string                                      m_remote_odometry_port_name;
+    std::mutex                                       m_connect_mutex;
+    double                                           m_last_connect_attempt;
+
+public:
+    map_odom_stream_reader();
+    ~map_odom_stream_reader();
+
+    //opens <local_prefix>/map_odom:i and <local_prefix>/odometry:i and connects them to the remote ports. If a connection
+    //fails, the clients use the rpc interface until the remote port is connected: getCurrentPosition() retries the
+    //connections, at most once per second. The correction is valid until a new one is received, the odometry is not used
+    //if it is older than timeout seconds.
+    bool open(const std::string& local_prefix, const std::string& remote_correction_port, const std::string& remote_odometry_port, double timeout);
+    void close();
+    bool isOpen() const { return m_open; }
+
+    //returns false if the correction or a recent odometry have not been received
+    bool getCurrentPosition(yarp::dev::Nav2D::Map2DLocation& loc);
+    bool getCurrentPosition(yarp::dev::Nav2D::Map2DLocation& loc, double& timestamp);
+
+    using yarp::os::TypedReaderCallback<yarp::dev::OdometryData>::onRead;
+    void onRead(yarp::dev::OdometryData& odom) override;
+
+private:
+    void retryConnect();
+};
+
+#endif
@@ -6,9 +6,13 @@
    GPL-2+ license. See the accompanying LICENSE file for details.
 */
 
+
 #define _USE_MATH_DEFINES
 #include "localization_device_with_estimated_odometry.h"
-#include <yarp/math/Math.h>
+#include <yarp/os/LogStream.h>
+#include <yarp/os/Time.h>
+#include <yarp/os/Value.h>
+#include <math.h>
 
 using namespace yarp::os;
 using namespace yarp::dev::Nav2D;
@@ -23,49 +27,183 @@ using namespace yarp::dev::Nav2D;
 
 
 //////////////////////////
-localization_device_with_estimated_odometry::localization_device_with_estimated_odometry()
+const size_t localization_device_with_estimated_odometry::max_window_size;
+
+localization_device_with_estimated_odometry::localization_device_with_estimated_odometry(size_t window_size, double threshold, bool adaptive)
 {
-    m_estimator = new iCub::ctrl::AWLinEstimator(3, 3);
+    m_window_size = 3;
+    m_threshold = 3.0;
+    m_adaptive = true;
+    reset();
+    setWindow(window_size, threshold, adaptive);
 }
 
 localization_device_with_estimated_odometry::~localization_device_with_estimated_odometry()
 {
-    delete m_estimator;
-    m_estimator=nullptr;
 }
 
-yarp::dev::OdometryData localization_device_with_estimated_odometry::estimate(const yarp::dev::Nav2D::Map2DLocation& m_localization_data)
+bool localization_device_with_estimated_odometry::configure(const yarp::os::Searchable& config)
 {
-    m_current_odom_mutex.lock();
-    //m_current_loc is in the world reference frame.
-    // hence this velocity is estimated in the world reference frame.
-    iCub::ctrl::AWPolyElement el;
-    el.data = yarp::sig::Vector(3);
-    el.data[0] = m_current_odom.odom_x = m_localization_data.x;
-    el.data[1] = m_current_odom.odom_y = m_localization_data.y;
-    el.data[2] = m_current_odom.odom_theta = m_localization_data.theta;
-    el.time = Time::now();
-    m_odom_vel.resize(3, 0.0);
-    m_odom_vel = m_estimator->estimate(el);
-    m_current_odom.odom_vel_x = m_odom_vel[0];
-    m_current_odom.odom_vel_y = m_odom_vel[1];
-    m_current_odom.odom_vel_theta = m_odom_vel[2];
-
-    //this is the velocity in robot reference frame.
-    //NB: for a non-holonomic robot robot_vel[1] ~= 0
-    m_robot_vel.resize(3, 0.0);
-    m_robot_vel[0] = m_odom_vel[0] * cos(m_localization_data.theta * DEG2RAD) - m_odom_vel[0] * sin(m_localization_data.theta * DEG2RAD);
-    m_robot_vel[1] = m_odom_vel[1] * sin(m_localization_data.theta * DEG2RAD) + m_odom_vel[1] * cos(m_localization_data.theta * DEG2RAD);
-    m_robot_vel[2] = m_odom_vel[2];
-    m_current_odom.base_vel_x = m_robot_vel[0];
-    m_current_odom.base_vel_y = m_robot_vel[1];
-    m_current_odom.base_vel_theta = m_robot_vel[2];
-
-    m_current_odom_mutex.unlock();
-    return m_current_odom;
+    int window_size = config.check("window_size", Value((int)m_window_size)).asInt();
+    double threshold = config.check("threshold", Value(m_threshold)).asDouble();
+    bool adaptive = config.check("adaptive", Value(m_adaptive)).asBool();
+    if (window_size < 2)
+    {
+        yError() << "localization_device_with_estimated_odometry: invalid window_size" << window_size;
+        return false;
+    }
+    return setWindow((size_t)window_size, threshold, adaptive);
+}
+
+bool localization_device_with_estimated_odometry::setWindow(size_t window_size, double threshold, bool adaptive)
+{
+    if (window_size < 2 || window_size > max_window_size || threshold <= 0)
+    {
+        yError() << "localization_device_with_estimated_odometry: window_size must be in [2," << max_window_size << "] and threshold > 0";
+        return false;
+    }
+    std::lock_guard<std::mutex> lock(m_mutex);
+    m_window_size = window_size;
+    m_threshold = threshold;
+    m_adaptive = adaptive;
+    //the stored poses are kept, up to the new window size
+    if (m_count > m_window_size) m_count = m_window_size;
+    return true;
+}
+
+void localization_device_with_estimated_odometry::reset()
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+    m_count = 0;
+    m_newest = 0;
+    m_last_theta = 0;
+    m_current_odom = yarp::dev::OdometryData();
+    publish();
+}
+
+double localization_device_with_estimated_odometry::velocity(size_t dim) const
+{
+    if (m_count < 2) return 0;
+
+    //least squares line on the last n poses, with the time relative to the newest one
+    double sx = 0, sy = 0, sxx = 0, sxy = 0;
+    double t0 = sample(0).t;
+    double accepted_slope = 0;
+    for (size_t n = 1; n <= m_count; n++)
+    {
+        const pose_sample& s = sample(n - 1);
+        double x = s.t - t0;
+        sx += x;
+        sy += s.v[dim];
+        sxx += x * x;
+        sxy += x * s.v[dim];
+        if (n < 2) continue;
+
+        double den = n * sxx - sx * sx;
+        if (den <= 0) break;
+        double slope = (n * sxy - sx * sy) / den;
+        double intercept = (sy - slope * sx) / n;
+
+        if (m_adaptive && n > 2)
+        {
+            //the window stops growing as soon as a pose is not explained by the line
+            bool window_ok = true;
+            for (size_t k = 0; k < n && window_ok; k++)
+            {
+                const pose_sample& p = sample(k);
+                window_ok = fabs(p.v[dim] - (intercept + slope * (p.t - t0))) <= m_threshold;
+            }
+            if (!window_ok) break;
+        }
+        accepted_slope = slope;
+    }
+    return accepted_slope;
 }
 
-yarp::dev::OdometryData localization_device_with_estimated_odometry::getOdometry()
+yarp::dev::OdometryData localization_device_with_estimated_odometry::estimate(const Map2DLocation& loc, double timestamp)
 {
+    if (timestamp <= 0) timestamp = Time::now();
+
+    std::lock_guard<std::mutex> lock(m_mutex);
+
+    //theta is unwrapped, so that the crossing of +-180 degrees is not seen as a fast rotation
+    double theta = loc.theta;
+    if (m_count > 0)
+    {
+        double d = loc.theta - m_last_theta;
+        d = fmod(d + 180.0, 360.0);
+        if (d < 0) d += 360.0;
+        theta = sample(0).v[2] + d - 180.0;
+    }
+    m_last_theta = loc.theta;
+
+    if (m_count > 0 && timestamp <= sample(0).t)
+    {
+        //same (or older) timestamp: the newest pose is updated
+        pose_sample& s = m_samples[m_newest];
+        s.v[0] = loc.x;
+        s.v[1] = loc.y;
+        s.v[2] = theta;
+    }
+    else
+    {
+        m_newest = (m_newest + 1) % max_window_size;
+        pose_sample& s = m_samples[m_newest];
+        s.t = timestamp;
+        s.v[0] = loc.x;
+        s.v[1] = loc.y;
+        s.v[2] = theta;
+        if (m_count < m_window_size) m_count++;
+    }
+
+    //the pose is in the world reference frame, hence this velocity is estimated in the world reference frame.
+    m_current_odom.odom_x = loc.x;
+    m_current_odom.odom_y = loc.y;
+    m_current_odom.odom_theta = loc.theta;
+    m_current_odom.odom_vel_x = velocity(0);
+    m_current_odom.odom_vel_y = velocity(1);
+    m_current_odom.odom_vel_theta = velocity(2);
+
+    //this is the velocity in robot reference frame (the world velocity rotated by -theta).
+    //NB: for a non-holonomic robot base_vel_y ~= 0
+    double c = cos(loc.theta * DEG2RAD);
+    double s = sin(loc.theta * DEG2RAD);
+    m_current_odom.base_vel_x = m_current_odom.odom_vel_x * c + m_current_odom.odom_vel_y * s;
+    m_current_odom.base_vel_y = -m_current_odom.odom_vel_x * s + m_current_odom.odom_vel_y * c;
+    m_current_odom.base_vel_theta = m_current_odom.odom_vel_theta;
+
+    publish();
     return m_current_odom;
-}
\ No newline at end of file
+}
+
+void localization_device_with_estimated_odometry::publish()
+{
+    odometry_snapshot s;
+    s.odom_x = m_current_odom.odom_x;
+    s.odom_y = m_current_odom.odom_y;
+    s.odom_theta = m_current_odom.odom_theta;
+    s.odom_vel_x = m_current_odom.odom_vel_x;
+    s.odom_vel_y = m_current_odom.odom_vel_y;
+    s.odom_vel_theta = m_current_odom.odom_vel_theta;
+    s.base_vel_x = m_current_odom.base_vel_x;
+    s.base_vel_y = m_current_odom.base_vel_y;
+    s.base_vel_theta = m_current_odom.base_vel_theta;
+    m_output.write(s);
+}
+
+yarp::dev::OdometryData localization_device_with_estimated_odometry::getOdometry() const
+{
+    odometry_snapshot s;
+    m_output.read(s);
+    yarp::dev::OdometryData odom;
+    odom.odom_x = s.odom_x;
+    odom.odom_y = s.odom_y;
+    odom.odom_theta = s.odom_theta;
+    odom.odom_vel_x = s.odom_vel_x;
+    odom.odom_vel_y = s.odom_vel_y;
+    odom.odom_vel_theta = s.odom_vel_theta;
+    odom.base_vel_x = s.base_vel_x;
+    odom.base_vel_y = s.base_vel_y;
+    odom.base_vel_theta = s.base_vel_theta;
+    return odom;
+}
@@ -6,36 +6,76 @@
    GPL-2+ license. See the accompanying LICENSE file for details.
 */
 
-#include <yarp/os/Network.h>
-#include <yarp/os/RFModule.h>
-#include <yarp/os/Time.h>
-#include <yarp/os/LogStream.h>
-#include <yarp/dev/PolyDriver.h>
+#ifndef LOCALIZATION_DEVICE_WITH_ESTIMATED_ODOMETRY_H
+#define LOCALIZATION_DEVICE_WITH_ESTIMATED_ODOMETRY_H
+
+#include <yarp/os/Searchable.h>
 #include <yarp/dev/Map2DLocation.h>
 #include <yarp/dev/OdometryData.h>
-#include <yarp/os/Bottle.h>
-#include <yarp/sig/Vector.h>
-#include <yarp/dev/ControlBoardInterfaces.h>
-#include <yarp/dev/IFrameTransform.h>
+#include <seqlock.h>
 #include <mutex>
-#include <math.h>
-#include <iCub/ctrl/adaptWinPolyEstimator.h>
-
-using namespace yarp::os;
+#include <cstddef>
 
+//! Estimates the velocity of the robot from the sequence of its localized poses, for the localization devices
+//! which do not receive the odometry of the robot (ILocalization2D::getEstimatedOdometry()).
+//! The velocity is the slope of a least squares line fitted, for each of x, y, theta, on the last poses:
+//! - adaptive window (default): the window grows from 2 poses up to window_size and stops before the first length for which
+//!   a pose is farther than threshold from the line (the algorithm of iCub::ctrl::AWLinEstimator);
+//! - fixed window: the line is fitted on the last window_size poses.
+//! The poses are stored in a fixed size ring buffer, so estimate() does not allocate memory.
+//! The time of each pose is the timestamp of the source data (e.g. the acquisition time of the sensor), so that
+//! the estimate does not depend on the scheduling of the thread which calls estimate().
+//! getOdometry() is wait-free: the last estimate is published in a seqlock_slot, so the readers never wait for estimate().
 class localization_device_with_estimated_odometry
 {
+public:
+    static const size_t max_window_size = 32;
+
 private:
-    //velocity estimation
-    yarp::sig::Vector            m_odom_vel;
-    yarp::sig::Vector            m_robot_vel;
-    iCub::ctrl::AWLinEstimator*  m_estimator;
-    yarp::dev::OdometryData      m_current_odom;
-    std::mutex                   m_current_odom_mutex;
+    struct pose_sample
+    {
+        double t;
+        double v[3];   //x [m], y [m], unwrapped theta [deg]
+    };
+
+    pose_sample                  m_samples[max_window_size];
+    size_t                       m_count;        //number of stored poses, up to m_window_size
+    size_t                       m_newest;       //index of the newest pose in m_samples
+    size_t                       m_window_size;
+    double                       m_threshold;
+    bool                         m_adaptive;
+    double                       m_last_theta;   //the theta of the last pose, before unwrapping
+
+    //OdometryData is not trivially copyable, hence the published copy is a plain struct
+    struct odometry_snapshot
+    {
+        double odom_x, odom_y, odom_theta;
+        double odom_vel_x, odom_vel_y, odom_vel_theta;
+        double base_vel_x, base_vel_y, base_vel_theta;
+    };
+
+    yarp::dev::OdometryData         m_current_odom;
+    seqlock_slot<odometry_snapshot> m_output;
+    std::mutex                      m_mutex;   //serializes the writers (estimate, setWindow, reset). Never taken by getOdometry().
 
 public:
-    localization_device_with_estimated_odometry();
+    localization_device_with_estimated_odometry(size_t window_size = 3, double threshold = 3.0, bool adaptive = true);
     virtual ~localization_device_with_estimated_odometry();
-    yarp::dev::OdometryData estimate(const yarp::dev::Nav2D::Map2DLocation& m_localization_data);
-    yarp::dev::OdometryData getOdometry();
+
+    //reads the optional parameters window_size, threshold, adaptive. Typically the ODOMETRY_ESTIMATION group of the device.
+    bool configure(const yarp::os::Searchable& config);
+    bool setWindow(size_t window_size, double threshold, bool adaptive);
+    void reset();
+
+    //adds the pose loc (x, y [m], theta [deg], in the map frame) acquired at time timestamp [s], and returns the new estimate.
+    //timestamp <= 0 means now. A pose with the same or an older timestamp replaces the newest one.
+    yarp::dev::OdometryData estimate(const yarp::dev::Nav2D::Map2DLocation& loc, double timestamp);
+    yarp::dev::OdometryData getOdometry() const;
+
+private:
+    const pose_sample& sample(size_t age) const { return m_samples[(m_newest + max_window_size - age) % max_window_size]; }
+    double velocity(size_t dim) const;
+    void publish();
 };
+
+#endif
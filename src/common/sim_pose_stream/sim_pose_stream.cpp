@@ -0,0 +1,54 @@
+/*
+ * Copyright (C) 2020 Istituto Italiano di Tecnologia (IIT)
+ * All rights reserved.
+ *
+ * This software may be modified and distributed under the terms of the
+ * GPL-2+ license. See the accompanying LICENSE file for details.
+ */
+
+#include "sim_pose_stream.h"
+
+using namespace yarp::os;
+
+void sim_pose_stream::add_pose(Bottle& msg, const std::string& object_name, const std::string& reference_frame, const pose_6d& pose)
+{
+    Bottle& b = msg.addList();
+    b.addString(object_name);
+    b.addString(reference_frame);
+    b.addDouble(pose.x);
+    b.addDouble(pose.y);
+    b.addDouble(pose.z);
+    b.addDouble(pose.roll);
+    b.addDouble(pose.pitch);
+    b.addDouble(pose.yaw);
+}
+
+bool sim_pose_stream::find_pose(const Bottle& msg, const std::string& object_name, const std::string& reference_frame, pose_6d& pose)
+{
+    for (size_t i = 0; i < msg.size(); i++)
+    {
+        Bottle* b = msg.get(i).asList();
+        if (b == nullptr || b->size() != 8) continue;
+        if (b->get(0).asString() != object_name || b->get(1).asString() != reference_frame) continue;
+        pose.x = b->get(2).asDouble();
+        pose.y = b->get(3).asDouble();
+        pose.z = b->get(4).asDouble();
+        pose.roll = b->get(5).asDouble();
+        pose.pitch = b->get(6).asDouble();
+        pose.yaw = b->get(7).asDouble();
+        return true;
+    }
+    return false;
+}
+
+bool sim_pose_stream::parse_get_pose_reply(const Bottle& reply, pose_6d& pose)
+{
+    if (reply.size() < 6) return false;
+    pose.x = reply.get(0).asDouble();
+    pose.y = reply.get(1).asDouble();
+    pose.z = reply.get(2).asDouble();
+    pose.roll = reply.get(3).asDouble();
+    pose.pitch = reply.get(4).asDouble();
+    pose.yaw = reply.get(5).asDouble();
+    return true;
+}
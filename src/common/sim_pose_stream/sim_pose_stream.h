@@ -0,0 +1,45 @@
+/*
+ * Copyright (C) 2020 Istituto Italiano di Tecnologia (IIT)
+ * All rights reserved.
+ *
+ * This software may be modified and distributed under the terms of the
+ * GPL-2+ license. See the accompanying LICENSE file for details.
+ */
+
+#ifndef SIM_POSE_STREAM_H
+#define SIM_POSE_STREAM_H
+
+#include <yarp/os/Bottle.h>
+#include <string>
+
+//! A streamed version of the getPose command of the simulator world interface.
+//! The simulator side publishes at a fixed rate the poses of a set of objects, the clients (e.g. gazeboLocalizer)
+//! keep the latest message and read it without blocking, instead of sending a getPose request at each cycle.
+//! Message format: a list of (object_name reference_frame x y z roll pitch yaw), one for each object, with
+//! the same values returned by "getPose object_name [reference_frame]" (meters, radians). The reference frame of the
+//! absolute poses is sim_pose_stream::world_frame.
+namespace sim_pose_stream
+{
+    const std::string world_frame = "world";
+
+    //a 6D pose: x y z [m] roll pitch yaw [rad]
+    struct pose_6d
+    {
+        double x = 0;
+        double y = 0;
+        double z = 0;
+        double roll = 0;
+        double pitch = 0;
+        double yaw = 0;
+    };
+
+    void add_pose(yarp::os::Bottle& msg, const std::string& object_name, const std::string& reference_frame, const pose_6d& pose);
+
+    //returns false if the message does not contain the pose of object_name in reference_frame
+    bool find_pose(const yarp::os::Bottle& msg, const std::string& object_name, const std::string& reference_frame, pose_6d& pose);
+
+    //parses the reply to a getPose command
+    bool parse_get_pose_reply(const yarp::os::Bottle& reply, pose_6d& pose);
+}
+
+#endif
@@ -302,7 +302,12 @@ bool extendedRangefinder2DWrapper::read(yarp::os::ConnectionReader& connection)
     int inter  = in.get(1).asVocab();
     bool ret = false;
 
-    if (inter == VOCAB_ILASER2D)
+    if (in.get(0).isString() && in.get(0).asString() == "stats")
+    {
+        publishLatency.addToBottle("scan_publish", out);
+        ret = true;
+    }
+    else if (inter == VOCAB_ILASER2D)
     {
         if (action == VOCAB_GET)
         {
@@ -898,6 +903,7 @@ void extendedRangefinder2DWrapper::run()
             b.addInt32(status);
             streamingPort.setEnvelope(lastStateStamp);
             streamingPort.write();
+            publishLatency.record_since(lastStateStamp.getTime());
 
             // publish modified laser port
             yarp::os::Bottle& bMod = streamingPortMod.prepare();
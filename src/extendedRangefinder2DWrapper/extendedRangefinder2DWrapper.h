@@ -53,6 +53,8 @@
 #include <yarp/rosmsg/sensor_msgs/LaserScan.h>
 #include <yarp/rosmsg/impl/yarpRosHelper.h>
 
+#include "latency_stats.h"
+
 
 
 #define DEFAULT_THREAD_PERIOD_2D 0.02 //s
@@ -105,6 +107,7 @@ private:
     yarp::dev::IRangefinder2D *sens_p;
     yarp::dev::IPreciselyTimed *iTimed;
     yarp::os::Stamp lastStateStamp;
+    latency_stats   publishLatency;   // time elapsed from the acquisition of the scan to its publication
     double _period;
     std::string sensorId;
     double minAngle, maxAngle;
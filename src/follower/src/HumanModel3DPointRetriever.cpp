@@ -12,14 +12,43 @@
 #include "HumanModel3DPointRetriever.h"
 #include <yarp/os/Log.h>
 #include <yarp/os/LogStream.h>
+#include <yarp/os/Network.h>
+#include <yarp/os/Time.h>
 
 using namespace yarp::os;
 using namespace FollowerTarget;
 
+static const std::string humanModelName="Luca";
+static const std::string humanModelRefFrame="SIM_CER_ROBOT::mobile_base_body_link";
+
 bool HumanModel3DPointRetriever::init(yarp::os::ResourceFinder &rf)
 {
     m_refFrame=ReferenceFrameOfTarget_t::mobile_base_body_link;
 
+    Bottle config_group = rf.findGroup("HUMAN_MODEL");
+    if (!config_group.isNull())
+    {
+        if (config_group.check("poseStreamPort"))
+        {
+            m_useStream=true;
+            std::string remotename = config_group.find("poseStreamPort").asString();
+            m_poseStreamTimeout = config_group.check("poseStreamTimeout", Value(0.5)).asDouble();
+
+            std::string portname="/follower/humanModelRetriver/poses:i";
+            if(!m_poseStreamPort.open(portname))
+            {
+                yError() << "HumanModel3DPointRetriever: error in opening" << portname << "port";
+                return false;
+            }
+            if(!Network::connect(remotename, portname, "udp"))
+            {
+                yError() << "HumanModel3DPointRetriever: unable to connect" << remotename << "to" << portname;
+                return false;
+            }
+            return true;
+        }
+    }
+
     std::string portname="/follower/humanModelRetriver/rpc";
     if(!m_worldInterfacePort.open(portname))
     {
@@ -35,18 +64,10 @@ Target_t HumanModel3DPointRetriever::getTarget(void)
 {
     Target_t t(m_refFrame); //it is initialized to false
 
-    // Prepare bottle containing command to send in order to get the current position
-    Bottle cmdGet, ansGet;
-    cmdGet.clear();
-    ansGet.clear();
-
-    cmdGet.addString("getPose");
-    cmdGet.addString("Luca");
-    cmdGet.addString("SIM_CER_ROBOT::mobile_base_body_link");
-    m_worldInterfacePort.write(cmdGet, ansGet);
-
-    if(m_debugOn)
-        yDebug() << "HumanModel3DPointRetriever: cmd-GET= " << cmdGet.toString() << "  Ans=" << ansGet.toString();
+    Bottle ansGet;
+    bool ret = m_useStream ? getPoseFromStream(ansGet) : getPoseFromRpc(ansGet);
+    if(!ret)
+        return t;
 
 
     //NOTE: if Luca doesn't exist in Gazebo than the answer is "0.0 0.0 0.0 0.0 0.0 0.0".
@@ -68,8 +89,56 @@ Target_t HumanModel3DPointRetriever::getTarget(void)
     return t;
 }
 
+bool HumanModel3DPointRetriever::getPoseFromRpc(Bottle &pose)
+{
+    // Prepare bottle containing command to send in order to get the current position
+    Bottle cmdGet;
+    cmdGet.addString("getPose");
+    cmdGet.addString(humanModelName);
+    cmdGet.addString(humanModelRefFrame);
+    pose.clear();
+    m_worldInterfacePort.write(cmdGet, pose);
+
+    if(m_debugOn)
+        yDebug() << "HumanModel3DPointRetriever: cmd-GET= " << cmdGet.toString() << "  Ans=" << pose.toString();
+    return true;
+}
+
+bool HumanModel3DPointRetriever::getPoseFromStream(Bottle &pose)
+{
+    //non blocking: the last received poses are used until a new message arrives
+    Bottle *b = m_poseStreamPort.read(false);
+    if(b != nullptr)
+    {
+        m_lastPoses = *b;
+        m_lastPosesTime = Time::now();
+    }
+    if(m_lastPosesTime < 0 || Time::now() - m_lastPosesTime > m_poseStreamTimeout)
+    {
+        if(m_debugOn)
+            yDebug() << "HumanModel3DPointRetriever: no recent pose received from the stream";
+        return false;
+    }
+
+    for(size_t i=0; i<m_lastPoses.size(); i++)
+    {
+        Bottle *p = m_lastPoses.get(i).asList();
+        if(p == nullptr || p->size() != 8)
+            continue;
+        if(p->get(0).asString() != humanModelName || p->get(1).asString() != humanModelRefFrame)
+            continue;
+        pose = p->tail().tail(); //x y z roll pitch yaw, as in the answer to getPose
+        return true;
+    }
+    return false;
+}
+
 bool HumanModel3DPointRetriever::deinit(void)
 {
+    m_worldInterfacePort.interrupt();
+    m_worldInterfacePort.close();
+    m_poseStreamPort.interrupt();
+    m_poseStreamPort.close();
     return(TargetRetriever::deinitInputPort());
 }
 
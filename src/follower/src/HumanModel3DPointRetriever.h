@@ -14,6 +14,8 @@
 #include "TargetRetriever.h"
 
 #include <yarp/os/RpcClient.h>
+#include <yarp/os/BufferedPort.h>
+#include <yarp/os/Bottle.h>
 
 namespace FollowerTarget
 {
@@ -26,6 +28,15 @@ namespace FollowerTarget
     private:
         yarp::os::RpcClient m_worldInterfacePort;
 
+        //streaming mode: the simulator publishes the poses, as a list of (object_name reference_frame x y z roll pitch yaw)
+        bool m_useStream=false;
+        yarp::os::BufferedPort<yarp::os::Bottle> m_poseStreamPort;
+        yarp::os::Bottle m_lastPoses;
+        double m_lastPosesTime=-1;
+        double m_poseStreamTimeout=0.5;
+
+        bool getPoseFromRpc(yarp::os::Bottle &pose);
+        bool getPoseFromStream(yarp::os::Bottle &pose);
     };
 }
 
@@ -93,6 +93,7 @@ void SimFramePainter::paint(const yarp::sig::Vector &point)
         if(ans.toString() == m_nameOfFrame)
         {
             m_isCreated = true;
+            m_paintedPoint = point;
             return;
         }
         else
@@ -104,29 +105,29 @@ void SimFramePainter::paint(const yarp::sig::Vector &point)
         return;
     }
 
-    // Prapare bottle containg command to send in order to get the current position
-    Bottle cmdGet, ansGet, cmdSet, ansSet;
-    cmdGet.clear();
-    ansGet.clear();
+    //each command is a blocking rpc to the simulator: nothing is sent if the frame has not moved
+    if( (m_paintedPoint.size() == point.size()) && (m_paintedPoint == point) )
+    {
+        return;
+    }
+
+    //send command for new position.
+    //The frame has been created with orientation (0 0 0) respect to m_frameIdOfRef and it is never rotated,
+    //so its orientation is not requested to the simulator with a getPose.
+    Bottle cmdSet, ansSet;
     cmdSet.clear();
     ansSet.clear();
-    cmdGet.addString("getPose");
-    cmdGet.addString(m_nameOfFrame);
-    cmdGet.addString(m_frameIdOfRef);
-    m_worldInterfacePort_ptr->write(cmdGet, ansGet);
-    //read the answer
-
-    //send command for new position
     cmdSet.addString("setPose");
     cmdSet.addString(m_nameOfFrame);
     cmdSet.addDouble(point[0]);
     cmdSet.addDouble(point[1]);
     cmdSet.addDouble(point[2]); // z
-    cmdSet.addDouble(ansGet.get(3).asDouble()); // r
-    cmdSet.addDouble(ansGet.get(4).asDouble()); // p
-    cmdSet.addDouble(ansGet.get(5).asDouble()); // y
+    cmdSet.addDouble(0); // r
+    cmdSet.addDouble(0); // p
+    cmdSet.addDouble(0); // y
     cmdSet.addString(m_frameIdOfRef);
     m_worldInterfacePort_ptr->write(cmdSet, ansSet);
+    m_paintedPoint = point;
 
 }
 
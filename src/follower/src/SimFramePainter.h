@@ -37,6 +37,7 @@ namespace FollowerTarget
             void setDebug(bool on) {m_debugOn=on;}
         private:
             bool m_isCreated;
+            yarp::sig::Vector m_paintedPoint; //the last position sent to the simulator
             std::string m_nameOfFrame;
             std::shared_ptr<yarp::os::RpcClient> m_worldInterfacePort_ptr;
             std::string m_frameIdOfRef;
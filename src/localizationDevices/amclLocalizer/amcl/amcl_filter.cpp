@@ -0,0 +1,494 @@
+/*
+ * Copyright (C) 2020 Istituto Italiano di Tecnologia (IIT)
+ * All rights reserved.
+ *
+ * This software may be modified and distributed under the terms of the
+ * GPL-2+ license. See the accompanying LICENSE file for details.
+ */
+///////////////////////////////////////////////////////////////////////////
+//
+// Desc: The particle filter core of amclLocalizer (odometry and laser
+//       update, resampling, pose selection, scan refinement, CPU budget)
+//
+///////////////////////////////////////////////////////////////////////////
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <stdlib.h>
+
+#include "amcl/amcl_filter.h"
+
+using namespace amcl;
+
+static double normalize(double z)
+{
+  return atan2(sin(z), cos(z));
+}
+
+static double angle_diff(double a, double b)
+{
+  double d1, d2;
+  a = normalize(a);
+  b = normalize(b);
+  d1 = a - b;
+  d2 = 2 * M_PI - fabs(d1);
+  if (d1 > 0)
+    d2 *= -1.0;
+  if (fabs(d1) < fabs(d2))
+    return(d1);
+  else
+    return(d2);
+}
+
+static double now()
+{
+  return std::chrono::duration<double>(std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+AMCLFilter::AMCLFilter()
+{
+  this->map = NULL;
+  this->pf = NULL;
+  this->odom = NULL;
+  this->laser = NULL;
+  this->refiner = NULL;
+  this->initialized = false;
+  this->force_update = false;
+  this->resample_count = 0;
+  this->odom_pose = pf_vector_zero();
+  this->pose = pf_vector_zero();
+  this->pose_cov = pf_matrix_zero();
+  this->timing.action = this->timing.sensor = this->timing.resample = this->timing.hypotheses = 0.0;
+  this->budget_particles = 0;
+  this->budget_beams = 0;
+  this->budget_cycles = 0;
+  this->budget_total_cycle = 0.0;
+  this->budget_filter_updates = 0;
+  this->budget_max_cycle = 0.0;
+  this->budget_last_update = -1.0;
+  this->budget_mean_cycle = 0.0;
+  this->budget_max_update_cycle = 0.0;
+}
+
+AMCLFilter::~AMCLFilter()
+{
+  this->Free();
+}
+
+void
+AMCLFilter::Free()
+{
+  delete this->odom;
+  delete this->laser;
+  delete this->refiner;
+  this->odom = NULL;
+  this->laser = NULL;
+  this->refiner = NULL;
+  if (this->pf)
+    pf_free(this->pf);
+  this->pf = NULL;
+}
+
+bool
+AMCLFilter::Init(const AMCLFilterParams& params, map_t *map, uint64_t seed)
+{
+  if (map == NULL || params.min_particles <= 0 || params.max_particles < params.min_particles)
+    return false;
+
+  this->Free();
+  this->params = params;
+  if (this->params.resample_interval < 1)
+    this->params.resample_interval = 1;
+  this->map = map;
+
+  // The free cells, for the uniform pose generator
+  this->free_cells.clear();
+  for (int i = 0; i < map->size_x * map->size_y; i++)
+  {
+    if (map->cells[i].occ_state == -1)
+      this->free_cells.push_back(i);
+  }
+  this->generator.seed((std::mt19937::result_type)(seed ^ (seed >> 32)));
+
+  this->pf = pf_alloc(params.min_particles, params.max_particles, params.alpha_slow, params.alpha_fast,
+                      (pf_init_model_fn_t)AMCLFilter::UniformPoseGenerator, (void *)this);
+  this->pf->pop_err = params.kld_err;
+  this->pf->pop_z = params.kld_z;
+  // pf_alloc() seeds the generator used by the resampling with the current time
+#ifdef WIN32
+  srand((unsigned int)seed);
+#else
+  srand48((long int)seed);
+#endif
+
+  this->odom = new AMCLOdom();
+  this->odom->SetModel(params.odom_model, params.odom_alpha1, params.odom_alpha2, params.odom_alpha3,
+                       params.odom_alpha4, params.odom_alpha5);
+  this->odom->SetRandomGenerator(params.odom_noise_drand48, seed);
+
+  this->laser = new AMCLLaser(params.max_beams, map);
+  if (params.laser_model == LASER_MODEL_BEAM)
+  {
+    this->laser->SetModelBeam(params.z_hit, params.z_short, params.z_max, params.z_rand,
+                              params.sigma_hit, params.lambda_short, 0.0);
+  }
+  else if (params.laser_model == LASER_MODEL_LIKELIHOOD_FIELD_PROB)
+  {
+    this->laser->SetModelLikelihoodFieldProb(params.z_hit, params.z_rand, params.sigma_hit,
+                                             params.likelihood_max_dist, params.do_beamskip,
+                                             params.beam_skip_distance, params.beam_skip_threshold,
+                                             params.beam_skip_error_threshold);
+  }
+  else
+  {
+    this->laser->SetModelLikelihoodField(params.z_hit, params.z_rand, params.sigma_hit, params.likelihood_max_dist);
+    this->laser->SetBeamSelection(params.adaptive_beams, params.do_beamskip, params.beam_skip_distance,
+                                  params.beam_skip_threshold, params.beam_skip_error_threshold);
+  }
+  // The laser pose is currently assumed to be zero
+  pf_vector_t laser_pose = pf_vector_zero();
+  this->laser->SetLaserPose(laser_pose);
+
+  if (params.refine_enable)
+  {
+    // The beam model does not compute the obstacle distances
+    if (map->max_occ_dist != params.likelihood_max_dist)
+      map_update_cspace(map, params.likelihood_max_dist);
+    this->refiner = new AMCLScanRefiner();
+    this->refiner->SetMap(map);
+    this->refiner->SetParams(params.refine_max_iterations, params.refine_max_points, params.refine_outlier_distance,
+                             params.refine_max_correction_dist, params.refine_max_correction_angle);
+  }
+
+  this->params.cpu_budget_min_particles = std::max(std::min(params.cpu_budget_min_particles, params.max_particles),
+                                                   params.min_particles);
+  this->params.cpu_budget_min_beams = std::max(std::min(params.cpu_budget_min_beams, params.max_beams), 2);
+  this->budget_particles = params.max_particles;
+  this->budget_beams = params.max_beams;
+  this->budget_cycles = 0;
+  this->budget_total_cycle = 0.0;
+  this->budget_filter_updates = 0;
+  this->budget_max_cycle = 0.0;
+  this->budget_last_update = -1.0;
+
+  this->initialized = false;
+  this->force_update = false;
+  this->resample_count = 0;
+  return true;
+}
+
+void
+AMCLFilter::Initialize(const pf_vector_t& mean, const pf_matrix_t& cov)
+{
+  // The samples are drawn with the seeded generator: pf_init() reseeds drand48() with a global counter
+  double l00 = sqrt(std::max(cov.m[0][0], 0.0));
+  double l10 = (l00 > 0.0) ? cov.m[1][0] / l00 : 0.0;
+  double l11 = sqrt(std::max(cov.m[1][1] - l10 * l10, 0.0));
+  double l22 = sqrt(std::max(cov.m[2][2], 0.0));
+  std::normal_distribution<double> dis_n(0.0, 1.0);
+  std::vector<pf_sample_t> samples(this->pf->max_samples);
+  for (size_t i = 0; i < samples.size(); i++)
+  {
+    double n0 = dis_n(this->generator);
+    double n1 = dis_n(this->generator);
+    double n2 = dis_n(this->generator);
+    samples[i].pose.v[0] = mean.v[0] + l00 * n0;
+    samples[i].pose.v[1] = mean.v[1] + l10 * n0 + l11 * n1;
+    samples[i].pose.v[2] = mean.v[2] + l22 * n2;
+    samples[i].weight = 1.0;
+  }
+  pf_init_samples(this->pf, (int)samples.size(), samples.data(), 0.0, 0.0);
+  this->initialized = false;
+  this->force_update = false;
+  this->resample_count = 0;
+}
+
+void
+AMCLFilter::InitializeFromHypotheses(const std::vector<scan_match_hyp_t>& hyps)
+{
+  if (hyps.empty())
+    return;
+  this->hypotheses = hyps;
+  pf_init_model(this->pf, (pf_init_model_fn_t)AMCLFilter::HypothesisPoseGenerator, (void *)this);
+  this->initialized = false;
+  this->force_update = false;
+  this->resample_count = 0;
+}
+
+void
+AMCLFilter::Restore(int sample_count, const pf_sample_t *samples, double w_slow, double w_fast,
+                    const pf_vector_t& odom_pose)
+{
+  pf_init_samples(this->pf, sample_count, samples, w_slow, w_fast);
+  this->odom_pose = odom_pose;
+  this->initialized = true;
+  this->force_update = true;
+  this->resample_count = 0;
+}
+
+int
+AMCLFilter::Update(const pf_vector_t& odom_pose, const std::vector<double>& ranges,
+                   double angle_min, double angle_increment, double range_min, double range_max)
+{
+  this->timing.action = this->timing.sensor = this->timing.resample = this->timing.hypotheses = 0.0;
+
+  bool update = false;
+  bool force_selection = false;
+  if (!this->initialized)
+  {
+    // First update: the particles are weighted without any motion
+    this->odom_pose = odom_pose;
+    this->initialized = true;
+    this->resample_count = 0;
+    update = true;
+    force_selection = true;
+  }
+  else
+  {
+    pf_vector_t delta;
+    delta.v[0] = odom_pose.v[0] - this->odom_pose.v[0];
+    delta.v[1] = odom_pose.v[1] - this->odom_pose.v[1];
+    delta.v[2] = angle_diff(odom_pose.v[2], this->odom_pose.v[2]);
+
+    update = fabs(delta.v[0]) > this->params.update_min_d ||
+             fabs(delta.v[1]) > this->params.update_min_d ||
+             fabs(delta.v[2]) > this->params.update_min_a ||
+             this->force_update;
+    this->force_update = false;
+    if (update)
+    {
+      AMCLOdomData odata;
+      odata.pose = odom_pose;
+      odata.delta = delta;
+      double t0 = now();
+      this->odom->UpdateAction(this->pf, (AMCLSensorData*)&odata);
+      this->timing.action = now() - t0;
+    }
+  }
+  if (!update)
+    return 0;
+
+  // Apply the range limits of the parameters, if any
+  AMCLLaserData ldata;
+  ldata.sensor = this->laser;
+  ldata.range_count = (int)ranges.size();
+  ldata.range_max = (this->params.laser_max_range > 0.0) ? std::min(range_max, this->params.laser_max_range) : range_max;
+  if (this->params.laser_min_range > 0.0)
+    range_min = std::max(range_min, this->params.laser_min_range);
+  // The AMCLLaserData destructor will free this memory
+  ldata.ranges = new double[ldata.range_count][2];
+  this->scan_points.clear();
+  for (int i = 0; i < ldata.range_count; i++)
+  {
+    double rho = ranges[i];
+    // amcl doesn't (yet) have a concept of min range. So we'll map short readings to max range.
+    ldata.ranges[i][0] = (rho <= range_min) ? ldata.range_max : rho;
+    ldata.ranges[i][1] = angle_min + (i * angle_increment);
+    // The readings without an obstacle cannot be aligned to the map
+    if (this->refiner && std::isfinite(rho) && rho > range_min && rho < ldata.range_max)
+    {
+      pf_vector_t p = pf_vector_zero();
+      p.v[0] = rho * cos(ldata.ranges[i][1]);
+      p.v[1] = rho * sin(ldata.ranges[i][1]);
+      this->scan_points.push_back(p);
+    }
+  }
+  double t0 = now();
+  this->laser->UpdateSensor(this->pf, (AMCLSensorData*)&ldata);
+  this->timing.sensor = now() - t0;
+  this->odom_pose = odom_pose;
+  int result = AMCL_FILTER_UPDATED;
+
+  bool resampled = false;
+  if (!(++this->resample_count % this->params.resample_interval))
+  {
+    t0 = now();
+    pf_update_resample(this->pf);
+    this->timing.resample = now() - t0;
+    resampled = true;
+  }
+
+  if (resampled || force_selection)
+  {
+    // The most probable cluster
+    t0 = now();
+    bool found = this->GetBestCluster(this->pose, this->pose_cov);
+    this->timing.hypotheses = now() - t0;
+    if (found)
+      result |= AMCL_FILTER_NEW_POSE;
+  }
+  return result;
+}
+
+bool
+AMCLFilter::GetBestCluster(pf_vector_t& mean, pf_matrix_t& cov) const
+{
+  const pf_sample_set_t *set = this->pf->sets + this->pf->current_set;
+  double max_weight = 0.0;
+  for (int c = 0; c < set->cluster_count; c++)
+  {
+    double weight;
+    pf_vector_t pose_mean;
+    pf_matrix_t pose_cov;
+    if (!pf_get_cluster_stats(this->pf, c, &weight, &pose_mean, &pose_cov))
+      break;
+    if (weight > max_weight)
+    {
+      max_weight = weight;
+      mean = pose_mean;
+      cov = pose_cov;
+    }
+  }
+  return max_weight > 0.0;
+}
+
+bool
+AMCLFilter::RefinePose(double time_budget)
+{
+  if (this->refiner == NULL || this->scan_points.empty())
+    return false;
+  return this->refiner->Refine(this->scan_points, this->pose, time_budget);
+}
+
+void
+AMCLFilter::AddCycle(double duration, bool filter_updated)
+{
+  this->budget_cycles++;
+  this->budget_total_cycle += duration;
+  if (filter_updated)
+  {
+    this->budget_filter_updates++;
+    this->budget_max_cycle = std::max(this->budget_max_cycle, duration);
+  }
+}
+
+bool
+AMCLFilter::IsAccuracyLimited() const
+{
+  return this->budget_particles < this->params.max_particles && this->pf->kld_samples > this->pf->max_samples;
+}
+
+bool
+AMCLFilter::IsCpuBudgetDue(double current_time) const
+{
+  return this->budget_last_update < 0.0 ||
+         current_time - this->budget_last_update >= this->params.cpu_budget_update_period;
+}
+
+cpu_budget_result_t
+AMCLFilter::UpdateCpuBudget(double current_time, double period, double mean_cycle)
+{
+  if (!this->params.cpu_budget_enable)
+    return CPU_BUDGET_UNCHANGED;
+  if (!this->IsCpuBudgetDue(current_time))
+    return CPU_BUDGET_UNCHANGED;
+  bool first = (this->budget_last_update < 0.0);
+  this->budget_last_update = current_time;
+
+  // Load since the last adaptation
+  if (mean_cycle < 0.0)
+    mean_cycle = this->budget_cycles ? this->budget_total_cycle / this->budget_cycles : 0.0;
+  double max_update_cycle = this->budget_max_cycle;
+  size_t filter_updates = this->budget_filter_updates;
+  this->budget_cycles = 0;
+  this->budget_total_cycle = 0.0;
+  this->budget_filter_updates = 0;
+  this->budget_max_cycle = 0.0;
+  // While the robot does not move the filter is not updated, so the cost of the filter is unknown
+  if (first || filter_updates == 0 || mean_cycle <= 0.0 || max_update_cycle <= 0.0)
+    return CPU_BUDGET_UNCHANGED;
+  this->budget_mean_cycle = mean_cycle;
+  this->budget_max_update_cycle = max_update_cycle;
+
+  // The tighter of the two constraints: the average load and the duration of the cycles with a filter update
+  double scale = std::min(this->params.cpu_budget_share * period / mean_cycle,
+                          this->params.cpu_budget_max_cycle * period / max_update_cycle);
+
+  // Dead band, to avoid oscillations
+  if (!(scale < 0.9 || (scale > 1.1 && (this->budget_particles < this->params.max_particles ||
+                                        this->budget_beams < this->params.max_beams))))
+    return CPU_BUDGET_UNCHANGED;
+
+  // The cost of the sensor update is proportional to particles * beams.
+  // The particles are reduced before the beams, and the beams are restored before the particles.
+  scale = std::max(0.5, std::min(2.0, scale));
+  int particles = this->budget_particles;
+  int beams = this->budget_beams;
+  if (scale < 1.0)
+  {
+    particles = std::max(this->params.cpu_budget_min_particles, (int)(this->budget_particles * scale));
+    double residual = scale * this->budget_particles / particles;
+    if (residual < 1.0)
+      beams = std::max(this->params.cpu_budget_min_beams, (int)(this->budget_beams * residual));
+  }
+  else
+  {
+    beams = std::min(this->params.max_beams, (int)ceil(this->budget_beams * scale));
+    double residual = scale * this->budget_beams / beams;
+    if (residual > 1.0)
+      particles = std::min(this->params.max_particles, (int)(this->budget_particles * residual));
+  }
+
+  if (particles == this->budget_particles && beams == this->budget_beams)
+    return (scale < 1.0) ? CPU_BUDGET_AT_MINIMUM : CPU_BUDGET_UNCHANGED;
+  this->budget_particles = particles;
+  this->budget_beams = beams;
+  pf_set_max_samples(this->pf, particles);
+  this->laser->SetMaxBeams(beams);
+  return CPU_BUDGET_CHANGED;
+}
+
+pf_vector_t
+AMCLFilter::UniformPoseGenerator(void *arg)
+{
+  // Called by the particle filter (initialization and recovery), once per random particle
+  AMCLFilter *self = (AMCLFilter*)arg;
+  map_t *map = self->map;
+  pf_vector_t p;
+
+  std::uniform_real_distribution<double> dis_t(-M_PI, +M_PI);
+  std::uniform_real_distribution<double> dis_cell(-0.5, +0.5);
+  p.v[2] = dis_t(self->generator);
+
+  if (self->free_cells.empty())
+  {
+    p.v[0] = map->origin_x;
+    p.v[1] = map->origin_y;
+    return p;
+  }
+
+  std::uniform_int_distribution<size_t> dis_index(0, self->free_cells.size() - 1);
+  int index = self->free_cells[dis_index(self->generator)];
+  // Uniformly distributed inside the free cell
+  p.v[0] = MAP_WXGX(map, index % map->size_x) + dis_cell(self->generator) * map->scale;
+  p.v[1] = MAP_WYGY(map, index / map->size_x) + dis_cell(self->generator) * map->scale;
+  return p;
+}
+
+pf_vector_t
+AMCLFilter::HypothesisPoseGenerator(void *arg)
+{
+  // Called by pf_init_model(), once per particle
+  AMCLFilter *self = (AMCLFilter*)arg;
+  const std::vector<scan_match_hyp_t>& hyps = self->hypotheses;
+
+  double total_score = 0;
+  for (size_t i = 0; i < hyps.size(); i++)
+    total_score += hyps[i].score;
+  std::uniform_real_distribution<double> dis_score(0, total_score);
+  double r = dis_score(self->generator);
+  size_t i = 0;
+  while (i + 1 < hyps.size() && r > hyps[i].score)
+  {
+    r -= hyps[i].score;
+    i++;
+  }
+
+  std::normal_distribution<double> dis_n(0, 1);
+  pf_vector_t p;
+  p.v[0] = hyps[i].pose.v[0] + sqrt(self->params.initial_cov_xx) * dis_n(self->generator);
+  p.v[1] = hyps[i].pose.v[1] + sqrt(self->params.initial_cov_yy) * dis_n(self->generator);
+  p.v[2] = normalize(hyps[i].pose.v[2] + sqrt(self->params.initial_cov_aa) * dis_n(self->generator));
+  return p;
+}
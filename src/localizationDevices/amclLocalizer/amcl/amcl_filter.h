@@ -0,0 +1,249 @@
+/*
+ * Copyright (C) 2020 Istituto Italiano di Tecnologia (IIT)
+ * All rights reserved.
+ *
+ * This software may be modified and distributed under the terms of the
+ * GPL-2+ license. See the accompanying LICENSE file for details.
+ */
+///////////////////////////////////////////////////////////////////////////
+//
+// Desc: The particle filter core of amclLocalizer (odometry and laser
+//       update, resampling, pose selection, scan refinement, CPU budget)
+//
+///////////////////////////////////////////////////////////////////////////
+
+#ifndef AMCL_FILTER_H
+#define AMCL_FILTER_H
+
+#include <math.h>
+#include <random>
+#include <vector>
+#include <stdint.h>
+
+#include "map/map.h"
+#include "pf/pf.h"
+#include "sensors/amcl_odom.h"
+#include "sensors/amcl_laser.h"
+#include "sensors/amcl_scan_matcher.h"
+#include "sensors/amcl_scan_refiner.h"
+
+#ifndef M_PI
+#define M_PI 3.14159265358979323846
+#endif
+
+namespace amcl
+{
+
+// Parameters of the filter. The defaults are the ones of the AMCL group of amclLocalizer.
+struct AMCLFilterParams
+{
+  // Particle filter
+  int min_particles = 100;
+  int max_particles = 5000;
+  double kld_err = 0.01;
+  double kld_z = 0.99;
+  double alpha_slow = 0.001;
+  double alpha_fast = 0.1;
+  int resample_interval = 2;
+
+  // The filter is updated when the robot moves more than this [m, rad]
+  double update_min_d = 0.2;
+  double update_min_a = M_PI / 6.0;
+
+  // Odometry model
+  odom_model_t odom_model = ODOM_MODEL_DIFF;
+  double odom_alpha1 = 0.2;
+  double odom_alpha2 = 0.2;
+  double odom_alpha3 = 0.2;
+  double odom_alpha4 = 0.2;
+  double odom_alpha5 = 0.2;
+  bool odom_noise_drand48 = false;
+
+  // Laser model
+  laser_model_t laser_model = LASER_MODEL_LIKELIHOOD_FIELD;
+  int max_beams = 30;
+  double laser_min_range = -1.0;
+  double laser_max_range = -1.0;
+  double z_hit = 0.95;
+  double z_short = 0.1;
+  double z_max = 0.05;
+  double z_rand = 0.05;
+  double sigma_hit = 0.2;
+  double lambda_short = 0.1;
+  double likelihood_max_dist = 2.0;
+  bool do_beamskip = false;
+  bool adaptive_beams = false;
+  double beam_skip_distance = 0.5;
+  double beam_skip_threshold = 0.3;
+  double beam_skip_error_threshold = 0.9;
+
+  // Scan to map refinement of the selected pose
+  bool refine_enable = false;
+  int refine_max_iterations = 5;
+  int refine_max_points = 180;
+  double refine_outlier_distance = 0.3;
+  double refine_max_correction_dist = 0.3;
+  double refine_max_correction_angle = 10.0 * M_PI / 180.0;
+
+  // CPU budget: the max number of particles and beams are adapted, within these bounds,
+  // so that the cycles of the caller take the given share of its period
+  bool cpu_budget_enable = false;
+  double cpu_budget_share = 0.5;
+  double cpu_budget_max_cycle = 0.8;
+  double cpu_budget_update_period = 1.0;
+  int cpu_budget_min_particles = 100;
+  int cpu_budget_min_beams = 10;
+
+  // Covariance of the initial pose, also used to spread the particles around
+  // the hypotheses of the global localization [m^2, m^2, rad^2]
+  double initial_cov_xx = 0.25;
+  double initial_cov_yy = 0.25;
+  double initial_cov_aa = 0.06853891945200942;
+};
+
+// Result of AMCLFilter::Update()
+enum
+{
+  AMCL_FILTER_UPDATED = 1,  // the sensor update has been performed: new particles
+  AMCL_FILTER_NEW_POSE = 2  // a new pose has been selected: GetPose()
+};
+
+// Result of AMCLFilter::UpdateCpuBudget()
+typedef enum
+{
+  CPU_BUDGET_UNCHANGED,
+  CPU_BUDGET_CHANGED,       // the limits have been changed
+  CPU_BUDGET_AT_MINIMUM     // the budget is exceeded with the minimum particles and beams
+} cpu_budget_result_t;
+
+// Duration of the stages of the last update [s], 0 if a stage has not been performed
+typedef struct
+{
+  double action;
+  double sensor;
+  double resample;   // includes the clustering of the new set
+  double hypotheses; // selection of the most probable cluster
+} amcl_filter_timing_t;
+
+// The particle filter used by amclLocalizer, independent of the middleware, so that
+// the same code is run by the device and by the off-line benchmarks.
+// A single laser is supported, with the pose of the robot.
+class AMCLFilter
+{
+  public: AMCLFilter();
+  public: ~AMCLFilter();
+  private: AMCLFilter(const AMCLFilter&) = delete;
+  private: AMCLFilter& operator=(const AMCLFilter&) = delete;
+
+  // Allocates the filter and the models. The map is not owned and must outlive the filter;
+  // its obstacle distances are computed if needed and not already available.
+  // seed initializes all the random generators (motion noise, resampling, uniform poses).
+  public: bool Init(const AMCLFilterParams& params, map_t *map, uint64_t seed);
+
+  // Draws the particles around a pose (normal distribution, cov of x, y and theta;
+  // the correlation of theta is ignored). The next Update() initializes the odometry.
+  public: void Initialize(const pf_vector_t& mean, const pf_matrix_t& cov);
+
+  // Draws the particles around the hypotheses of the global localization, proportionally to their score
+  public: void InitializeFromHypotheses(const std::vector<scan_match_hyp_t>& hyps);
+
+  // Replaces the particles (e.g. with a saved state). The motion since odom_pose is applied by the next Update().
+  public: void Restore(int sample_count, const pf_sample_t *samples, double w_slow, double w_fast,
+                       const pf_vector_t& odom_pose);
+
+  // Updates the filter with the odometry and a scan, if the robot moved more than the
+  // thresholds since the last update. odom_pose is in [m, m, rad]. The scan is made of
+  // ranges.size() readings from angle_min, every angle_increment [rad]; range_min and range_max
+  // are the limits of the sensor, further limited by the parameters.
+  // Returns a combination of AMCL_FILTER_UPDATED and AMCL_FILTER_NEW_POSE.
+  public: int Update(const pf_vector_t& odom_pose, const std::vector<double>& ranges,
+                     double angle_min, double angle_increment, double range_min, double range_max);
+
+  // Aligns the pose selected by the last Update() to its scan, within time_budget [s].
+  // Returns true if the pose has been refined.
+  public: bool RefinePose(double time_budget);
+
+  // The selected pose (mean of the most probable cluster) and its covariance
+  public: const pf_vector_t& GetPose() const { return this->pose; }
+  public: const pf_matrix_t& GetPoseCov() const { return this->pose_cov; }
+
+  // Mean and covariance of the most probable cluster of the current set. Returns false if there are no clusters.
+  public: bool GetBestCluster(pf_vector_t& mean, pf_matrix_t& cov) const;
+
+  // The current set of particles
+  public: const pf_sample_set_t* GetSampleSet() const { return this->pf->sets + this->pf->current_set; }
+  public: double GetWSlow() const { return this->pf->w_slow; }
+  public: double GetWFast() const { return this->pf->w_fast; }
+
+  // The odometry at the last update; valid once IsInitialized()
+  public: bool IsInitialized() const { return this->initialized; }
+  public: const pf_vector_t& GetOdomPose() const { return this->odom_pose; }
+
+  // The next Update() is performed even if the robot did not move
+  public: void ForceUpdate() { this->force_update = true; }
+
+  // CPU budget. AddCycle() is called at the end of each cycle of the caller, with its duration [s]
+  // and whether the filter has been updated. UpdateCpuBudget() adapts the limits every
+  // cpu_budget_update_period [s] of current_time (IsCpuBudgetDue()), using the cycles added meanwhile.
+  // mean_cycle is the mean duration of the cycles since the last adaptation, if the caller measures
+  // it (e.g. the statistics of its thread); if negative, the mean of the added cycles is used.
+  public: void AddCycle(double duration, bool filter_updated);
+  public: bool IsCpuBudgetDue(double current_time) const;
+  public: cpu_budget_result_t UpdateCpuBudget(double current_time, double period, double mean_cycle = -1.0);
+  public: int GetMaxParticles() const { return this->budget_particles; }
+  public: int GetMaxBeams() const { return this->budget_beams; }
+  public: int GetKldSamples() const { return this->pf->kld_samples; }
+  // Load measured by the last UpdateCpuBudget(): mean cycle and longest cycle with a filter update [s]
+  public: double GetMeanCycle() const { return this->budget_mean_cycle; }
+  public: double GetMaxUpdateCycle() const { return this->budget_max_update_cycle; }
+  // The KLD bound requires more particles than the budget allows
+  public: bool IsAccuracyLimited() const;
+
+  public: const AMCLScanRefiner* GetRefiner() const { return this->refiner; }
+  public: const AMCLFilterParams& GetParams() const { return this->params; }
+  public: size_t GetFreeCellCount() const { return this->free_cells.size(); }
+  public: const amcl_filter_timing_t& GetLastTiming() const { return this->timing; }
+
+  private: static pf_vector_t UniformPoseGenerator(void *arg);
+  private: static pf_vector_t HypothesisPoseGenerator(void *arg);
+  private: void Free();
+
+  private: AMCLFilterParams params;
+  private: map_t *map;
+  private: pf_t *pf;
+  private: AMCLOdom *odom;
+  private: AMCLLaser *laser;
+  private: AMCLScanRefiner *refiner;
+
+  // Indices of the free cells of the map, for the uniform pose generator
+  private: std::vector<int> free_cells;
+  private: std::mt19937 generator;
+  private: std::vector<scan_match_hyp_t> hypotheses;
+
+  private: bool initialized;
+  private: bool force_update;
+  private: int resample_count;
+  private: pf_vector_t odom_pose;
+
+  // The last selected pose, and the scan used by the refinement
+  private: pf_vector_t pose;
+  private: pf_matrix_t pose_cov;
+  private: std::vector<pf_vector_t> scan_points;
+
+  private: amcl_filter_timing_t timing;
+
+  // CPU budget
+  private: int budget_particles;
+  private: int budget_beams;
+  private: size_t budget_cycles;
+  private: double budget_total_cycle;
+  private: size_t budget_filter_updates;
+  private: double budget_max_cycle;
+  private: double budget_last_update;
+  private: double budget_mean_cycle;
+  private: double budget_max_update_cycle;
+};
+
+}
+
+#endif
@@ -52,6 +52,9 @@ map_t *map_alloc(void)
   
   // Allocate storage for main map
   map->cells = (map_cell_t*) NULL;
+
+  // The cspace has not been computed yet
+  map->max_occ_dist = 0;
   
   return map;
 }
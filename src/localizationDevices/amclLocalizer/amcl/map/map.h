@@ -99,6 +99,16 @@ int map_load_occ(map_t *map, const char *filename, double scale, int negate);
 // Load a wifi signal strength map
 //int map_load_wifi(map_t *map, const char *filename, int index);
 
+// Compute a hash of the map geometry and occupancy
+uint64_t map_hash(map_t *map);
+
+// Save the cspace distances, computed by map_update_cspace, to a file
+int map_save_cspace(map_t *map, const char *filename);
+
+// Load the cspace distances from a file saved by map_save_cspace. Fails if the
+// file has been computed for a different map or a different max_occ_dist.
+int map_load_cspace(map_t *map, const char *filename, double max_occ_dist);
+
 // Update the cspace distances
 void map_update_cspace(map_t *map, double max_occ_dist);
 
@@ -30,9 +30,34 @@
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#ifndef _WIN32
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
 
 #include "amcl/map/map.h"
 
+// Header of the cspace files, followed by size_x * size_y float distances.
+// The version is incremented whenever the layout changes; the header and
+// cell sizes guard against files written by a build with a different layout.
+typedef struct
+{
+  char magic[8];
+  uint32_t version;
+  uint32_t header_size;
+  uint32_t cell_size;
+  int32_t reserved;
+  uint64_t hash;
+  int32_t size_x, size_y;
+  double scale;
+  double max_occ_dist;
+} map_cspace_header_t;
+
+static const char map_cspace_magic[8] = "AMCLCSP";
+#define MAP_CSPACE_VERSION 2
+
 
 ////////////////////////////////////////////////////////////////////////////
 // Load an occupancy grid
@@ -133,6 +158,195 @@ int map_load_occ(map_t *map, const char *filename, double scale, int negate)
 }
 
 
+////////////////////////////////////////////////////////////////////////////
+// Compute a hash (FNV-1a) of the map geometry and occupancy
+static uint64_t map_hash_bytes(uint64_t hash, const void *data, size_t size)
+{
+  const unsigned char *bytes = (const unsigned char*) data;
+  size_t i;
+  for (i = 0; i < size; i++)
+  {
+    hash ^= bytes[i];
+    hash *= 1099511628211ULL;
+  }
+  return hash;
+}
+
+uint64_t map_hash(map_t *map)
+{
+  uint64_t hash = 14695981039346656037ULL;
+  int i;
+
+  hash = map_hash_bytes(hash, &map->size_x, sizeof(map->size_x));
+  hash = map_hash_bytes(hash, &map->size_y, sizeof(map->size_y));
+  hash = map_hash_bytes(hash, &map->scale, sizeof(map->scale));
+  hash = map_hash_bytes(hash, &map->origin_x, sizeof(map->origin_x));
+  hash = map_hash_bytes(hash, &map->origin_y, sizeof(map->origin_y));
+  for (i = 0; i < map->size_x * map->size_y; i++)
+  {
+    signed char occ = (signed char) map->cells[i].occ_state;
+    hash = map_hash_bytes(hash, &occ, 1);
+  }
+  return hash;
+}
+
+
+////////////////////////////////////////////////////////////////////////////
+// Save the cspace distances
+int map_save_cspace(map_t *map, const char *filename)
+{
+  FILE *file;
+  map_cspace_header_t header;
+  char tmp_filename[1024];
+  float *dist;
+  int i, n;
+
+  n = map->size_x * map->size_y;
+  memset(&header, 0, sizeof(header));
+  memcpy(header.magic, map_cspace_magic, sizeof(header.magic));
+  header.version = MAP_CSPACE_VERSION;
+  header.header_size = sizeof(map_cspace_header_t);
+  header.cell_size = sizeof(float);
+  header.hash = map_hash(map);
+  header.size_x = map->size_x;
+  header.size_y = map->size_y;
+  header.scale = map->scale;
+  header.max_occ_dist = map->max_occ_dist;
+
+  dist = (float*) malloc(n * sizeof(float));
+  if (dist == NULL)
+    return -1;
+  for (i = 0; i < n; i++)
+    dist[i] = (float) map->cells[i].occ_dist;
+
+  // Write a temporary file, then rename it, so that a partially written
+  // file is never loaded
+  snprintf(tmp_filename, sizeof(tmp_filename), "%s.tmp", filename);
+  file = fopen(tmp_filename, "wb");
+  if (file == NULL)
+  {
+    fprintf(stderr, "%s: %s\n", strerror(errno), tmp_filename);
+    free(dist);
+    return -1;
+  }
+  if (fwrite(&header, sizeof(header), 1, file) != 1 ||
+      fwrite(dist, sizeof(float), n, file) != (size_t) n)
+  {
+    fprintf(stderr, "%s: %s\n", strerror(errno), tmp_filename);
+    fclose(file);
+    free(dist);
+    remove(tmp_filename);
+    return -1;
+  }
+  fclose(file);
+  free(dist);
+
+  // rename() atomically replaces the previous file (on Windows it fails if
+  // the target exists)
+#ifdef _WIN32
+  remove(filename);
+#endif
+  if (rename(tmp_filename, filename) != 0)
+  {
+    fprintf(stderr, "%s: %s\n", strerror(errno), filename);
+    remove(tmp_filename);
+    return -1;
+  }
+  return 0;
+}
+
+
+////////////////////////////////////////////////////////////////////////////
+// Load the cspace distances
+static int map_check_cspace_header(map_t *map, const map_cspace_header_t *header, double max_occ_dist)
+{
+  if (memcmp(header->magic, map_cspace_magic, sizeof(header->magic)) != 0)
+    return -1;
+  if (header->version != MAP_CSPACE_VERSION ||
+      header->header_size != sizeof(map_cspace_header_t) ||
+      header->cell_size != sizeof(float))
+    return -1;
+  if (header->size_x != map->size_x || header->size_y != map->size_y ||
+      header->scale != map->scale || header->max_occ_dist != max_occ_dist)
+    return -1;
+  if (header->hash != map_hash(map))
+    return -1;
+  return 0;
+}
+
+int map_load_cspace(map_t *map, const char *filename, double max_occ_dist)
+{
+  const map_cspace_header_t *header;
+  const float *dist;
+  size_t size;
+  int i, n;
+
+  n = map->size_x * map->size_y;
+  size = sizeof(map_cspace_header_t) + n * sizeof(float);
+
+#ifndef _WIN32
+  // The file is mapped in memory: no read buffers, and the pages are shared
+  // by all the processes loading the same map
+  int fd;
+  struct stat st;
+  void *data;
+
+  fd = open(filename, O_RDONLY);
+  if (fd < 0)
+    return -1;
+  if (fstat(fd, &st) != 0 || (size_t) st.st_size != size)
+  {
+    close(fd);
+    return -1;
+  }
+  data = mmap(NULL, size, PROT_READ, MAP_SHARED, fd, 0);
+  close(fd);
+  if (data == MAP_FAILED)
+    return -1;
+
+  header = (const map_cspace_header_t*) data;
+  if (map_check_cspace_header(map, header, max_occ_dist) != 0)
+  {
+    munmap(data, size);
+    return -1;
+  }
+  dist = (const float*) (header + 1);
+  for (i = 0; i < n; i++)
+    map->cells[i].occ_dist = dist[i];
+  munmap(data, size);
+#else
+  FILE *file;
+  char *data;
+
+  file = fopen(filename, "rb");
+  if (file == NULL)
+    return -1;
+  data = (char*) malloc(size);
+  if (data == NULL || fread(data, 1, size, file) != size || fgetc(file) != EOF)
+  {
+    free(data);
+    fclose(file);
+    return -1;
+  }
+  fclose(file);
+
+  header = (const map_cspace_header_t*) data;
+  if (map_check_cspace_header(map, header, max_occ_dist) != 0)
+  {
+    free(data);
+    return -1;
+  }
+  dist = (const float*) (header + 1);
+  for (i = 0; i < n; i++)
+    map->cells[i].occ_dist = dist[i];
+  free(data);
+#endif
+
+  map->max_occ_dist = max_occ_dist;
+  return 0;
+}
+
+
 ////////////////////////////////////////////////////////////////////////////
 // Load a wifi signal strength map
 /*
@@ -70,6 +70,8 @@ pf_t *pf_alloc(int min_samples, int max_samples,
 
   pf->min_samples = min_samples;
   pf->max_samples = max_samples;
+  pf->alloc_samples = max_samples;
+  pf->kld_samples = max_samples;
 
   // Control parameters for the population size calculation.  [err] is
   // the max error between the true distribution and the estimated
@@ -136,6 +138,16 @@ void pf_free(pf_t *pf)
   return;
 }
 
+// Change the max number of samples
+void pf_set_max_samples(pf_t *pf, int max_samples)
+{
+  if (max_samples > pf->alloc_samples)
+    max_samples = pf->alloc_samples;
+  if (max_samples < pf->min_samples)
+    max_samples = pf->min_samples;
+  pf->max_samples = max_samples;
+}
+
 // Initialize the filter using a guassian
 void pf_init(pf_t *pf, pf_vector_t mean, pf_matrix_t cov)
 {
@@ -214,6 +226,53 @@ void pf_init_model(pf_t *pf, pf_init_model_fn_t init_fn, void *init_data)
   return;
 }
 
+// Initialize the filter from a given set of samples
+void pf_init_samples(pf_t *pf, int sample_count, const pf_sample_t *samples,
+                     double w_slow, double w_fast)
+{
+  int i;
+  double total;
+  pf_sample_set_t *set;
+  pf_sample_t *sample;
+
+  set = pf->sets + pf->current_set;
+
+  // Create the kd tree for adaptive sampling
+  pf_kdtree_clear(set->kdtree);
+
+  if (sample_count > pf->max_samples)
+    sample_count = pf->max_samples;
+  set->sample_count = sample_count;
+
+  total = 0;
+  for (i = 0; i < set->sample_count; i++)
+    total += samples[i].weight;
+
+  for (i = 0; i < set->sample_count; i++)
+  {
+    sample = set->samples + i;
+    sample->pose = samples[i].pose;
+    if (total > 0)
+      sample->weight = samples[i].weight / total;
+    else
+      sample->weight = 1.0 / set->sample_count;
+
+    // Add sample to histogram
+    pf_kdtree_insert(set->kdtree, sample->pose, sample->weight);
+  }
+
+  pf->w_slow = w_slow;
+  pf->w_fast = w_fast;
+
+  // Re-compute cluster statistics
+  pf_cluster_stats(pf, set);
+
+  //set converged to 0
+  pf_init_converged(pf);
+
+  return;
+}
+
 void pf_init_converged(pf_t *pf){
   pf_sample_set_t *set;
   set = pf->sets + pf->current_set;
@@ -461,7 +520,10 @@ int pf_resample_limit(pf_t *pf, int k)
   int n;
 
   if (k <= 1)
+  {
+    pf->kld_samples = pf->max_samples;
     return pf->max_samples;
+  }
 
   a = 1;
   b = 2 / (9 * ((double) k - 1));
@@ -469,6 +531,7 @@ int pf_resample_limit(pf_t *pf, int k)
   x = a - b + c;
 
   n = (int) ceil((k - 1) / (2 * pf->pop_err) * x * x * x);
+  pf->kld_samples = n;
 
   if (n < pf->min_samples)
     return pf->min_samples;
@@ -113,6 +113,13 @@ typedef struct _pf_t
   // This min and max number of samples
   int min_samples, max_samples;
 
+  // Number of samples allocated for each set: max_samples can be changed up to this value
+  int alloc_samples;
+
+  // Number of samples required by the KLD bound at the last resampling, before
+  // being limited to [min_samples, max_samples]
+  int kld_samples;
+
   // Population size parameters
   double pop_err, pop_z;
   
@@ -144,12 +151,20 @@ pf_t *pf_alloc(int min_samples, int max_samples,
 // Free an existing filter
 void pf_free(pf_t *pf);
 
+// Change the max number of samples, limited to [min_samples, number of samples allocated].
+// The current set keeps its samples: the new limit applies from the next resampling.
+void pf_set_max_samples(pf_t *pf, int max_samples);
+
 // Initialize the filter using a guassian
 void pf_init(pf_t *pf, pf_vector_t mean, pf_matrix_t cov);
 
 // Initialize the filter using some model
 void pf_init_model(pf_t *pf, pf_init_model_fn_t init_fn, void *init_data);
 
+// Initialize the filter from a given set of samples (e.g. a saved state)
+void pf_init_samples(pf_t *pf, int sample_count, const pf_sample_t *samples,
+                     double w_slow, double w_fast);
+
 // Update the filter with some new action
 void pf_update_action(pf_t *pf, pf_action_model_fn_t action_fn, void *action_data);
 
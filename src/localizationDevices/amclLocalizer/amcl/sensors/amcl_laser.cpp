@@ -36,6 +36,13 @@
 
 using namespace amcl;
 
+// Number of particles used by the beam selection to check the beams against the map
+#define BEAM_SELECTION_PARTICLES 32
+// Weight of the curvature of the scan (0..1) respect to a straight wall (1)
+#define BEAM_SELECTION_CURVATURE_GAIN 4.0
+// Gap between consecutive end points which marks the edge of an obstacle [m]
+#define BEAM_SELECTION_EDGE_DISTANCE 0.2
+
 ////////////////////////////////////////////////////////////////////////////////
 // Default constructor
 AMCLLaser::AMCLLaser(size_t max_beams, map_t* map) : AMCLSensor(), 
@@ -46,6 +53,10 @@ AMCLLaser::AMCLLaser(size_t max_beams, map_t* map) : AMCLSensor(),
 
   this->max_beams = max_beams;
   this->map = map;
+  this->adaptive_beams = false;
+  this->do_beamskip = false;
+  this->dir_first = 0.0;
+  this->dir_last = 0.0;
 
   return;
 }
@@ -90,7 +101,9 @@ AMCLLaser::SetModelLikelihoodField(double z_hit,
   this->z_rand = z_rand;
   this->sigma_hit = sigma_hit;
 
-  map_update_cspace(this->map, max_occ_dist);
+  // The distances may have been already computed (or loaded from a file)
+  if (this->map->max_occ_dist != max_occ_dist)
+    map_update_cspace(this->map, max_occ_dist);
 }
 
 void 
@@ -111,7 +124,29 @@ AMCLLaser::SetModelLikelihoodFieldProb(double z_hit,
   this->beam_skip_distance = beam_skip_distance;
   this->beam_skip_threshold = beam_skip_threshold;
   this->beam_skip_error_threshold = beam_skip_error_threshold;
-  map_update_cspace(this->map, max_occ_dist);
+  if (this->map->max_occ_dist != max_occ_dist)
+    map_update_cspace(this->map, max_occ_dist);
+}
+
+void
+AMCLLaser::SetBeamSelection(bool adaptive,
+                            bool do_beamskip,
+                            double beam_skip_distance,
+                            double beam_skip_threshold,
+                            double beam_skip_error_threshold)
+{
+  this->adaptive_beams = adaptive;
+  this->do_beamskip = do_beamskip;
+  this->beam_skip_distance = beam_skip_distance;
+  this->beam_skip_threshold = beam_skip_threshold;
+  this->beam_skip_error_threshold = beam_skip_error_threshold;
+}
+
+void
+AMCLLaser::SetMaxBeams(int max_beams)
+{
+  // The temp data of the beam skipping is reallocated by the model if needed
+  this->max_beams = (max_beams < 2) ? 2 : max_beams;
 }
 
 
@@ -225,6 +260,29 @@ double AMCLLaser::LikelihoodFieldModel(AMCLLaserData *data, pf_sample_set_t* set
 
   total_weight = 0.0;
 
+  // Pre-compute a couple of things
+  double z_hit_denom = 2 * self->sigma_hit * self->sigma_hit;
+  double z_rand_mult = 1.0/data->range_max;
+
+  // Choose the beams
+  if (self->adaptive_beams)
+  {
+    self->SelectBeams(data, set);
+  }
+  else
+  {
+    step = (data->range_count - 1) / (self->max_beams - 1);
+
+    // Step size must be at least 1
+    if(step < 1)
+      step = 1;
+
+    self->beam_indices.clear();
+    for (i = 0; i < data->range_count; i += step)
+      self->beam_indices.push_back(i);
+  }
+  int beam_count = (int)self->beam_indices.size();
+
   // Compute the sample weights
   for (j = 0; j < set->sample_count; j++)
   {
@@ -236,18 +294,9 @@ double AMCLLaser::LikelihoodFieldModel(AMCLLaserData *data, pf_sample_set_t* set
 
     p = 1.0;
 
-    // Pre-compute a couple of things
-    double z_hit_denom = 2 * self->sigma_hit * self->sigma_hit;
-    double z_rand_mult = 1.0/data->range_max;
-
-    step = (data->range_count - 1) / (self->max_beams - 1);
-
-    // Step size must be at least 1
-    if(step < 1)
-      step = 1;
-
-    for (i = 0; i < data->range_count; i += step)
+    for (int b = 0; b < beam_count; b++)
     {
+      i = self->beam_indices[b];
       obs_range = data->ranges[i][0];
       obs_bearing = data->ranges[i][1];
 
@@ -299,6 +348,138 @@ double AMCLLaser::LikelihoodFieldModel(AMCLLaserData *data, pf_sample_set_t* set
   return(total_weight);
 }
 
+void AMCLLaser::UpdateBeamDirections(AMCLLaserData *data)
+{
+  int i;
+
+  // The bearings are evenly spaced (see AMCLFilter::Update), so the number
+  // of beams and the first and last bearing identify the scan geometry
+  if (data->range_count == (int)this->dir_cos.size() &&
+      (data->range_count == 0 ||
+       (data->ranges[0][1] == this->dir_first &&
+        data->ranges[data->range_count - 1][1] == this->dir_last)))
+    return;
+
+  this->dir_cos.resize(data->range_count);
+  this->dir_sin.resize(data->range_count);
+  for (i = 0; i < data->range_count; i++)
+  {
+    this->dir_cos[i] = cos(data->ranges[i][1]);
+    this->dir_sin[i] = sin(data->ranges[i][1]);
+  }
+  if (data->range_count > 0)
+  {
+    this->dir_first = data->ranges[0][1];
+    this->dir_last = data->ranges[data->range_count - 1][1];
+  }
+}
+
+void AMCLLaser::SelectBeams(AMCLLaserData *data, pf_sample_set_t* set)
+{
+  int i, c, j;
+
+  // The candidates are the valid readings, with their end points in the laser frame
+  this->UpdateBeamDirections(data);
+  this->cand_index.clear();
+  this->cand_x.clear();
+  this->cand_y.clear();
+  for (i = 0; i < data->range_count; i++)
+  {
+    double obs_range = data->ranges[i][0];
+    if (obs_range >= data->range_max || obs_range != obs_range)
+      continue;
+    this->cand_index.push_back(i);
+    this->cand_x.push_back(obs_range * this->dir_cos[i]);
+    this->cand_y.push_back(obs_range * this->dir_sin[i]);
+  }
+  int count = (int)this->cand_index.size();
+
+  // Weight of each beam: the turn of the scan outline at its end point
+  // (|sin| of the angle between the previous and the next segment).
+  // The end points next to a gap (the edge of an obstacle) get the maximum weight.
+  this->cand_weight.resize(count);
+  for (c = 0; c < count; c++)
+  {
+    double curvature = 1.0;
+    if (c > 0 && c < count - 1)
+    {
+      double ax = this->cand_x[c] - this->cand_x[c - 1];
+      double ay = this->cand_y[c] - this->cand_y[c - 1];
+      double bx = this->cand_x[c + 1] - this->cand_x[c];
+      double by = this->cand_y[c + 1] - this->cand_y[c];
+      double la = sqrt(ax * ax + ay * ay);
+      double lb = sqrt(bx * bx + by * by);
+      if (la < BEAM_SELECTION_EDGE_DISTANCE && lb < BEAM_SELECTION_EDGE_DISTANCE && la > 0 && lb > 0)
+        curvature = fabs(ax * by - ay * bx) / (la * lb);
+    }
+    this->cand_weight[c] = 1.0 + BEAM_SELECTION_CURVATURE_GAIN * curvature;
+  }
+
+  // Beam skipping: the end points are checked on a subset of the particles
+  // and the beams which disagree with the map for most of them get no weight.
+  // Like in LikelihoodFieldModelProb, this is done only if the filter has converged.
+  if (this->do_beamskip && set->converged && count > 0)
+  {
+    int stride = set->sample_count / BEAM_SELECTION_PARTICLES;
+    if (stride < 1)
+      stride = 1;
+    int checked = 0;
+    this->cand_agree.assign(count, 0);
+    for (j = 0; j < set->sample_count; j += stride, checked++)
+    {
+      pf_vector_t pose = pf_vector_coord_add(this->laser_pose, set->samples[j].pose);
+      double cs = cos(pose.v[2]);
+      double sn = sin(pose.v[2]);
+      for (c = 0; c < count; c++)
+      {
+        int mi = MAP_GXWX(this->map, pose.v[0] + cs * this->cand_x[c] - sn * this->cand_y[c]);
+        int mj = MAP_GYWY(this->map, pose.v[1] + sn * this->cand_x[c] + cs * this->cand_y[c]);
+        if (MAP_VALID(this->map, mi, mj) &&
+            this->map->cells[MAP_INDEX(this->map, mi, mj)].occ_dist < this->beam_skip_distance)
+          this->cand_agree[c]++;
+      }
+    }
+
+    int skipped = 0;
+    for (c = 0; c < count; c++)
+    {
+      if (this->cand_agree[c] <= this->beam_skip_threshold * checked)
+        skipped++;
+    }
+    // Too many disagreeing beams: the filter may have converged to a wrong pose, use all of them
+    if (skipped < count * this->beam_skip_error_threshold)
+    {
+      for (c = 0; c < count; c++)
+      {
+        if (this->cand_agree[c] <= this->beam_skip_threshold * checked)
+          this->cand_weight[c] = 0;
+      }
+    }
+  }
+
+  // Draw max_beams beams with a probability proportional to their weight
+  // (systematic sampling, no random numbers: the same scan gives the same beams)
+  this->beam_indices.clear();
+  double total = 0;
+  for (c = 0; c < count; c++)
+    total += this->cand_weight[c];
+  if (total <= 0)
+    return;
+  double step = total / this->max_beams;
+  double next = step / 2;
+  double cumulative = 0;
+  for (c = 0; c < count; c++)
+  {
+    cumulative += this->cand_weight[c];
+    if (cumulative > next)
+    {
+      this->beam_indices.push_back(this->cand_index[c]);
+      while (next < cumulative)
+        next += step;
+    }
+  }
+}
+
 double AMCLLaser::LikelihoodFieldModelProb(AMCLLaserData *data, pf_sample_set_t* set)
 {
   AMCLLaser *self;
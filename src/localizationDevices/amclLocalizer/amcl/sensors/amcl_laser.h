@@ -29,6 +29,8 @@
 #ifndef AMCL_LASER_H
 #define AMCL_LASER_H
 
+#include <vector>
+
 #include "amcl_sensor.h"
 #include "../map/map.h"
 
@@ -86,10 +88,28 @@ class AMCLLaser : public AMCLSensor
 					   double beam_skip_threshold, 
 					   double beam_skip_error_threshold);
 
+  // Adaptive beam selection (used by LikelihoodFieldModel model).
+  // If adaptive is true, the max_beams beams are not evenly spaced: they are
+  // drawn with a probability which increases with the curvature of the scan
+  // at their end point, so corners and edges get more beams than straight walls.
+  // If do_beamskip is also true and the filter has converged, the beams whose
+  // end points are far (beam_skip_distance) from the obstacles of the map for
+  // most particles (1 - beam_skip_threshold) are not used, unless they are more
+  // than beam_skip_error_threshold of the scan.
+  public: void SetBeamSelection(bool adaptive,
+                                bool do_beamskip,
+                                double beam_skip_distance,
+                                double beam_skip_threshold,
+                                double beam_skip_error_threshold);
+
   // Update the filter based on the sensor model.  Returns true if the
   // filter has been updated.
   public: virtual bool UpdateSensor(pf_t *pf, AMCLSensorData *data);
 
+  // Change the max number of beams used by the models (at least 2)
+  public: void SetMaxBeams(int max_beams);
+  public: int GetMaxBeams() const { return this->max_beams; }
+
   // Set the laser's pose after construction
   public: void SetLaserPose(pf_vector_t& laser_pose) 
           {this->laser_pose = laser_pose;}
@@ -107,6 +127,12 @@ class AMCLLaser : public AMCLSensor
 
   private: void reallocTempData(int max_samples, int max_obs);
 
+  // Fills beam_indices with the beams to be used by LikelihoodFieldModel
+  private: void SelectBeams(AMCLLaserData *data, pf_sample_set_t* set);
+
+  // Recomputes dir_cos and dir_sin if the scan geometry has changed
+  private: void UpdateBeamDirections(AMCLLaserData *data);
+
   private: laser_model_t model_type;
 
   // Current data timestamp
@@ -129,6 +155,24 @@ class AMCLLaser : public AMCLSensor
   //this would be an error condition 
   private: double beam_skip_error_threshold;
 
+  // Adaptive beam selection (used by LikelihoodFieldModel model)
+  private: bool adaptive_beams;
+  private: std::vector<int> beam_indices;
+
+  // Scratch buffers of the beam selection, one element per valid beam
+  private: std::vector<int> cand_index;
+  private: std::vector<double> cand_x;
+  private: std::vector<double> cand_y;
+  private: std::vector<double> cand_weight;
+  private: std::vector<int> cand_agree;
+
+  // Direction of each beam (cos, sin of its bearing), computed once per scan
+  // geometry: the first and last bearing of the scan it refers to
+  private: std::vector<double> dir_cos;
+  private: std::vector<double> dir_sin;
+  private: double dir_first;
+  private: double dir_last;
+
   //temp data that is kept before observations are integrated to each particle (requried for beam skipping)
   private: int max_samples;
   private: int max_obs;
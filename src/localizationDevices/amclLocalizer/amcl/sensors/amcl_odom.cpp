@@ -39,6 +39,9 @@ using namespace amcl;
 static double
 normalize(double z)
 {
+  // Most of the angles (e.g. the sampled noise) are already in range
+  if (z >= -M_PI && z <= M_PI)
+    return z;
   return atan2(sin(z),cos(z));
 }
 static double
@@ -62,6 +65,7 @@ angle_diff(double a, double b)
 AMCLOdom::AMCLOdom() : AMCLSensor()
 {
   this->time = 0.0;
+  this->use_drand48 = false;
 }
 
 void
@@ -108,6 +112,38 @@ AMCLOdom::SetModel( odom_model_t type,
   this->alpha5 = alpha5;
 }
 
+void
+AMCLOdom::SetRandomGenerator(bool use_drand48, uint64_t seed, unsigned int stream)
+{
+  this->use_drand48 = use_drand48;
+  this->random.Seed(seed, stream);
+}
+
+////////////////////////////////////////////////////////////////////////////////
+// Draw the unit noise of all the samples in one pass
+void AMCLOdom::DrawNoise(int n)
+{
+  this->noise_a.resize(n);
+  this->noise_b.resize(n);
+  this->noise_c.resize(n);
+  if (this->use_drand48)
+  {
+    // Same sequence of calls of the original per-sample implementation
+    for (int i = 0; i < n; i++)
+    {
+      this->noise_a[i] = pf_ran_gaussian(1.0);
+      this->noise_b[i] = pf_ran_gaussian(1.0);
+      this->noise_c[i] = pf_ran_gaussian(1.0);
+    }
+  }
+  else
+  {
+    this->random.Gaussian(this->noise_a.data(), n);
+    this->random.Gaussian(this->noise_b.data(), n);
+    this->random.Gaussian(this->noise_c.data(), n);
+  }
+}
+
 ////////////////////////////////////////////////////////////////////////////////
 // Apply the action model
 bool AMCLOdom::UpdateAction(pf_t *pf, AMCLSensorData *data)
@@ -121,144 +157,86 @@ bool AMCLOdom::UpdateAction(pf_t *pf, AMCLSensorData *data)
   set = pf->sets + pf->current_set;
   pf_vector_t old_pose = pf_vector_sub(ndata->pose, ndata->delta);
 
+  // The noise of all the samples is drawn at once, then the pose differences
+  // are computed on contiguous arrays and finally applied to the samples.
+  // pf_ran_gaussian(sigma) is equivalent to sigma * N(0,1).
+  int n = set->sample_count;
+  this->DrawNoise(n);
+  this->theta.resize(n);
+  this->dx.resize(n);
+  this->dy.resize(n);
+  this->dtheta.resize(n);
+  const double* na = this->noise_a.data();
+  const double* nb = this->noise_b.data();
+  const double* nc = this->noise_c.data();
+  double* th = this->theta.data();
+  double* ddx = this->dx.data();
+  double* ddy = this->dy.data();
+  double* dth = this->dtheta.data();
+
+  for (int i = 0; i < n; i++)
+    th[i] = set->samples[i].pose.v[2];
+
   switch( this->model_type )
   {
   case ODOM_MODEL_OMNI:
+  case ODOM_MODEL_OMNI_CORRECTED:
   {
-    double delta_trans, delta_rot, delta_bearing;
-    double delta_trans_hat, delta_rot_hat, delta_strafe_hat;
+    double delta_trans, delta_rot, delta_bearing0;
+    double trans_hat_stddev, rot_hat_stddev, strafe_hat_stddev;
 
     delta_trans = sqrt(ndata->delta.v[0]*ndata->delta.v[0] +
                        ndata->delta.v[1]*ndata->delta.v[1]);
     delta_rot = ndata->delta.v[2];
 
     // Precompute a couple of things
-    double trans_hat_stddev = (alpha3 * (delta_trans*delta_trans) +
-                               alpha1 * (delta_rot*delta_rot));
-    double rot_hat_stddev = (alpha4 * (delta_rot*delta_rot) +
-                             alpha2 * (delta_trans*delta_trans));
-    double strafe_hat_stddev = (alpha1 * (delta_rot*delta_rot) +
-                                alpha5 * (delta_trans*delta_trans));
-
-    for (int i = 0; i < set->sample_count; i++)
+    if (this->model_type == ODOM_MODEL_OMNI)
     {
-      pf_sample_t* sample = set->samples + i;
-
-      delta_bearing = angle_diff(atan2(ndata->delta.v[1], ndata->delta.v[0]),
-                                 old_pose.v[2]) + sample->pose.v[2];
-      double cs_bearing = cos(delta_bearing);
-      double sn_bearing = sin(delta_bearing);
-
-      // Sample pose differences
-      delta_trans_hat = delta_trans + pf_ran_gaussian(trans_hat_stddev);
-      delta_rot_hat = delta_rot + pf_ran_gaussian(rot_hat_stddev);
-      delta_strafe_hat = 0 + pf_ran_gaussian(strafe_hat_stddev);
-      // Apply sampled update to particle pose
-      sample->pose.v[0] += (delta_trans_hat * cs_bearing + 
-                            delta_strafe_hat * sn_bearing);
-      sample->pose.v[1] += (delta_trans_hat * sn_bearing - 
-                            delta_strafe_hat * cs_bearing);
-      sample->pose.v[2] += delta_rot_hat ;
+      trans_hat_stddev = (alpha3 * (delta_trans*delta_trans) +
+                          alpha1 * (delta_rot*delta_rot));
+      rot_hat_stddev = (alpha4 * (delta_rot*delta_rot) +
+                        alpha2 * (delta_trans*delta_trans));
+      strafe_hat_stddev = (alpha1 * (delta_rot*delta_rot) +
+                           alpha5 * (delta_trans*delta_trans));
     }
-  }
-  break;
-  case ODOM_MODEL_DIFF:
-  {
-    // Implement sample_motion_odometry (Prob Rob p 136)
-    double delta_rot1, delta_trans, delta_rot2;
-    double delta_rot1_hat, delta_trans_hat, delta_rot2_hat;
-    double delta_rot1_noise, delta_rot2_noise;
-
-    // Avoid computing a bearing from two poses that are extremely near each
-    // other (happens on in-place rotation).
-    if(sqrt(ndata->delta.v[1]*ndata->delta.v[1] + 
-            ndata->delta.v[0]*ndata->delta.v[0]) < 0.01)
-      delta_rot1 = 0.0;
     else
-      delta_rot1 = angle_diff(atan2(ndata->delta.v[1], ndata->delta.v[0]),
-                              old_pose.v[2]);
-    delta_trans = sqrt(ndata->delta.v[0]*ndata->delta.v[0] +
-                       ndata->delta.v[1]*ndata->delta.v[1]);
-    delta_rot2 = angle_diff(ndata->delta.v[2], delta_rot1);
-
-    // We want to treat backward and forward motion symmetrically for the
-    // noise model to be applied below.  The standard model seems to assume
-    // forward motion.
-    delta_rot1_noise = std::min(fabs(angle_diff(delta_rot1,0.0)),
-                                fabs(angle_diff(delta_rot1,M_PI)));
-    delta_rot2_noise = std::min(fabs(angle_diff(delta_rot2,0.0)),
-                                fabs(angle_diff(delta_rot2,M_PI)));
-
-    for (int i = 0; i < set->sample_count; i++)
     {
-      pf_sample_t* sample = set->samples + i;
-
-      // Sample pose differences
-      delta_rot1_hat = angle_diff(delta_rot1,
-                                  pf_ran_gaussian(this->alpha1*delta_rot1_noise*delta_rot1_noise +
-                                                  this->alpha2*delta_trans*delta_trans));
-      delta_trans_hat = delta_trans - 
-              pf_ran_gaussian(this->alpha3*delta_trans*delta_trans +
-                              this->alpha4*delta_rot1_noise*delta_rot1_noise +
-                              this->alpha4*delta_rot2_noise*delta_rot2_noise);
-      delta_rot2_hat = angle_diff(delta_rot2,
-                                  pf_ran_gaussian(this->alpha1*delta_rot2_noise*delta_rot2_noise +
-                                                  this->alpha2*delta_trans*delta_trans));
-
-      // Apply sampled update to particle pose
-      sample->pose.v[0] += delta_trans_hat * 
-              cos(sample->pose.v[2] + delta_rot1_hat);
-      sample->pose.v[1] += delta_trans_hat * 
-              sin(sample->pose.v[2] + delta_rot1_hat);
-      sample->pose.v[2] += delta_rot1_hat + delta_rot2_hat;
+      trans_hat_stddev = sqrt( alpha3 * (delta_trans*delta_trans) +
+                               alpha4 * (delta_rot*delta_rot) );
+      rot_hat_stddev = sqrt( alpha1 * (delta_rot*delta_rot) +
+                             alpha2 * (delta_trans*delta_trans) );
+      strafe_hat_stddev = sqrt( alpha4 * (delta_rot*delta_rot) +
+                                alpha5 * (delta_trans*delta_trans) );
     }
-  }
-  break;
-  case ODOM_MODEL_OMNI_CORRECTED:
-  {
-    double delta_trans, delta_rot, delta_bearing;
-    double delta_trans_hat, delta_rot_hat, delta_strafe_hat;
+    // The bearing of the motion with respect to the old pose is the same for all the samples
+    delta_bearing0 = angle_diff(atan2(ndata->delta.v[1], ndata->delta.v[0]),
+                                old_pose.v[2]);
 
-    delta_trans = sqrt(ndata->delta.v[0]*ndata->delta.v[0] +
-                       ndata->delta.v[1]*ndata->delta.v[1]);
-    delta_rot = ndata->delta.v[2];
-
-    // Precompute a couple of things
-    double trans_hat_stddev = sqrt( alpha3 * (delta_trans*delta_trans) +
-                                    alpha4 * (delta_rot*delta_rot) );
-    double rot_hat_stddev = sqrt( alpha1 * (delta_rot*delta_rot) +
-                                  alpha2 * (delta_trans*delta_trans) );
-    double strafe_hat_stddev = sqrt( alpha4 * (delta_rot*delta_rot) +
-                                     alpha5 * (delta_trans*delta_trans) );
-
-    for (int i = 0; i < set->sample_count; i++)
+    for (int i = 0; i < n; i++)
     {
-      pf_sample_t* sample = set->samples + i;
-
-      delta_bearing = angle_diff(atan2(ndata->delta.v[1], ndata->delta.v[0]),
-                                 old_pose.v[2]) + sample->pose.v[2];
+      double delta_bearing = delta_bearing0 + th[i];
       double cs_bearing = cos(delta_bearing);
       double sn_bearing = sin(delta_bearing);
 
       // Sample pose differences
-      delta_trans_hat = delta_trans + pf_ran_gaussian(trans_hat_stddev);
-      delta_rot_hat = delta_rot + pf_ran_gaussian(rot_hat_stddev);
-      delta_strafe_hat = 0 + pf_ran_gaussian(strafe_hat_stddev);
-      // Apply sampled update to particle pose
-      sample->pose.v[0] += (delta_trans_hat * cs_bearing + 
-                            delta_strafe_hat * sn_bearing);
-      sample->pose.v[1] += (delta_trans_hat * sn_bearing - 
-                            delta_strafe_hat * cs_bearing);
-      sample->pose.v[2] += delta_rot_hat ;
+      double delta_trans_hat = delta_trans + trans_hat_stddev * na[i];
+      double delta_rot_hat = delta_rot + rot_hat_stddev * nb[i];
+      double delta_strafe_hat = 0 + strafe_hat_stddev * nc[i];
+      ddx[i] = (delta_trans_hat * cs_bearing +
+                delta_strafe_hat * sn_bearing);
+      ddy[i] = (delta_trans_hat * sn_bearing -
+                delta_strafe_hat * cs_bearing);
+      dth[i] = delta_rot_hat;
     }
   }
   break;
+  case ODOM_MODEL_DIFF:
   case ODOM_MODEL_DIFF_CORRECTED:
   {
     // Implement sample_motion_odometry (Prob Rob p 136)
     double delta_rot1, delta_trans, delta_rot2;
-    double delta_rot1_hat, delta_trans_hat, delta_rot2_hat;
     double delta_rot1_noise, delta_rot2_noise;
+    double rot1_hat_stddev, trans_hat_stddev, rot2_hat_stddev;
 
     // Avoid computing a bearing from two poses that are extremely near each
     // other (happens on in-place rotation).
@@ -280,31 +258,42 @@ bool AMCLOdom::UpdateAction(pf_t *pf, AMCLSensorData *data)
     delta_rot2_noise = std::min(fabs(angle_diff(delta_rot2,0.0)),
                                 fabs(angle_diff(delta_rot2,M_PI)));
 
-    for (int i = 0; i < set->sample_count; i++)
+    rot1_hat_stddev = this->alpha1*delta_rot1_noise*delta_rot1_noise +
+                      this->alpha2*delta_trans*delta_trans;
+    trans_hat_stddev = this->alpha3*delta_trans*delta_trans +
+                       this->alpha4*delta_rot1_noise*delta_rot1_noise +
+                       this->alpha4*delta_rot2_noise*delta_rot2_noise;
+    rot2_hat_stddev = this->alpha1*delta_rot2_noise*delta_rot2_noise +
+                      this->alpha2*delta_trans*delta_trans;
+    if (this->model_type == ODOM_MODEL_DIFF_CORRECTED)
     {
-      pf_sample_t* sample = set->samples + i;
+      rot1_hat_stddev = sqrt(rot1_hat_stddev);
+      trans_hat_stddev = sqrt(trans_hat_stddev);
+      rot2_hat_stddev = sqrt(rot2_hat_stddev);
+    }
 
+    for (int i = 0; i < n; i++)
+    {
       // Sample pose differences
-      delta_rot1_hat = angle_diff(delta_rot1,
-                                  pf_ran_gaussian(sqrt(this->alpha1*delta_rot1_noise*delta_rot1_noise +
-                                                       this->alpha2*delta_trans*delta_trans)));
-      delta_trans_hat = delta_trans - 
-              pf_ran_gaussian(sqrt(this->alpha3*delta_trans*delta_trans +
-                                   this->alpha4*delta_rot1_noise*delta_rot1_noise +
-                                   this->alpha4*delta_rot2_noise*delta_rot2_noise));
-      delta_rot2_hat = angle_diff(delta_rot2,
-                                  pf_ran_gaussian(sqrt(this->alpha1*delta_rot2_noise*delta_rot2_noise +
-                                                       this->alpha2*delta_trans*delta_trans)));
+      double delta_rot1_hat = angle_diff(delta_rot1, rot1_hat_stddev * na[i]);
+      double delta_trans_hat = delta_trans - trans_hat_stddev * nb[i];
+      double delta_rot2_hat = angle_diff(delta_rot2, rot2_hat_stddev * nc[i]);
 
-      // Apply sampled update to particle pose
-      sample->pose.v[0] += delta_trans_hat * 
-              cos(sample->pose.v[2] + delta_rot1_hat);
-      sample->pose.v[1] += delta_trans_hat * 
-              sin(sample->pose.v[2] + delta_rot1_hat);
-      sample->pose.v[2] += delta_rot1_hat + delta_rot2_hat;
+      ddx[i] = delta_trans_hat * cos(th[i] + delta_rot1_hat);
+      ddy[i] = delta_trans_hat * sin(th[i] + delta_rot1_hat);
+      dth[i] = delta_rot1_hat + delta_rot2_hat;
     }
   }
   break;
   }
+
+  // Apply sampled update to particle pose
+  for (int i = 0; i < n; i++)
+  {
+    pf_sample_t* sample = set->samples + i;
+    sample->pose.v[0] += ddx[i];
+    sample->pose.v[1] += ddy[i];
+    sample->pose.v[2] += dth[i];
+  }
   return true;
 }
@@ -29,7 +29,11 @@
 #ifndef AMCL_ODOM_H
 #define AMCL_ODOM_H
 
+#include <vector>
+#include <stdint.h>
+
 #include "amcl_sensor.h"
+#include "amcl_random.h"
 #include "../pf/pf_pdf.h"
 
 #ifndef M_PI
@@ -82,10 +86,20 @@ class AMCLOdom : public AMCLSensor
                          double alpha4,
                          double alpha5 = 0 );
 
+  // Selects the generator of the motion noise: if use_drand48 is true, the
+  // global drand48() generator (pf_ran_gaussian) is used, as in the original
+  // implementation. Otherwise (default) a xoshiro256+ generator owned by this
+  // model, initialized with the given seed and stream.
+  public: void SetRandomGenerator(bool use_drand48, uint64_t seed = 0,
+                                  unsigned int stream = 0);
+
   // Update the filter based on the action model.  Returns true if the filter
   // has been updated.
   public: virtual bool UpdateAction(pf_t *pf, AMCLSensorData *data);
 
+  // Draws 3*n unit gaussian samples into noise_a, noise_b, noise_c
+  private: void DrawNoise(int n);
+
   // Current data timestamp
   private: double time;
   
@@ -94,6 +108,14 @@ class AMCLOdom : public AMCLSensor
 
   // Drift parameters
   private: double alpha1, alpha2, alpha3, alpha4, alpha5;
+
+  // Noise generator
+  private: bool use_drand48;
+  private: AMCLRandom random;
+
+  // Per-particle work buffers (structure of arrays), reused across updates
+  private: std::vector<double> noise_a, noise_b, noise_c;
+  private: std::vector<double> theta, dx, dy, dtheta;
 };
 
 
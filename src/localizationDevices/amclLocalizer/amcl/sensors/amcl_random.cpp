@@ -0,0 +1,97 @@
+/*
+ * Copyright (C) 2020 Istituto Italiano di Tecnologia (IIT)
+ * All rights reserved.
+ *
+ * This software may be modified and distributed under the terms of the
+ * GPL-2+ license. See the accompanying LICENSE file for details.
+ */
+///////////////////////////////////////////////////////////////////////////
+//
+// Desc: Random number generator for the AMCL sensor models
+//
+///////////////////////////////////////////////////////////////////////////
+
+#include <math.h>
+
+#include "amcl/sensors/amcl_random.h"
+
+#ifndef M_PI
+#define M_PI 3.14159265358979323846
+#endif
+
+using namespace amcl;
+
+AMCLRandom::AMCLRandom()
+{
+  this->Seed(0);
+}
+
+void
+AMCLRandom::Seed(uint64_t seed, unsigned int stream)
+{
+  // The state is initialized with splitmix64, as suggested by the xoshiro authors
+  uint64_t z = seed;
+  for (int i = 0; i < 4; i++)
+  {
+    z += 0x9e3779b97f4a7c15ULL;
+    uint64_t x = z;
+    x = (x ^ (x >> 30)) * 0xbf58476d1ce4e5b9ULL;
+    x = (x ^ (x >> 27)) * 0x94d049bb133111ebULL;
+    s[i] = x ^ (x >> 31);
+  }
+  for (unsigned int i = 0; i < stream; i++)
+  {
+    this->Jump();
+  }
+}
+
+void
+AMCLRandom::Jump()
+{
+  static const uint64_t JUMP[] = { 0x180ec6d33cfd0abaULL, 0xd5a61266f0c9392cULL,
+                                   0xa9582618e03fc9aaULL, 0x39abdc4529b1661cULL };
+  uint64_t s0 = 0, s1 = 0, s2 = 0, s3 = 0;
+  for (int i = 0; i < 4; i++)
+  {
+    for (int b = 0; b < 64; b++)
+    {
+      if (JUMP[i] & (1ULL << b))
+      {
+        s0 ^= s[0];
+        s1 ^= s[1];
+        s2 ^= s[2];
+        s3 ^= s[3];
+      }
+      this->Next();
+    }
+  }
+  s[0] = s0;
+  s[1] = s1;
+  s[2] = s2;
+  s[3] = s3;
+}
+
+void
+AMCLRandom::Gaussian(double* out, int n)
+{
+  // Draw the uniform numbers (one pair every two outputs, plus one for an odd tail)
+  for (int i = 0; i < n; i++)
+  {
+    out[i] = this->Uniform();
+  }
+  double tail_u2 = (n % 2) ? this->Uniform() : 0.0;
+
+  // Box-Muller transform, in place
+  for (int k = 0; k < n / 2; k++)
+  {
+    double r = sqrt(-2.0 * log(out[2 * k]));
+    double t = 2.0 * M_PI * out[2 * k + 1];
+    out[2 * k] = r * cos(t);
+    out[2 * k + 1] = r * sin(t);
+  }
+  if (n % 2)
+  {
+    double r = sqrt(-2.0 * log(out[n - 1]));
+    out[n - 1] = r * cos(2.0 * M_PI * tail_u2);
+  }
+}
@@ -0,0 +1,71 @@
+/*
+ * Copyright (C) 2020 Istituto Italiano di Tecnologia (IIT)
+ * All rights reserved.
+ *
+ * This software may be modified and distributed under the terms of the
+ * GPL-2+ license. See the accompanying LICENSE file for details.
+ */
+///////////////////////////////////////////////////////////////////////////
+//
+// Desc: Random number generator for the AMCL sensor models
+//
+///////////////////////////////////////////////////////////////////////////
+
+#ifndef AMCL_RANDOM_H
+#define AMCL_RANDOM_H
+
+#include <stdint.h>
+
+namespace amcl
+{
+
+// xoshiro256+ pseudo random generator.
+// Unlike drand48(), the state is owned by the instance: each worker uses its own stream,
+// so that the sequence of drawn numbers (and the filter output) is reproducible for a given seed.
+class AMCLRandom
+{
+  public: AMCLRandom();
+
+  // Initializes the state from a seed. Different streams of the same seed
+  // are non-overlapping (each stream is 2^128 numbers apart).
+  public: void Seed(uint64_t seed, unsigned int stream = 0);
+
+  // Returns a uniformly distributed 64 bit number
+  public: inline uint64_t Next()
+  {
+    const uint64_t result = s[0] + s[3];
+    const uint64_t t = s[1] << 17;
+    s[2] ^= s[0];
+    s[3] ^= s[1];
+    s[1] ^= s[2];
+    s[0] ^= s[3];
+    s[2] ^= t;
+    s[3] = Rotl(s[3], 45);
+    return result;
+  }
+
+  // Returns a uniformly distributed number in (0,1]
+  public: inline double Uniform()
+  {
+    return ((Next() >> 11) + 1) * (1.0 / 9007199254740992.0);
+  }
+
+  // Fills out[0..n) with samples drawn from a zero-mean, unit variance Gaussian distribution.
+  // The uniform numbers are drawn first, then converted in a separate loop (Box-Muller transform,
+  // two samples per pair) which has no dependencies among the iterations and can be vectorized.
+  public: void Gaussian(double* out, int n);
+
+  // Advances the state by 2^128 steps
+  private: void Jump();
+
+  private: static inline uint64_t Rotl(const uint64_t x, int k)
+  {
+    return (x << k) | (x >> (64 - k));
+  }
+
+  private: uint64_t s[4];
+};
+
+}
+
+#endif
@@ -0,0 +1,291 @@
+/*
+ * Copyright (C) 2020 Istituto Italiano di Tecnologia (IIT)
+ * All rights reserved.
+ *
+ * This software may be modified and distributed under the terms of the
+ * GPL-2+ license. See the accompanying LICENSE file for details.
+ */
+///////////////////////////////////////////////////////////////////////////
+//
+// Desc: Correlative scan matcher for the global localization
+//
+///////////////////////////////////////////////////////////////////////////
+
+#include <algorithm>
+#include <thread>
+#include <math.h>
+
+#include "amcl/sensors/amcl_scan_matcher.h"
+
+#ifndef M_PI
+#define M_PI 3.14159265358979323846
+#endif
+
+using namespace amcl;
+
+AMCLScanMatcher::AMCLScanMatcher()
+{
+  this->map = NULL;
+  this->slices = 0;
+  this->max_hyps = 0;
+  this->next_slice = 0;
+  this->threshold = 0;
+  this->min_threshold = 0;
+  this->SetSearchParams(M_PI / 180.0, 0.5, 100, 0, 0.5, M_PI / 6.0);
+}
+
+void
+AMCLScanMatcher::SetMap(map_t *map, double sigma_hit, int levels)
+{
+  this->map = map;
+  if (levels < 1)
+    levels = 1;
+  this->grids.resize(levels);
+
+  // Level 0: the likelihood field
+  std::vector<uint8_t>& grid0 = this->grids[0];
+  grid0.resize(map->size_x * map->size_y);
+  double z_hit_denom = 2 * sigma_hit * sigma_hit;
+  for (int i = 0; i < map->size_x * map->size_y; i++)
+  {
+    double z = map->cells[i].occ_dist;
+    grid0[i] = (uint8_t)floor(255.0 * exp(-(z * z) / z_hit_denom) + 0.5);
+  }
+
+  // Level h: max of the four 2^(h-1) windows of the previous level
+  for (int h = 1; h < levels; h++)
+  {
+    int pad = (1 << h) - 1;
+    int half = 1 << (h - 1);
+    int width = map->size_x + pad;
+    int height = map->size_y + pad;
+    std::vector<uint8_t>& grid = this->grids[h];
+    grid.resize(width * height);
+    for (int j = 0; j < height; j++)
+    {
+      int y = j - pad;
+      for (int i = 0; i < width; i++)
+      {
+        int x = i - pad;
+        int v = std::max(std::max(this->Value(h - 1, x, y), this->Value(h - 1, x + half, y)),
+                         std::max(this->Value(h - 1, x, y + half), this->Value(h - 1, x + half, y + half)));
+        grid[i + j * width] = (uint8_t)v;
+      }
+    }
+  }
+}
+
+void
+AMCLScanMatcher::SetSearchParams(double angular_step, double min_score, int max_points,
+                                 int threads, double min_distance, double min_angle)
+{
+  this->angular_step = angular_step;
+  this->min_score = min_score;
+  this->max_points = max_points;
+  this->threads = threads;
+  this->min_distance = min_distance;
+  this->min_angle = min_angle;
+}
+
+int
+AMCLScanMatcher::Match(const std::vector<pf_vector_t>& points, int max_hyps,
+                       std::vector<scan_match_hyp_t>& hyps)
+{
+  hyps.clear();
+  if (this->map == NULL || points.empty() || max_hyps <= 0 || this->angular_step <= 0)
+    return 0;
+
+  // Use at most max_points, evenly spaced along the scan
+  this->points.clear();
+  int step = 1;
+  if (this->max_points > 0 && (int)points.size() > this->max_points)
+    step = (points.size() + this->max_points - 1) / this->max_points;
+  for (size_t i = 0; i < points.size(); i += step)
+    this->points.push_back(points[i]);
+
+  this->slices = (int)ceil(2 * M_PI / this->angular_step);
+  this->next_slice = 0;
+  this->min_threshold = (int)(this->min_score * 255.0 * this->points.size());
+  this->threshold = this->min_threshold;
+  this->max_hyps = max_hyps;
+  this->found.clear();
+  this->found_score.clear();
+
+  int n_threads = this->threads;
+  if (n_threads <= 0)
+    n_threads = std::max(1, (int)std::thread::hardware_concurrency());
+  n_threads = std::min(n_threads, this->slices);
+
+  std::vector<std::thread> workers;
+  for (int t = 0; t < n_threads; t++)
+  {
+    workers.push_back(std::thread([this]()
+    {
+      int slice;
+      while ((slice = this->next_slice++) < this->slices)
+        this->SearchSlice(slice);
+    }));
+  }
+  for (size_t t = 0; t < workers.size(); t++)
+    workers[t].join();
+
+  hyps = this->found;
+  for (size_t i = 0; i < hyps.size(); i++)
+    hyps[i].score = this->found_score[i] / (255.0 * this->points.size());
+  return (int)hyps.size();
+}
+
+int
+AMCLScanMatcher::Score(int level, int x, int y, const RotatedScan& scan) const
+{
+  int score = 0;
+  int n = (int)scan.dx.size();
+  int pad = (1 << level) - 1;
+  int width = this->map->size_x + pad;
+  if (x + scan.min_dx + pad >= 0 && x + scan.max_dx < this->map->size_x &&
+      y + scan.min_dy + pad >= 0 && y + scan.max_dy < this->map->size_y)
+  {
+    // All the points are inside the grid, no need to check each of them
+    const uint8_t* grid = &this->grids[level][(x + pad) + (y + pad) * width];
+    for (int k = 0; k < n; k++)
+      score += grid[scan.dx[k] + scan.dy[k] * width];
+  }
+  else
+  {
+    for (int k = 0; k < n; k++)
+      score += this->Value(level, x + scan.dx[k], y + scan.dy[k]);
+  }
+  return score;
+}
+
+void
+AMCLScanMatcher::SearchSlice(int slice)
+{
+  RotatedScan scan;
+  scan.theta = -M_PI + slice * (2 * M_PI / this->slices);
+  double cs = cos(scan.theta);
+  double sn = sin(scan.theta);
+
+  // Offsets (in cells) of the scan points, for this orientation
+  int n = (int)this->points.size();
+  scan.dx.resize(n);
+  scan.dy.resize(n);
+  for (int k = 0; k < n; k++)
+  {
+    double x = cs * this->points[k].v[0] - sn * this->points[k].v[1];
+    double y = sn * this->points[k].v[0] + cs * this->points[k].v[1];
+    scan.dx[k] = (int)floor(x / this->map->scale + 0.5);
+    scan.dy[k] = (int)floor(y / this->map->scale + 0.5);
+  }
+  scan.min_dx = *std::min_element(scan.dx.begin(), scan.dx.end());
+  scan.max_dx = *std::max_element(scan.dx.begin(), scan.dx.end());
+  scan.min_dy = *std::min_element(scan.dy.begin(), scan.dy.end());
+  scan.max_dy = *std::max_element(scan.dy.begin(), scan.dy.end());
+
+  // The whole map, at the coarsest level
+  int top = (int)this->grids.size() - 1;
+  int w = 1 << top;
+  std::vector<Candidate> candidates;
+  for (int y = 0; y < this->map->size_y; y += w)
+  {
+    for (int x = 0; x < this->map->size_x; x += w)
+    {
+      Candidate c;
+      c.x = x;
+      c.y = y;
+      c.score = this->Score(top, x, y, scan);
+      if (c.score > this->threshold)
+        candidates.push_back(c);
+    }
+  }
+
+  this->Branch(candidates, top, scan);
+}
+
+void
+AMCLScanMatcher::Branch(std::vector<Candidate>& candidates, int level, const RotatedScan& scan)
+{
+  // Best candidates first, so that the threshold raises as soon as possible
+  std::sort(candidates.begin(), candidates.end());
+
+  for (size_t i = 0; i < candidates.size(); i++)
+  {
+    const Candidate& c = candidates[i];
+    if (c.score <= this->threshold)
+      break;
+
+    if (level == 0)
+    {
+      // The robot must be in the free space
+      if (MAP_VALID(this->map, c.x, c.y) &&
+          this->map->cells[MAP_INDEX(this->map, c.x, c.y)].occ_state == -1)
+        this->AddHypothesis(c.x, c.y, scan.theta, c.score);
+      continue;
+    }
+
+    int half = 1 << (level - 1);
+    std::vector<Candidate> children;
+    for (int j = 0; j < 4; j++)
+    {
+      Candidate child;
+      child.x = c.x + (j % 2) * half;
+      child.y = c.y + (j / 2) * half;
+      if (child.x >= this->map->size_x || child.y >= this->map->size_y)
+        continue;
+      child.score = this->Score(level - 1, child.x, child.y, scan);
+      if (child.score > this->threshold)
+        children.push_back(child);
+    }
+    this->Branch(children, level - 1, scan);
+  }
+}
+
+void
+AMCLScanMatcher::AddHypothesis(int x, int y, double theta, int score)
+{
+  std::lock_guard<std::mutex> lock(this->hyps_mutex);
+
+  scan_match_hyp_t hyp;
+  hyp.pose.v[0] = MAP_WXGX(this->map, x);
+  hyp.pose.v[1] = MAP_WYGY(this->map, y);
+  hyp.pose.v[2] = theta;
+  hyp.score = 0;
+
+  // Keep only the best among the close hypotheses
+  for (size_t i = 0; i < this->found.size(); )
+  {
+    double ddx = this->found[i].pose.v[0] - hyp.pose.v[0];
+    double ddy = this->found[i].pose.v[1] - hyp.pose.v[1];
+    double dth = this->found[i].pose.v[2] - hyp.pose.v[2];
+    dth = fabs(atan2(sin(dth), cos(dth)));
+    if (sqrt(ddx * ddx + ddy * ddy) < this->min_distance && dth < this->min_angle)
+    {
+      if (this->found_score[i] >= score)
+        return;
+      this->found.erase(this->found.begin() + i);
+      this->found_score.erase(this->found_score.begin() + i);
+    }
+    else
+    {
+      i++;
+    }
+  }
+
+  size_t pos = 0;
+  while (pos < this->found_score.size() && this->found_score[pos] >= score)
+    pos++;
+  this->found.insert(this->found.begin() + pos, hyp);
+  this->found_score.insert(this->found_score.begin() + pos, score);
+  if ((int)this->found.size() > this->max_hyps)
+  {
+    this->found.pop_back();
+    this->found_score.pop_back();
+  }
+
+  // When the list is full, only better poses are of interest. Replacing several
+  // close hypotheses with a single one shortens the list, so the threshold can drop again.
+  if ((int)this->found.size() == this->max_hyps)
+    this->threshold = this->found_score.back();
+  else
+    this->threshold = this->min_threshold;
+}
@@ -0,0 +1,138 @@
+/*
+ * Copyright (C) 2020 Istituto Italiano di Tecnologia (IIT)
+ * All rights reserved.
+ *
+ * This software may be modified and distributed under the terms of the
+ * GPL-2+ license. See the accompanying LICENSE file for details.
+ */
+///////////////////////////////////////////////////////////////////////////
+//
+// Desc: Correlative scan matcher for the global localization
+//
+///////////////////////////////////////////////////////////////////////////
+
+#ifndef AMCL_SCAN_MATCHER_H
+#define AMCL_SCAN_MATCHER_H
+
+#include <vector>
+#include <mutex>
+#include <atomic>
+#include <stdint.h>
+
+#include "../map/map.h"
+#include "../pf/pf_vector.h"
+
+namespace amcl
+{
+
+// A pose of the robot found by the scan matcher
+typedef struct
+{
+  pf_vector_t pose;
+
+  // Score, as a fraction of the maximum possible score [0..1]
+  double score;
+
+} scan_match_hyp_t;
+
+// Searches the whole map for the poses which best explain a laser scan.
+// The score of a pose is the sum of the likelihood field (the same one used
+// by the likelihood field laser model) at the end points of the scan.
+// The search is a branch and bound over a pyramid of max-pooled copies of the
+// likelihood field: the score of a node at level h is an upper bound of the
+// scores of all the poses inside its 2^h x 2^h cells window, so whole areas
+// of the map are discarded without evaluating their poses.
+// The orientations are split in slices, which are searched in parallel.
+class AMCLScanMatcher
+{
+  public: AMCLScanMatcher();
+
+  // Builds the likelihood field and its pyramid (levels >= 1).
+  // The obstacle distances of the map (map_update_cspace) must be already computed.
+  public: void SetMap(map_t *map, double sigma_hit, int levels);
+
+  // Search parameters:
+  // angular_step: orientation resolution [rad]
+  // min_score: poses scoring less than this fraction are discarded
+  // max_points: number of scan points used for the search
+  // threads: number of worker threads (0 = one per core)
+  // min_distance, min_angle: hypotheses closer than this [m, rad] are merged
+  public: void SetSearchParams(double angular_step, double min_score, int max_points,
+                               int threads, double min_distance, double min_angle);
+
+  // Returns true if SetMap() has been called
+  public: bool IsReady() const { return this->map != NULL; }
+
+  // Finds at most max_hyps poses of the robot, sorted by decreasing score.
+  // points are the end points of the scan in the robot frame (v[0], v[1]).
+  // Returns the number of hypotheses found.
+  public: int Match(const std::vector<pf_vector_t>& points, int max_hyps,
+                    std::vector<scan_match_hyp_t>& hyps);
+
+  // A node of the search tree: robot at cells [x, x+2^level) x [y, y+2^level)
+  private: struct Candidate
+  {
+    int x, y;
+    int score;
+    // std::sort puts the best candidates first
+    bool operator<(const Candidate& other) const { return score > other.score; }
+  };
+
+  // Likelihood of the cell (x, y) at the given level of the pyramid
+  private: inline int Value(int level, int x, int y) const
+  {
+    int pad = (1 << level) - 1;
+    x += pad;
+    y += pad;
+    int width = this->map->size_x + pad;
+    if (x < 0 || y < 0 || x >= width || y >= this->map->size_y + pad)
+      return 0;
+    return this->grids[level][x + y * width];
+  }
+
+  // The scan points rotated by theta, as offsets in cells, and their bounding box
+  private: struct RotatedScan
+  {
+    double theta;
+    std::vector<int> dx, dy;
+    int min_dx, max_dx, min_dy, max_dy;
+  };
+
+  private: int Score(int level, int x, int y, const RotatedScan& scan) const;
+
+  private: void SearchSlice(int slice);
+
+  private: void Branch(std::vector<Candidate>& candidates, int level, const RotatedScan& scan);
+
+  private: void AddHypothesis(int x, int y, double theta, int score);
+
+  // The map (not owned)
+  private: map_t *map;
+
+  // grids[h][x + y * (size_x + 2^h - 1)] = max of the likelihood field (0..255)
+  // in the cells [x, x+2^h) x [y, y+2^h), x and y starting from -(2^h - 1)
+  private: std::vector<std::vector<uint8_t> > grids;
+
+  // Search parameters
+  private: double angular_step;
+  private: double min_score;
+  private: int max_points;
+  private: int threads;
+  private: double min_distance;
+  private: double min_angle;
+
+  // State of the current search
+  private: std::vector<pf_vector_t> points;
+  private: int slices;
+  private: std::atomic<int> next_slice;
+  private: std::atomic<int> threshold;
+  private: int min_threshold; // threshold of min_score, used until the list of hypotheses is full
+  private: int max_hyps;
+  private: std::mutex hyps_mutex;
+  private: std::vector<scan_match_hyp_t> found;
+  private: std::vector<int> found_score;
+};
+
+}
+
+#endif
@@ -0,0 +1,269 @@
+/*
+ * Copyright (C) 2020 Istituto Italiano di Tecnologia (IIT)
+ * All rights reserved.
+ *
+ * This software may be modified and distributed under the terms of the
+ * GPL-2+ license. See the accompanying LICENSE file for details.
+ */
+///////////////////////////////////////////////////////////////////////////
+//
+// Desc: Scan to map refinement of the pose estimated by the particle filter
+//
+///////////////////////////////////////////////////////////////////////////
+
+#include <algorithm>
+#include <chrono>
+#include <math.h>
+
+#include "amcl/sensors/amcl_scan_refiner.h"
+
+#ifndef M_PI
+#define M_PI 3.14159265358979323846
+#endif
+
+using namespace amcl;
+
+// Below this number of inliers the alignment is not constrained enough
+static const int min_inliers = 10;
+
+static double elapsed_since(const std::chrono::steady_clock::time_point& t)
+{
+  return std::chrono::duration<double>(std::chrono::steady_clock::now() - t).count();
+}
+
+AMCLScanRefiner::AMCLScanRefiner()
+{
+  this->map = NULL;
+  this->time_per_point = 0.0;
+  this->last_iterations = 0;
+  this->last_residual = 0.0;
+  this->refined_count = 0;
+  this->rejected_count = 0;
+  this->skipped_count = 0;
+  this->SetParams(5, 180, 0.3, 0.3, 10.0 * M_PI / 180.0);
+}
+
+void
+AMCLScanRefiner::SetMap(map_t *map)
+{
+  this->map = map;
+}
+
+void
+AMCLScanRefiner::SetParams(int max_iterations, int max_points, double outlier_distance,
+                           double max_correction_dist, double max_correction_angle)
+{
+  this->max_iterations = std::max(1, max_iterations);
+  this->max_points = std::max(min_inliers, max_points);
+  this->outlier_distance = outlier_distance;
+  this->max_correction_dist = max_correction_dist;
+  this->max_correction_angle = max_correction_angle;
+}
+
+bool
+AMCLScanRefiner::Distance(double x, double y, double& d, double& gx, double& gy) const
+{
+  // Continuous cell coordinates: the centers of the cells are at integer values (see MAP_GXWX)
+  double cx = (x - this->map->origin_x) / this->map->scale + this->map->size_x / 2;
+  double cy = (y - this->map->origin_y) / this->map->scale + this->map->size_y / 2;
+  int i = (int)floor(cx);
+  int j = (int)floor(cy);
+  if (!MAP_VALID(this->map, i, j) || !MAP_VALID(this->map, i + 1, j + 1))
+    return false;
+  double fx = cx - i;
+  double fy = cy - j;
+
+  double d00 = this->map->cells[MAP_INDEX(this->map, i, j)].occ_dist;
+  double d10 = this->map->cells[MAP_INDEX(this->map, i + 1, j)].occ_dist;
+  double d01 = this->map->cells[MAP_INDEX(this->map, i, j + 1)].occ_dist;
+  double d11 = this->map->cells[MAP_INDEX(this->map, i + 1, j + 1)].occ_dist;
+
+  d = (d00 * (1 - fx) + d10 * fx) * (1 - fy) + (d01 * (1 - fx) + d11 * fx) * fy;
+  gx = ((d10 - d00) * (1 - fy) + (d11 - d01) * fy) / this->map->scale;
+  gy = ((d01 - d00) * (1 - fx) + (d11 - d10) * fx) / this->map->scale;
+  return true;
+}
+
+int
+AMCLScanRefiner::Evaluate(const pf_vector_t& pose, double& cost, double h[3][3], double b[3]) const
+{
+  double c = cos(pose.v[2]);
+  double s = sin(pose.v[2]);
+  double outlier_cost = this->outlier_distance * this->outlier_distance;
+  int inliers = 0;
+  cost = 0.0;
+  if (h)
+  {
+    for (int r = 0; r < 3; r++)
+    {
+      b[r] = 0.0;
+      for (int k = 0; k < 3; k++)
+        h[r][k] = 0.0;
+    }
+  }
+
+  for (size_t i = 0; i < this->scan.size(); i++)
+  {
+    double px = this->scan[i].v[0];
+    double py = this->scan[i].v[1];
+    double rx = c * px - s * py;
+    double ry = s * px + c * py;
+    double d, gx, gy;
+    // The truncated cost: the outliers count, but do not move the pose
+    if (!this->Distance(pose.v[0] + rx, pose.v[1] + ry, d, gx, gy) || d >= this->outlier_distance)
+    {
+      cost += outlier_cost;
+      continue;
+    }
+    cost += d * d;
+    inliers++;
+    if (h)
+    {
+      // Jacobian of the distance respect to (x, y, theta)
+      double j[3] = { gx, gy, -gx * ry + gy * rx };
+      for (int r = 0; r < 3; r++)
+      {
+        b[r] += j[r] * d;
+        for (int k = r; k < 3; k++)
+          h[r][k] += j[r] * j[k];
+      }
+    }
+  }
+  if (h)
+  {
+    h[1][0] = h[0][1];
+    h[2][0] = h[0][2];
+    h[2][1] = h[1][2];
+  }
+  return inliers;
+}
+
+// Solves the damped system (h + lambda * diag(h)) * x = -b by Gaussian elimination
+static bool solve3(const double h[3][3], const double b[3], double x[3])
+{
+  const double lambda = 1e-3;
+  double a[3][4];
+  for (int r = 0; r < 3; r++)
+  {
+    for (int k = 0; k < 3; k++)
+      a[r][k] = h[r][k];
+    a[r][r] += lambda * h[r][r];
+    a[r][3] = -b[r];
+  }
+  for (int col = 0; col < 3; col++)
+  {
+    int pivot = col;
+    for (int r = col + 1; r < 3; r++)
+      if (fabs(a[r][col]) > fabs(a[pivot][col]))
+        pivot = r;
+    if (fabs(a[pivot][col]) < 1e-12)
+      return false;
+    for (int k = 0; k < 4; k++)
+      std::swap(a[col][k], a[pivot][k]);
+    for (int r = 0; r < 3; r++)
+    {
+      if (r == col)
+        continue;
+      double f = a[r][col] / a[col][col];
+      for (int k = col; k < 4; k++)
+        a[r][k] -= f * a[col][k];
+    }
+  }
+  for (int r = 0; r < 3; r++)
+    x[r] = a[r][3] / a[r][r];
+  return true;
+}
+
+bool
+AMCLScanRefiner::Refine(const std::vector<pf_vector_t>& points, pf_vector_t& pose, double time_budget)
+{
+  this->last_iterations = 0;
+  if (this->map == NULL || (int)points.size() < min_inliers)
+    return false;
+
+  std::chrono::steady_clock::time_point t_start = std::chrono::steady_clock::now();
+
+  // Evenly subsampled scan
+  this->scan.clear();
+  size_t step = (points.size() + this->max_points - 1) / this->max_points;
+  for (size_t i = 0; i < points.size(); i += step)
+    this->scan.push_back(points[i]);
+
+  // Timing guard: an evaluation is not started if it is expected to exceed the budget
+  double expected = this->time_per_point * this->scan.size();
+  if (expected > time_budget)
+  {
+    this->skipped_count++;
+    return false;
+  }
+
+  double h[3][3], b[3];
+  double cost;
+  std::chrono::steady_clock::time_point t0 = std::chrono::steady_clock::now();
+  int inliers = this->Evaluate(pose, cost, h, b);
+  double t_eval = elapsed_since(t0) / this->scan.size();
+  this->time_per_point = (this->time_per_point > 0) ? 0.9 * this->time_per_point + 0.1 * t_eval : t_eval;
+  if (inliers < min_inliers)
+  {
+    this->rejected_count++;
+    return false;
+  }
+
+  pf_vector_t current = pose;
+  for (int it = 0; it < this->max_iterations; it++)
+  {
+    double delta[3];
+    if (!solve3(h, b, delta))
+      break;
+    pf_vector_t candidate = current;
+    candidate.v[0] += delta[0];
+    candidate.v[1] += delta[1];
+    candidate.v[2] = atan2(sin(candidate.v[2] + delta[2]), cos(candidate.v[2] + delta[2]));
+
+    expected = this->time_per_point * this->scan.size();
+    if (elapsed_since(t_start) + expected > time_budget)
+      break;
+
+    double candidate_h[3][3], candidate_b[3];
+    double candidate_cost;
+    t0 = std::chrono::steady_clock::now();
+    int candidate_inliers = this->Evaluate(candidate, candidate_cost, candidate_h, candidate_b);
+    t_eval = elapsed_since(t0) / this->scan.size();
+    this->time_per_point = 0.9 * this->time_per_point + 0.1 * t_eval;
+
+    // The step is accepted only if it reduces the cost
+    if (candidate_inliers < min_inliers || candidate_cost >= cost)
+      break;
+    current = candidate;
+    cost = candidate_cost;
+    for (int r = 0; r < 3; r++)
+    {
+      b[r] = candidate_b[r];
+      for (int k = 0; k < 3; k++)
+        h[r][k] = candidate_h[r][k];
+    }
+    this->last_iterations++;
+
+    // Converged: the step is much smaller than a cell
+    if (fabs(delta[0]) < 1e-4 && fabs(delta[1]) < 1e-4 && fabs(delta[2]) < 1e-4)
+      break;
+  }
+
+  if (this->last_iterations == 0)
+    return false;
+
+  // A large correction means that the alignment converged to a wrong local minimum
+  double dx = current.v[0] - pose.v[0];
+  double dy = current.v[1] - pose.v[1];
+  double da = atan2(sin(current.v[2] - pose.v[2]), cos(current.v[2] - pose.v[2]));
+  if (sqrt(dx * dx + dy * dy) > this->max_correction_dist || fabs(da) > this->max_correction_angle)
+  {
+    this->rejected_count++;
+    return false;
+  }
+
+  pose = current;
+  this->last_residual = sqrt(cost / this->scan.size());
+  this->refined_count++;
+  return true;
+}
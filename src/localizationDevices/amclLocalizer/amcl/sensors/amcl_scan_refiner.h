@@ -0,0 +1,93 @@
+/*
+ * Copyright (C) 2020 Istituto Italiano di Tecnologia (IIT)
+ * All rights reserved.
+ *
+ * This software may be modified and distributed under the terms of the
+ * GPL-2+ license. See the accompanying LICENSE file for details.
+ */
+///////////////////////////////////////////////////////////////////////////
+//
+// Desc: Scan to map refinement of the pose estimated by the particle filter
+//
+///////////////////////////////////////////////////////////////////////////
+
+#ifndef AMCL_SCAN_REFINER_H
+#define AMCL_SCAN_REFINER_H
+
+#include <vector>
+
+#include "../map/map.h"
+#include "../pf/pf_vector.h"
+
+namespace amcl
+{
+
+// Refines a pose of the robot by aligning a laser scan to the map.
+// The cost is the sum of the squared distances between the end points of the
+// scan and the nearest obstacle, i.e. the distance field used by the likelihood
+// field laser model (map_update_cspace), bilinearly interpolated so that its
+// gradient is continuous. The distances are truncated at outlier_distance, so
+// the points which do not correspond to the map (people, furniture) do not pull
+// the pose. The cost is minimized by a few Gauss-Newton iterations, starting
+// from the estimate of the filter.
+class AMCLScanRefiner
+{
+  public: AMCLScanRefiner();
+
+  // The obstacle distances of the map (map_update_cspace) must be already computed.
+  public: void SetMap(map_t *map);
+
+  // max_iterations: Gauss-Newton iterations
+  // max_points: number of scan points used (evenly subsampled)
+  // outlier_distance: points farther than this from the obstacles are ignored [m]
+  // max_correction_dist, max_correction_angle: a larger correction is rejected [m, rad]
+  public: void SetParams(int max_iterations, int max_points, double outlier_distance,
+                         double max_correction_dist, double max_correction_angle);
+
+  // Refines pose (in place). points are the end points of the scan in the robot frame (v[0], v[1]).
+  // time_budget is the time available for the refinement [s]: an iteration which is expected
+  // to end after it is not started, so the refinement can be skipped altogether.
+  // Returns true if the pose has been refined.
+  public: bool Refine(const std::vector<pf_vector_t>& points, pf_vector_t& pose, double time_budget);
+
+  // Statistics
+  public: int GetLastIterations() const { return this->last_iterations; }
+  public: double GetLastResidual() const { return this->last_residual; }
+  public: long GetRefinedCount() const { return this->refined_count; }
+  public: long GetRejectedCount() const { return this->rejected_count; }
+  public: long GetSkippedCount() const { return this->skipped_count; }
+
+  // Distance to the nearest obstacle at the world point (x, y) and its gradient.
+  // Returns false outside the map.
+  private: bool Distance(double x, double y, double& d, double& gx, double& gy) const;
+
+  // Evaluates the truncated cost at pose and, if h and b are not NULL, the
+  // Gauss-Newton system h * delta = -b. Returns the number of inliers.
+  private: int Evaluate(const pf_vector_t& pose, double& cost, double h[3][3], double b[3]) const;
+
+  // The map (not owned)
+  private: map_t *map;
+
+  // Parameters
+  private: int max_iterations;
+  private: int max_points;
+  private: double outlier_distance;
+  private: double max_correction_dist;
+  private: double max_correction_angle;
+
+  // The subsampled scan of the current refinement
+  private: std::vector<pf_vector_t> scan;
+
+  // Measured time of one evaluation of one point [s], used by the timing guard
+  private: double time_per_point;
+
+  private: int last_iterations;
+  private: double last_residual;
+  private: long refined_count;
+  private: long rejected_count;
+  private: long skipped_count;
+};
+
+}
+
+#endif
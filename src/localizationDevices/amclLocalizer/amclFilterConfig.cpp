@@ -0,0 +1,152 @@
+/*
+ * Copyright (C) 2020 Istituto Italiano di Tecnologia (IIT)
+ * All rights reserved.
+ *
+ * This software may be modified and distributed under the terms of the
+ * GPL-2+ license. See the accompanying LICENSE file for details.
+ */
+
+#include "amclFilterConfig.h"
+#include <yarp/os/LogStream.h>
+#include <map_layers.h>
+#include <cstdlib>
+
+using namespace yarp::os;
+using namespace yarp::dev::Nav2D;
+using namespace amcl;
+
+#define DEG2RAD M_PI/180
+
+bool readAmclFilterParams(const Bottle& amcl_group, const Bottle& initial_group, AMCLFilterParams& params)
+{
+    params.laser_min_range = amcl_group.check("laser_min_range", Value(-1.0)).asDouble();
+    params.laser_max_range = amcl_group.check("laser_max_range", Value(-1.0)).asDouble();
+    params.max_beams = amcl_group.check("laser_max_beams", Value(30)).asInt();
+    params.min_particles = amcl_group.check("min_particles", Value(100)).asInt();
+    params.max_particles = amcl_group.check("max_particles", Value(5000)).asInt();
+    params.kld_err = amcl_group.check("kld_err", Value(0.01)).asDouble();
+    params.kld_z = amcl_group.check("kld_z", Value(0.99)).asDouble();
+    params.odom_alpha1 = amcl_group.check("odom_alpha1", Value(0.2)).asDouble();
+    params.odom_alpha2 = amcl_group.check("odom_alpha2", Value(0.2)).asDouble();
+    params.odom_alpha3 = amcl_group.check("odom_alpha3", Value(0.2)).asDouble();
+    params.odom_alpha4 = amcl_group.check("odom_alpha4", Value(0.2)).asDouble();
+    params.odom_alpha5 = amcl_group.check("odom_alpha5", Value(0.2)).asDouble();
+    //"xoshiro" (default) or "drand48" (the original, slower, global generator)
+    params.odom_noise_drand48 = (amcl_group.check("odom_noise_generator", Value("xoshiro")).asString() == "drand48");
+
+    params.do_beamskip = amcl_group.check("do_beamskip", Value(false)).asBool();
+    params.adaptive_beams = amcl_group.check("laser_adaptive_beams", Value(false)).asBool();
+    params.beam_skip_distance = amcl_group.check("beam_skip_distance", Value(0.5)).asDouble();
+    params.beam_skip_threshold = amcl_group.check("beam_skip_threshold", Value(0.3)).asDouble();
+    params.beam_skip_error_threshold = amcl_group.check("beam_skip_error_threshold", Value(0.9)).asDouble();
+
+    params.z_hit = amcl_group.check("laser_z_hit", Value(0.95)).asDouble();
+    params.z_short = amcl_group.check("laser_z_short", Value(0.1)).asDouble();
+    params.z_max = amcl_group.check("laser_z_max", Value(0.05)).asDouble();
+    params.z_rand = amcl_group.check("laser_z_rand", Value(0.05)).asDouble();
+    params.sigma_hit = amcl_group.check("laser_sigma_hit", Value(0.2)).asDouble();
+    params.lambda_short = amcl_group.check("laser_lambda_short", Value(0.1)).asDouble();
+    params.likelihood_max_dist = amcl_group.check("laser_likelihood_max_dist", Value(2.0)).asDouble();
+
+    std::string laser_model_type = amcl_group.check("laser_model_type", Value("likelihood_field")).asString();
+    if (laser_model_type == "beam")
+    {
+        params.laser_model = LASER_MODEL_BEAM;
+    }
+    else if (laser_model_type == "likelihood_field")
+    {
+        params.laser_model = LASER_MODEL_LIKELIHOOD_FIELD;
+    }
+    else if (laser_model_type == "likelihood_field_prob")
+    {
+        params.laser_model = LASER_MODEL_LIKELIHOOD_FIELD_PROB;
+    }
+    else
+    {
+        yWarning("Unknown laser model type \"%s\"; defaulting to likelihood_field model", laser_model_type.c_str());
+        params.laser_model = LASER_MODEL_LIKELIHOOD_FIELD;
+    }
+
+    std::string odom_model_type = amcl_group.check("odom_model_type", Value("diff")).asString();
+    if (odom_model_type == "diff")
+        params.odom_model = ODOM_MODEL_DIFF;
+    else if (odom_model_type == "omni")
+        params.odom_model = ODOM_MODEL_OMNI;
+    else if (odom_model_type == "diff-corrected")
+        params.odom_model = ODOM_MODEL_DIFF_CORRECTED;
+    else if (odom_model_type == "omni-corrected")
+        params.odom_model = ODOM_MODEL_OMNI_CORRECTED;
+    else
+    {
+        yWarning("Unknown odom model type \"%s\"; defaulting to diff model", odom_model_type.c_str());
+        params.odom_model = ODOM_MODEL_DIFF;
+    }
+
+    params.update_min_d = amcl_group.check("update_min_d", Value(0.2)).asDouble();
+    params.update_min_a = amcl_group.check("update_min_a", Value(M_PI / 6.0)).asDouble();
+    params.resample_interval = amcl_group.check("resample_interval", Value(2)).asInt();
+    params.alpha_slow = amcl_group.check("recovery_alpha_slow", Value(0.001)).asDouble();
+    params.alpha_fast = amcl_group.check("recovery_alpha_fast", Value(0.1)).asDouble();
+
+    params.refine_enable = amcl_group.check("refine_enable", Value(false)).asBool();
+    params.refine_max_iterations = amcl_group.check("refine_max_iterations", Value(5)).asInt();
+    params.refine_max_points = amcl_group.check("refine_max_points", Value(180)).asInt();
+    params.refine_outlier_distance = amcl_group.check("refine_outlier_distance", Value(0.3)).asDouble();
+    params.refine_max_correction_dist = amcl_group.check("refine_max_correction_dist", Value(0.3)).asDouble();
+    params.refine_max_correction_angle = amcl_group.check("refine_max_correction_angle", Value(10.0)).asDouble() * DEG2RAD;
+
+    //the particles and beams are reduced down to these values when the cycle exceeds its CPU budget
+    params.cpu_budget_enable = amcl_group.check("cpu_budget_enable", Value(false)).asBool();
+    params.cpu_budget_share = amcl_group.check("cpu_budget_share", Value(0.5)).asDouble();
+    params.cpu_budget_max_cycle = amcl_group.check("cpu_budget_max_cycle", Value(0.8)).asDouble();
+    params.cpu_budget_update_period = amcl_group.check("cpu_budget_update_period", Value(1.0)).asDouble();
+    params.cpu_budget_min_particles = amcl_group.check("cpu_budget_min_particles", Value(params.min_particles)).asInt();
+    params.cpu_budget_min_beams = amcl_group.check("cpu_budget_min_beams", Value(10)).asInt();
+    if (params.cpu_budget_enable && (params.cpu_budget_share <= 0 || params.cpu_budget_max_cycle <= 0))
+    {
+        yError() << "Invalid cpu_budget_share/cpu_budget_max_cycle";
+        return false;
+    }
+
+    //the default numbers have been taken from initialization message posted by rviz
+    params.initial_cov_xx = initial_group.check("initial_cov_xx", Value(0.25)).asDouble();
+    params.initial_cov_yy = initial_group.check("initial_cov_yy", Value(0.25)).asDouble();
+    params.initial_cov_aa = initial_group.check("initial_cov_aa", Value(0.06853891945200942)).asDouble();
+    if (params.initial_cov_xx < 0 || params.initial_cov_yy < 0 || params.initial_cov_aa < 0)
+    {
+        yError() << "Invalid initial_cov_xx/initial_cov_yy/initial_cov_aa";
+        return false;
+    }
+
+    if (params.min_particles <= 0 || params.max_particles < params.min_particles)
+    {
+        yError() << "Invalid min_particles/max_particles";
+        return false;
+    }
+    return true;
+}
+
+map_t* convertAmclMap(MapGrid2D& yarp_map)
+{
+    map_t* map = map_alloc();
+    yAssert(map);
+
+    map->size_x = yarp_map.width();
+    map->size_y = yarp_map.height();
+    yarp_map.getResolution(map->scale);
+    double x_orig;
+    double y_orig;
+    double t_orig;
+    yarp_map.getOrigin(x_orig, y_orig, t_orig);
+    map->origin_x = x_orig + (map->size_x / 2) * map->scale;
+    map->origin_y = y_orig + (map->size_y / 2) * map->scale;
+
+    map->cells = (map_cell_t*)malloc(sizeof(map_cell_t)*map->size_x*map->size_y);
+    yAssert(map->cells);
+
+    //occupied if occupancy > 50%, unknown if not available
+    map_layers::grid_layer occupancy;
+    map_layers::get_occupancy(yarp_map, occupancy);
+    map_layers::to_occ_state(occupancy, 50.0, map->cells, nullptr);
+    return map;
+}
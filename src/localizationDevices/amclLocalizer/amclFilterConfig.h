@@ -0,0 +1,27 @@
+/*
+ * Copyright (C) 2020 Istituto Italiano di Tecnologia (IIT)
+ * All rights reserved.
+ *
+ * This software may be modified and distributed under the terms of the
+ * GPL-2+ license. See the accompanying LICENSE file for details.
+ */
+
+#ifndef AMCL_FILTER_CONFIG_H
+#define AMCL_FILTER_CONFIG_H
+
+#include <yarp/os/Bottle.h>
+#include <yarp/dev/MapGrid2D.h>
+#include "amcl/amcl_filter.h"
+
+//! The configuration of amcl::AMCLFilter and the conversion of its map, shared by the amclLocalizer device
+//! and the off-line tools which run the same filter.
+
+//reads the filter parameters from the AMCL group and the initial covariance from the INITIAL_POS group.
+//Returns false if a parameter is invalid.
+bool readAmclFilterParams(const yarp::os::Bottle& amcl_group, const yarp::os::Bottle& initial_group, amcl::AMCLFilterParams& params);
+
+//converts the occupancy of a map to an AMCL map: occupied if occupancy > 50%, unknown if not available.
+//The obstacle distances are not computed.
+map_t* convertAmclMap(yarp::dev::Nav2D::MapGrid2D& yarp_map);
+
+#endif
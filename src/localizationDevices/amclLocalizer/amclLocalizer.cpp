@@ -20,6 +20,8 @@
 #include <cmath>
 #include <random>
 #include <algorithm>
+#include <cstdio>
+#include <cstring>
 #include "amclLocalizer.h"
 
 using namespace yarp::os;
@@ -36,27 +38,6 @@ using namespace amcl;
 
 #define  LOWLEVEL_DEBUG
 
-
-static double normalize(double z)
-{
-    return atan2(sin(z), cos(z));
-}
-
-static double angle_diff(double a, double b)
-{
-    double d1, d2;
-    a = normalize(a);
-    b = normalize(b);
-    d1 = a - b;
-    d2 = 2 * M_PI - fabs(d1);
-    if (d1 > 0)
-        d2 *= -1.0;
-    if (fabs(d1) < fabs(d2))
-        return(d1);
-    else
-        return(d2);
-}
-
 void amclLocalizerRPCHandler::setInterface(amclLocalizer* iface)
 {
     this->interface = iface;
@@ -66,8 +47,45 @@ void amclLocalizerRPCHandler::setInterface(amclLocalizer* iface)
 bool amclLocalizerRPCHandler::respond(const yarp::os::Bottle& command, yarp::os::Bottle& reply)
 {
     reply.clear();
-    reply.addVocab(Vocab::encode("many"));
-    reply.addString("Not yet Implemented");
+    if (command.get(0).asString() == "help")
+    {
+        reply.addVocab(Vocab::encode("many"));
+        reply.addString("Available commands are:");
+        reply.addString("stats");
+        reply.addString("global_localize [max_hypotheses]");
+    }
+    else if (command.get(0).asString() == "stats")
+    {
+        interface->thread->getLatencyStats(reply);
+    }
+    else if (command.get(0).asString() == "global_localize")
+    {
+        int max_hypotheses = (command.size() > 1) ? command.get(1).asInt() : -1;
+        std::vector<Map2DLocation> hypotheses;
+        std::vector<double> scores;
+        if (interface->thread->globalLocalization(max_hypotheses, hypotheses, scores))
+        {
+            reply.addVocab(Vocab::encode("ok"));
+            for (size_t i = 0; i < hypotheses.size(); i++)
+            {
+                Bottle& h = reply.addList();
+                h.addString(hypotheses[i].map_id);
+                h.addDouble(hypotheses[i].x);
+                h.addDouble(hypotheses[i].y);
+                h.addDouble(hypotheses[i].theta);
+                h.addDouble(scores[i]);
+            }
+        }
+        else
+        {
+            reply.addVocab(Vocab::encode("err"));
+        }
+    }
+    else
+    {
+        reply.addVocab(Vocab::encode("many"));
+        reply.addString("Not yet Implemented");
+    }
     return true;
 }
 
@@ -92,8 +110,9 @@ bool    amclLocalizer::stopLocalizationService()
 
 bool   amclLocalizer::getCurrentPosition(yarp::dev::Nav2D::Map2DLocation& loc, yarp::sig::Matrix& cov)
 {
-    yError() << "Not yet implemented";
-    return false;
+    double timestamp;
+    thread->getCurrentLoc(loc, cov, timestamp);
+    return true;
 }
 
 bool   amclLocalizer::getEstimatedOdometry(yarp::dev::OdometryData& odom)
@@ -117,346 +136,609 @@ bool   amclLocalizer::getCurrentPosition(Map2DLocation& loc)
 
 bool   amclLocalizer::setInitialPose(const Map2DLocation& loc)
 {
-    thread->initializeLocalization(loc);
-    return true;
+    return thread->initializeLocalization(loc);
 }
 
 bool   amclLocalizer::setInitialPose(const yarp::dev::Nav2D::Map2DLocation& loc, const yarp::sig::Matrix& cov)
 {
-    thread->initializeLocalization(loc,cov);
-    return true;
+    return thread->initializeLocalization(loc,cov);
+}
+
+
+//////////////////////////
+
+void amcl_odometry_handler::onRead(yarp::dev::OdometryData& b)
+{
+    if (m_owner == nullptr) return;
+
+    //use the time at which the odometry was computed, if the sender provides it
+    yarp::os::Stamp stamp;
+    double timestamp = yarp::os::Time::now();
+    if (getEnvelope(stamp) && stamp.isValid())
+    {
+        timestamp = stamp.getTime();
+    }
+    m_owner->odometryReceived(b, timestamp);
 }
 
 //////////////////////////
 
 amclLocalizerThread::amclLocalizerThread(double _period, yarp::os::Searchable& _cfg) : PeriodicThread(_period), m_cfg(_cfg)
 {
-    m_handler_odom = nullptr;
-    m_handler_pf = nullptr;
-    m_handler_laser = nullptr;
-    m_initial_pose_hyp = nullptr;
     m_amcl_map = nullptr;
+    m_tf_broadcast = true;
+    m_scan_matcher = nullptr;
+    m_global_localization_hypotheses = 5;
+    m_refine_time_margin = 0.005;
+    m_cpu_budget_last_warning = -1;
+    m_cycle_start_time = 0;
+    m_map_hash = 0;
+    m_checkpoint_period = 10.0;
+    m_last_checkpoint = -1;
+    m_checkpoint_resume = true;
+    m_checkpoint_pending = false;
+    m_checkpoint_stop = false;
+    m_checkpoint_w_slow = 0;
+    m_checkpoint_w_fast = 0;
+    m_checkpoint_odom_pose = pf_vector_zero();
     m_iMap = nullptr;
     m_iLaser = nullptr;
+    m_iLaserTimed = nullptr;
+    m_publish_latency_stats = false;
 
     m_last_odometry_data_received = -1;
+    m_laser_measurement_timestamp = 0;
     m_last_statistics_printed = -1;
+    m_odometry_timestamp = 0;
+    m_last_odometry_timestamp = 0;
+    m_localization_timestamp = 0;
+    m_port_odometry_input.m_owner = this;
 
     m_localization_data.map_id = "unknown";
     m_localization_data.x = nan("");
     m_localization_data.y = nan("");
     m_localization_data.theta = nan("");
+    m_localization_cov.resize(3, 3);
+    m_localization_cov.zero();
+    m_init_request_pending = false;
+    publishLocalization();
 
-    m_estimator = new iCub::ctrl::AWLinEstimator(3,3);
+    m_particles_max_published = 0;
 
 }
 
-void amclLocalizerThread::updateFilter()
+bool amclLocalizerThread::updateFilter()
 {
-    int laser_index = 0; //@@@always use the first and unique (for now) laser
-
-    pf_vector_t delta = pf_vector_zero();
     pf_vector_t pose;
     pose.v[0] = m_odometry_data.x;
     pose.v[1] = m_odometry_data.y;
-    pose.v[2] = m_odometry_data.theta*DEG2RAD; //@@@@ CHECK THIS!!!
+    pose.v[2] = m_odometry_data.theta*DEG2RAD;
 
-    if (m_pf_initialized)
-    {
-        // Compute change in pose
-        delta.v[0] = pose.v[0] - m_pf_odom_pose.v[0];
-        delta.v[1] = pose.v[1] - m_pf_odom_pose.v[1];
-        delta.v[2] = angle_diff(pose.v[2], m_pf_odom_pose.v[2]);
-
-        // See if we should update the filter
-        bool update = fabs(delta.v[0]) > m_config.m_d_thresh ||
-                      fabs(delta.v[1]) > m_config.m_d_thresh ||
-                      fabs(delta.v[2]) > m_config.m_a_thresh;
+    double angle_min = m_min_laser_angle * DEG2RAD; ///@@@ THIS needs to be expressed in the base frame, in RADIANS
+    double angle_increment = m_horizontal_resolution *DEG2RAD; //@@@ THIS needs to expressed in the base frame, in RADIANS
+    // wrapping angle to [-pi .. pi]
+    angle_increment = fmod(angle_increment + 5 * M_PI, 2 * M_PI) - M_PI; //@@@CHEKC THIS
 
+    int result = m_filter.Update(pose, m_laser_ranges, angle_min, angle_increment, m_min_laser_distance, m_max_laser_distance);
+    if (result & AMCL_FILTER_UPDATED)
+    {
 #ifdef LOWLEVEL_DEBUG
-        if (update)
-        {
-            yDebug() << "Update requested by thresholds";
-        }
-        else
-        {
-    #ifdef LOWLEVEL_ALWAYS_DEBUG
-            yDebug() << "No threshold update requested";
-    #endif
-        }
-        if(m_force_update)
-        {
-            yDebug() << "Force Update requested";
-        }
+        yDebug("Filter updated, num samples: %d", m_filter.GetSampleSet()->sample_count);
 #endif
+        publishParticles(m_filter.GetSampleSet());
+    }
 
-        update = update || m_force_update;
-        m_force_update = false;
-
-        // Set the laser update flags
-        if (update)
+    if (result & AMCL_FILTER_NEW_POSE)
+    {
+        pf_vector_t pose_mean = m_filter.GetPose();
+        const pf_matrix_t& pose_cov = m_filter.GetPoseCov();
+        yDebug("Max weight pose: x:%.3f y:%.3f t:%.3f (t_deg:%.3f)",
+            pose_mean.v[0], pose_mean.v[1], pose_mean.v[2], pose_mean.v[2]*RAD2DEG);
+
+        //the mean of the cluster is aligned to the last scan, within the time left in this period
+        double time_budget = getPeriod() - (yarp::os::Time::now() - m_cycle_start_time) - m_refine_time_margin;
+        if (m_filter.RefinePose(time_budget))
         {
-            for (unsigned int i = 0; i < m_lasers_update.size(); i++)
-            {
-                m_lasers_update[i] = true;
-            }
-#ifdef LOWLEVEL_DEBUG
-            yDebug() << "1. Laser updated = true";
-#endif
+            pose_mean = m_filter.GetPose();
+            yDebug("Refined pose: x:%.3f y:%.3f t_deg:%.3f (%d iterations, residual %.3f)",
+                pose_mean.v[0], pose_mean.v[1], pose_mean.v[2] * RAD2DEG,
+                m_filter.GetRefiner()->GetLastIterations(), m_filter.GetRefiner()->GetLastResidual());
         }
-        else
+
+        //a pose set meanwhile by setInitialPose() is not overwritten: the filter is reinitialized by the next cycle
+        std::unique_lock<std::mutex> init_lock(m_init_request_mutex);
+        if (m_init_request_pending)
         {
-#ifdef LOWLEVEL_DEBUG
-    #ifdef LOWLEVEL_ALWAYS_DEBUG
-            yDebug() << "1. Laser updated unrequested";
-    #endif
-#endif
+            return (result & AMCL_FILTER_UPDATED) != 0;
         }
+        setCorrection(pose_mean.v[0],
+                      pose_mean.v[1],
+                      pose_mean.v[2] * RAD2DEG,
+                      m_odometry_data);
+        publishCorrection(m_odometry_timestamp);
+
+        //the odometry callback may have received a newer sample after run() copied m_odometry_data
+        m_odometry_mutex.lock();
+            Map2DLocation latest_odom = m_last_odometry_data;
+            double latest_odom_timestamp = m_last_odometry_timestamp;
+        m_odometry_mutex.unlock();
+
+        m_localization_data_mutex.lock();
+            //the new correction composed with the odometry used by the filter
+            Map2DLocation corrected_loc = map_odom::compose(m_pf_data, m_odometry_data);
+            //the published pose is the new correction composed with the most recent odometry sample
+            Map2DLocation loc = corrected_loc;
+            double loc_timestamp = m_odometry_timestamp;
+            if (latest_odom_timestamp > m_odometry_timestamp)
+            {
+                loc = map_odom::compose(m_pf_data, latest_odom);
+                loc_timestamp = latest_odom_timestamp;
+            }
+            //never go back in time: a newer sample applied meanwhile by the callback already uses the new correction
+            if (loc_timestamp >= m_localization_timestamp)
+            {
+                m_localization_data.x = loc.x;
+                m_localization_data.y = loc.y;
+                m_localization_data.theta = loc.theta;
+                m_localization_timestamp = loc_timestamp;
+            }
+            for (size_t r = 0; r < 3; r++)
+                for (size_t k = 0; k < 3; k++)
+                    m_localization_cov[r][k] = pose_cov.m[r][k];
+            publishLocalization();
+        m_localization_data_mutex.unlock();
+        init_lock.unlock();
+        m_laser_to_correction_latency.record_since(m_laser_measurement_timestamp);
+
+        //velocity estimation block
+        //the corrected pose refers to the time of the odometry used by the filter
+        m_odometry_estimator.estimate(corrected_loc, m_odometry_timestamp);
     }
+    return (result & AMCL_FILTER_UPDATED) != 0;
+}
 
-    bool force_publication = false;
-    //first run, filter initialization
-    if (m_pf_initialized==false)
+void amclLocalizerThread::publishParticles(const pf_sample_set_t* set)
+{
+    //decimation of the published particles
+    size_t count = set->sample_count;
+    size_t stride = 1;
+    if (m_particles_max_published > 0 && count > m_particles_max_published)
     {
-#ifdef LOWLEVEL_DEBUG
-        yDebug() << "m_pf_initialized=false, intialiazing...";
-#endif
-        // Pose at last filter update
-        m_pf_odom_pose = pose;
-        // Filter is now initialized
-        m_pf_initialized = true;
-        // Should update sensor data
-        for (unsigned int i = 0; i < m_lasers_update.size(); i++)
-        {
-            m_lasers_update[i] = true;
-        }
-        force_publication = true;
-        m_resample_count = 0;
+        stride = (count + m_particles_max_published - 1) / m_particles_max_published;
     }
-    // If the robot has moved, update the filter
-    else if (m_pf_initialized && m_lasers_update[laser_index])
+
+    //the back buffer can be reused only if no reader is still holding it
+    if (!m_particle_back_buffer || m_particle_back_buffer.use_count() > 1)
     {
-#ifdef LOWLEVEL_DEBUG
-        yDebug() << "m_pf_init=true, m_lasers_update=true. update odometry";
-#endif
-        //printf("pose\n");
-        //pf_vector_fprintf(pose, stdout, "%.3f");
+        m_particle_back_buffer = std::make_shared<std::vector<float>>();
+    }
+    std::vector<float>& buffer = *m_particle_back_buffer;
+    buffer.clear();
+    buffer.reserve(4 * (count / stride + 1));
+    for (size_t i = 0; i < count; i += stride)
+    {
+        buffer.push_back((float)set->samples[i].pose.v[0]);
+        buffer.push_back((float)set->samples[i].pose.v[1]);
+        buffer.push_back((float)(set->samples[i].pose.v[2] * RAD2DEG));
+        buffer.push_back((float)set->samples[i].weight);
+    }
 
-        AMCLOdomData odata;
-        odata.pose = pose;
-        // HACK
-        // Modify the delta in the action data so the filter gets
-        // updated correctly
-        odata.delta = delta;
+    //publish the new snapshot, the old one becomes the back buffer
+    std::shared_ptr<const std::vector<float>> front = m_particle_back_buffer;
+    std::shared_ptr<const std::vector<float>> old = std::atomic_exchange(&m_particle_snapshot, front);
+    m_particle_back_buffer = std::const_pointer_cast<std::vector<float>>(old);
 
-        // Use the action data to update the filter
-        m_handler_odom->UpdateAction(m_handler_pf, (AMCLSensorData*)&odata);
+    //stream the snapshot
+    if (m_port_particles_output.getOutputCount() > 0)
+    {
+        yarp::sig::VectorOf<float>& v = m_port_particles_output.prepare();
+        v.resize(front->size());
+        std::copy(front->begin(), front->end(), v.begin());
+        m_port_particles_output.write();
+    }
+}
 
-        // Pose at last filter update
-        //this->pf_odom_pose = pose;
+bool amclLocalizerThread::getPoses(std::vector<Map2DLocation>& poses)
+{
+    std::shared_ptr<const std::vector<float>> snapshot = std::atomic_load(&m_particle_snapshot);
+    poses.clear();
+    if (!snapshot) return true;
+    size_t count = snapshot->size() / 4;
+    poses.resize(count);
+    for (size_t i = 0; i < count; i++)
+    {
+        poses[i].x = (*snapshot)[i * 4 + 0];
+        poses[i].y = (*snapshot)[i * 4 + 1];
+        poses[i].theta = (*snapshot)[i * 4 + 2];
     }
+    return true;
+}
+
+void amclLocalizerThread::setCorrection(double map_x, double map_y, double map_theta, const Map2DLocation& odom)
+{
+    //computes the map->odom transform such that: map_pose = correction * odom_pose
+    Map2DLocation map_pose;
+    map_pose.x = map_x;
+    map_pose.y = map_y;
+    map_pose.theta = map_theta;
+    Map2DLocation c = map_odom::correction(map_pose, odom);
+    std::lock_guard<std::mutex> lock(m_localization_data_mutex);
+    m_pf_data.theta = c.theta;
+    m_pf_data.x = c.x;
+    m_pf_data.y = c.y;
+}
 
-    bool resampled = false;
-    // If the robot has moved, update the filter
-    if (m_lasers_update[laser_index])
+void amclLocalizerThread::applyCorrection(const Map2DLocation& odom, double timestamp)
+{
+    std::lock_guard<std::mutex> lock(m_localization_data_mutex);
+    //never go back in time if an older odometry sample is applied after a newer one
+    if (timestamp < m_localization_timestamp) return;
+    Map2DLocation loc = map_odom::compose(m_pf_data, odom);
+    m_localization_data.x     = loc.x;
+    m_localization_data.y     = loc.y;
+    m_localization_data.theta = loc.theta;
+    m_localization_timestamp = timestamp;
+    publishLocalization();
+}
+
+void amclLocalizerThread::publishLocalization()
+{
+    //called with m_localization_data_mutex locked
+    amcl_localization_snapshot s;
+    strncpy(s.map_id, m_localization_data.map_id.c_str(), sizeof(s.map_id) - 1);
+    s.map_id[sizeof(s.map_id) - 1] = 0;
+    s.x = m_localization_data.x;
+    s.y = m_localization_data.y;
+    s.theta = m_localization_data.theta;
+    for (size_t r = 0; r < 3; r++)
+        for (size_t k = 0; k < 3; k++)
+            s.cov[r * 3 + k] = m_localization_cov[r][k];
+    s.timestamp = m_localization_timestamp;
+    m_output.write(s);
+}
+
+void amclLocalizerThread::publishCorrection(double timestamp)
+{
+    if (!m_map_odom_stream.isOpen()) return;
+    m_localization_data_mutex.lock();
+        Map2DLocation correction = m_pf_data;
+    m_localization_data_mutex.unlock();
+    m_map_odom_stream.publish(correction, timestamp);
+}
+
+void amclLocalizerThread::updateCpuBudget(double current_time, bool filter_updated)
+{
+    //the longest cycle with a filter update is measured here, the average duration of run()
+    //since the last adaptation is read from the PeriodicThread statistics
+    m_filter.AddCycle(yarp::os::Time::now() - current_time, filter_updated);
+    if (!m_filter.IsCpuBudgetDue(current_time)) return;
+    double used = getEstimatedUsed();
+    resetStat();
+    cpu_budget_result_t result = m_filter.UpdateCpuBudget(current_time, getPeriod(), used);
+    if (result == CPU_BUDGET_CHANGED)
     {
-#ifdef LOWLEVEL_DEBUG
-        yDebug() << "m_lasers_update=true, update laser data";
-#endif
-        AMCLLaserData ldata;
-        ldata.sensor = m_lasers[laser_index];
-        ldata.range_count = m_laser_measurement_data.size(); //@@@ 360? get this form the laser
-        double angle_min = m_min_laser_angle * DEG2RAD; ///@@@ get this from the laser, THIS needs to be expressed in the base frame, in RADIAS
-        double angle_increment = m_horizontal_resolution *DEG2RAD; //@@@ THIS needs to expressed in the base frame, in RADIANS
-        // wrapping angle to [-pi .. pi]
-        angle_increment = fmod(angle_increment + 5 * M_PI, 2 * M_PI) - M_PI; //@@@CHEKC THIS
-
-#ifdef  LOWLEVEL_DEBUG 
-        yDebug("Laser #%d, angles in base frame: min: %.3f, inc: %.3f, size %d", laser_index, angle_min, angle_increment, ldata.range_count);
-#endif
+        yDebug("CPU budget: run() %.2fms on average, %.2fms max with a filter update: particles %d, beams %d",
+            m_filter.GetMeanCycle() * 1000.0, m_filter.GetMaxUpdateCycle() * 1000.0, m_filter.GetMaxParticles(), m_filter.GetMaxBeams());
+    }
+    else if (result == CPU_BUDGET_AT_MINIMUM && current_time - m_cpu_budget_last_warning > 10.0)
+    {
+        m_cpu_budget_last_warning = current_time;
+        yWarning("CPU budget: run() takes %.2fms on average, %.2fms max with a filter update, already using the minimum particles (%d) and beams (%d)",
+            m_filter.GetMeanCycle() * 1000.0, m_filter.GetMaxUpdateCycle() * 1000.0, m_filter.GetMaxParticles(), m_filter.GetMaxBeams());
+    }
 
-        // Apply range min/max thresholds, if the user supplied them
-        if (m_config.m_laser_max_range > 0.0)
-        {
-            double tmp = m_max_laser_distance;
-            ldata.range_max = std::min(tmp, m_config.m_laser_max_range);
-        }
-        else
-        {
-            ldata.range_max = m_max_laser_distance;
-        }
-        double range_min;
-        if (m_config.m_laser_min_range > 0.0)
-        {
-            double tmp = m_min_laser_distance;
-            range_min = std::max(tmp, m_config.m_laser_min_range);
-        }
-        else
-        {
-            range_min = m_min_laser_distance;
-        }
-        // The AMCLLaserData destructor will free this memory
-        ldata.ranges = new double[ldata.range_count][2];
-        yAssert(ldata.ranges);
-        for (int i = 0; i<ldata.range_count; i++)
+    //the accuracy is limited by the budget, not by the KLD bound
+    if (m_filter.IsAccuracyLimited() && current_time - m_cpu_budget_last_warning > 10.0)
+    {
+        m_cpu_budget_last_warning = current_time;
+        yWarning("CPU budget: the KLD bound requires %d particles, limited to %d (beams: %d of %d)",
+            m_filter.GetKldSamples(), m_filter.GetMaxParticles(), m_filter.GetMaxBeams(), m_filter_params.max_beams);
+    }
+}
+
+void amclLocalizerThread::odometryReceived(const OdometryData& odom, double timestamp)
+{
+    Map2DLocation odom_pose;
+    odom_pose.x = odom.odom_x;
+    odom_pose.y = odom.odom_y;
+    odom_pose.theta = odom.odom_theta;
+
+    m_odometry_mutex.lock();
+        m_last_odometry_data_received = yarp::os::Time::now();
+        m_last_odometry_data = odom_pose;
+        m_last_odometry_timestamp = timestamp;
+    m_odometry_mutex.unlock();
+
+    //the localization is updated at the odometry rate, using the last correction computed by the filter
+    applyCorrection(odom_pose, timestamp);
+    m_odometry_to_pose_latency.record_since(timestamp);
+
+    if (m_pose_stream.isOpen())
+    {
+        Map2DLocation loc;
+        yarp::sig::Matrix cov;
+        double loc_timestamp;
+        getCurrentLoc(loc, cov, loc_timestamp);
+        m_pose_stream.publish(loc, cov, loc_timestamp);
+    }
+}
+
+bool amclLocalizerThread::globalLocalization(int max_hypotheses, std::vector<Map2DLocation>& hypotheses, std::vector<double>& scores)
+{
+    hypotheses.clear();
+    scores.clear();
+    if (m_scan_matcher == nullptr)
+    {
+        yError() << "Global localization is disabled (global_localization_enable = false)";
+        return false;
+    }
+    if (max_hypotheses <= 0)
+    {
+        max_hypotheses = m_global_localization_hypotheses;
+    }
+
+    //end points of the last scan, in the robot frame (the laser pose is currently assumed to be zero)
+    std::vector<pf_vector_t> points;
+    std::string map_id;
+    m_mutex.lock();
+        double range_max = m_max_laser_distance;
+        if (m_filter_params.laser_max_range > 0.0) range_max = std::min(range_max, m_filter_params.laser_max_range);
+        double range_min = m_min_laser_distance;
+        if (m_filter_params.laser_min_range > 0.0) range_min = std::max(range_min, m_filter_params.laser_min_range);
+        double angle_min = m_min_laser_angle * DEG2RAD;
+        double angle_increment = m_horizontal_resolution * DEG2RAD;
+        angle_increment = fmod(angle_increment + 5 * M_PI, 2 * M_PI) - M_PI;
+        for (size_t i = 0; i < m_laser_measurement_data.size(); i++)
         {
-            // amcl doesn't (yet) have a concept of min range.  So we'll map short readings to max range.
             double rho = 0;
             double theta = 0;
-            m_laser_measurement_data[i].get_polar(rho,theta); //@@@@ check carefully, i and theta
-            if (rho <= range_min)
+            m_laser_measurement_data[i].get_polar(rho, theta);
+            //the readings without an obstacle carry no information for the search
+            if (std::isfinite(rho) && rho > range_min && rho < range_max)
             {
-                ldata.ranges[i][0] = ldata.range_max;
+                double angle = angle_min + (i * angle_increment);
+                pf_vector_t p = pf_vector_zero();
+                p.v[0] = rho * cos(angle);
+                p.v[1] = rho * sin(angle);
+                points.push_back(p);
             }
-            else
-            {
-                ldata.ranges[i][0] = rho;
-            }
-            // Compute bearing
-            ldata.ranges[i][1] = angle_min + (i * angle_increment);
-            yDebug() << ldata.ranges[i][1];
         }
+        map_id = m_initial_loc.map_id;
+    m_mutex.unlock();
 
-        m_lasers[laser_index]->UpdateSensor(m_handler_pf, (AMCLSensorData*)&ldata);
+    if (points.empty())
+    {
+        yError() << "Global localization: no valid laser data available";
+        return false;
+    }
 
-        m_lasers_update[laser_index] = false;
+    //the search is performed without holding the filter lock
+    double t_start = yarp::os::Time::now();
+    std::vector<scan_match_hyp_t> hyps;
+    int found = m_scan_matcher->Match(points, max_hypotheses, hyps);
+    yInfo("Global localization: %d hypotheses found in %.3fs, using %d laser points", found, yarp::os::Time::now() - t_start, (int)points.size());
+    if (found == 0)
+    {
+        return false;
+    }
 
-        m_pf_odom_pose = pose;
+    for (size_t i = 0; i < hyps.size(); i++)
+    {
+        Map2DLocation loc;
+        loc.map_id = map_id;
+        loc.x = hyps[i].pose.v[0];
+        loc.y = hyps[i].pose.v[1];
+        loc.theta = hyps[i].pose.v[2] * RAD2DEG;
+        hypotheses.push_back(loc);
+        scores.push_back(hyps[i].score);
+        yDebug("Hypothesis %d: x:%.3f y:%.3f t_deg:%.3f score:%.3f", (int)i, loc.x, loc.y, loc.theta, hyps[i].score);
+    }
 
-        // Resample the particles
-        if (!(++m_resample_count % m_resample_interval))
-        {
-            pf_update_resample(m_handler_pf);
-            yDebug("Resampled by time (count %d / %d)", m_resample_count, m_resample_interval);
-            resampled = true;
-        }
+    //re-seed the filter around the hypotheses. The best one is used as current localization until the next filter update.
+    std::lock_guard<std::mutex> lock(m_mutex);
+    m_filter.InitializeFromHypotheses(hyps);
+    setInitialLoc(hypotheses[0]);
+    return true;
+}
 
-        pf_sample_set_t* set = m_handler_pf->sets + m_handler_pf->current_set;
-#ifdef LOWLEVEL_DEBUG
-        yDebug("Num samples: %d\n", set->sample_count);
-#endif
-        // Publish the resulting cloud
-        // TODO: set maximum rate for publishing
-        if (!m_force_update)
-        {
-            //mutex protected vs amclLocalizerThread::getPoses()
-            m_particle_poses_mutex.lock();
-            m_particle_poses.clear();
-            for (int i = 0; i < set->sample_count; i++)
-            {
-                Map2DLocation ppose;
-                ppose.x = set->samples[i].pose.v[0];
-                ppose.y = set->samples[i].pose.v[1];
-                ppose.theta = set->samples[i].pose.v[2]*RAD2DEG; //@@@@@@@CHECKME
-                m_particle_poses.push_back(ppose);
-            }
-            m_particle_poses_mutex.unlock();
-        }
+//header of the checkpoint files, followed by sample_count pf_sample_t.
+//version is incremented whenever the layout changes, header_size and sample_size reject the files written by
+//a build with a different layout of the structures.
+struct amcl_checkpoint_header_t
+{
+    char     magic[8];
+    uint32_t version;
+    uint32_t header_size;
+    uint32_t sample_size;
+    int32_t  sample_count;
+    uint64_t map_hash;
+    double   w_slow;
+    double   w_fast;
+    double   odom_pose[3]; //odometry at the last filter update [m, m, rad]
+};
+static const char amcl_checkpoint_magic[8] = "AMCLPF1";
+static const uint32_t amcl_checkpoint_version = 2;
+
+void amclLocalizerThread::checkpointFilter()
+{
+    //called by run() with m_mutex locked. If the previous checkpoint is still being written, this one is skipped.
+    std::unique_lock<std::mutex> lock(m_checkpoint_mutex, std::try_to_lock);
+    if (!lock.owns_lock() || m_checkpoint_pending || m_filter.IsInitialized() == false)
+    {
+        return;
     }
+    const pf_sample_set_t* set = m_filter.GetSampleSet();
+    m_checkpoint_samples.assign(set->samples, set->samples + set->sample_count);
+    m_checkpoint_w_slow = m_filter.GetWSlow();
+    m_checkpoint_w_fast = m_filter.GetWFast();
+    m_checkpoint_odom_pose = m_filter.GetOdomPose();
+    m_checkpoint_pending = true;
+    lock.unlock();
+    m_checkpoint_cv.notify_one();
+}
 
-    if (resampled || force_publication)
+void amclLocalizerThread::checkpointWriter()
+{
+    std::unique_lock<std::mutex> lock(m_checkpoint_mutex);
+    while (true)
     {
-        // Read out the current hypotheses
-        double max_weight = 0.0;
-        int max_weight_hyp = -1;
-        std::vector<amcl_hyp_t> hyps;
-        hyps.resize(m_handler_pf->sets[m_handler_pf->current_set].cluster_count);
-        for (int hyp_count = 0;
-            hyp_count < m_handler_pf->sets[m_handler_pf->current_set].cluster_count; hyp_count++)
+        m_checkpoint_cv.wait(lock, [this] { return m_checkpoint_pending || m_checkpoint_stop; });
+        if (m_checkpoint_stop)
         {
-            double weight;
-            pf_vector_t pose_mean;
-            pf_matrix_t pose_cov;
-            if (!pf_get_cluster_stats(m_handler_pf, hyp_count, &weight, &pose_mean, &pose_cov))
-            {
-                yError("Couldn't get stats on cluster %d", hyp_count);
-                break;
-            }
-
-            hyps[hyp_count].weight = weight;
-            hyps[hyp_count].pf_pose_mean = pose_mean;
-            hyps[hyp_count].pf_pose_cov = pose_cov;
-
-            if (hyps[hyp_count].weight > max_weight)
-            {
-                max_weight = hyps[hyp_count].weight;
-                max_weight_hyp = hyp_count;
-            }
+            return;
         }
 
-        if (max_weight > 0.0)
+        amcl_checkpoint_header_t header;
+        memset(&header, 0, sizeof(header));
+        memcpy(header.magic, amcl_checkpoint_magic, sizeof(header.magic));
+        header.version = amcl_checkpoint_version;
+        header.header_size = sizeof(amcl_checkpoint_header_t);
+        header.sample_size = sizeof(pf_sample_t);
+        header.map_hash = m_map_hash;
+        header.sample_count = (int32_t)m_checkpoint_samples.size();
+        header.w_slow = m_checkpoint_w_slow;
+        header.w_fast = m_checkpoint_w_fast;
+        for (int i = 0; i < 3; i++) header.odom_pose[i] = m_checkpoint_odom_pose.v[i];
+
+        //the file is written with a temporary name, then renamed, so a crash never leaves a truncated checkpoint
+        std::string tmp_file = m_checkpoint_file + ".tmp";
+        FILE* file = fopen(tmp_file.c_str(), "wb");
+        bool ok = (file != nullptr);
+        if (ok)
         {
-            yDebug("Max weight pose: x:%.3f y:%.3f t:%.3f (t_deg:%.3f)",
-                hyps[max_weight_hyp].pf_pose_mean.v[0],
-                hyps[max_weight_hyp].pf_pose_mean.v[1],
-                hyps[max_weight_hyp].pf_pose_mean.v[2],
-                hyps[max_weight_hyp].pf_pose_mean.v[2]*RAD2DEG);
-
-            m_localization_data_mutex.lock();
-                m_pf_data.x = hyps[max_weight_hyp].pf_pose_mean.v[0];
-                m_pf_data.y = hyps[max_weight_hyp].pf_pose_mean.v[1];
-                m_pf_data.theta = hyps[max_weight_hyp].pf_pose_mean.v[2] * RAD2DEG;
-                m_pf_data.x     -= m_odometry_data.x;
-                m_pf_data.y     -= m_odometry_data.y;
-                m_pf_data.theta -= m_odometry_data.theta;
-            m_localization_data_mutex.unlock();
-
-
-            // odometry estimation from position
-
-            //velocity estimation block
-            if (1)
-            {
-                m_current_odom_mutex.lock();
-                //m_current_loc is in the world reference frame.
-                // hence this velocity is estimated in the world reference frame.
-                iCub::ctrl::AWPolyElement el;
-                el.data = yarp::sig::Vector(3);
-                el.data[0]=  m_current_odom.odom_x = m_localization_data.x;
-                el.data[1] = m_current_odom.odom_y = m_localization_data.y;
-                el.data[2] = m_current_odom.odom_theta = m_localization_data.theta;
-                el.time = Time::now();
-                m_odom_vel.resize(3,0.0);
-                m_odom_vel = m_estimator->estimate(el);
-                m_current_odom.odom_vel_x = m_odom_vel[0];
-                m_current_odom.odom_vel_y = m_odom_vel[1];
-                m_current_odom.odom_vel_theta = m_odom_vel[2];
-
-                //this is the velocity in robot reference frame.
-                //NB: for a non-holonomic robot robot_vel[1] ~= 0
-                m_robot_vel.resize(3, 0.0);
-                m_robot_vel[0] = m_odom_vel[0] * cos(m_localization_data.theta * DEG2RAD) - m_odom_vel[0] * sin(m_localization_data.theta * DEG2RAD);
-                m_robot_vel[1] = m_odom_vel[1] * sin(m_localization_data.theta * DEG2RAD) + m_odom_vel[1] * cos(m_localization_data.theta * DEG2RAD);
-                m_robot_vel[2] = m_odom_vel[2];
-                m_current_odom.base_vel_x = m_robot_vel[0];
-                m_current_odom.base_vel_y = m_robot_vel[1];
-                m_current_odom.base_vel_theta = m_robot_vel[2];
-
-                m_current_odom_mutex.unlock();
-            }
-
+            ok = fwrite(&header, sizeof(header), 1, file) == 1 &&
+                 fwrite(m_checkpoint_samples.data(), sizeof(pf_sample_t), m_checkpoint_samples.size(), file) == m_checkpoint_samples.size();
+            ok = (fclose(file) == 0) && ok;
         }
-
+        if (ok)
+        {
+            //rename() atomically replaces the previous checkpoint (on Windows it fails if the target exists)
+#ifdef _WIN32
+            remove(m_checkpoint_file.c_str());
+#endif
+            ok = (rename(tmp_file.c_str(), m_checkpoint_file.c_str()) == 0);
+        }
+        if (!ok)
+        {
+            yWarning() << "Unable to write the filter checkpoint" << m_checkpoint_file;
+        }
+        m_checkpoint_pending = false;
     }
 }
 
-bool amclLocalizerThread::getPoses(std::vector<Map2DLocation>& poses)
+bool amclLocalizerThread::restoreFilter()
 {
-    std::lock_guard<std::mutex> lock(m_particle_poses_mutex);
-    poses = m_particle_poses;
+    FILE* file = fopen(m_checkpoint_file.c_str(), "rb");
+    if (file == nullptr)
+    {
+        yInfo() << "No filter checkpoint found in" << m_checkpoint_file;
+        return false;
+    }
+    amcl_checkpoint_header_t header;
+    std::vector<pf_sample_t> samples;
+    long file_size = -1;
+    if (fseek(file, 0, SEEK_END) == 0)
+    {
+        file_size = ftell(file);
+        rewind(file);
+    }
+    bool ok = fread(&header, sizeof(header), 1, file) == 1 &&
+              memcmp(header.magic, amcl_checkpoint_magic, sizeof(header.magic)) == 0 &&
+              header.version == amcl_checkpoint_version &&
+              header.header_size == sizeof(amcl_checkpoint_header_t) &&
+              header.sample_size == sizeof(pf_sample_t) &&
+              header.sample_count > 0 &&
+              file_size == (long)(sizeof(amcl_checkpoint_header_t) + header.sample_count * sizeof(pf_sample_t));
+    if (ok)
+    {
+        samples.resize(header.sample_count);
+        ok = fread(samples.data(), sizeof(pf_sample_t), samples.size(), file) == samples.size();
+    }
+    fclose(file);
+    if (!ok)
+    {
+        yWarning() << "Invalid filter checkpoint" << m_checkpoint_file;
+        return false;
+    }
+    if (header.map_hash != m_map_hash)
+    {
+        yWarning() << "The filter checkpoint" << m_checkpoint_file << "refers to a different map, ignored";
+        return false;
+    }
+
+    std::lock_guard<std::mutex> lock(m_mutex);
+    //the samples refer to the odometry of the checkpoint: the motion since then is applied by the next (forced) update.
+    //This is valid if the odometry has not been reset meanwhile.
+    pf_vector_t odom_pose;
+    odom_pose.v[0] = header.odom_pose[0];
+    odom_pose.v[1] = header.odom_pose[1];
+    odom_pose.v[2] = header.odom_pose[2];
+    m_filter.Restore((int)samples.size(), samples.data(), header.w_slow, header.w_fast, odom_pose);
+
+    //the most probable cluster (the mean of the whole set is meaningless for a multimodal cloud)
+    pf_vector_t best = m_filter.GetSampleSet()->mean;
+    pf_matrix_t best_cov;
+    m_filter.GetBestCluster(best, best_cov);
+
+    //the map->odom correction of the checkpoint, composed with the most recent odometry sample
+    Map2DLocation odom;
+    odom.x = header.odom_pose[0];
+    odom.y = header.odom_pose[1];
+    odom.theta = header.odom_pose[2] * RAD2DEG;
+    setCorrection(best.v[0], best.v[1], best.v[2] * RAD2DEG, odom);
+    m_odometry_mutex.lock();
+        bool odom_received = m_last_odometry_data_received > 0;
+        Map2DLocation latest_odom = m_last_odometry_data;
+        double latest_odom_timestamp = m_last_odometry_timestamp;
+    m_odometry_mutex.unlock();
+    m_localization_data_mutex.lock();
+        m_pf_data.map_id = m_initial_loc.map_id;
+        Map2DLocation loc = odom_received ? map_odom::compose(m_pf_data, latest_odom) : map_odom::compose(m_pf_data, odom);
+        m_localization_data.map_id = m_initial_loc.map_id;
+        m_localization_data.x = loc.x;
+        m_localization_data.y = loc.y;
+        m_localization_data.theta = loc.theta;
+        m_localization_timestamp = latest_odom_timestamp;
+        publishLocalization();
+    m_localization_data_mutex.unlock();
+    publishCorrection(latest_odom_timestamp);
+
+    yInfo("Filter restored from %s: %d samples, best cluster x:%.3f y:%.3f t_deg:%.3f", m_checkpoint_file.c_str(),
+        (int)samples.size(), best.v[0], best.v[1], best.v[2] * RAD2DEG);
     return true;
 }
 
+void amclLocalizerThread::getLatencyStats(Bottle& b)
+{
+    m_odometry_to_pose_latency.addToBottle("odometry_to_pose", b);
+    m_laser_to_correction_latency.addToBottle("laser_to_correction", b);
+    if (m_filter.GetRefiner())
+    {
+        Bottle& r = b.addList();
+        r.addString("scan_refinement");
+        r.addInt((int)m_filter.GetRefiner()->GetRefinedCount());
+        r.addInt((int)m_filter.GetRefiner()->GetRejectedCount());
+        r.addInt((int)m_filter.GetRefiner()->GetSkippedCount());
+    }
+    if (m_filter_params.cpu_budget_enable)
+    {
+        Bottle& r = b.addList();
+        r.addString("cpu_budget");
+        r.addInt(m_filter.GetMaxParticles());
+        r.addInt(m_filter.GetMaxBeams());
+    }
+}
+
 bool amclLocalizerThread::getCurrentOdom(OdometryData& odom)
 {
-    std::lock_guard<std::mutex> lock(m_current_odom_mutex);
-    odom = m_current_odom;
+    odom = m_odometry_estimator.getOdometry();
     return true;
 }
 
 void amclLocalizerThread::run()
 {
     double current_time = yarp::os::Time::now();
+    m_cycle_start_time = current_time;
 
 #ifdef LOWLEVEL_DEBUG
 //    yDebug();
@@ -467,46 +749,79 @@ void amclLocalizerThread::run()
     if (current_time - m_last_statistics_printed > 10.0)
     {
         m_last_statistics_printed = yarp::os::Time::now();
+        if (m_publish_latency_stats && m_port_latency_output.getOutputCount() > 0)
+        {
+            Bottle& b = m_port_latency_output.prepare();
+            b.clear();
+            getLatencyStats(b);
+            m_port_latency_output.write();
+        }
     }
 
+    //a client connected after the last correction receives it within one second
+    m_map_odom_stream.refresh(1.0);
+
     std::lock_guard<std::mutex> lock(m_mutex);
 
-    //read odometry data
-    if (current_time - m_last_odometry_data_received > 0.1)
+    //initialization requested by setInitialPose()
+    m_init_request_mutex.lock();
+        bool init_request_pending = m_init_request_pending;
+        Map2DLocation init_request_loc = m_init_request_loc;
+        yarp::sig::Matrix init_request_cov = m_init_request_cov;
+        m_init_request_pending = false;
+    m_init_request_mutex.unlock();
+    if (init_request_pending)
     {
-        yWarning() << "No localization data received for more than 0.1s!";
+        reinitializeFilter(init_request_loc, init_request_cov);
     }
-    yarp::dev::OdometryData* odom = m_port_odometry_input.read(false);
-    if (odom)
+
+    //read odometry data (received by the port callback)
+    m_odometry_mutex.lock();
+        double last_odometry_data_received = m_last_odometry_data_received;
+        m_odometry_data.x = m_last_odometry_data.x;
+        m_odometry_data.y = m_last_odometry_data.y;
+        m_odometry_data.theta = m_last_odometry_data.theta;
+        m_odometry_timestamp = m_last_odometry_timestamp;
+    m_odometry_mutex.unlock();
+    if (current_time - last_odometry_data_received > 0.1)
     {
-        m_last_odometry_data_received = yarp::os::Time::now();
-        m_odometry_data.x = odom->odom_x;
-        m_odometry_data.y = odom->odom_y;
-        m_odometry_data.theta = odom->odom_theta;
+        yWarning() << "No localization data received for more than 0.1s!";
     }
 
     //read laser data
     bool las_ok = m_iLaser->getLaserMeasurement(m_laser_measurement_data);
     if (las_ok)
     {
-        m_laser_measurement_timestamp = yarp::os::Time::now();
-        pf_vector_t pose_v;
-        //@@@@set here the pose of the laser respect to base_frame_id
-        pose_v.v[0] = 0;
-        pose_v.v[1] = 0;
-        pose_v.v[2] = 0;
-        m_lasers[0]->SetLaserPose(pose_v);
+        //use the acquisition time of the scan, if available
+        if (m_iLaserTimed) m_laser_measurement_timestamp = m_iLaserTimed->getLastInputStamp().getTime();
+        else               m_laser_measurement_timestamp = yarp::os::Time::now();
+        //@@@@the laser is assumed to be in the origin of base_frame_id
+        m_laser_ranges.resize(m_laser_measurement_data.size());
+        for (size_t i = 0; i < m_laser_measurement_data.size(); i++)
+        {
+            double angle;
+            m_laser_measurement_data[i].get_polar(m_laser_ranges[i], angle);
+        }
     }
 
     //process data
-    updateFilter();
+    bool filter_updated = updateFilter();
+    if (m_filter_params.cpu_budget_enable)
+    {
+        updateCpuBudget(current_time, filter_updated);
+    }
 
-    //add the odometry
-    m_localization_data_mutex.lock();
-        m_localization_data.x     = m_pf_data.x     + m_odometry_data.x;
-        m_localization_data.y     = m_pf_data.y     + m_odometry_data.y;
-        m_localization_data.theta = m_pf_data.theta + m_odometry_data.theta;
+    //periodic snapshot of the filter state
+    if (m_checkpoint_file != "" && current_time - m_last_checkpoint > m_checkpoint_period)
+    {
+        m_last_checkpoint = current_time;
+        checkpointFilter();
+    }
+
+    //add the odometry. Between two filter updates this is also done by the odometry port callback.
+    applyCorrection(m_odometry_data, m_odometry_timestamp);
 #if DEBUG_DATA
+    m_localization_data_mutex.lock();
         auto& od = m_port_odometry_debug_out.prepare();
         od.odom_x = m_localization_data.x;
         od.odom_y = m_localization_data.y;
@@ -517,17 +832,47 @@ void amclLocalizerThread::run()
         pd.odom_y = m_pf_data.y;
         pd.odom_theta = m_pf_data.theta;
         m_port_pd_debug_out.write();
-#endif
     m_localization_data_mutex.unlock();
+#endif
 }
 
 bool amclLocalizerThread::initializeLocalization(const Map2DLocation& loc, const yarp::sig::Matrix& cov)
 {
-    std::lock_guard<std::mutex> lock(m_mutex);
-    m_localization_data.map_id = loc.map_id;
-    m_localization_data.x = loc.x;
-    m_localization_data.y = loc.y;
-    m_localization_data.theta = loc.theta;
+    if (loc.map_id.size() > AMCL_MAX_MAP_ID_LENGTH)
+    {
+        yError() << "Map id" << loc.map_id << "is longer than" << AMCL_MAX_MAP_ID_LENGTH << "characters";
+        return false;
+    }
+    if (cov.rows() < 3 || cov.cols() < 3)
+    {
+        yError() << "The initial covariance must be a 3x3 matrix";
+        return false;
+    }
+
+    //the filter is reinitialized by run(): the caller never waits for the filter update in progress.
+    //The pose is published immediately, so that the getters return it as soon as this method returns.
+    std::lock_guard<std::mutex> lock(m_init_request_mutex);
+    m_init_request_loc = loc;
+    m_init_request_cov = cov;
+    m_init_request_pending = true;
+    m_localization_data_mutex.lock();
+        for (size_t r = 0; r < 3; r++)
+            for (size_t k = 0; k < 3; k++)
+                m_localization_cov[r][k] = cov[r][k];
+    m_localization_data_mutex.unlock();
+    setInitialLoc(loc);
+    return true;
+}
+
+bool amclLocalizerThread::initializeLocalization(const Map2DLocation& loc)
+{
+    return initializeLocalization(loc, m_initial_covariance_msg);
+}
+
+void amclLocalizerThread::reinitializeFilter(const Map2DLocation& loc, const yarp::sig::Matrix& cov)
+{
+    //called with m_mutex locked
+    setInitialLoc(loc);
 
     // Re-initialize the filter
     pf_vector_t pf_init_pose_mean = pf_vector_zero();
@@ -542,75 +887,62 @@ bool amclLocalizerThread::initializeLocalization(const Map2DLocation& loc, const
     pf_init_pose_cov.m[1][1] = cov[1][1];
     pf_init_pose_cov.m[2][2] = cov[2][2];
 
-    if (m_initial_pose_hyp)
-    {
-        delete m_initial_pose_hyp;
-        m_initial_pose_hyp = nullptr;
-    }
-    m_initial_pose_hyp = new amcl_hyp_t();
-    m_initial_pose_hyp->pf_pose_mean = pf_init_pose_mean;
-    m_initial_pose_hyp->pf_pose_cov = pf_init_pose_cov;
-
-    applyInitialPose();
-    return true;
+    m_filter.Initialize(pf_init_pose_mean, pf_init_pose_cov);
 }
 
-bool amclLocalizerThread::initializeLocalization(const Map2DLocation& loc)
-{
-    std::lock_guard<std::mutex> lock(m_mutex);
-    m_pf_data.map_id = loc.map_id;
-    m_pf_data.x = loc.x - m_odometry_data.x;
-    m_pf_data.y = loc.y - m_odometry_data.y;
-    m_pf_data.theta = loc.theta - m_odometry_data.theta;
-    m_localization_data.map_id = loc.map_id;
-    m_localization_data.x      = loc.x;
-    m_localization_data.y      = loc.y;
-    m_localization_data.theta  = loc.theta;
-
-    // Re-initialize the filter
-    pf_vector_t pf_init_pose_mean = pf_vector_zero();
-    pf_init_pose_mean.v[0] = loc.x;
-    pf_init_pose_mean.v[1] = loc.y;
-    pf_init_pose_mean.v[2] = loc.theta * DEG2RAD; //@@@@ check me
-    pf_matrix_t pf_init_pose_cov = pf_matrix_zero();
 
-    pf_init_pose_cov.m[0][0] = m_initial_covariance_msg[0][0];
-    pf_init_pose_cov.m[0][1] = m_initial_covariance_msg[0][1];
-    pf_init_pose_cov.m[1][0] = m_initial_covariance_msg[1][0];
-    pf_init_pose_cov.m[1][1] = m_initial_covariance_msg[1][1];
-    pf_init_pose_cov.m[2][2] = m_initial_covariance_msg[2][2];
+void amclLocalizerThread::setInitialLoc(const Map2DLocation& loc)
+{
+    //the correction is computed respect to the most recent odometry sample
+    m_odometry_mutex.lock();
+        Map2DLocation odom = m_last_odometry_data;
+        double timestamp = m_last_odometry_timestamp;
+    m_odometry_mutex.unlock();
+    setCorrection(loc.x, loc.y, loc.theta, odom);
 
-    // Copy in the covariance, converting from 6-D to 3-D
-    /*
-    // @@@@@@ check me
-    for (int i = 0; i<2; i++)
-    {
-        for (int j = 0; j<2; j++)
-        {
-            pf_init_pose_cov.m[i][j] = msg.pose.covariance[6 * i + j];
-        }
-    }
-    pf_init_pose_cov.m[2][2] = msg.pose.covariance[6 * 5 + 5];
-    */
+    m_localization_data_mutex.lock();
+        m_pf_data.map_id = loc.map_id;
+        m_localization_data.map_id = loc.map_id;
+        m_localization_data.x      = loc.x;
+        m_localization_data.y      = loc.y;
+        m_localization_data.theta  = loc.theta;
+        m_localization_timestamp   = timestamp;
+        publishLocalization();
+    m_localization_data_mutex.unlock();
+    publishCorrection(timestamp);
+}
 
-    if (m_initial_pose_hyp)
-    {
-        delete m_initial_pose_hyp;
-        m_initial_pose_hyp = nullptr;
-    }
-    m_initial_pose_hyp = new amcl_hyp_t();
-    m_initial_pose_hyp->pf_pose_mean = pf_init_pose_mean;
-    m_initial_pose_hyp->pf_pose_cov = pf_init_pose_cov;
+bool amclLocalizerThread::getCurrentLoc(Map2DLocation& loc)
+{
+    double timestamp;
+    return getCurrentLoc(loc, timestamp);
+}
 
-    applyInitialPose();
+bool amclLocalizerThread::getCurrentLoc(Map2DLocation& loc, double& timestamp)
+{
+    amcl_localization_snapshot s;
+    m_output.read(s);
+    loc.map_id = s.map_id;
+    loc.x = s.x;
+    loc.y = s.y;
+    loc.theta = s.theta;
+    timestamp = s.timestamp;
     return true;
 }
 
-
-bool amclLocalizerThread::getCurrentLoc(Map2DLocation& loc)
+bool amclLocalizerThread::getCurrentLoc(Map2DLocation& loc, yarp::sig::Matrix& cov, double& timestamp)
 {
-    std::lock_guard<std::mutex> lock (m_localization_data_mutex);
-    loc = m_localization_data;
+    amcl_localization_snapshot s;
+    m_output.read(s);
+    loc.map_id = s.map_id;
+    loc.x = s.x;
+    loc.y = s.y;
+    loc.theta = s.theta;
+    cov.resize(3, 3);
+    for (size_t r = 0; r < 3; r++)
+        for (size_t k = 0; k < 3; k++)
+            cov[r][k] = s.cov[r * 3 + k];
+    timestamp = s.timestamp;
     return true;
 }
 
@@ -669,6 +1001,13 @@ bool amclLocalizerThread::threadInit()
     m_local_name = "amclLocalizer";
     if (general_group.check("name")) { m_local_name = general_group.find("name").asString(); }
 
+    //optional odometry estimation group
+    if (!m_odometry_estimator.configure(m_cfg.findGroup("ODOMETRY_ESTIMATION")))
+    {
+        yError() << "Invalid [ODOMETRY_ESTIMATION] group";
+        return false;
+    }
+
     //laser group
     if (laser_group.check("laser_broadcast_port") == false)
     {
@@ -692,6 +1031,7 @@ bool amclLocalizerThread::threadInit()
 
     //opens a YARP port to receive odometry data
     std::string odom_portname = "/" + m_local_name + "/odometry:i";
+    m_port_odometry_input.useCallback();  // input should go to onRead() callback
     bool b1 = m_port_odometry_input.open(odom_portname.c_str());
     bool b2 = yarp::os::Network::sync(odom_portname.c_str(), false);
     bool b3 = yarp::os::Network::connect(m_port_broadcast_odometry_name.c_str(), odom_portname.c_str());
@@ -701,6 +1041,44 @@ bool amclLocalizerThread::threadInit()
         return false;
     }
 
+    //opens a YARP port to stream the particles cloud
+    std::string particles_portname = "/" + m_local_name + "/particles:o";
+    if (m_port_particles_output.open(particles_portname.c_str()) == false)
+    {
+        yError() << "Unable to open port" << particles_portname;
+        return false;
+    }
+
+    //opens a YARP port to stream the latency statistics (optional)
+    if (general_group.check("publish_latency_stats")) { m_publish_latency_stats = general_group.find("publish_latency_stats").asBool(); }
+    if (m_publish_latency_stats)
+    {
+        std::string latency_portname = "/" + m_local_name + "/latency:o";
+        if (m_port_latency_output.open(latency_portname.c_str()) == false)
+        {
+            yError() << "Unable to open port" << latency_portname;
+            return false;
+        }
+    }
+
+    //opens a YARP port to stream the localization to the navigation modules (optional)
+    if (general_group.check("publish_pose_stream") && general_group.find("publish_pose_stream").asBool())
+    {
+        if (m_pose_stream.open("/" + m_local_name + "/pose:o") == false)
+        {
+            return false;
+        }
+    }
+
+    //opens a YARP port to stream the map->odom correction, composed with the odometry by the clients (optional)
+    if (general_group.check("publish_map_odom_stream") && general_group.find("publish_map_odom_stream").asBool())
+    {
+        if (m_map_odom_stream.open("/" + m_local_name + "/map_odom:o") == false)
+        {
+            return false;
+        }
+    }
+
     //initial location initialization
     if (initial_group.check("initial_x")) { m_initial_loc.x = initial_group.find("initial_x").asDouble(); }
     else { yError() << "missing initial_x param"; return false; }
@@ -710,91 +1088,49 @@ bool amclLocalizerThread::threadInit()
     else { yError() << "missing initial_theta param"; return false; }
     if (initial_group.check("initial_map")) { m_initial_loc.map_id = initial_group.find("initial_map").asString(); }
     else { yError() << "missing initial_map param"; return false; }
+    if (m_initial_loc.map_id.size() > AMCL_MAX_MAP_ID_LENGTH) { yError() << "initial_map is longer than" << AMCL_MAX_MAP_ID_LENGTH << "characters"; return false; }
     
     // Grab params off the param server
     m_use_map_topic = initial_group.check("use_map_topic", Value(false)).asBool();
     m_first_map_only = initial_group.check("first_map_only", Value(false)).asBool();
 
-    double tmp;
-    m_config.m_laser_min_range = amcl_group.check("laser_min_range", Value(-1.0)).asDouble();
-    m_config.m_laser_max_range = amcl_group.check("laser_max_range", Value(-1.0)).asDouble();
-    m_config.m_max_beams = amcl_group.check("laser_max_beams", Value(30)).asDouble();
-    m_config.m_min_particles = amcl_group.check("min_particles", Value(100)).asInt();
-    m_config.m_max_particles = amcl_group.check("max_particles", Value(5000)).asInt();
-    m_config.m_pf_err = amcl_group.check("kld_err", Value(0.01)).asDouble();
-    m_config.m_pf_z = amcl_group.check("kld_z", Value(0.99)).asDouble();
-    m_config.m_alpha1 = amcl_group.check("odom_alpha1", Value(0.2)).asDouble();
-    m_config.m_alpha2 = amcl_group.check("odom_alpha2", Value(0.2)).asDouble();
-    m_config.m_alpha3 = amcl_group.check("odom_alpha3", Value(0.2)).asDouble();
-    m_config.m_alpha4 = amcl_group.check("odom_alpha4", Value(0.2)).asDouble();
-    m_config.m_alpha5 = amcl_group.check("odom_alpha5", Value(0.2)).asDouble();
-
-    m_config.m_do_beamskip = amcl_group.check("do_beamskip", Value(false)).asBool();
-    m_config.m_beam_skip_distance = amcl_group.check("beam_skip_distance", Value(0.5)).asDouble();
-    m_config.m_beam_skip_threshold = amcl_group.check("beam_skip_threshold", Value(0.3)).asDouble();
-    m_config.m_beam_skip_error_threshold = amcl_group.check("beam_skip_error_threshold", Value(0.9)).asDouble();
-
-    m_config.m_z_hit = amcl_group.check("laser_z_hit", Value(0.95)).asDouble();
-    m_config.m_z_short = amcl_group.check("laser_z_short", Value(0.1)).asDouble();
-    m_config.m_z_max = amcl_group.check("laser_z_max", Value(0.05)).asDouble();
-    m_config.m_z_rand = amcl_group.check("laser_z_rand", Value(0.05)).asDouble();
-    m_config.m_sigma_hit = amcl_group.check("laser_sigma_hit", Value(0.2)).asDouble();
-    m_config.m_lambda_short = amcl_group.check("laser_lambda_short", Value(0.1)).asDouble();
-    m_config.m_laser_likelihood_max_dist = amcl_group.check("laser_likelihood_max_dist", Value(2.0)).asDouble();
-    std::string tmp_laser_model_type = amcl_group.check("laser_model_type", Value("likelihood_field")).asString();
-
-    m_initial_covariance_msg.resize(3, 3);
-    m_initial_covariance_msg.zero();
-    //the following default numbers have been taken from initialization message posted by rviz
-    m_initial_covariance_msg[0][0] = 0.25;
-    m_initial_covariance_msg[1][1] = 0.25;
-    m_initial_covariance_msg[2][2] = 0.06853891945200942;
-
-    if (tmp_laser_model_type == "beam")
+    //the parameters of the filter, shared with the off-line tools
+    if (readAmclFilterParams(amcl_group, initial_group, m_filter_params) == false)
     {
-        m_laser_model_type = LASER_MODEL_BEAM;
-    }
-    else if (tmp_laser_model_type == "likelihood_field")
-    {
-        m_laser_model_type = LASER_MODEL_LIKELIHOOD_FIELD;
-    }
-    else if (tmp_laser_model_type == "likelihood_field_prob")
-    {
-        m_laser_model_type = LASER_MODEL_LIKELIHOOD_FIELD_PROB;
-    }
-    else
-    {
-        yWarning("Unknown laser model type \"%s\"; defaulting to likelihood_field model",
-                 tmp_laser_model_type.c_str());
-                 m_laser_model_type = LASER_MODEL_LIKELIHOOD_FIELD;
+        return false;
     }
+    //0 = seed from the current time, otherwise the motion noise is reproducible
+    int random_seed = amcl_group.check("random_seed", Value(0)).asInt();
 
-    std::string tmp_odom_model_type = amcl_group.check("odom_model_type", Value("diff")).asString();
-    if (tmp_odom_model_type == "diff")
-        m_odom_model_type = ODOM_MODEL_DIFF;
-    else if (tmp_odom_model_type == "omni")
-        m_odom_model_type = ODOM_MODEL_OMNI;
-    else if (tmp_odom_model_type == "diff-corrected")
-        m_odom_model_type = ODOM_MODEL_DIFF_CORRECTED;
-    else if (tmp_odom_model_type == "omni-corrected")
-        m_odom_model_type = ODOM_MODEL_OMNI_CORRECTED;
-    else
-    {
-        yWarning("Unknown odom model type \"%s\"; defaulting to diff model",
-            tmp_odom_model_type.c_str());
-        m_odom_model_type = ODOM_MODEL_DIFF;
-    }
+    m_initial_covariance_msg.resize(3, 3);
+    m_initial_covariance_msg.zero();
+    m_initial_covariance_msg[0][0] = m_filter_params.initial_cov_xx;
+    m_initial_covariance_msg[1][1] = m_filter_params.initial_cov_yy;
+    m_initial_covariance_msg[2][2] = m_filter_params.initial_cov_aa;
 
-    m_config.m_d_thresh = amcl_group.check("update_min_d", Value(0.2)).asDouble();
-    m_config.m_a_thresh = amcl_group.check("update_min_a", Value(M_PI / 6.0)).asDouble();
     m_odom_frame_id = amcl_group.check("odom_frame_id", Value("odom")).asString();
     m_base_frame_id = amcl_group.check("base_frame_id", Value("base_link")).asString();
     m_global_frame_id = amcl_group.check("global_frame_id", Value("map")).asString();
-    m_resample_interval = amcl_group.check("resample_interval", Value(2)).asDouble();
-     
-    m_config.m_alpha_slow = amcl_group.check("recovery_alpha_slow", Value(0.001)).asDouble();
-    m_config.m_alpha_fast = amcl_group.check("recovery_alpha_fast", Value(0.1)).asDouble();
     m_tf_broadcast = amcl_group.check("tf_broadcast", Value(true)).asBool();
+    m_particles_max_published = amcl_group.check("particles_max_published", Value(0)).asInt();
+
+    bool   global_localization_enable = amcl_group.check("global_localization_enable", Value(true)).asBool();
+    int    global_localization_levels = amcl_group.check("global_localization_levels", Value(7)).asInt();
+    double global_localization_angular_step = amcl_group.check("global_localization_angular_step", Value(1.0)).asDouble();
+    double global_localization_min_score = amcl_group.check("global_localization_min_score", Value(0.5)).asDouble();
+    int    global_localization_max_points = amcl_group.check("global_localization_max_points", Value(100)).asInt();
+    int    global_localization_threads = amcl_group.check("global_localization_threads", Value(0)).asInt();
+    double global_localization_min_distance = amcl_group.check("global_localization_min_distance", Value(1.0)).asDouble();
+    double global_localization_min_angle = amcl_group.check("global_localization_min_angle", Value(30.0)).asDouble();
+    m_global_localization_hypotheses = amcl_group.check("global_localization_hypotheses", Value(5)).asInt();
+
+    m_refine_time_margin = amcl_group.check("refine_time_margin", Value(0.005)).asDouble();
+
+    //the obstacle distances of each map are computed once and saved in this directory (empty = disabled)
+    std::string cspace_cache_dir = amcl_group.check("cspace_cache_dir", Value("")).asString();
+    m_checkpoint_file = amcl_group.check("checkpoint_file", Value("")).asString();
+    m_checkpoint_period = amcl_group.check("checkpoint_period", Value(10.0)).asDouble();
+    m_checkpoint_resume = amcl_group.check("checkpoint_resume", Value(true)).asBool();
 
     //get the map from the map_server
     Property map_options;
@@ -827,72 +1163,75 @@ bool amclLocalizerThread::threadInit()
         return false;
     }
 
-    m_amcl_map = convertMap(m_yarp_map);
+    uint64_t seed = (random_seed != 0) ? (uint64_t)random_seed : (uint64_t)(yarp::os::Time::now() * 1e6);
+
+    m_amcl_map = convertAmclMap(m_yarp_map);
+    m_map_hash = map_hash(m_amcl_map);
 
-    if (m_handler_pf != nullptr)
+    //obstacle distances (likelihood field), loaded from the cache if already computed for this map
+    bool cspace_needed = (m_filter_params.laser_model != LASER_MODEL_BEAM) || global_localization_enable || m_filter_params.refine_enable;
+    if (cspace_needed && cspace_cache_dir != "")
     {
-        pf_free(m_handler_pf);
-        m_handler_pf = nullptr;
+        char hash_str[32];
+        snprintf(hash_str, sizeof(hash_str), "%016llx", (unsigned long long)m_map_hash);
+        std::string cspace_file = cspace_cache_dir + "/amcl_cspace_" + hash_str + ".bin";
+        if (map_load_cspace(m_amcl_map, cspace_file.c_str(), m_filter_params.likelihood_max_dist) == 0)
+        {
+            yInfo() << "Obstacle distances loaded from" << cspace_file;
+        }
+        else
+        {
+            yInfo("Computing the obstacle distances; this can take some time on large maps...");
+            map_update_cspace(m_amcl_map, m_filter_params.likelihood_max_dist);
+            if (map_save_cspace(m_amcl_map, cspace_file.c_str()) == 0)
+            {
+                yInfo() << "Obstacle distances saved to" << cspace_file;
+            }
+            else
+            {
+                yWarning() << "Unable to save the obstacle distances to" << cspace_file;
+            }
+        }
     }
-    m_handler_pf = pf_alloc(m_config.m_min_particles, m_config.m_max_particles,
-                            m_config.m_alpha_slow, m_config.m_alpha_fast,
-                           (pf_init_model_fn_t)amclLocalizerThread::uniformPoseGenerator,
-                           (void *)m_amcl_map);
-    m_handler_pf->pop_err = m_config.m_pf_err;
-    m_handler_pf->pop_z = m_config.m_pf_z;
 
-    // Initialize the filter
-    pf_vector_t pf_init_pose_mean = pf_vector_zero();
-    pf_matrix_t pf_init_pose_cov = pf_matrix_zero();
-    pf_init_pose_cov.m[0][0] = m_initial_covariance_msg[0][0];
-    pf_init_pose_cov.m[0][1] = m_initial_covariance_msg[0][1];
-    pf_init_pose_cov.m[1][0] = m_initial_covariance_msg[1][0];
-    pf_init_pose_cov.m[1][1] = m_initial_covariance_msg[1][1];
-    pf_init_pose_cov.m[2][2] = m_initial_covariance_msg[2][2];
-    pf_init_pose_mean.v[0] = m_initial_loc.x;
-    pf_init_pose_mean.v[1] = m_initial_loc.y;
-    pf_init_pose_mean.v[2] = m_initial_loc.theta *DEG2RAD;
-
-    pf_init(m_handler_pf, pf_init_pose_mean, pf_init_pose_cov);
-    m_pf_initialized = false;
-
-    // Instantiate the sensor objects
-    // Odometry
-    if (m_handler_odom)
+    // Particle filter and sensor models
+    yInfo("Initializing the filter; this can take some time on large maps...");
+    if (m_filter.Init(m_filter_params, m_amcl_map, seed) == false)
     {
-        delete m_handler_odom;
-        m_handler_odom = 0;
+        yError() << "Unable to initialize the filter";
+        return false;
     }
-    m_handler_odom = new AMCLOdom();
-    yAssert(m_handler_odom);
-    m_handler_odom->SetModel(m_odom_model_type, m_config.m_alpha1, m_config.m_alpha2, m_config.m_alpha3, m_config.m_alpha4, m_config.m_alpha5);
-
-    // Laser
-    if (m_handler_laser)
+    if (m_filter.GetFreeCellCount() == 0)
     {
-        delete m_handler_laser;
-        m_handler_laser = 0;
+        yError() << "The map has no free cells: the global localization cannot draw any pose";
     }
-    m_handler_laser = new AMCLLaser(m_config.m_max_beams, m_amcl_map);
-    yAssert(m_handler_laser);
-    if (m_laser_model_type == LASER_MODEL_BEAM)
+    else
     {
-        m_handler_laser->SetModelBeam(m_config.m_z_hit, m_config.m_z_short, m_config.m_z_max, m_config.m_z_rand, m_config.m_sigma_hit, m_config.m_lambda_short, 0.0);
+        yDebug() << "Free cells of the map:" << m_filter.GetFreeCellCount();
     }
-    else if (m_laser_model_type == LASER_MODEL_LIKELIHOOD_FIELD_PROB)
+    yInfo("Done initializing the filter.");
+
+    // Global localization
+    if (m_scan_matcher)
     {
-        yInfo("Initializing likelihood field model; this can take some time on large maps...");
-        m_handler_laser->SetModelLikelihoodFieldProb(m_config.m_z_hit, m_config.m_z_rand, m_config.m_sigma_hit,
-            m_config.m_laser_likelihood_max_dist,
-            m_config.m_do_beamskip, m_config.m_beam_skip_distance,
-            m_config.m_beam_skip_threshold, m_config.m_beam_skip_error_threshold);
-        yInfo("Done initializing likelihood field model with probabilities.");
+        delete m_scan_matcher;
+        m_scan_matcher = nullptr;
     }
-    else if (m_laser_model_type == LASER_MODEL_LIKELIHOOD_FIELD)
+    if (global_localization_enable)
     {
-        yInfo("Initializing likelihood field model; this can take some time on large maps...");
-        m_handler_laser->SetModelLikelihoodField(m_config.m_z_hit, m_config.m_z_rand, m_config.m_sigma_hit, m_config.m_laser_likelihood_max_dist);
-        yInfo("Done initializing likelihood field model.");
+        yInfo("Initializing the global localization search; this can take some time on large maps...");
+        if (m_amcl_map->max_occ_dist != m_filter_params.likelihood_max_dist)
+        {
+            //the likelihood field has not been computed by the laser model
+            map_update_cspace(m_amcl_map, m_filter_params.likelihood_max_dist);
+        }
+        m_scan_matcher = new AMCLScanMatcher();
+        yAssert(m_scan_matcher);
+        m_scan_matcher->SetMap(m_amcl_map, m_filter_params.sigma_hit, global_localization_levels);
+        m_scan_matcher->SetSearchParams(global_localization_angular_step * DEG2RAD, global_localization_min_score,
+            global_localization_max_points, global_localization_threads,
+            global_localization_min_distance, global_localization_min_angle * DEG2RAD);
+        yInfo("Done initializing the global localization search.");
     }
 
     //opens the laser client and the corresponding interface
@@ -911,6 +1250,7 @@ bool amclLocalizerThread::threadInit()
         yError() << "Unable to open laser interface";
         return false;
     }
+    m_pLas.view(m_iLaserTimed);
 
     if (m_iLaser->getScanLimits(m_min_laser_angle, m_max_laser_angle) == false)
     {
@@ -931,156 +1271,55 @@ bool amclLocalizerThread::threadInit()
     }
 
     m_laser_angle_of_view = fabs(m_min_laser_angle) + fabs(m_max_laser_angle);
-    
-    //@@@@ add an entry for each equipped laser device
-    m_lasers.push_back(new AMCLLaser(*m_handler_laser));
-    m_lasers_update.push_back(true);
 
     //@@@CHECK the position of this call
-    this->initializeLocalization(m_initial_loc);
-    return true;
-}
-
-void amclLocalizerThread::threadRelease()
-{
-    if (m_handler_odom)
+    if (m_checkpoint_file == "" || m_checkpoint_resume == false || restoreFilter() == false)
     {
-        delete m_handler_odom;
-        m_handler_odom = nullptr;
-    }
-    if (m_handler_laser)
-    {
-        delete m_handler_laser;
-        m_handler_laser = nullptr;
+        std::lock_guard<std::mutex> lock(m_mutex);
+        reinitializeFilter(m_initial_loc, m_initial_covariance_msg);
     }
 
-    //@@@@@@@@@@@@@@must use its own alloc?
-    if (m_handler_pf != nullptr)
+    if (m_checkpoint_file != "")
     {
-       pf_free(m_handler_pf);
-       m_handler_pf = nullptr;
+        m_checkpoint_stop = false;
+        m_checkpoint_thread = std::thread(&amclLocalizerThread::checkpointWriter, this);
     }
+    return true;
 }
 
-pf_vector_t amclLocalizerThread::uniformPoseGenerator(void* arg)
+void amclLocalizerThread::threadRelease()
 {
-    map_t* map = (map_t*)arg;
-#if NEW_UNIFORM_SAMPLING
-    unsigned int rand_index = drand48() * free_space_indices.size();
-    std::pair<int, int> free_point = free_space_indices[rand_index];
-    pf_vector_t p;
-    p.v[0] = MAP_WXGX(map, free_point.first);
-    p.v[1] = MAP_WYGY(map, free_point.second);
-    p.v[2] = drand48() * 2 * M_PI - M_PI;
-#else
-    double min_x, max_x, min_y, max_y;
-
-    min_x = -(map->size_x * map->scale) / 2.0 + map->origin_x;
-    max_x = (map->size_x * map->scale) / 2.0 + map->origin_x;
-    min_y = -(map->size_y * map->scale) / 2.0 + map->origin_y;
-    max_y = (map->size_y * map->scale) / 2.0 + map->origin_y;
-
-    pf_vector_t p;
-
-    yDebug("Generating new uniform sample");
-    std::random_device rd;
-    std::mt19937 gen(rd());
-#if 0
-    std::uniform_real_distribution<double> dis_x(min_x, max_x);
-    std::uniform_real_distribution<double> dis_y(min_y, max_y);
-#else
-    if (max_x < min_x) std::swap(min_x, max_x);
-    std::uniform_real_distribution<double> dis_x(min_x, max_x);
-
-    if (max_y < min_y) std::swap(min_y, max_y);
-    std::uniform_real_distribution<double> dis_y(min_y, max_y);
-#endif
-    std::uniform_real_distribution<double> dis_t(-M_PI, +M_PI);
-
-    for (size_t check_counter=0;; check_counter++)
-    {
-        //p.v[0] = min_x + drand48() * (max_x - min_x);
-        //p.v[1] = min_y + drand48() * (max_y - min_y);
-        //p.v[2] = drand48() * 2 * M_PI - M_PI;
-
-        p.v[0] = dis_x(gen);
-        p.v[1] = dis_y(gen);
-        p.v[2] = dis_t(gen);
-        // Check that it's a free cell
-        int i, j;
-        i = MAP_GXWX(map, p.v[0]);
-        j = MAP_GYWY(map, p.v[1]);
-        if (MAP_VALID(map, i, j) && (map->cells[MAP_INDEX(map, i, j)].occ_state == -1))
-        {
-            break;
-        }
-
-        if (check_counter > 10000)
-        {
-            yError() << "Deadlock detected. Problems in map data: no free cells found";
-        }
+    if (m_checkpoint_thread.joinable())
+    {
+        m_checkpoint_mutex.lock();
+        m_checkpoint_stop = true;
+        m_checkpoint_mutex.unlock();
+        m_checkpoint_cv.notify_one();
+        m_checkpoint_thread.join();
     }
-#endif
-    return p;
-}
 
-map_t* amclLocalizerThread::convertMap(MapGrid2D& yarp_map)
-{
-    map_t* map = map_alloc();
-    yAssert(map);
-
-    map->size_x = yarp_map.width();
-    map->size_y = yarp_map.height();
-    yarp_map.getResolution(map->scale);
-    double x_orig;
-    double y_orig;
-    double t_orig;
-    yarp_map.getOrigin(x_orig, y_orig, t_orig);
-    map->origin_x = x_orig + (map->size_x / 2) * map->scale;
-    map->origin_y = y_orig + (map->size_y / 2) * map->scale;
-
-    map->cells = (map_cell_t*)malloc(sizeof(map_cell_t)*map->size_x*map->size_y);
-    yAssert(map->cells);
-    //for (int i = 0; i<map->size_x * map->size_y; i++)
-    for (int y = 0; y < map->size_y; y++)
-        for (int x = 0; x < map->size_x; x++)
-    {
-        int i = y * map->size_x + x;
-        double occupancy;
-        Nav2D::XYCell cell(x,y);
-
-        yarp_map.getOccupancyData(cell, occupancy);
-
-#if 0
-        if (occupancy == 0)
-            map->cells[i].occ_state = -1;
-        else if (occupancy == 100)
-            map->cells[i].occ_state = +1;
-        else
-            map->cells[i].occ_state = 0;
-#else
-        //@@@@check me
-        if (occupancy >= 0)
-        {
-            if (occupancy > 50)
-            {
-                map->cells[i].occ_state = +1;
-            }
-            else
-            {
-                map->cells[i].occ_state = -1;
-            }
-        }
-        else
-        {
-            map->cells[i].occ_state = 0;
-        }
-#endif
+    m_port_odometry_input.interrupt();
+    m_port_odometry_input.close();
+
+    if (m_scan_matcher)
+    {
+        delete m_scan_matcher;
+        m_scan_matcher = nullptr;
+    }
 
-        
+    //not owned by m_filter, which does not access it anymore
+    if (m_amcl_map)
+    {
+        map_free(m_amcl_map);
+        m_amcl_map = nullptr;
     }
 
-    return map;
+    m_port_particles_output.interrupt();
+    m_port_particles_output.close();
+    m_port_latency_output.interrupt();
+    m_port_latency_output.close();
+    m_pose_stream.close();
+    m_map_odom_stream.close();
 }
 
 bool amclLocalizer::open(yarp::os::Searchable& config)
@@ -1156,15 +1395,3 @@ bool amclLocalizer::close()
     rpcPort.close();
     return true;
 }
- 
-void amclLocalizerThread::applyInitialPose()
-{
-    if (m_initial_pose_hyp != nullptr && m_amcl_map != nullptr)
-    {
-        pf_init(m_handler_pf, m_initial_pose_hyp->pf_pose_mean, m_initial_pose_hyp->pf_pose_cov);
-        m_pf_initialized = false;
-
-        delete m_initial_pose_hyp;
-        m_initial_pose_hyp = NULL;
-    }
-}
@@ -21,13 +21,25 @@
 #include <yarp/dev/PolyDriver.h>
 #include <yarp/dev/IRangefinder2D.h>
 #include <yarp/dev/IMap2D.h>
+#include <yarp/dev/PreciselyTimed.h>
 #include <cmath>
+#include <memory>
+#include <random>
+#include <vector>
+#include <thread>
+#include <condition_variable>
 
 #include "./amcl/map/map.h"
 #include "./amcl/pf/pf.h"
-#include "./amcl/sensors/amcl_odom.h"
-#include "./amcl/sensors/amcl_laser.h"
-#include <iCub/ctrl/adaptWinPolyEstimator.h>
+#include "./amcl/sensors/amcl_scan_matcher.h"
+#include "./amcl/amcl_filter.h"
+#include "amclFilterConfig.h"
+#include <localization_device_with_estimated_odometry.h>
+#include <latency_stats.h>
+#include <localization_stream.h>
+#include <map_odom_stream.h>
+#include <map_layers.h>
+#include <seqlock.h>
 
 
 using namespace yarp::os;
@@ -36,19 +48,18 @@ class amclLocalizer;
 class amclLocalizerThread;
 #define DEBUG_DATA 1
 
-// Pose hypothesis
-typedef struct
+//the localization read by the getters, published at each pose update. Fixed size, so that it can be stored in a seqlock_slot.
+//Longer map ids are rejected when the map is set.
+#define AMCL_MAX_MAP_ID_LENGTH 63
+struct amcl_localization_snapshot
 {
-    // Total weight (weights sum to 1)
-    double weight;
-
-    // Mean of pose estimate
-    pf_vector_t pf_pose_mean;
-
-    // Covariance of pose estimate
-    pf_matrix_t pf_pose_cov;
-
-} amcl_hyp_t;
+    char   map_id[AMCL_MAX_MAP_ID_LENGTH + 1];
+    double x;
+    double y;
+    double theta;
+    double cov[9];
+    double timestamp;
+};
 
 class amclLocalizerRPCHandler : public yarp::dev::DeviceResponder
 {
@@ -91,6 +102,18 @@ public:
 
 };
 
+//receives the odometry data and updates the localization at the odometry rate
+class amcl_odometry_handler : public BufferedPort<yarp::dev::OdometryData>
+{
+public:
+    amclLocalizerThread*         m_owner;
+
+    amcl_odometry_handler() : m_owner(nullptr) {}
+
+    using BufferedPort<yarp::dev::OdometryData>::onRead;
+    void onRead(yarp::dev::OdometryData& b) override;
+};
+
 class amclLocalizerThread : public yarp::os::PeriodicThread
 {
 protected:
@@ -98,21 +121,21 @@ protected:
     double                       m_last_statistics_printed;
     yarp::dev::Nav2D::Map2DLocation     m_initial_loc;
     yarp::dev::Nav2D::Map2DLocation     m_odometry_data;
+    double                       m_odometry_timestamp;
     std::mutex                   m_mutex;
     yarp::os::Searchable&        m_cfg;
     std::string                  m_local_name;
 
     //odometry port
     std::string                  m_port_broadcast_odometry_name;
-    yarp::os::BufferedPort<yarp::dev::OdometryData>  m_port_odometry_input;
+    amcl_odometry_handler        m_port_odometry_input;
+    std::mutex                   m_odometry_mutex;
+    yarp::dev::Nav2D::Map2DLocation     m_last_odometry_data;
+    double                       m_last_odometry_timestamp;
     double                       m_last_odometry_data_received;
 
     //velocity estimation
-    yarp::sig::Vector            m_odom_vel;
-    yarp::sig::Vector            m_robot_vel;
-    iCub::ctrl::AWLinEstimator*  m_estimator;
-    yarp::dev::OdometryData      m_current_odom;
-    std::mutex                   m_current_odom_mutex;
+    localization_device_with_estimated_odometry m_odometry_estimator;
 
 #ifdef DEBUG_DATA
     yarp::os::BufferedPort<yarp::dev::OdometryData> m_port_odometry_debug_out;
@@ -127,7 +150,9 @@ protected:
     //laser client
     yarp::dev::PolyDriver                        m_pLas;
     yarp::dev::IRangefinder2D*                   m_iLaser;
+    yarp::dev::IPreciselyTimed*                  m_iLaserTimed;
     std::vector<yarp::dev::LaserMeasurementData> m_laser_measurement_data;
+    std::vector<double>                          m_laser_ranges;  //the ranges of m_laser_measurement_data, used by the filter
     double                                       m_laser_measurement_timestamp;
     double                                       m_min_laser_angle;
     double                                       m_max_laser_angle;
@@ -140,69 +165,81 @@ protected:
     bool m_use_map_topic;
     bool m_first_map_only;
 
-    struct
-    {
-        double m_laser_min_range;
-        double m_laser_max_range;
-        double m_max_beams;
-        int    m_min_particles;
-        int    m_max_particles;
-        double m_pf_err;
-        double m_pf_z;
-        double m_alpha1;
-        double m_alpha2;
-        double m_alpha3;
-        double m_alpha4;
-        double m_alpha5;
-        bool   m_do_beamskip;
-        double m_beam_skip_distance;
-        double m_beam_skip_threshold;
-        double m_beam_skip_error_threshold;
-        double m_z_hit;
-        double m_z_short;
-        double m_z_max;
-        double m_z_rand;
-        double m_sigma_hit;
-        double m_lambda_short;
-        double m_laser_likelihood_max_dist;
-        double m_alpha_slow;
-        double m_alpha_fast;
-        double m_d_thresh;
-        double m_a_thresh;
-    } m_config;
-
-    amcl::laser_model_t m_laser_model_type;
-    amcl::odom_model_t m_odom_model_type;
-    std::string m_odom_frame_id;
-    std::string m_base_frame_id;
-    std::string m_global_frame_id;
-    int m_resample_interval;
-    int m_resample_count;
-    std::vector< bool > m_lasers_update;
-    std::vector< amcl::AMCLLaser* > m_lasers;
-
-    bool m_tf_broadcast;
-
-    amcl::AMCLOdom*  m_handler_odom;
-    amcl::AMCLLaser* m_handler_laser;
-    bool             m_force_update;
-
-    pf_t* m_handler_pf;
-    bool m_pf_initialized;
-    pf_vector_t m_pf_odom_pose;
-    amcl_hyp_t* m_initial_pose_hyp;
-    map_t* m_amcl_map;
-
-    //all the estimated particles
-    std::mutex m_particle_poses_mutex;
-    std::vector<yarp::dev::Nav2D::Map2DLocation> m_particle_poses;
-
-    //the robot most probable position
+    //the particle filter, shared with the off-line tools (amclReplayBenchmark)
+    amcl::AMCLFilterParams       m_filter_params;
+    amcl::AMCLFilter             m_filter;
+    map_t*                       m_amcl_map;
+    std::string                  m_odom_frame_id;
+    std::string                  m_base_frame_id;
+    std::string                  m_global_frame_id;
+    bool                         m_tf_broadcast;
+    double                       m_cpu_budget_last_warning;
+
+    //global localization
+    amcl::AMCLScanMatcher*              m_scan_matcher; //nullptr if the global localization is disabled
+    int                                 m_global_localization_hypotheses;
+
+    //scan to map refinement of the pose of the selected cluster
+    double                              m_refine_time_margin; //time of the period left to the rest of the cycle [s]
+    double                              m_cycle_start_time;
+
+    //filter checkpoints. The samples are copied by run() and written to disk by m_checkpoint_thread.
+    uint64_t                     m_map_hash;
+    std::string                  m_checkpoint_file; //empty = checkpoints disabled
+    double                       m_checkpoint_period;
+    double                       m_last_checkpoint;
+    bool                         m_checkpoint_resume;
+    std::thread                  m_checkpoint_thread;
+    std::mutex                   m_checkpoint_mutex;
+    std::condition_variable      m_checkpoint_cv;
+    bool                         m_checkpoint_pending;
+    bool                         m_checkpoint_stop;
+    std::vector<pf_sample_t>     m_checkpoint_samples;
+    double                       m_checkpoint_w_slow;
+    double                       m_checkpoint_w_fast;
+    pf_vector_t                  m_checkpoint_odom_pose;
+
+    //all the estimated particles, packed as float32 (x[m], y[m], theta[deg], weight) records.
+    //The snapshot is atomically swapped at the end of each filter update, so readers never block the filter thread.
+    //The previous snapshot is reused as back buffer when no reader is still holding it.
+    std::shared_ptr<const std::vector<float>>            m_particle_snapshot;
+    std::shared_ptr<std::vector<float>>                  m_particle_back_buffer;
+    size_t                                               m_particles_max_published; //0 = all the particles
+    yarp::os::BufferedPort<yarp::sig::VectorOf<float>>   m_port_particles_output;
+
+    //the robot most probable position.
+    //m_pf_data is the map->odom correction computed at each filter update, m_localization_data is
+    //the correction composed with the most recent odometry sample, stamped with the odometry source time.
+    //m_localization_data_mutex serializes the writers (filter thread, odometry callback, initialization) and is never
+    //taken by the getters, which read the snapshot in m_output.
     std::mutex                          m_localization_data_mutex;
     yarp::dev::Nav2D::Map2DLocation     m_localization_data;
+    double                              m_localization_timestamp;
     yarp::dev::Nav2D::Map2DLocation     m_pf_data;
+    yarp::sig::Matrix                   m_localization_cov;  //covariance of the most probable cluster (m, rad)
+    seqlock_slot<amcl_localization_snapshot> m_output;
+
+    //initialization requested by setInitialPose(): the pose is published immediately, the filter is reinitialized
+    //by run() at the beginning of the next cycle, so that the caller does not wait for the filter update in progress.
+    //A new pose computed by the update in progress is discarded while the request is pending.
+    std::mutex                          m_init_request_mutex;
+    bool                                m_init_request_pending;
+    yarp::dev::Nav2D::Map2DLocation     m_init_request_loc;
+    yarp::sig::Matrix                   m_init_request_cov;
 
     yarp::sig::Matrix    m_initial_covariance_msg;
+
+    //latency statistics
+    bool                                           m_publish_latency_stats;
+    latency_stats                                  m_odometry_to_pose_latency;     //from the odometry timestamp to the pose update
+    latency_stats                                  m_laser_to_correction_latency;  //from the laser timestamp to the filter correction
+    yarp::os::BufferedPort<yarp::os::Bottle>       m_port_latency_output;
+
+    //streamed localization, published at each pose update (optional)
+    localization_stream_publisher                  m_pose_stream;
+
+    //streamed map->odom correction, published at each filter update (optional)
+    map_odom_stream_publisher                      m_map_odom_stream;
 public:
     amclLocalizerThread(double _period, yarp::os::Searchable& _cfg);
     virtual bool threadInit() override;
@@ -213,12 +250,25 @@ public:
     bool initializeLocalization(const yarp::dev::Nav2D::Map2DLocation& loc);
     bool initializeLocalization(const yarp::dev::Nav2D::Map2DLocation& loc, const yarp::sig::Matrix& cov);
     bool getCurrentLoc(yarp::dev::Nav2D::Map2DLocation& loc);
+    bool getCurrentLoc(yarp::dev::Nav2D::Map2DLocation& loc, double& timestamp);
+    bool getCurrentLoc(yarp::dev::Nav2D::Map2DLocation& loc, yarp::sig::Matrix& cov, double& timestamp);
+    void odometryReceived(const yarp::dev::OdometryData& odom, double timestamp);
     bool getCurrentOdom(yarp::dev::OdometryData& odom);
     bool getPoses(std::vector<yarp::dev::Nav2D::Map2DLocation>& poses);
+    void getLatencyStats(yarp::os::Bottle& b);
+    bool globalLocalization(int max_hypotheses, std::vector<yarp::dev::Nav2D::Map2DLocation>& hypotheses, std::vector<double>& scores);
 
 private:
-    static pf_vector_t uniformPoseGenerator(void* arg);
-    map_t* convertMap(yarp::dev::Nav2D::MapGrid2D& yarp_map);
-    void updateFilter();
-    void applyInitialPose();
+    void publishParticles(const pf_sample_set_t* set);
+    bool updateFilter();
+    void setInitialLoc(const yarp::dev::Nav2D::Map2DLocation& loc);
+    void setCorrection(double map_x, double map_y, double map_theta, const yarp::dev::Nav2D::Map2DLocation& odom);
+    void applyCorrection(const yarp::dev::Nav2D::Map2DLocation& odom, double timestamp);
+    void publishCorrection(double timestamp);
+    void publishLocalization();
+    void reinitializeFilter(const yarp::dev::Nav2D::Map2DLocation& loc, const yarp::sig::Matrix& cov);
+    void updateCpuBudget(double current_time, bool filter_updated);
+    void checkpointFilter();
+    void checkpointWriter();
+    bool restoreFilter();
 };
@@ -22,6 +22,7 @@
 #include <yarp/os/Port.h>
 #include <yarp/os/LogStream.h>
 #include <yarp/os/Node.h>
+#include <yarp/os/Stamp.h>
 #include <yarp/os/Bottle.h>
 #include <yarp/sig/Vector.h>
 #include <yarp/dev/INavigation2D.h>
@@ -80,8 +81,8 @@ bool   gazeboLocalizer::getCurrentPosition(Map2DLocation& loc)
 
 bool  gazeboLocalizer::getEstimatedOdometry(yarp::dev::OdometryData& odom)
 {
-    yError() << " gazeboLocalizer::getEstimatedOdometry is not yet implemented";
-    return false;
+    thread->getCurrentOdom(odom);
+    return true;
 }
 
 bool   gazeboLocalizer::setInitialPose(const Map2DLocation& loc)
@@ -102,6 +103,38 @@ gazeboLocalizerThread::gazeboLocalizerThread(double _period, yarp::os::Searchabl
     m_localization_data.theta = 0;
 
     m_local_name_prefix = "/gazeboLocalizer";
+    m_use_gazebo_stream = false;
+    m_gazebo_stream_timeout = 0.5;
+    m_last_gazebo_pose_time = -1;
+    m_gazebo_pose_timestamp = 0;
+}
+
+bool gazeboLocalizerThread::read_gazebo_pose_rpc(sim_pose_stream::pose_6d& pose)
+{
+    Bottle cmd, ans;
+    cmd.addString("getPose");
+    cmd.addString(m_object_name);
+    if (!m_port_gazebo_comm.write(cmd, ans)) return false;
+    m_gazebo_pose_timestamp = yarp::os::Time::now();
+    return sim_pose_stream::parse_get_pose_reply(ans, pose);
+}
+
+bool gazeboLocalizerThread::read_gazebo_pose_stream(sim_pose_stream::pose_6d& pose)
+{
+    //non blocking: if no new message has been received, the last pose is kept
+    Bottle* b = m_port_gazebo_stream.read(false);
+    if (b == nullptr) return false;
+    if (!sim_pose_stream::find_pose(*b, m_object_name, sim_pose_stream::world_frame, pose))
+    {
+        yWarning() << "gazeboLocalizerThread: the pose stream does not contain" << m_object_name;
+        return false;
+    }
+    m_last_gazebo_pose_time = yarp::os::Time::now();
+    //the envelope contains the time at which the simulator published the pose
+    Stamp stamp;
+    m_port_gazebo_stream.getEnvelope(stamp);
+    m_gazebo_pose_timestamp = stamp.isValid() ? stamp.getTime() : m_last_gazebo_pose_time;
+    return true;
 }
 
 void gazeboLocalizerThread::run()
@@ -113,31 +146,24 @@ void gazeboLocalizerThread::run()
     {
         m_last_statistics_printed = yarp::os::Time::now();
         yDebug() << "gazeboLocalizerThread running with period: " << this->getPeriod();
+        if (m_use_gazebo_stream && current_time - m_last_gazebo_pose_time > m_gazebo_stream_timeout)
+        {
+            yWarning() << "gazeboLocalizerThread: no pose received from" << m_remote_gazebo_stream_port_name;
+        }
     }
 
+    //the simulator is queried before locking the mutex, so that getCurrentLoc() does not wait for its answer
+    sim_pose_stream::pose_6d pose;
+    bool ret = m_use_gazebo_stream ? read_gazebo_pose_stream(pose) : read_gazebo_pose_rpc(pose);
+
     lock_guard<std::mutex> lock(m_mutex);
 
-    //@@@@READ DATA FROM DEVICE here
-    Bottle cmd, ans;
-    cmd.addString("getPose");
-    cmd.addString(m_object_name);
-    bool ret = m_port_gazebo_comm.write(cmd, ans);
     if (ret)
     {
-        if (ans.size() > 0)
-        {
-            //this is the full 6D pose...
-            double x = ans.get(0).asFloat64();
-            double y = ans.get(1).asFloat64();
-            double z = ans.get(2).asFloat64();
-            double ar = ans.get(3).asFloat64(); //radians
-            double ap = ans.get(4).asFloat64(); //radians
-            double ay = ans.get(5).asFloat64(); //radians
-            //...but we are interested only into its projection on the XY map plane
-            m_gazebo_data.x = x;
-            m_gazebo_data.y = y;
-            m_gazebo_data.theta = ay; //radians
-        }
+        //the pose is the full 6D pose, but we are interested only into its projection on the XY map plane
+        m_gazebo_data.x = pose.x;
+        m_gazebo_data.y = pose.y;
+        m_gazebo_data.theta = pose.yaw; //radians
     }
 
     //@@@@COMPUTE LOCALIZATION DATA here
@@ -147,6 +173,15 @@ void gazeboLocalizerThread::run()
     m_localization_data.theta = m_gazebo_data.theta*RAD2DEG + m_map_to_gazebo_transform.theta;
     if      (m_localization_data.theta >= +360) m_localization_data.theta -= 360;
     else if (m_localization_data.theta <= -360) m_localization_data.theta += 360;
+
+    //velocity estimation and publication, only when a new pose has been received.
+    //The pose is stamped with the time it refers to, not with the time of this cycle.
+    if (ret)
+    {
+        m_odometry_estimator.estimate(m_localization_data, m_gazebo_pose_timestamp);
+        //the ground truth has no covariance
+        m_pose_stream.publish(m_localization_data, yarp::sig::Matrix(), m_gazebo_pose_timestamp);
+    }
 }
 
 bool gazeboLocalizerThread::initializeLocalization(const Map2DLocation& loc)
@@ -170,6 +205,12 @@ bool gazeboLocalizerThread::getCurrentLoc(Map2DLocation& loc)
     return true;
 }
 
+bool gazeboLocalizerThread::getCurrentOdom(yarp::dev::OdometryData& odom)
+{
+    odom = m_odometry_estimator.getOdometry();
+    return true;
+}
+
 bool gazeboLocalizerThread::open_gazebo()
 {
     if (m_port_gazebo_comm.open(m_local_gazebo_port_name))
@@ -185,6 +226,21 @@ bool gazeboLocalizerThread::open_gazebo()
     return false;
 }
 
+bool gazeboLocalizerThread::open_gazebo_stream()
+{
+    if (m_port_gazebo_stream.open(m_local_gazebo_stream_port_name))
+    {
+        if (yarp::os::Network::connect(m_remote_gazebo_stream_port_name, m_local_gazebo_stream_port_name, "udp"))
+        {
+            return true;
+        }
+        yError() << "open_gazebo_stream() failed, unable to connect port " << m_remote_gazebo_stream_port_name << " with " << m_local_gazebo_stream_port_name;
+        return false;
+    }
+    yError() << "open_gazebo_stream() failed, unable to open port " << m_local_gazebo_stream_port_name;
+    return false;
+}
+
 bool gazeboLocalizerThread::threadInit()
 {
     //configuration file checking
@@ -209,6 +265,13 @@ bool gazeboLocalizerThread::threadInit()
         return false;
     }
 
+    //optional odometry estimation group
+    if (!m_odometry_estimator.configure(m_cfg.findGroup("ODOMETRY_ESTIMATION")))
+    {
+        yError() << "Invalid [ODOMETRY_ESTIMATION] group";
+        return false;
+    }
+
     //general group
     m_local_name_prefix = "/gazeboLocalizer";
     if (general_group.check("local_name"))
@@ -220,20 +283,38 @@ bool gazeboLocalizerThread::threadInit()
         yInfo() << "local_name parameter not set. Using:" << m_local_name_prefix;
     }
     m_local_gazebo_port_name = m_local_name_prefix + "/gazebo_rpc";
+    m_local_gazebo_stream_port_name = m_local_name_prefix + "/gazebo_pose:i";
 
     if (general_group.check("robot_name")) { m_object_name = general_group.find("robot_name").asString(); }
     else { yError() << "missing robot_name param"; yError() << "I need the name of the object to be localized!"; return false; }
 
-    if (general_group.check("world_interface_port")) { m_remote_gazebo_port_name = general_group.find("world_interface_port").asString(); }
+    //the poses can be streamed by the simulator (pose_stream_port) or requested at each cycle (world_interface_port)
+    if (general_group.check("pose_stream_port"))
+    {
+        m_use_gazebo_stream = true;
+        m_remote_gazebo_stream_port_name = general_group.find("pose_stream_port").asString();
+        m_gazebo_stream_timeout = general_group.check("pose_stream_timeout", Value(0.5)).asDouble();
+    }
+    else if (general_group.check("world_interface_port")) { m_remote_gazebo_port_name = general_group.find("world_interface_port").asString(); }
     else { yError() << "missing world_interface_port param"; return false; }
 
     //starts communication with gazebo
-    if (!open_gazebo())
+    bool gazebo_ok = m_use_gazebo_stream ? open_gazebo_stream() : open_gazebo();
+    if (!gazebo_ok)
     {
         yError() << "Unable to start communication with gazebo!";
         return false;
     }
 
+    //streams the localization to the navigation modules (optional)
+    if (general_group.check("publish_pose_stream") && general_group.find("publish_pose_stream").asBool())
+    {
+        if (!m_pose_stream.open(m_local_name_prefix + "/pose:o"))
+        {
+            return false;
+        }
+    }
+
     //initial location initialization
     Map2DLocation tmp_loc;
     if (initial_group.check("map_transform_x")) { tmp_loc.x = initial_group.find("map_transform_x").asDouble(); }
@@ -254,6 +335,9 @@ void gazeboLocalizerThread::threadRelease()
     yDebug() << "Closing ports";
     m_port_gazebo_comm.interrupt();
     m_port_gazebo_comm.close();
+    m_port_gazebo_stream.interrupt();
+    m_port_gazebo_stream.close();
+    m_pose_stream.close();
 }
 
 bool gazeboLocalizer::open(yarp::os::Searchable& config)
@@ -29,9 +29,13 @@
 #include <yarp/dev/ControlBoardInterfaces.h>
 #include <yarp/os/PeriodicThread.h>
 #include <yarp/os/RpcClient.h>
+#include <yarp/os/BufferedPort.h>
 #include <math.h>
 #include <mutex>
 #include <yarp/dev/IMap2D.h>
+#include <localization_stream.h>
+#include <sim_pose_stream.h>
+#include <localization_device_with_estimated_odometry.h>
 
 #ifndef GAZEBO_LOCALIZER_H
 #define GAZEBO_LOCALIZER_H
@@ -96,10 +100,25 @@ protected:
     std::string                  m_remote_gazebo_port_name;
     std::string                  m_object_name;
     yarp::os::RpcClient          m_port_gazebo_comm;
+    localization_stream_publisher m_pose_stream;
 
+    //streaming mode: the simulator publishes the poses, instead of answering a getPose request at each cycle
+    bool                         m_use_gazebo_stream;
+    std::string                  m_local_gazebo_stream_port_name;
+    std::string                  m_remote_gazebo_stream_port_name;
+    yarp::os::BufferedPort<yarp::os::Bottle> m_port_gazebo_stream;
+    double                       m_gazebo_stream_timeout;
+    double                       m_last_gazebo_pose_time;
+    double                       m_gazebo_pose_timestamp;   //the time of the simulator pose
+
+    //velocity estimation
+    localization_device_with_estimated_odometry m_odometry_estimator;
 
 private:
     bool open_gazebo();
+    bool open_gazebo_stream();
+    bool read_gazebo_pose_rpc(sim_pose_stream::pose_6d& pose);
+    bool read_gazebo_pose_stream(sim_pose_stream::pose_6d& pose);
 
 public:
     gazeboLocalizerThread(double _period, yarp::os::Searchable& _cfg);
@@ -110,6 +129,7 @@ public:
 public:
     bool initializeLocalization(const yarp::dev::Nav2D::Map2DLocation& loc);
     bool getCurrentLoc(yarp::dev::Nav2D::Map2DLocation& loc);
+    bool getCurrentOdom(yarp::dev::OdometryData& odom);
 };
 
 #endif
@@ -134,6 +134,9 @@ void odomLocalizerThread::run()
         m_last_statistics_printed = yarp::os::Time::now();
     }
 
+    //a client connected after the last initialization receives the correction within one second
+    m_map_odom_stream.refresh(1.0);
+
     lock_guard<std::mutex> lock(m_mutex);
     yarp::dev::OdometryData *loc = m_port_odometry_input.read(false);
     if (loc)
@@ -154,6 +157,11 @@ void odomLocalizerThread::run()
 
         if      (m_current_loc.theta >= +360) m_current_loc.theta -= 360;
         else if (m_current_loc.theta <= -360) m_current_loc.theta += 360;
+
+        //the pose has the timestamp of the odometry it comes from
+        yarp::os::Stamp stamp;
+        double timestamp = (m_port_odometry_input.getEnvelope(stamp) && stamp.isValid()) ? stamp.getTime() : current_time;
+        m_pose_stream.publish(m_current_loc, yarp::sig::Matrix(), timestamp);
     }
     if (current_time - m_last_odometry_data_received > 0.1)
     {
@@ -182,6 +190,9 @@ bool odomLocalizerThread::initializeLocalization(const Map2DLocation& loc)
         m_current_loc.y = 0+m_initial_loc.y;
         m_current_loc.theta = 0+m_initial_loc.theta;
     }
+
+    //the localization is the odometry moved to the initial pose, i.e. a constant map->odom correction
+    m_map_odom_stream.publish(map_odom::correction(m_initial_loc, m_initial_odom));
     return true;
 }
 
@@ -253,6 +264,22 @@ bool odomLocalizerThread::threadInit()
         return false;
     }
 
+    //streams the localization to the navigation modules (optional)
+    if (general_group.check("publish_pose_stream") && general_group.find("publish_pose_stream").asBool())
+    {
+        if (!m_pose_stream.open("/" + m_local_name + "/pose:o"))
+        {
+            return false;
+        }
+    }
+    if (general_group.check("publish_map_odom_stream") && general_group.find("publish_map_odom_stream").asBool())
+    {
+        if (!m_map_odom_stream.open("/" + m_local_name + "/map_odom:o"))
+        {
+            return false;
+        }
+    }
+
     //initial location initialization
     Map2DLocation tmp_loc;
     if (initial_group.check("initial_x")) { tmp_loc.x = initial_group.find("initial_x").asDouble(); }
@@ -270,7 +297,8 @@ bool odomLocalizerThread::threadInit()
 
 void odomLocalizerThread::threadRelease()
 {
-
+    m_pose_stream.close();
+    m_map_odom_stream.close();
 }
 
 
@@ -30,6 +30,8 @@
 #include <yarp/dev/OdometryData.h>
 #include <yarp/os/PeriodicThread.h>
 #include <mutex>
+#include <localization_stream.h>
+#include <map_odom_stream.h>
 #include <math.h>
 
 using namespace yarp::os;
@@ -110,6 +112,12 @@ protected:
     yarp::os::BufferedPort<yarp::dev::OdometryData>  m_port_odometry_input;
     double                       m_last_odometry_data_received;
 
+    //streamed localization (optional)
+    localization_stream_publisher m_pose_stream;
+
+    //streamed map->odom correction, which changes only when the localization is initialized (optional)
+    map_odom_stream_publisher    m_map_odom_stream;
+
 public:
     odomLocalizerThread(const double _period, yarp::os::Searchable& _cfg);
     virtual bool threadInit() override;
@@ -139,8 +139,6 @@ rosLocalizerThread::rosLocalizerThread(double _period, yarp::os::Searchable& _cf
       
     m_seq_counter=0;
     m_rosTime = yarp::os::Time::now();
-
-    m_estimator = new iCub::ctrl::AWLinEstimator(3,3);
 }
 
 
@@ -168,16 +166,10 @@ void rosLocalizerThread::publish_map()
     ogrid.info.origin.orientation.y = q.y();
     ogrid.info.origin.orientation.z = q.z();
     ogrid.info.origin.orientation.w = q.w();
-    ogrid.data.resize(m_current_map.width()*m_current_map.height());
-    int index=0;
-    yarp::dev::Nav2D::XYCell cell;
-    for (cell.y=m_current_map.height(); cell.y-- > 0;)
-      for (cell.x=0; cell.x<m_current_map.width(); cell.x++)
-      {
-        m_current_map.getOccupancyData(cell,tmp);
-        ogrid.data[index++]=(int)tmp;
-      }
-      
+    map_layers::grid_layer occupancy;
+    map_layers::get_occupancy(m_current_map, occupancy);
+    map_layers::to_ros_occupancy(occupancy, ogrid.data);
+
     m_rosPublisher_occupancyGrid.write();
 }
 
@@ -206,36 +198,26 @@ void rosLocalizerThread::run()
         m_localization_data.theta = pose[5] * RAD2DEG;
 
         //velocity estimation block
-        if (1)
+        //the transform has no timestamp, the reception time is used instead
+        m_odometry_estimator.estimate(m_localization_data, m_tf_data_received);
+
+    }
+
+    //the map->odom transform changes only when the ROS localization corrects the odometry,
+    //so it is published only when it changes and the clients compose it with the odometry.
+    if (m_map_odom_stream.isOpen())
+    {
+        yarp::sig::Vector map_odom_pose(6, 0.0);
+        if (m_iTf->transformPose(m_frame_odom_id, m_frame_map_id, iv, map_odom_pose))
         {
-            m_current_odom_mutex.lock();
-            //m_current_loc is in the world reference frame.
-            // hence this velocity is estimated in the world reference frame.
-            iCub::ctrl::AWPolyElement el;
-            el.data = yarp::sig::Vector(3);
-            el.data[0]=  m_current_odom.odom_x = m_localization_data.x;
-            el.data[1] = m_current_odom.odom_y = m_localization_data.y;
-            el.data[2] = m_current_odom.odom_theta = m_localization_data.theta;
-            el.time = Time::now();
-            m_odom_vel.resize(3,0.0);
-            m_odom_vel = m_estimator->estimate(el);
-            m_current_odom.odom_vel_x = m_odom_vel[0];
-            m_current_odom.odom_vel_y = m_odom_vel[1];
-            m_current_odom.odom_vel_theta = m_odom_vel[2];
-
-            //this is the velocity in robot reference frame.
-            //NB: for a non-holonomic robot robot_vel[1] ~= 0
-            m_robot_vel.resize(3, 0.0);
-            m_robot_vel[0] = m_odom_vel[0] * cos(m_localization_data.theta * DEG2RAD) - m_odom_vel[0] * sin(m_localization_data.theta * DEG2RAD);
-            m_robot_vel[1] = m_odom_vel[1] * sin(m_localization_data.theta * DEG2RAD) + m_odom_vel[1] * cos(m_localization_data.theta * DEG2RAD);
-            m_robot_vel[2] = m_odom_vel[2];
-            m_current_odom.base_vel_x = m_robot_vel[0];
-            m_current_odom.base_vel_y = m_robot_vel[1];
-            m_current_odom.base_vel_theta = m_robot_vel[2];
-
-            m_current_odom_mutex.unlock();
+            Map2DLocation correction;
+            correction.map_id = m_localization_data.map_id;
+            correction.x = map_odom_pose[0];
+            correction.y = map_odom_pose[1];
+            correction.theta = map_odom_pose[5] * RAD2DEG;
+            m_map_odom_stream.publish(correction);
         }
-
+        m_map_odom_stream.refresh(1.0);
     }
     if (current_time - m_tf_data_received > 0.1)
     {
@@ -362,8 +344,7 @@ bool rosLocalizerThread::getEstimatedPoses(std::vector<yarp::dev::Nav2D::Map2DLo
 
 bool rosLocalizerThread::getCurrentOdom(OdometryData& odom)
 {
-    std::lock_guard<std::mutex> lock(m_current_odom_mutex);
-    odom = m_current_odom;
+    odom = m_odometry_estimator.getOdometry();
     return true;
 }
 
@@ -386,6 +367,13 @@ bool rosLocalizerThread::threadInit()
 
     Bottle ros_group = m_cfg.findGroup("ROS");
 
+    //optional odometry estimation group
+    if (!m_odometry_estimator.configure(m_cfg.findGroup("ODOMETRY_ESTIMATION")))
+    {
+        yError() << "Invalid [ODOMETRY_ESTIMATION] group";
+        return false;
+    }
+
     Bottle tf_group = m_cfg.findGroup("TF");
     if (tf_group.isNull())
     {
@@ -486,6 +474,14 @@ bool rosLocalizerThread::threadInit()
     }
     m_frame_map_id = tf_group.find("map_frame_id").asString();
     m_frame_robot_id = tf_group.find("robot_frame_id").asString();
+    if (tf_group.check("odom_frame_id"))
+    {
+        m_frame_odom_id = tf_group.find("odom_frame_id").asString();
+        if (!m_map_odom_stream.open("/" + m_module_name + "/map_odom:o"))
+        {
+            return false;
+        }
+    }
 
 
     //opens a client to receive localization data from transformServer
@@ -533,6 +529,7 @@ bool rosLocalizerThread::threadInit()
 
 void rosLocalizerThread::threadRelease()
 {
+    m_map_odom_stream.close();
     if (m_ptf.isValid())
     {
         m_ptf.close();
@@ -40,7 +40,9 @@
 #include <mutex>
 #include <math.h>
 
-#include <iCub/ctrl/adaptWinPolyEstimator.h>
+#include <localization_device_with_estimated_odometry.h>
+#include <map_layers.h>
+#include <map_odom_stream.h>
 
 
 using namespace yarp::os;
@@ -128,11 +130,7 @@ protected:
     std::string                  m_local_name;
 
     //velocity estimation
-    yarp::sig::Vector            m_odom_vel;
-    yarp::sig::Vector            m_robot_vel;
-    iCub::ctrl::AWLinEstimator*  m_estimator;
-    yarp::dev::OdometryData      m_current_odom;
-    std::mutex                   m_current_odom_mutex;
+    localization_device_with_estimated_odometry m_odometry_estimator;
 
     //configuration options
     bool                         m_ros_enabled;
@@ -146,6 +144,8 @@ protected:
     double                       m_tf_data_received;
     std::string                  m_frame_robot_id;
     std::string                  m_frame_map_id;
+    std::string                  m_frame_odom_id;     //optional: the map->odom transform is streamed to the clients
+    map_odom_stream_publisher    m_map_odom_stream;
 
     //map interface 
     yarp::dev::PolyDriver        m_pmap;
@@ -20,6 +20,8 @@
 #include <yarp/dev/ControlBoardInterfaces.h>
 #include <mutex>
 #include <math.h>
+#include <cstdio>
+#include <cstring>
 #include "t265Localizer.h"
 
 using namespace yarp::os;
@@ -80,8 +82,7 @@ bool   t265Localizer::getCurrentPosition(Map2DLocation& loc)
 
 bool   t265Localizer::setInitialPose(const Map2DLocation& loc)
 {
-    thread->initializeLocalization(loc);
-    return true;
+    return thread->initializeLocalization(loc);
 }
 
 bool   t265Localizer::getCurrentPosition(Map2DLocation& loc, yarp::sig::Matrix& cov)
@@ -94,8 +95,7 @@ bool   t265Localizer::getCurrentPosition(Map2DLocation& loc, yarp::sig::Matrix&
 bool   t265Localizer::setInitialPose(const Map2DLocation& loc, const yarp::sig::Matrix& cov)
 {
     yWarning() << "Covariance matrix is not currently handled by t265Localizer";
-    thread->initializeLocalization(loc);
-    return true;
+    return thread->initializeLocalization(loc);
 }
 
 bool    t265Localizer::startLocalizationService()
@@ -134,8 +134,13 @@ void odometry_handler::onRead(yarp::dev::OdometryData& b)
 t265LocalizerThread::t265LocalizerThread(double _period, yarp::os::Searchable& _cfg) : PeriodicThread(_period), m_cfg(_cfg)
 {
     m_odometry_handler = nullptr;
+    transformClientInt = nullptr;
     m_last_statistics_printed = -1;
-    m_estimator = new iCub::ctrl::AWLinEstimator(3,3);
+    m_camera_rotation_valid = false;
+    m_replay_start_time = 0;
+    m_replay_first_timestamp = 0;
+    m_replay_next_sample = t265_pose_sample();
+    m_replay_next_sample_valid = false;
 
     m_iMap = 0;
     m_remote_map = "/mapServer";
@@ -145,12 +150,11 @@ t265LocalizerThread::t265LocalizerThread(double _period, yarp::os::Searchable& _
     m_current_loc.x = m_current_device_data.x = m_initial_device_data.x = m_initial_loc.x = 0;
     m_current_loc.y = m_current_device_data.y = m_initial_device_data.y = m_initial_loc.y = 0;
     m_current_loc.theta = m_current_device_data.theta = m_initial_device_data.theta = m_initial_loc.theta = 0;
+    publish_output();
 }
 
 t265LocalizerThread::~t265LocalizerThread()
 {
-    delete m_estimator;
-    m_estimator = nullptr;
 }
 
 void t265LocalizerThread::odometry_update()
@@ -158,98 +162,42 @@ void t265LocalizerThread::odometry_update()
 
 }
 
-void t265LocalizerThread::run()
+bool t265LocalizerThread::cache_camera_rotation()
 {
-   double current_time = yarp::os::Time::now();
-
-    //print some stats every 10 seconds
-    if (current_time - m_last_statistics_printed > 10.0)
+    //the camera-to-base rotation is static, so it is requested only once
+    yarp::sig::Matrix transformMat(4,4);
+    if (transformClientInt == nullptr ||
+        transformClientInt->getTransform(baseFrame, targetFrame, transformMat) == false)
     {
-        m_last_statistics_printed = yarp::os::Time::now();
+        return false;
     }
 
-    lock_guard<std::mutex> lock(m_mutex);
+    // transformMatRot * rotationMatCameraX(-90 deg around x) * rotationMatCameraY(90 deg around y)
+    const double rotationMatCameraXY[3][3] = { { 0, 0, 1 },
+                                               { 1, 0, 0 },
+                                               { 0, -1, 0 } };
+    for (size_t r = 0; r < 3; r++)
+        for (size_t c = 0; c < 3; c++)
+        {
+            m_camera_rotation[r][c] = transformMat(r, 0) * rotationMatCameraXY[0][c] +
+                                      transformMat(r, 1) * rotationMatCameraXY[1][c] +
+                                      transformMat(r, 2) * rotationMatCameraXY[2][c];
+        }
+    m_camera_rotation_valid.store(true, std::memory_order_release);
+    yInfo() << "t265LocalizerThread: camera-to-base rotation acquired from" << baseFrame << "to" << targetFrame;
+    return true;
+}
 
-    //read data from the device
-    // Wait for the next set of frames from the camera
-    auto frames = m_realsense_pipe.wait_for_frames();
-    // Get a frame from the pose stream
-    auto f = frames.first_or_default(RS2_STREAM_POSE);
-    // Cast the frame to pose_frame and get its data
-    rs2_pose pose_data = f.as<rs2::pose_frame>().get_pose_data();
-    
-    yarp::sig::Matrix transformMat(3,3);
-    yarp::sig::Matrix transformMatRot(3,3);
-    yarp::sig::Matrix rotationMatCameraZ(3,3);
-    yarp::sig::Matrix rotationMatCameraY(3,3);
-    yarp::sig::Matrix rotationMatCameraX(3,3);
-    
-    transformMat.zero();
-    transformMatRot.zero();
-    rotationMatCameraZ.zero();
-    rotationMatCameraY.zero();
-    rotationMatCameraX.zero();
-    
-    // 90 deg around z
-    rotationMatCameraZ(0,1) = -1;
-    rotationMatCameraZ(1,0) = 1;
-    rotationMatCameraZ(2,2) = 1;
-
-    // 90 deg around y
-    rotationMatCameraY(0,2) = 1;
-    rotationMatCameraY(2,0) = 1;
-    rotationMatCameraY(1,1) = 1;
-
-    // -90 deg around x
-    rotationMatCameraX(0,0) = 1;
-    rotationMatCameraX(2,1) = -1;
-    rotationMatCameraX(1,2) = 1;
-
-
-    // transformMatRot*-rotationMatCameraX*rotationMatCameraZ*poserotationmatrix
-    if (transformClientInt->getTransform(baseFrame, targetFrame, transformMat))
-    {
-        transformMatRot = transformMat.submatrix(0,2,0,2);
-
-        m_current_device_data.x = -pose_data.translation.z;
-        m_current_device_data.y = -pose_data.translation.x;
-       yarp::math::Quaternion q (pose_data.rotation.x, pose_data.rotation.y, pose_data.rotation.z, pose_data.rotation.w);
-        auto m = q.toRotationMatrix3x3();
-        //m = transformMatRot*rotationMatCameraZ*rotationMatCameraX*m;
-        m = transformMatRot*rotationMatCameraX*rotationMatCameraY*m;   //OK WITH euler
-
-        //auto v = yarp::math::dcm2euler(m);
-        //auto v = yarp::math::dcm2ypr(m);
-        auto v = yarp::math::dcm2euler(m);
-
-        m_current_device_data.theta = v[0] * RAD2DEG;
-
-        //yDebug() << "transformMat" << transformMat.toString();
-        //yDebug() << "Mat" << m.toString();
-        //yDebug() << "A1" << yarp::math::dcm2euler(m).toString() << v[0] *RAD2DEG  << v[1] *RAD2DEG << v[2] *RAD2DEG;
+void t265LocalizerThread::process_pose(const t265_pose_sample& pose_data)
+{
+    lock_guard<std::mutex> lock(m_mutex);
 
-    }
-    else
-    {
-        m_current_device_data.x = -pose_data.translation.z;
-        m_current_device_data.y = -pose_data.translation.x;
-        // yarp::math::Quaternion q (pose_data.rotation.x, pose_data.rotation.y, pose_data.rotation.z, pose_data.rotation.w);
-        yarp::math::Quaternion q (pose_data.rotation.x, pose_data.rotation.y, pose_data.rotation.z, pose_data.rotation.w);
-        //yDebug() << "quat" << q.toString();
-        auto m = q.toRotationMatrix3x3();
-        //yDebug() << "Mat" << m.toString();
-        //auto v = yarp::math::dcm2euler(m);
-        //yDebug() << "A1" << yarp::math::dcm2euler(m).toString() << v[0] *RAD2DEG  << v[1] *RAD2DEG << v[2] *RAD2DEG;
-        auto v = yarp::math::dcm2rpy(m);
-        //yDebug() << "A2" << v.toString() << v[0] *RAD2DEG  << v[1] *RAD2DEG << v[2] *RAD2DEG;
-        // m_current_device_data.theta =  v[1]*RAD2DEG; // no, give only rotation around y between -90 and +90
-        m_current_device_data.theta = atan2(m(0,2),m(0,0))*RAD2DEG;
-    }
-    //yDebug() << "device pose (x y t) before relocation:" << m_current_device_data.x << m_current_device_data.y << m_current_device_data.theta;
+    //the camera-to-base rotation is written once, before the flag
+    const double (*camera_rotation)[3] = m_camera_rotation_valid.load(std::memory_order_acquire) ? m_camera_rotation : nullptr;
+    t265_pose::to_planar(pose_data, camera_rotation, m_current_device_data.x, m_current_device_data.y, m_current_device_data.theta);
 
     //relocate data in robot frame
     relocate_data(m_current_device_data);
-    //yDebug() << "device pose (x y t) after relocation: " << m_current_device_data.x << m_current_device_data.y << m_current_device_data.theta;
 
     //compute data localization
     double c = cos((-m_initial_device_data.theta + m_initial_loc.theta)*DEG2RAD);
@@ -264,38 +212,90 @@ void t265LocalizerThread::run()
     if (m_current_loc.theta >= +360) m_current_loc.theta -= 360;
     else if (m_current_loc.theta <= -360) m_current_loc.theta += 360;
 
-    //velocity estimation block
-    if (1)
-    {
-         //m_current_loc is in the world reference frame.
-        // hence this velocity is estimated in the world reference frame.
-        iCub::ctrl::AWPolyElement el;
-        el.data = yarp::sig::Vector(3);
-        el.data[0]=  m_current_odom.odom_x = m_current_loc.x;
-        el.data[1] = m_current_odom.odom_y = m_current_loc.y;
-        el.data[2] = m_current_odom.odom_theta = m_current_loc.theta;
-        el.time = Time::now();
-        m_odom_vel.resize(3,0.0);
-        m_odom_vel = m_estimator->estimate(el);
-        m_current_odom.odom_vel_x = m_odom_vel[0];
-        m_current_odom.odom_vel_y = m_odom_vel[1];
-        m_current_odom.odom_vel_theta = m_odom_vel[2];
-
-        //this is the velocity in robot reference frame.
-        //NB: for a non-holonomic robot robot_vel[1] ~= 0
-        m_robot_vel.resize(3, 0.0);
-        m_robot_vel[0] = m_odom_vel[0] * cos(m_current_loc.theta * DEG2RAD) - m_odom_vel[0] * sin(m_current_loc.theta * DEG2RAD);
-        m_robot_vel[1] = m_odom_vel[1] * sin(m_current_loc.theta * DEG2RAD) + m_odom_vel[1] * cos(m_current_loc.theta * DEG2RAD);
-        m_robot_vel[2] = m_odom_vel[2];
-        m_current_odom.base_vel_x = m_robot_vel[0];
-        m_current_odom.base_vel_y = m_robot_vel[1];
-        m_current_odom.base_vel_theta = m_robot_vel[2];
+    //velocity estimation block, with the timestamp of the camera
+    m_current_odom = m_odometry_estimator.estimate(m_current_loc, pose_data.timestamp);
+
+    publish_output();
+}
+
+void t265LocalizerThread::publish_output()
+{
+    //publish the new data to the getters
+    t265_localization_snapshot snapshot;
+    strncpy(snapshot.map_id, m_current_loc.map_id.c_str(), sizeof(snapshot.map_id) - 1);
+    snapshot.map_id[sizeof(snapshot.map_id) - 1] = 0;
+    snapshot.x = m_current_loc.x;
+    snapshot.y = m_current_loc.y;
+    snapshot.theta = m_current_loc.theta;
+    snapshot.odom_vel_x = m_current_odom.odom_vel_x;
+    snapshot.odom_vel_y = m_current_odom.odom_vel_y;
+    snapshot.odom_vel_theta = m_current_odom.odom_vel_theta;
+    snapshot.base_vel_x = m_current_odom.base_vel_x;
+    snapshot.base_vel_y = m_current_odom.base_vel_y;
+    snapshot.base_vel_theta = m_current_odom.base_vel_theta;
+    m_output.write(snapshot);
+}
+
+bool t265LocalizerThread::read_replay_sample(t265_pose_sample& pose)
+{
+    //each line of the replay file contains: timestamp[s] tx ty tz qx qy qz qw
+    std::string line;
+    while (std::getline(m_replay_file, line))
+    {
+        if (line.empty() || line[0] == '#') continue;
+        if (t265_pose::parse(line, pose)) return true;
+        yWarning() << "t265LocalizerThread: skipping invalid line in replay file:" << line;
+    }
+    return false;
+}
+
+void t265LocalizerThread::replay_poses()
+{
+    //feeds all the recorded samples which are due, respecting the original timing
+    double elapsed = yarp::os::Time::now() - m_replay_start_time;
+    while (m_replay_next_sample_valid &&
+           m_replay_next_sample.timestamp - m_replay_first_timestamp <= elapsed)
+    {
+        process_pose(m_replay_next_sample);
+        m_replay_next_sample_valid = read_replay_sample(m_replay_next_sample);
+        if (!m_replay_next_sample_valid)
+        {
+            yInfo() << "t265LocalizerThread: replay of" << m_replay_file_name << "completed";
+        }
+    }
+}
+
+void t265LocalizerThread::run()
+{
+   double current_time = yarp::os::Time::now();
+
+    //print some stats every 10 seconds
+    if (current_time - m_last_statistics_printed > 10.0)
+    {
+        m_last_statistics_printed = yarp::os::Time::now();
+    }
+
+    //the poses are received through the realsense callback (or the replay file),
+    //this thread just acquires the static camera-to-base transform, once available.
+    if (m_camera_rotation_valid.load(std::memory_order_acquire) == false)
+    {
+        cache_camera_rotation();
+    }
+
+    if (m_replay_file.is_open())
+    {
+        replay_poses();
     }
 }
 
 bool t265LocalizerThread::initializeLocalization(const Map2DLocation& loc)
 {
     yInfo() << "t265LocalizerThread: Localization init request: (" << loc.map_id << ")";
+    if (loc.map_id.size() > T265_MAX_MAP_ID_LENGTH)
+    {
+        yError() << "Map id" << loc.map_id << "is longer than" << T265_MAX_MAP_ID_LENGTH << "characters";
+        return false;
+    }
     lock_guard<std::mutex> lock(m_mutex);
     m_initial_loc.map_id = loc.map_id;
     m_initial_loc.x = loc.x;
@@ -313,21 +313,35 @@ bool t265LocalizerThread::initializeLocalization(const Map2DLocation& loc)
         m_current_loc.x = 0 + m_initial_loc.x;
         m_current_loc.y = 0 + m_initial_loc.y;
         m_current_loc.theta = 0 + m_initial_loc.theta;
+        publish_output();
     }
     return true;
 }
 
 bool t265LocalizerThread::getCurrentLoc(Map2DLocation& loc)
 {
-    lock_guard<std::mutex> lock(m_mutex);
-    loc = m_current_loc;
+    t265_localization_snapshot snapshot;
+    m_output.read(snapshot);
+    loc.map_id = snapshot.map_id;
+    loc.x = snapshot.x;
+    loc.y = snapshot.y;
+    loc.theta = snapshot.theta;
     return true;
 }
 
 bool t265LocalizerThread::getCurrentOdom(OdometryData& odom)
 {
-    lock_guard<std::mutex> lock(m_mutex);
-    odom = m_current_odom;
+    t265_localization_snapshot snapshot;
+    m_output.read(snapshot);
+    odom.odom_x = snapshot.x;
+    odom.odom_y = snapshot.y;
+    odom.odom_theta = snapshot.theta;
+    odom.odom_vel_x = snapshot.odom_vel_x;
+    odom.odom_vel_y = snapshot.odom_vel_y;
+    odom.odom_vel_theta = snapshot.odom_vel_theta;
+    odom.base_vel_x = snapshot.base_vel_x;
+    odom.base_vel_y = snapshot.base_vel_y;
+    odom.base_vel_theta = snapshot.base_vel_theta;
     return true;
 }
 
@@ -336,11 +350,53 @@ bool t265LocalizerThread::open_device()
 #ifdef SIMULATE_T265
     return true;
 #else
-    //initialize Realsense device
+    if (m_replay_file_name != "")
+    {
+        m_replay_file.open(m_replay_file_name);
+        if (m_replay_file.is_open() == false)
+        {
+            yError() << "Unable to open replay file" << m_replay_file_name;
+            return false;
+        }
+        yInfo() << "t265LocalizerThread: replaying poses from" << m_replay_file_name;
+        m_replay_next_sample = t265_pose_sample();
+        m_replay_next_sample_valid = read_replay_sample(m_replay_next_sample);
+        if (m_replay_next_sample_valid == false)
+        {
+            yError() << "No valid sample in replay file" << m_replay_file_name;
+            m_replay_file.close();
+            return false;
+        }
+        m_replay_first_timestamp = m_replay_next_sample.timestamp;
+        m_replay_start_time = yarp::os::Time::now();
+        return true;
+    }
+
+    //initialize Realsense device. The poses are received asynchronously through the callback,
+    //so that no thread waits for the next frame.
     try
     {
         m_realsense_cfg.enable_stream(RS2_STREAM_POSE, RS2_FORMAT_6DOF);
-        m_realsense_pipe.start(m_realsense_cfg);
+        m_realsense_pipe.start(m_realsense_cfg, [this](const rs2::frame& frame)
+        {
+            rs2::pose_frame f = frame.as<rs2::pose_frame>();
+            if (rs2::frameset fs = frame.as<rs2::frameset>())
+            {
+                f = fs.first_or_default(RS2_STREAM_POSE).as<rs2::pose_frame>();
+            }
+            if (!f) return;
+            rs2_pose pose_data = f.get_pose_data();
+            t265_pose_sample sample;
+            sample.timestamp = f.get_timestamp() / 1000.0;
+            sample.tx = pose_data.translation.x;
+            sample.ty = pose_data.translation.y;
+            sample.tz = pose_data.translation.z;
+            sample.qx = pose_data.rotation.x;
+            sample.qy = pose_data.rotation.y;
+            sample.qz = pose_data.rotation.z;
+            sample.qw = pose_data.rotation.w;
+            process_pose(sample);
+        });
     }
     catch (const rs2::error & e)
     {
@@ -389,11 +445,19 @@ bool t265LocalizerThread::threadInit()
         return false;
     }
 
+    //optional odometry estimation group
+    if (!m_odometry_estimator.configure(m_cfg.findGroup("ODOMETRY_ESTIMATION")))
+    {
+        yError() << "Invalid [ODOMETRY_ESTIMATION] group";
+        return false;
+    }
+
 
 
 
     //general group
     if (general_group.check("local_name")) { m_local_name = general_group.find("local_name").asString(); }
+    if (general_group.check("replay_file")) { m_replay_file_name = general_group.find("replay_file").asString(); }
 
     //initialize the device relocation system on the robot
     movable_localization_device::init(m_cfg);
@@ -415,7 +479,7 @@ bool t265LocalizerThread::threadInit()
     else { yError() << "missing map_transform_t param"; return false; }
     if (initial_group.check("initial_map")) { tmp_loc.map_id = initial_group.find("initial_map").asString(); }
     else { yError() << "missing initial_map param"; return false; }
-    this->initializeLocalization(tmp_loc);
+    if (!this->initializeLocalization(tmp_loc)) return false;
 
     if (general_group.check("local_name"))
     {
@@ -456,8 +520,12 @@ bool t265LocalizerThread::threadInit()
         }
     }
 
-    //the odometry port
-    if (m_odometry_handler==nullptr)
+    //the odometry port (not available when replaying recorded data)
+    if (m_replay_file.is_open())
+    {
+        yInfo() << "Odometry input disabled during replay";
+    }
+    else if (m_odometry_handler==nullptr)
     {
         m_odometry_handler = new odometry_handler(m_realsense_pipe.get_active_profile().get_device());
         m_odometry_handler->useCallback();  // input should go to onRead() callback
@@ -527,11 +595,29 @@ bool t265LocalizerThread::threadInit()
 
     yInfo() << "tranformClient successfully open";
 
+    //if not yet available, the transform is requested again by the periodic thread
+    cache_camera_rotation();
+
     return true;
 }
 
 void t265LocalizerThread::threadRelease()
 {
+   if (m_replay_file.is_open())
+   {
+       m_replay_file.close();
+   }
+   else
+   {
+       try
+       {
+           m_realsense_pipe.stop();
+       }
+       catch (const rs2::error & e)
+       {
+           yWarning() << "RealSense error calling " << e.get_failed_function() << ":" << e.what();
+       }
+   }
    if (m_odometry_handler)
    {
        m_odometry_handler->interrupt();
@@ -21,9 +21,13 @@
 #include <yarp/os/PeriodicThread.h>
 #include <math.h>
 #include <mutex>
+#include <atomic>
+#include <fstream>
 #include <yarp/dev/IMap2D.h>
 #include <movable_localization_device.h>
-#include <iCub/ctrl/adaptWinPolyEstimator.h>
+#include <seqlock.h>
+#include <localization_device_with_estimated_odometry.h>
+#include "t265_pose.h"
 
 #include <yarp/dev/IFrameTransform.h>
 
@@ -93,6 +97,17 @@ public:
     void onRead(yarp::dev::OdometryData& b) override;
 };
 
+//the output of the localizer, published by the pose callback and read wait-free by the getters.
+//Fixed size, so that it can be stored in a seqlock_slot: longer map ids are rejected when the map is set.
+#define T265_MAX_MAP_ID_LENGTH 63
+struct t265_localization_snapshot
+{
+    char   map_id[T265_MAX_MAP_ID_LENGTH + 1];
+    double x, y, theta;
+    double odom_vel_x, odom_vel_y, odom_vel_theta;
+    double base_vel_x, base_vel_y, base_vel_theta;
+};
+
 class t265LocalizerThread : public yarp::os::PeriodicThread,
                                    movable_localization_device
 {
@@ -100,7 +115,7 @@ protected:
     //general
     double                       m_last_statistics_printed;
     yarp::dev::Nav2D::Map2DLocation     m_map_to_device_transform;
-    std::mutex                   m_mutex;
+    std::mutex                   m_mutex;   //serializes the pose callback and the initialization. Never taken by the getters.
     yarp::os::Searchable&        m_cfg;
     std::string                  m_local_name;
     std::string                  m_local_name_prefix;
@@ -111,10 +126,23 @@ protected:
     yarp::dev::OdometryData             m_current_odom;
     yarp::dev::Nav2D::Map2DLocation     m_current_device_data;
 
+    //the output data
+    seqlock_slot<t265_localization_snapshot> m_output;
+
+    //the static camera-to-base rotation, cached once the transform is available
+    double                       m_camera_rotation[3][3];
+    std::atomic<bool>            m_camera_rotation_valid;
+
+    //offline replay of recorded rs2_pose data
+    std::string                  m_replay_file_name;
+    std::ifstream                m_replay_file;
+    double                       m_replay_start_time;
+    double                       m_replay_first_timestamp;
+    t265_pose_sample             m_replay_next_sample;
+    bool                         m_replay_next_sample_valid;
+
     //velocity estimation
-    yarp::sig::Vector            m_odom_vel;
-    yarp::sig::Vector            m_robot_vel;
-    iCub::ctrl::AWLinEstimator*  m_estimator;
+    localization_device_with_estimated_odometry m_odometry_estimator;
 
     //map server
     std::string                  m_remote_map;
@@ -128,6 +156,11 @@ protected:
 
 private:
     bool open_device();
+    bool cache_camera_rotation();
+    void process_pose(const t265_pose_sample& pose);
+    void publish_output();  //must be called with m_mutex locked
+    bool read_replay_sample(t265_pose_sample& pose);
+    void replay_poses();
 
     yarp::dev::PolyDriver transformClientDriver;
     yarp::dev::IFrameTransform *transformClientInt;
@@ -0,0 +1,68 @@
+/*
+ * Copyright (C) 2020 Istituto Italiano di Tecnologia (IIT)
+ * All rights reserved.
+ *
+ * This software may be modified and distributed under the terms of the
+ * GPL-2+ license. See the accompanying LICENSE file for details.
+ */
+
+#include "t265_pose.h"
+#include <cmath>
+#include <cstdio>
+
+#ifndef M_PI
+#define M_PI 3.14159265358979323846
+#endif
+
+#define RAD2DEG 180/M_PI
+
+bool t265_pose::parse(const std::string& line, t265_pose_sample& pose)
+{
+    int n = sscanf(line.c_str(), "%lf %lf %lf %lf %lf %lf %lf %lf", &pose.timestamp,
+                   &pose.tx, &pose.ty, &pose.tz, &pose.qx, &pose.qy, &pose.qz, &pose.qw);
+    return n == 8;
+}
+
+void t265_pose::to_planar(const t265_pose_sample& pose, const double (*camera_rotation)[3], double& x, double& y, double& theta)
+{
+    //quaternion to rotation matrix
+    const double& qx = pose.qx;
+    const double& qy = pose.qy;
+    const double& qz = pose.qz;
+    const double& qw = pose.qw;
+    const double q[3][3] = { { 1 - 2 * (qy*qy + qz*qz), 2 * (qx*qy - qz*qw),     2 * (qx*qz + qy*qw) },
+                             { 2 * (qx*qy + qz*qw),     1 - 2 * (qx*qx + qz*qz), 2 * (qy*qz - qx*qw) },
+                             { 2 * (qx*qz - qy*qw),     2 * (qy*qz + qx*qw),     1 - 2 * (qx*qx + qy*qy) } };
+
+    x = -pose.tz;
+    y = -pose.tx;
+    if (camera_rotation != nullptr)
+    {
+        //m = camera_rotation * q. Only the third column of m, and m(1,0), m(1,1) at the singularities,
+        //are needed by the first euler (ZYZ) angle
+        double m2[3];
+        for (size_t r = 0; r < 3; r++)
+        {
+            m2[r] = camera_rotation[r][0] * q[0][2] +
+                    camera_rotation[r][1] * q[1][2] +
+                    camera_rotation[r][2] * q[2][2];
+        }
+        //same as yarp::math::dcm2euler(m)[0], including its choice at the singularities
+        double phi = 0;
+        if (m2[2] < 1.0 && m2[2] > -1.0)
+        {
+            phi = atan2(m2[1], m2[0]);
+        }
+        else
+        {
+            double m10 = camera_rotation[1][0] * q[0][0] + camera_rotation[1][1] * q[1][0] + camera_rotation[1][2] * q[2][0];
+            double m11 = camera_rotation[1][0] * q[0][1] + camera_rotation[1][1] * q[1][1] + camera_rotation[1][2] * q[2][1];
+            phi = (m2[2] >= 1.0) ? atan2(m10, m11) : -atan2(m10, m11);
+        }
+        theta = phi * RAD2DEG;
+    }
+    else
+    {
+        theta = atan2(q[0][2], q[0][0]) * RAD2DEG;
+    }
+}
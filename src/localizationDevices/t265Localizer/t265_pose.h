@@ -0,0 +1,35 @@
+/*
+ * Copyright (C) 2020 Istituto Italiano di Tecnologia (IIT)
+ * All rights reserved.
+ *
+ * This software may be modified and distributed under the terms of the
+ * GPL-2+ license. See the accompanying LICENSE file for details.
+ */
+
+#ifndef T265_POSE_H
+#define T265_POSE_H
+
+#include <string>
+
+//a pose sample, as provided by the device (rs2_pose) or read from a replay file
+struct t265_pose_sample
+{
+    double timestamp; //s
+    double tx, ty, tz;
+    double qx, qy, qz, qw;
+};
+
+//! The conversion of the rs2_pose samples of the t265 into planar poses.
+//! It does not depend on the middleware nor on librealsense, so that the same code is run by t265Localizer
+//! and by the offline replay check (src/tests/t265Replay).
+namespace t265_pose
+{
+    //parses a line of a replay file: timestamp[s] tx ty tz qx qy qz qw. Returns false if the line is invalid.
+    bool parse(const std::string& line, t265_pose_sample& pose);
+
+    //the planar pose of the camera: x, y [m], theta [deg]. The camera frame (x right, y up, z backward)
+    //is converted with the camera-to-base rotation, if available (camera_rotation != nullptr).
+    void to_planar(const t265_pose_sample& pose, const double (*camera_rotation)[3], double& x, double& y, double& theta);
+}
+
+#endif
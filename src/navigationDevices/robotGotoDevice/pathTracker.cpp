@@ -0,0 +1,176 @@
+/*
+ * Copyright (C) 2020 Istituto Italiano di Tecnologia (IIT)
+ * All rights reserved.
+ *
+ * This software may be modified and distributed under the terms of the
+ * GPL-2+ license. See the accompanying LICENSE file for details.
+ */
+
+#include "pathTracker.h"
+#include <cmath>
+#include <limits>
+
+#ifndef M_PI
+#define M_PI 3.14159265358979323846
+#endif
+
+namespace
+{
+    const double PT_RAD2DEG = 180.0 / M_PI;
+    const double PT_DEG2RAD = M_PI / 180.0;
+}
+
+PathTracker::PathTracker()
+{
+    m_segment = 0;
+    m_lookahead_min = 0.3;
+    m_lookahead_max = 1.0;
+    m_lookahead_time = 1.0;
+    m_rotate_in_place_angle = 60.0;
+}
+
+void PathTracker::setParams(double lookahead_min, double lookahead_max, double lookahead_time, double rotate_in_place_angle)
+{
+    m_lookahead_min = lookahead_min;
+    m_lookahead_max = (lookahead_max > lookahead_min) ? lookahead_max : lookahead_min;
+    m_lookahead_time = lookahead_time;
+    m_rotate_in_place_angle = rotate_in_place_angle;
+}
+
+void PathTracker::setPath(const std::vector<point_t>& path)
+{
+    m_path = path;
+    m_cumulative_length.resize(m_path.size());
+    double length = 0;
+    for (size_t i = 0; i < m_path.size(); i++)
+    {
+        if (i > 0) length += hypot(m_path[i].x - m_path[i - 1].x, m_path[i].y - m_path[i - 1].y);
+        m_cumulative_length[i] = length;
+    }
+    m_segment = 0;
+    if (!m_path.empty()) m_lookahead_point = m_path.front();
+}
+
+void PathTracker::clear()
+{
+    m_path.clear();
+    m_cumulative_length.clear();
+    m_segment = 0;
+}
+
+double PathTracker::project(size_t i, double x, double y, double& s) const
+{
+    const point_t& a = m_path[i];
+    const point_t& b = m_path[i + 1];
+    double sx = b.x - a.x;
+    double sy = b.y - a.y;
+    double len2 = sx * sx + sy * sy;
+    double t = 0;
+    if (len2 > 0)
+    {
+        t = ((x - a.x) * sx + (y - a.y) * sy) / len2;
+        t = (t < 0) ? 0 : ((t > 1) ? 1 : t);
+    }
+    double px = a.x + t * sx;
+    double py = a.y + t * sy;
+    s = m_cumulative_length[i] + t * sqrt(len2);
+    return hypot(x - px, y - py);
+}
+
+PathTracker::point_t PathTracker::pointAt(double s) const
+{
+    for (size_t i = 1; i < m_path.size(); i++)
+    {
+        if (m_cumulative_length[i] >= s)
+        {
+            double len = m_cumulative_length[i] - m_cumulative_length[i - 1];
+            double t = (len > 0) ? (s - m_cumulative_length[i - 1]) / len : 1.0;
+            return point_t(m_path[i - 1].x + t * (m_path[i].x - m_path[i - 1].x),
+                           m_path[i - 1].y + t * (m_path[i].y - m_path[i - 1].y));
+        }
+    }
+    return m_path.back();
+}
+
+bool PathTracker::compute(double x, double y, double theta, double current_speed, double tolerance,
+                          double gain_lin, double gain_ang, double max_lin_speed, double max_ang_speed,
+                          bool holonomic, output_t& out)
+{
+    out.linear_vel = 0;
+    out.linear_dir = 0;
+    out.angular_vel = 0;
+    if (m_path.empty()) return false;
+
+    const point_t& last = m_path.back();
+    double distance_to_last = hypot(last.x - x, last.y - y);
+    if (distance_to_last < tolerance) return false;
+
+    double lookahead = m_lookahead_min + m_lookahead_time * fabs(current_speed);
+    lookahead = (lookahead < m_lookahead_max) ? lookahead : m_lookahead_max;
+
+    //progress along the path: the closest segment among the next ones, the robot never goes back.
+    //Only the segments close to the current one are checked, so that the robot does not skip a loop of the path.
+    double s_robot = m_cumulative_length.back();
+    if (m_path.size() > 1)
+    {
+        double best = std::numeric_limits<double>::max();
+        size_t best_segment = m_segment;
+        double s_window = m_cumulative_length[m_segment + 1] + 2 * m_lookahead_max;
+        for (size_t i = m_segment; i + 1 < m_path.size(); i++)
+        {
+            if (i > m_segment && m_cumulative_length[i] > s_window) break;
+            double s;
+            double d = project(i, x, y, s);
+            if (d < best)
+            {
+                best = d;
+                best_segment = i;
+                s_robot = s;
+            }
+        }
+        m_segment = best_segment;
+    }
+
+    //the distance left, along the path
+    double remaining = m_cumulative_length.back() - s_robot;
+    remaining = (remaining > distance_to_last) ? remaining : distance_to_last;
+
+    m_lookahead_point = (remaining <= lookahead) ? last : pointAt(s_robot + lookahead);
+
+    //the lookahead point in the robot frame
+    double c = cos(theta * PT_DEG2RAD);
+    double s = sin(theta * PT_DEG2RAD);
+    double dx = m_lookahead_point.x - x;
+    double dy = m_lookahead_point.y - y;
+    double xr = c * dx + s * dy;
+    double yr = -s * dx + c * dy;
+    double alpha = atan2(yr, xr) * PT_RAD2DEG;
+
+    double v = gain_lin * remaining;
+    v = (v < max_lin_speed) ? v : max_lin_speed;
+
+    if (holonomic)
+    {
+        out.linear_vel = v;
+        out.linear_dir = alpha;
+        out.angular_vel = gain_ang * alpha;
+    }
+    else if (fabs(alpha) > m_rotate_in_place_angle)
+    {
+        //the path is behind the robot, turn first
+        out.angular_vel = gain_ang * alpha;
+    }
+    else
+    {
+        //curvature of the arc through the lookahead point
+        double d2 = xr * xr + yr * yr;
+        double curvature = (d2 > 0) ? 2 * yr / d2 : 0;
+        if (fabs(curvature) * v * PT_RAD2DEG > max_ang_speed)
+        {
+            v = max_ang_speed * PT_DEG2RAD / fabs(curvature);
+        }
+        out.linear_vel = v;
+        out.angular_vel = v * curvature * PT_RAD2DEG;
+    }
+    return true;
+}
@@ -0,0 +1,98 @@
+/*
+ * Copyright (C) 2020 Istituto Italiano di Tecnologia (IIT)
+ * All rights reserved.
+ *
+ * This software may be modified and distributed under the terms of the
+ * GPL-2+ license. See the accompanying LICENSE file for details.
+ */
+
+#ifndef PATH_TRACKER_H
+#define PATH_TRACKER_H
+
+#include <vector>
+#include <cstddef>
+
+/**
+* Pure pursuit tracking of a path (a polyline of waypoints), used by robotGoto in path following mode.
+* The robot steers towards the point of the path which is a lookahead distance ahead of its projection
+* on the path. The lookahead grows with the speed, so the robot cuts the corners at the intermediate
+* waypoints instead of stopping on them.
+* Units are the ones used by robotGoto: meters, degrees, m/s and deg/s.
+*/
+class PathTracker
+{
+public:
+    struct point_t
+    {
+        double x;
+        double y;
+        point_t() : x(0), y(0) {}
+        point_t(double _x, double _y) : x(_x), y(_y) {}
+    };
+
+    struct output_t
+    {
+        double linear_vel;   //m/s
+        double linear_dir;   //deg, in the robot frame
+        double angular_vel;  //deg/s
+    };
+
+    PathTracker();
+
+    /**
+    * Sets the parameters of the controller.
+    * @param lookahead_min the lookahead distance when the robot is still [m]
+    * @param lookahead_max the maximum lookahead distance [m]
+    * @param lookahead_time the lookahead distance increases by lookahead_time*speed [s]
+    * @param rotate_in_place_angle if the lookahead point is outside this angle, a differential drive robot rotates in place [deg]
+    */
+    void setParams(double lookahead_min, double lookahead_max, double lookahead_time, double rotate_in_place_angle);
+
+    /**
+    * Sets a new path. The tracking starts from the first segment.
+    */
+    void setPath(const std::vector<point_t>& path);
+
+    void clear();
+
+    bool isEmpty() const { return m_path.empty(); }
+
+    /**
+    * Computes the velocity command for the current robot pose.
+    * The linear velocity is proportional (gain_lin) to the distance left along the path, so the robot slows down only
+    * near the end of the path, and it is limited so that the angular velocity does not exceed max_ang_speed.
+    * @return false if the robot is within tolerance from the last point of the path (the output is not computed)
+    */
+    bool compute(double x, double y, double theta, double current_speed, double tolerance,
+                 double gain_lin, double gain_ang, double max_lin_speed, double max_ang_speed,
+                 bool holonomic, output_t& out);
+
+    /**
+    * Returns the last lookahead point computed
+    */
+    point_t getLookaheadPoint() const { return m_lookahead_point; }
+
+    /**
+    * Returns the index of the next waypoint to be passed
+    */
+    size_t getNextWaypointIndex() const { return m_segment + 1; }
+
+    const std::vector<point_t>& getPath() const { return m_path; }
+
+private:
+    std::vector<point_t> m_path;
+    std::vector<double>  m_cumulative_length;  //length of the path from the first point to each point
+    size_t  m_segment;                         //the robot is on the segment [m_segment, m_segment+1]
+    point_t m_lookahead_point;
+
+    double m_lookahead_min;
+    double m_lookahead_max;
+    double m_lookahead_time;
+    double m_rotate_in_place_angle;
+
+    //projection of (x,y) on the segment i, returns the distance and the position along the path
+    double project(size_t i, double x, double y, double& s) const;
+    point_t pointAt(double s) const;
+};
+
+#endif
@@ -79,7 +79,10 @@ GotoThread::GotoThread(double _period, Searchable &_cfg) :
     m_pause_start = 0;
     m_pause_duration = 0;
     m_iLaser = 0;
+    m_iLaserTimed = 0;
     m_iLoc = 0;
+    m_laser_timestamp = 0;
+    m_publish_latency_stats = false;
     m_min_laser_angle = 0;
     m_max_laser_angle = 0;
     m_robot_radius = 0;
@@ -87,6 +90,12 @@ GotoThread::GotoThread(double _period, Searchable &_cfg) :
     m_robot_laser_y = 0;
     m_robot_laser_t = 0;
     m_rosNode = 0;
+    m_path_following = false;
+    m_last_lin_vel = 0;
+    m_path_lookahead_min = 0.3;
+    m_path_lookahead_max = 1.0;
+    m_path_lookahead_time = 1.0;
+    m_path_rotate_in_place_angle = 60.0;
     m_stats_time_curr = yarp::os::Time::now();
     m_stats_time_last = yarp::os::Time::now();
 }
@@ -244,6 +253,11 @@ bool GotoThread::threadInit()
     if (trajectory_group.check("min_ang_speed"))      { m_default_max_ang_speed      = m_min_ang_speed      = trajectory_group.find("min_ang_speed").asDouble(); }
     if (trajectory_group.check("goal_tolerance_lin")) { m_default_goal_tolerance_lin = m_goal_tolerance_lin = trajectory_group.find("goal_tolerance_lin").asDouble(); }
     if (trajectory_group.check("goal_tolerance_ang")) { m_default_goal_tolerance_lin = m_goal_tolerance_ang = trajectory_group.find("goal_tolerance_ang").asDouble(); }
+    if (trajectory_group.check("path_lookahead_min"))    { m_path_lookahead_min = trajectory_group.find("path_lookahead_min").asDouble(); }
+    if (trajectory_group.check("path_lookahead_max"))    { m_path_lookahead_max = trajectory_group.find("path_lookahead_max").asDouble(); }
+    if (trajectory_group.check("path_lookahead_time"))   { m_path_lookahead_time = trajectory_group.find("path_lookahead_time").asDouble(); }
+    if (trajectory_group.check("path_rotate_in_place_angle")) { m_path_rotate_in_place_angle = trajectory_group.find("path_rotate_in_place_angle").asDouble(); }
+    m_path_tracker.setParams(m_path_lookahead_min, m_path_lookahead_max, m_path_lookahead_time, m_path_rotate_in_place_angle);
 
     Bottle geometry_group = m_cfg.findGroup("ROBOT_GEOMETRY");
     if (geometry_group.isNull())
@@ -315,6 +329,11 @@ bool GotoThread::threadInit()
     ret &= m_port_status_output.open((localName + "/status:o").c_str());
     ret &= m_port_speak_output.open((localName + "/speak:o").c_str());
     ret &= m_port_gui_output.open((localName + "/gui:o").c_str());
+    if (general_group.check("publish_latency_stats")) { m_publish_latency_stats = general_group.find("publish_latency_stats").asBool(); }
+    if (m_publish_latency_stats)
+    {
+        ret &= m_port_latency_output.open((localName + "/latency:o").c_str());
+    }
     if (ret == false)
     {
         yError() << "Unable to open module ports";
@@ -339,6 +358,31 @@ bool GotoThread::threadInit()
         return false;
     }
 
+    //subscribe to the localization stream, if available
+    if (localization_group.check("localization_stream_port"))
+    {
+        std::string stream_port = localization_group.find("localization_stream_port").asString();
+        double stream_timeout = localization_group.check("localization_stream_timeout", Value(0.1)).asDouble();
+        if (m_loc_stream.open(localName + "/localization:i", stream_port, stream_timeout) == false)
+        {
+            yError() << "Unable to open the localization stream port";
+            return false;
+        }
+    }
+
+    //subscribe to the map->odom correction and to the odometry, if available
+    if (localization_group.check("map_odom_stream_port") && localization_group.check("odometry_port"))
+    {
+        std::string map_odom_port = localization_group.find("map_odom_stream_port").asString();
+        std::string odometry_port = localization_group.find("odometry_port").asString();
+        double odometry_timeout = localization_group.check("odometry_timeout", Value(0.1)).asDouble();
+        if (m_map_odom_stream.open(localName, map_odom_port, odometry_port, odometry_timeout) == false)
+        {
+            yError() << "Unable to open the map->odom stream ports";
+            return false;
+        }
+    }
+
 
     //open the laser interface
     Bottle laserBottle = m_cfg.findGroup("LASER");
@@ -373,6 +417,11 @@ bool GotoThread::threadInit()
         yError() << "Unable to open laser interface";
         return false;
     }
+    m_pLas.view(m_iLaserTimed);
+    if (m_iLaserTimed == 0)
+    {
+        yWarning() << "Laser timestamps not available, latency statistics disabled";
+    }
 
     if (m_iLaser->getScanLimits(m_min_laser_angle, m_max_laser_angle) == false)
     {
@@ -402,6 +451,8 @@ void GotoThread::threadRelease()
     if (m_ptf.isValid()) m_ptf.close();
     if (m_pLas.isValid()) m_pLas.close();
     if (m_pLoc.isValid()) m_pLoc.close();
+    m_loc_stream.close();
+    m_map_odom_stream.close();
 
     m_port_target_input.interrupt();
     m_port_target_input.close();
@@ -418,6 +469,9 @@ void GotoThread::threadRelease()
     m_port_gui_output.interrupt();
     m_port_gui_output.close();
 
+    m_port_latency_output.interrupt();
+    m_port_latency_output.close();
+
     m_rosGoalInputPort.interrupt();
     m_rosGoalInputPort.close();
 
@@ -439,7 +493,10 @@ void GotoThread::threadRelease()
 
 bool GotoThread::evaluateLocalization()
 {
-    bool ret = m_iLoc->getCurrentPosition(m_localization_data);
+    //the streamed localization does not block, the rpc is the fallback
+    bool ret = m_map_odom_stream.getCurrentPosition(m_localization_data) ||
+               m_loc_stream.getCurrentPosition(m_localization_data) ||
+               m_iLoc->getCurrentPosition(m_localization_data);
     if (ret)
     {
         m_loc_timeout_counter = 0;
@@ -484,6 +541,7 @@ void GotoThread::getLaserData()
     if (ret)
     {
         m_las_timeout_counter = 0;
+        if (m_iLaserTimed) m_laser_timestamp = m_iLaserTimed->getLastInputStamp().getTime();
     }
     else
     {
@@ -676,6 +734,14 @@ void GotoThread::run()
         {
             yInfo() << "robotGoto running, ALL ok, status:" << getStatusAsString(m_status);
         }
+
+        if (m_publish_latency_stats && m_port_latency_output.getOutputCount() > 0)
+        {
+            Bottle& b = m_port_latency_output.prepare();
+            b.clear();
+            getLatencyStats(b);
+            m_port_latency_output.write();
+        }
     }
 
     m_mutex.wait();
@@ -742,8 +808,26 @@ void GotoThread::run()
             m_control_out.linear_vel *= speed_ramp;
             m_control_out.angular_vel*= speed_ramp;
 
+            //path following: track the path until the last waypoint, then align as for a single target
+            PathTracker::output_t path_out;
+            if (m_path_following &&
+                !m_path_tracker.compute(m_localization_data.x, m_localization_data.y, m_localization_data.theta, m_last_lin_vel,
+                                        m_goal_tolerance_lin, m_gain_lin, m_gain_ang, m_max_lin_speed, m_max_ang_speed,
+                                        m_robot_is_holonomic, path_out))
+            {
+                m_path_following = false;
+            }
+
+            if (m_path_following)
+            {
+                //===========================
+                m_control_out.linear_vel = path_out.linear_vel;
+                m_control_out.linear_dir = path_out.linear_dir;
+                m_control_out.angular_vel = path_out.angular_vel;
+                //===========================
+            }
             //you are near to goal
-            if (fabs(distance)< m_goal_tolerance_lin)
+            else if (fabs(distance)< m_goal_tolerance_lin)
             {
                 if (m_target_data.weak_angle)
                 {
@@ -888,6 +972,8 @@ void GotoThread::run()
         }
     }
 
+    m_last_lin_vel = m_control_out.linear_vel;
+
     //send commands
     if (m_publishRosStuff) publishLocalPlan();
     sendOutput();
@@ -904,7 +990,16 @@ void GotoThread::sendOutput()
         m_status == navigation_status_moving)
     {
         Bottle &b = m_port_commands_output.prepare();
-        m_port_commands_output.setEnvelope(stamp);
+        //the commands are stamped with the time of the laser scan used to compute them,
+        //so that the receiver can measure the sensor-to-actuation latency
+        if (m_laser_timestamp > 0)
+        {
+            m_port_commands_output.setEnvelope(yarp::os::Stamp(stamp.getCount(), m_laser_timestamp));
+        }
+        else
+        {
+            m_port_commands_output.setEnvelope(stamp);
+        }
         b.clear();
         b.addInt(2);                    // polar speed commands
         b.addDouble(m_control_out.linear_dir);    // angle in deg
@@ -912,6 +1007,7 @@ void GotoThread::sendOutput()
         b.addDouble(m_control_out.angular_vel);    // ang_vel in deg/s
         b.addDouble(100);
         m_port_commands_output.write();
+        m_laser_to_command_latency.record_since(m_laser_timestamp);
     }
 
     if (m_port_status_output.getOutputCount()>0)
@@ -947,6 +1043,7 @@ void GotoThread::sendOutput()
 void GotoThread::setNewAbsTarget(yarp::sig::Vector target)
 {
     //data is formatted as follows: x, y, angle
+    m_path_following = false;
     m_target_data.weak_angle = false;
     if (target.size() == 2)
     {
@@ -981,6 +1078,37 @@ void GotoThread::setNewAbsTarget(yarp::sig::Vector target)
     publishCurrentGoal();
 }
 
+bool GotoThread::setNewAbsPath(const std::vector<Map2DLocation>& path)
+{
+    if (path.empty())
+    {
+        yError() << "setNewAbsPath: the path is empty";
+        return false;
+    }
+
+    //the final target, with the orientation of the last waypoint
+    yarp::sig::Vector target;
+    target.push_back(path.back().x);
+    target.push_back(path.back().y);
+    if (std::isnan(path.back().theta) == false)
+    {
+        target.push_back(path.back().theta);
+    }
+    setNewAbsTarget(target);
+
+    //the path starts from the current position of the robot
+    std::vector<PathTracker::point_t> points;
+    points.push_back(PathTracker::point_t(m_localization_data.x, m_localization_data.y));
+    for (size_t i = 0; i < path.size(); i++)
+    {
+        points.push_back(PathTracker::point_t(path[i].x, path[i].y));
+    }
+    m_path_tracker.setPath(points);
+    m_path_following = true;
+    yDebug("received new path: %d waypoints", (int)path.size());
+    return true;
+}
+
 bool GotoThread::getCurrentAbsTarget(Map2DLocation& target)
 {
     //TODO: check for target validity
@@ -1014,6 +1142,7 @@ void GotoThread::resetParamsToDefaultValue()
 void GotoThread::setNewRelTarget(yarp::sig::Vector target)
 {
     //target and localization data are formatted as follows: x, y, angle (in degrees)
+    m_path_following = false;
     m_target_data.weak_angle = false;
     if (target.size() == 2)
     {
@@ -1103,6 +1232,7 @@ bool GotoThread::stopMovement()
     bool ret = true;
     yInfo( "asked to stop");
     m_status = navigation_status_idle;
+    m_path_following = false;
     return ret;
 }
 
@@ -1116,6 +1246,11 @@ NavigationStatusEnum GotoThread::getNavigationStatusAsInt()
     return m_status;
 }
 
+void GotoThread::getLatencyStats(Bottle& b)
+{
+    m_laser_to_command_latency.addToBottle("laser_to_command", b);
+}
+
 void GotoThread::printStats()
 {
     yDebug( "* robotGoto thread:");
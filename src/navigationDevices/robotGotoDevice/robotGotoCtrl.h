@@ -39,6 +39,7 @@
 #include <yarp/dev/IFrameTransform.h>
 #include <yarp/os/LogStream.h>
 #include <yarp/dev/ILocalization2D.h>
+#include <yarp/dev/PreciselyTimed.h>
 #include <string>
 #include <math.h>
 #include <mutex>
@@ -46,6 +47,10 @@
 #include <yarp/rosmsg/geometry_msgs/PoseStamped.h>
 #include <yarp/rosmsg/nav_msgs/Path.h>
 #include "obstacles.h"
+#include "pathTracker.h"
+#include <latency_stats.h>
+#include <localization_stream.h>
+#include <map_odom_stream.h>
 
 using namespace std;
 using namespace yarp::os;
@@ -114,12 +119,22 @@ public:
     double m_default_approach_direction;
     double m_default_approach_speed;
 
+    //path following (pure pursuit)
+    double m_path_lookahead_min;          //m
+    double m_path_lookahead_max;          //m
+    double m_path_lookahead_time;         //s
+    double m_path_rotate_in_place_angle;  //deg
+
     //watchdogs for data received from external sources
     double m_stats_time_last;
     double m_stats_time_curr;
     int    m_loc_timeout_counter;
     int    m_las_timeout_counter;
 
+    //latency statistics
+    bool          m_publish_latency_stats;
+    latency_stats m_laser_to_command_latency;   //from the timestamp of the laser scan to the command sent to baseControl
+
     //semaphore
     Semaphore m_mutex;
 
@@ -133,14 +148,21 @@ protected:
     PolyDriver                      m_pLas;
     PolyDriver                      m_pLoc;
     IRangefinder2D*                 m_iLaser;
+    IPreciselyTimed*                m_iLaserTimed;
     Nav2D::ILocalization2D*         m_iLoc;
 
+    //streamed localization (optional), m_iLoc is used when no recent data is available
+    localization_stream_reader      m_loc_stream;
+    //map->odom correction composed locally with the odometry (optional), preferred to m_loc_stream
+    map_odom_stream_reader          m_map_odom_stream;
+
     //yarp ports
     BufferedPort<yarp::sig::Vector> m_port_target_input;
     BufferedPort<yarp::os::Bottle>  m_port_commands_output;
     BufferedPort<yarp::os::Bottle>  m_port_status_output;
     BufferedPort<yarp::os::Bottle>  m_port_speak_output;
     BufferedPort<yarp::os::Bottle>  m_port_gui_output;
+    BufferedPort<yarp::os::Bottle>  m_port_latency_output;
 
     //ROS topics
     yarp::os::Node*                 m_rosNode;
@@ -154,6 +176,7 @@ protected:
     yarp::dev::Nav2D::Map2DLocation    m_localization_data;
     target_type                        m_target_data;
     std::vector<LaserMeasurementData>  m_laser_data;
+    double                             m_laser_timestamp;
     
     Nav2D::NavigationStatusEnum m_status;
     Nav2D::NavigationStatusEnum m_status_after_approach;
@@ -172,6 +195,11 @@ protected:
     //obstacle handler
     obstacles_class*     m_obstacle_handler;
 
+    //path following: the target is the last point of the path, reached tracking the whole path
+    PathTracker          m_path_tracker;
+    bool                 m_path_following;
+    double               m_last_lin_vel;
+
     //internal type definition to store control output
     struct
     {
@@ -211,6 +239,14 @@ public:
     * @param target a three-elements vector containing the robot pose (x,y,theta)
     */
     void          setNewAbsTarget(yarp::sig::Vector target);
+
+    /**
+    * Sets a new path, expressed in the map reference frame. The robot tracks the path without stopping
+    * at the intermediate waypoints, and it aligns with the orientation of the last waypoint (if not nan).
+    * @param path the sequence of waypoints to be followed
+    * @return false if the path is empty
+    */
+    bool          setNewAbsPath(const std::vector<yarp::dev::Nav2D::Map2DLocation>& path);
     
     /**
     * Sets a new target, expressed in the robot reference frame.
@@ -282,6 +318,12 @@ public:
     * Prints stats about the internal status of the module
     */
     void          printStats();
+
+    /**
+    * Appends to a bottle the latency statistics of the module, as (stage count p50 p99 max) lists (ms).
+    * @param b the bottle to be filled
+    */
+    void          getLatencyStats(yarp::os::Bottle& b);
     
 private:
     /**
@@ -127,6 +127,11 @@ bool robotGotoDev  ::parse_respond_string(const yarp::os::Bottle& command, yarp:
         reply.addString("params reset done");
     }
 
+    else if (command.get(0).isString() && command.get(0).asString() == "stats")
+    {
+        gotoThread->getLatencyStats(reply);
+    }
+
     else if (command.get(0).isString() && command.get(0).asString() == "approach")
     {
         double dir    = command.get(1).asDouble();
@@ -136,6 +141,32 @@ bool robotGotoDev  ::parse_respond_string(const yarp::os::Bottle& command, yarp:
         reply.addString("approach command received");
     }
 
+    else if (command.get(0).isString() && command.get(0).asString() == "follow_path")
+    {
+        //follow_path (x y theta) (x y theta) ... the orientation is used only for the last waypoint
+        std::vector<Map2DLocation> path;
+        for (size_t i = 1; i < command.size(); i++)
+        {
+            Bottle* p = command.get(i).asList();
+            if (p == nullptr || p->size() < 2)
+            {
+                path.clear();
+                break;
+            }
+            double theta = (p->size() > 2) ? p->get(2).asDouble() : std::nan("");
+            path.push_back(Map2DLocation("unknown_to_robotGoto", p->get(0).asDouble(), p->get(1).asDouble(), theta));
+        }
+        if (gotoThread->setNewAbsPath(path))
+        {
+            reply.addVocab(VOCAB_OK);
+        }
+        else
+        {
+            yError() << "Invalid follow_path command";
+            reply.addVocab(VOCAB_ERR);
+        }
+    }
+
     else if (command.get(0).asString() == "set")
     {
         if (command.get(1).asString() == "linear_tol")
@@ -324,7 +355,9 @@ bool robotGotoRPCHandler::respond(const yarp::os::Bottle& command, yarp::os::Bot
         reply.addVocab(Vocab::encode("many"));
         reply.addString("Available commands are:");
         reply.addString("approach <angle in degrees> <linear velocity> <time>");
+        reply.addString("follow_path (<x> <y>) ... (<x> <y> <theta>)");
         reply.addString("reset_params");
+        reply.addString("stats");
         reply.addString("set linear_tol <m>");
         reply.addString("set linear_ang <deg>");
         reply.addString("set max_lin_speed <m/s>");
@@ -90,6 +90,8 @@ bool map_utilites::simplifyPath(MapGrid2D& map, Map2DPath input_path, Map2DPath&
 void map_utilites::update_obstacles_map(MapGrid2D& map_to_be_updated, const MapGrid2D& obstacles_map)
 {
     //copies obstacles (and only them) from a source map to a destination map
+    //NB: flag_dst is never written back, so the destination map is not modified. Writing it would keep the temporary
+    //obstacles (e.g. people) in the planner map until it is reloaded: a fix needs a copy reset from the static map.
     if (map_to_be_updated.width() != obstacles_map.width() ||
         map_to_be_updated.height() != map_to_be_updated.height())
     {
@@ -30,6 +30,8 @@
 #include <yarp/dev/IRangefinder2D.h>
 #include <yarp/dev/INavigation2D.h>
 #include <string>
+#include <limits>
+#include <algorithm>
 
 #define _USE_MATH_DEFINES
 #include <math.h>
@@ -51,7 +53,9 @@ using namespace yarp::dev::Nav2D;
 
 bool  PlannerThread::readLocalizationData()
 {
-    bool ret = m_iLoc->getCurrentPosition(m_localization_data);
+    //the streamed localization does not block, the rpc is the fallback
+    bool ret = m_loc_stream.getCurrentPosition(m_localization_data) ||
+               m_iLoc->getCurrentPosition(m_localization_data);
     if (ret)
     {
         m_loc_timeout_counter = 0;
@@ -78,6 +82,15 @@ bool  PlannerThread::readLocalizationData()
         {
             m_temporary_obstacles_map_mutex.lock();
             m_temporary_obstacles_map = m_current_map;
+            //the cells of the new map are cleared by the next readLaserData()
+            m_temporary_obstacles_rect.x0 = 0;
+            m_temporary_obstacles_rect.y0 = 0;
+            m_temporary_obstacles_rect.w = m_temporary_obstacles_map.width();
+            m_temporary_obstacles_rect.h = m_temporary_obstacles_map.height();
+            //the map has been switched: clients must perform a full transfer
+            m_temporary_obstacles_map_version++;
+            m_temporary_obstacles_map_full_version = m_temporary_obstacles_map_version;
+            m_temporary_obstacles_map_changes.clear();
             m_temporary_obstacles_map_mutex.unlock();
             yInfo() << "Map '" << m_localization_data.map_id << "' successfully obtained from server";
             m_current_map.enlargeObstacles(m_robot_radius);
@@ -141,9 +154,11 @@ void  PlannerThread::readLaserData()
 {
     std::vector<LaserMeasurementData> scan;
     bool ret = m_iLaser->getLaserMeasurement(scan);
+    double scan_timestamp = 0;
 
     if (ret)
     {
+        if (m_iLaserTimed) scan_timestamp = m_iLaserTimed->getLastInputStamp().getTime();
         m_laser_map_cells.clear();
         size_t scansize = scan.size();
         for (size_t i = 0; i<scansize; i++)
@@ -174,18 +189,60 @@ void  PlannerThread::readLaserData()
     m_temporary_obstacles_map_mutex.lock();
     MapGrid2D temp_map = m_temporary_obstacles_map;
     m_temporary_obstacles_map_mutex.unlock();
-    for (size_t y=0; y< temp_map.height(); y++)
-        for (size_t x=0; x< temp_map.width(); x++)
-            temp_map.setMapFlag(XYCell(x,y),MapGrid2D::MAP_CELL_FREE);
+    //the changed cells are the old obstacles, which are cleared, and the new ones with their enlargement:
+    //their bounding box is computed here, so that only its cells are compared with the previous map.
+    //The old obstacles are all inside m_temporary_obstacles_rect, so the rest of the map is not scanned.
+    map_grid_delta::cell_rect candidates;
+    size_t clear_x1 = std::min(m_temporary_obstacles_rect.x0 + m_temporary_obstacles_rect.w, temp_map.width());
+    size_t clear_y1 = std::min(m_temporary_obstacles_rect.y0 + m_temporary_obstacles_rect.h, temp_map.height());
+    for (size_t y = m_temporary_obstacles_rect.y0; y < clear_y1; y++)
+        for (size_t x = m_temporary_obstacles_rect.x0; x < clear_x1; x++)
+        {
+            MapGrid2D::map_flags flag;
+            temp_map.getMapFlag(XYCell(x,y), flag);
+            if (flag != MapGrid2D::MAP_CELL_FREE)
+            {
+                temp_map.setMapFlag(XYCell(x,y),MapGrid2D::MAP_CELL_FREE);
+                candidates.include(x,y);
+            }
+        }
+    map_grid_delta::cell_rect obstacles;
     for (size_t i=0; i< m_laser_map_cells.size(); i++)
     {
-        temp_map.setMapFlag(m_laser_map_cells[i],MapGrid2D::MAP_CELL_TEMPORARY_OBSTACLE);
+        if (temp_map.setMapFlag(m_laser_map_cells[i],MapGrid2D::MAP_CELL_TEMPORARY_OBSTACLE))
+        {
+            obstacles.include(m_laser_map_cells[i].x, m_laser_map_cells[i].y);
+        }
     }
     //enlarge the laser scanner data
     temp_map.enlargeObstacles(m_robot_radius);
+    double resolution = 0;
+    temp_map.getResolution(resolution);
+    if (!obstacles.empty() && resolution > 0)
+    {
+        size_t margin = (size_t)std::ceil(m_robot_radius / resolution) + 1;
+        size_t x0 = (obstacles.x0 > margin) ? obstacles.x0 - margin : 0;
+        size_t y0 = (obstacles.y0 > margin) ? obstacles.y0 - margin : 0;
+        obstacles.include(x0, y0);
+        obstacles.include(std::min(obstacles.x0 + obstacles.w - 1 + margin, temp_map.width() - 1),
+                          std::min(obstacles.y0 + obstacles.h - 1 + margin, temp_map.height() - 1));
+    }
+    candidates.include(obstacles);
+    m_temporary_obstacles_rect = obstacles;
+    //m_temporary_obstacles_map is written only by this thread, so it can be compared without locking the mutex
+    map_grid_delta::cell_rect changed = map_grid_delta::changed_region(m_temporary_obstacles_map, temp_map, candidates);
     m_temporary_obstacles_map_mutex.lock();
     m_temporary_obstacles_map = temp_map;
+    m_temporary_obstacles_map_center = m_localization_data;
+    if (!changed.empty())
+    {
+        const size_t max_stored_changes = 100;
+        m_temporary_obstacles_map_version++;
+        m_temporary_obstacles_map_changes.push_back(changed);
+        if (m_temporary_obstacles_map_changes.size() > max_stored_changes) m_temporary_obstacles_map_changes.pop_front();
+    }
     m_temporary_obstacles_map_mutex.unlock();
+    if (ret) m_laser_to_map_latency.record_since(scan_timestamp);
 }
 
 bool prepare_image(IplImage* & image_to_be_prepared, const IplImage* template_image)
@@ -236,6 +293,14 @@ void PlannerThread::run()
         }
         if (err == false)
             yInfo() << "robotPathPlanner running, ALL ok. Navigation status:" << this->getNavigationStatusAsString();
+
+        if (m_publish_latency_stats && m_port_latency_output.getOutputCount() > 0)
+        {
+            Bottle& b = m_port_latency_output.prepare();
+            b.clear();
+            getLatencyStats(b);
+            m_port_latency_output.write();
+        }
     }
     
     m_mutex.wait();
@@ -261,9 +326,15 @@ void PlannerThread::run()
         {
             if (m_inner_status == navigation_status_goal_reached)
             {
-                if (m_current_path_iterator == m_current_path->end())
+                if (m_path_following_active || m_current_path_iterator == m_current_path->end())
                 {
                     //navigation is complete
+                    if (m_path_following_active)
+                    {
+                        m_current_path_iterator = m_current_path->end();
+                        m_remaining_path.clear();
+                        m_path_following_active = false;
+                    }
                     yInfo("goal reached, navigation complete");
                     m_planner_status = navigation_status_goal_reached;
                     m_final_goal_reached_at_timeX = yarp::os::Time::now();
@@ -413,7 +484,10 @@ void PlannerThread::run()
                     cmd.addString("stop");
                     m_port_commands_output.write(cmd, ans);
                     map_utilites::update_obstacles_map(m_current_map, m_augmented_map);
-                    sendWaypoint();
+                    if (!m_path_following_active || !sendPath(true))
+                    {
+                        sendWaypoint();
+                    }
                 }
                 else
                 {
@@ -437,6 +511,10 @@ void PlannerThread::run()
                 yError("PathPlanner in error status");
                 m_planner_status = navigation_status_error;
             }
+            else if (m_inner_status == navigation_status_idle && m_path_following && sendPath(false))
+            {
+                //the inner navigator tracks the whole path, up to the final goal
+            }
             else if (m_inner_status == navigation_status_idle)
             {
                 //send the first waypoint
@@ -648,6 +726,51 @@ bool PlannerThread::getOstaclesMap(MapGrid2D& obstacles_map)
     return true;
 }
 
+void PlannerThread::getOstaclesMapDelta(size_t since_version, bool pack_as_blob, yarp::os::Bottle& reply)
+{
+    std::lock_guard<std::mutex> lock(m_temporary_obstacles_map_mutex);
+    reply.addString(m_temporary_obstacles_map.getMapName());
+    reply.addInt64(m_temporary_obstacles_map_version);
+
+    //the versions stored in m_temporary_obstacles_map_changes are the last changes.size() ones
+    size_t oldest_stored_version = m_temporary_obstacles_map_version - m_temporary_obstacles_map_changes.size() + 1;
+    if (since_version == m_temporary_obstacles_map_version)
+    {
+        reply.addString("none");
+        return;
+    }
+    if (since_version > m_temporary_obstacles_map_version ||
+        since_version < m_temporary_obstacles_map_full_version ||
+        since_version + 1 < oldest_stored_version)
+    {
+        reply.addString("full");
+        return;
+    }
+
+    map_grid_delta::cell_rect region;
+    for (size_t i = since_version + 1 - oldest_stored_version; i < m_temporary_obstacles_map_changes.size(); i++)
+    {
+        region.include(m_temporary_obstacles_map_changes[i]);
+    }
+    reply.addString("delta");
+    map_grid_delta::encode(m_temporary_obstacles_map, region, pack_as_blob, reply.addList());
+}
+
+void PlannerThread::getLatencyStats(yarp::os::Bottle& b)
+{
+    m_laser_to_map_latency.addToBottle("laser_to_obstacles_map", b);
+}
+
+void PlannerThread::getOstaclesMapROI(double radius_m, bool pack_as_blob, yarp::os::Bottle& reply)
+{
+    std::lock_guard<std::mutex> lock(m_temporary_obstacles_map_mutex);
+    reply.addString(m_temporary_obstacles_map.getMapName());
+    reply.addInt64(m_temporary_obstacles_map_version);
+    reply.addString("roi");
+    map_grid_delta::cell_rect region = map_grid_delta::roi_around(m_temporary_obstacles_map, m_temporary_obstacles_map_center.x, m_temporary_obstacles_map_center.y, radius_m);
+    map_grid_delta::encode(m_temporary_obstacles_map, region, pack_as_blob, reply.addList());
+}
+
 void PlannerThread::sendWaypoint()
 {
     size_t path_size = m_current_path->size();
@@ -686,6 +809,85 @@ void PlannerThread::sendWaypoint()
     m_inner_status = inner_status;
 }
 
+bool PlannerThread::setInnerParam(const std::string& param, double value)
+{
+    Bottle cmd, ans;
+    cmd.addString("set");
+    cmd.addString(param);
+    cmd.addDouble(value);
+    return m_port_commands_output.write(cmd, ans);
+}
+
+bool PlannerThread::sendPath(bool from_closest_waypoint)
+{
+    m_path_following_active = false;
+    if (m_current_path->size() == 0)
+    {
+        return false;
+    }
+
+    //when resuming, skip the waypoints already passed
+    Map2DPath::iterator start = m_current_path->begin();
+    if (from_closest_waypoint)
+    {
+        double min_distance = std::numeric_limits<double>::max();
+        for (Map2DPath::iterator it = m_current_path->begin(); it != m_current_path->end(); it++)
+        {
+            double d = sqrt(pow(it->x - m_localization_data.x, 2) + pow(it->y - m_localization_data.y, 2));
+            if (d < min_distance)
+            {
+                min_distance = d;
+                start = it;
+            }
+        }
+    }
+
+    //the tolerance of the final goal, the speed limits of the waypoints
+    bool ret = true;
+    ret &= setInnerParam("linear_tol", m_goal_tolerance_lin);
+    ret &= setInnerParam("angular_tol", m_goal_tolerance_ang);
+    ret &= setInnerParam("max_lin_speed", m_waypoint_max_lin_speed);
+    ret &= setInnerParam("max_ang_speed", m_waypoint_max_ang_speed);
+    ret &= setInnerParam("min_lin_speed", m_waypoint_min_lin_speed);
+    ret &= setInnerParam("min_ang_speed", m_waypoint_min_ang_speed);
+    ret &= setInnerParam("ang_speed_gain", m_goal_ang_gain);
+    ret &= setInnerParam("lin_speed_gain", m_goal_lin_gain);
+
+    //the waypoints followed by the final goal
+    Bottle cmd, ans;
+    cmd.addString("follow_path");
+    for (Map2DPath::iterator it = start; it != m_current_path->end(); it++)
+    {
+        XYCell cell = m_current_map.toXYCell(*it);
+        Bottle& p = cmd.addList();
+        p.addDouble(m_current_map.cell2World(cell).x);
+        p.addDouble(m_current_map.cell2World(cell).y);
+    }
+    Bottle& goal = cmd.addList();
+    goal.addDouble(m_final_goal.x);
+    goal.addDouble(m_final_goal.y);
+    if (std::isnan(m_final_goal.theta) == false)
+    {
+        goal.addDouble(m_final_goal.theta);
+    }
+
+    ret = ret && m_port_commands_output.write(cmd, ans);
+    if (!ret || ans.get(0).asVocab() != VOCAB_OK)
+    {
+        yWarning("the inner navigator does not accept a path, sending one waypoint at a time");
+        return false;
+    }
+    yInfo("sending the whole path (%d waypoints)", (int)(m_current_path->end() - start) + 1);
+    m_current_path_iterator = start;
+    m_path_following_active = true;
+
+    //get inner navigation status
+    NavigationStatusEnum inner_status;
+    m_iInnerNav_ctrl->getNavigationStatus(inner_status);
+    m_inner_status = inner_status;
+    return true;
+}
+
 void PlannerThread::sendFinalGoal()
 {
     if (std::isnan(m_final_goal.theta) == false)
@@ -730,6 +932,7 @@ bool PlannerThread::startPath()
     //clear the memory 
     m_computed_path.clear();
     m_computed_simplified_path.clear();
+    m_path_following_active = false;
     m_planner_status = navigation_status_thinking;
 
     //search for a path
@@ -33,6 +33,7 @@
 #include <yarp/dev/PolyDriver.h>
 #include <yarp/os/RateThread.h>
 #include <yarp/dev/IRangefinder2D.h>
+#include <yarp/dev/PreciselyTimed.h>
 #include <yarp/dev/IMap2D.h>
 #include <yarp/dev/MapGrid2D.h>
 #include <yarp/os/Log.h>
@@ -47,6 +48,9 @@
 #include <yarp/dev/Map2DPath.h>
 #include <yarp/dev/Map2DLocation.h>
 #include "map.h"
+#include <map_grid_delta.h>
+#include <latency_stats.h>
+#include <localization_stream.h>
 
 using namespace std;
 
@@ -80,6 +84,7 @@ class PlannerThread: public yarp::os::PeriodicThread
     double m_waypoint_ang_gain;        //deg/s
     double m_waypoint_lin_gain;        //m/s
     int    m_min_waypoint_distance;    //cells
+    bool   m_path_following;           //the whole path is sent to the inner navigator, instead of one waypoint at a time
 
     //semaphore
     public:
@@ -103,6 +108,11 @@ class PlannerThread: public yarp::os::PeriodicThread
     yarp::dev::Nav2D::MapGrid2D m_current_map;
     yarp::dev::Nav2D::MapGrid2D m_temporary_obstacles_map;
     std::mutex m_temporary_obstacles_map_mutex;
+    size_t     m_temporary_obstacles_map_version;             //incremented every time m_temporary_obstacles_map changes
+    size_t     m_temporary_obstacles_map_full_version;        //the version at which the map was switched (a full transfer is needed)
+    std::deque<map_grid_delta::cell_rect> m_temporary_obstacles_map_changes;  //changed regions of the last versions, the last one is the current version
+    yarp::dev::Nav2D::Map2DLocation       m_temporary_obstacles_map_center;   //the robot pose used to build m_temporary_obstacles_map, read by the rpc thread
+    map_grid_delta::cell_rect             m_temporary_obstacles_rect;         //the bounding box of the non-free cells of m_temporary_obstacles_map, used only by the thread
     yarp::dev::Nav2D::MapGrid2D m_augmented_map;
     bool      m_force_map_reload;
 
@@ -112,12 +122,15 @@ class PlannerThread: public yarp::os::PeriodicThread
     yarp::dev::PolyDriver                                  m_pLas;
     yarp::dev::PolyDriver                                  m_pMap;
     yarp::dev::IRangefinder2D*                             m_iLaser;
+    yarp::dev::IPreciselyTimed*                            m_iLaserTimed;
     yarp::dev::Nav2D::IMap2D*                              m_iMap;
     yarp::dev::Nav2D::ILocalization2D*                     m_iLoc;
+    localization_stream_reader                             m_loc_stream; //optional, m_iLoc is the fallback
 
     //yarp ports
     BufferedPort<yarp::sig::ImageOf<yarp::sig::PixelRgb> > m_port_map_output;
     BufferedPort<yarp::os::Bottle>                         m_port_status_output;
+    BufferedPort<yarp::os::Bottle>                         m_port_latency_output;
     RpcClient                                              m_port_commands_output;
     yarp::dev::PolyDriver                                  m_pInnerNav;
     yarp::dev::Nav2D::INavigation2DControlActions*         m_iInnerNav_ctrl;
@@ -140,6 +153,7 @@ class PlannerThread: public yarp::os::PeriodicThread
     yarp::dev::Nav2D::Map2DPath*                  m_current_path;
     yarp::dev::Nav2D::Map2DPath::iterator         m_current_path_iterator;
     std::deque< yarp::dev::Nav2D::Map2DLocation>  m_remaining_path;
+    bool                                          m_path_following_active;  //the inner navigator is tracking the whole path
 
     //statuses of the internal finite-state machine
     yarp::dev::Nav2D::NavigationStatusEnum   m_planner_status;
@@ -153,6 +167,10 @@ class PlannerThread: public yarp::os::PeriodicThread
     double              m_stats_time_curr;
     double              m_stats_time_last;
 
+    //latency statistics
+    bool                m_publish_latency_stats;
+    latency_stats       m_laser_to_map_latency;  //from the timestamp of the laser scan to the update of the obstacles map
+
     public:
     /**
     * Sets a new target, expressed in the map reference frame.
@@ -266,6 +284,32 @@ class PlannerThread: public yarp::os::PeriodicThread
     bool          getCurrentMap(yarp::dev::Nav2D::MapGrid2D& current_map) const;
     bool          getCurrentPath(yarp::dev::Nav2D::Map2DPath& current_path) const;
     bool          getOstaclesMap(yarp::dev::Nav2D::MapGrid2D& obstacles_map);
+
+    /**
+    * Returns the portion of the obstacles map which changed after a given version, run-length encoded.
+    * The reply contains: map_name version type [x0 y0 w h runs], where type is:
+    * "none" if nothing changed, "delta" if the changed region follows, "full" if the client must request the whole map
+    * (e.g. the map was switched or the requested version is too old).
+    * @param since_version the last version received by the client
+    * @param pack_as_blob if true, the runs are packed into a binary blob
+    * @param reply the bottle to be filled
+    */
+    void          getOstaclesMapDelta(size_t since_version, bool pack_as_blob, yarp::os::Bottle& reply);
+
+    /**
+    * Returns a square region of the obstacles map centered on the robot, run-length encoded.
+    * The reply contains: map_name version "roi" x0 y0 w h runs
+    * @param radius_m the half size of the region [m]
+    * @param pack_as_blob if true, the runs are packed into a binary blob
+    * @param reply the bottle to be filled
+    */
+    void          getOstaclesMapROI(double radius_m, bool pack_as_blob, yarp::os::Bottle& reply);
+
+    /**
+    * Appends to a bottle the latency statistics of the module, as (stage count p50 p99 max) lists (ms).
+    * @param b the bottle to be filled
+    */
+    void          getLatencyStats(yarp::os::Bottle& b);
     bool          setRobotRadius(double size);
     bool          getRobotRadius(double& size);
 
@@ -273,6 +317,8 @@ class PlannerThread: public yarp::os::PeriodicThread
     bool          startPath();
     void          sendWaypoint();
     void          sendFinalGoal();
+    bool          sendPath(bool from_closest_waypoint);
+    bool          setInnerParam(const std::string& param, double value);
     bool          readLocalizationData();
     void          readLaserData();
     bool          readInnerNavigationStatus();
@@ -47,7 +47,9 @@ PlannerThread::PlannerThread(double _period, Searchable &_cfg) :
     m_current_path = &m_computed_simplified_path;
     m_min_waypoint_distance = 0;
     m_iLaser = 0;
+    m_iLaserTimed = 0;
     m_iLoc = 0;
+    m_publish_latency_stats = false;
     m_min_laser_angle = 0;
     m_max_laser_angle = 0;
     m_robot_radius = 0;
@@ -55,11 +57,15 @@ PlannerThread::PlannerThread(double _period, Searchable &_cfg) :
     m_robot_laser_y = 0;
     m_robot_laser_t = 0;
     m_enable_try_recovery=false;
+    m_path_following = false;
+    m_path_following_active = false;
     m_stats_time_curr = yarp::os::Time::now();
     m_stats_time_last = yarp::os::Time::now();
     m_iInnerNav_ctrl = 0;
     m_iInnerNav_target = 0;
     m_force_map_reload = false;
+    m_temporary_obstacles_map_version = 0;
+    m_temporary_obstacles_map_full_version = 0;
     m_navigation_started_at_timeX = 0;
     m_final_goal_reached_at_timeX = 0;
 }
@@ -117,6 +123,7 @@ bool PlannerThread::threadInit()
     else { yError() << "Missing min_waypoint_distance parameter"; return false; }
     if (navigation_group.check("enable_try_recovery")) { m_enable_try_recovery = (navigation_group.find("enable_try_recovery").asInt() == 1); }
     else { yError() << "Missing enable_try_recovery parameter"; return false; }
+    if (navigation_group.check("path_following")) { m_path_following = (navigation_group.find("path_following").asInt() == 1); }
 
     Bottle general_group = m_cfg.findGroup("GENERAL");
     if (general_group.isNull())
@@ -166,6 +173,11 @@ bool PlannerThread::threadInit()
     ret &= m_port_status_output.open((localName + "/plannerStatus:o").c_str());
     ret &= m_port_commands_output.open((localName + "/commands:o").c_str());
     ret &= m_port_map_output.open((localName + "/map:o").c_str());
+    if (general_group.check("publish_latency_stats")) { m_publish_latency_stats = general_group.find("publish_latency_stats").asBool(); }
+    if (m_publish_latency_stats)
+    {
+        ret &= m_port_latency_output.open((localName + "/latency:o").c_str());
+    }
     if (ret == false)
     {
         yError() << "Unable to open module ports";
@@ -189,6 +201,16 @@ bool PlannerThread::threadInit()
             yError() << "Unable to view localization interface";
             return false;
         }
+        if (localization_group.check("localization_stream_port"))
+        {
+            std::string stream_port = localization_group.find("localization_stream_port").asString();
+            double stream_timeout = localization_group.check("localization_stream_timeout", Value(0.1)).asDouble();
+            if (m_loc_stream.open(localName + "/localization:i", stream_port, stream_timeout) == false)
+            {
+                yError() << "Unable to open the localization stream port";
+                return false;
+            }
+        }
     }
 
     //open the map interface
@@ -240,6 +262,11 @@ bool PlannerThread::threadInit()
             yError() << "Unable to open laser interface";
             return false;
         }
+        m_pLas.view(m_iLaserTimed);
+        if (m_iLaserTimed == 0)
+        {
+            yWarning() << "Laser timestamps not available, latency statistics disabled";
+        }
         if (m_iLaser->getScanLimits(m_min_laser_angle, m_max_laser_angle) == false)
         {
             yError() << "Unable to obtain laser scan limits";
@@ -297,12 +324,15 @@ bool PlannerThread::threadInit()
 void PlannerThread :: threadRelease()
 {
     if (m_pLoc.isValid()) m_pLoc.close();
+    m_loc_stream.close();
     if (m_ptf.isValid()) m_ptf.close();
     if (m_pLas.isValid()) m_pLas.close();
     m_port_map_output.interrupt();
     m_port_map_output.close();
     m_port_status_output.interrupt();
     m_port_status_output.close();
+    m_port_latency_output.interrupt();
+    m_port_latency_output.close();
     m_port_commands_output.interrupt();
     m_port_commands_output.close();
 }
@@ -121,6 +121,33 @@ bool robotPathPlannerDev::read(yarp::os::ConnectionReader& connection)
     if (!ok) return false;
     reply.clear();
 
+    //the obstacles map requests are protected by their own mutex and they do not need to wait for the planner thread
+    if (command.get(0).asString() == "get_local_map_delta")
+    {
+        size_t since_version = (size_t)(command.get(1).asInt64());
+        bool pack_as_blob = (command.get(2).asString() == "blob");
+        m_plannerThread->getOstaclesMapDelta(since_version, pack_as_blob, reply);
+        yarp::os::ConnectionWriter *returnToSender = connection.getWriter();
+        if (returnToSender != nullptr) reply.write(*returnToSender);
+        return true;
+    }
+    else if (command.get(0).asString() == "get_local_map_roi")
+    {
+        double radius = command.get(1).asFloat64();
+        bool pack_as_blob = (command.get(2).asString() == "blob");
+        m_plannerThread->getOstaclesMapROI(radius, pack_as_blob, reply);
+        yarp::os::ConnectionWriter *returnToSender = connection.getWriter();
+        if (returnToSender != nullptr) reply.write(*returnToSender);
+        return true;
+    }
+    else if (command.get(0).asString() == "stats")
+    {
+        m_plannerThread->getLatencyStats(reply);
+        yarp::os::ConnectionWriter *returnToSender = connection.getWriter();
+        if (returnToSender != nullptr) reply.write(*returnToSender);
+        return true;
+    }
+
     m_plannerThread->m_mutex.wait();
     if (command.get(0).isString())
     {
@@ -129,6 +156,9 @@ bool robotPathPlannerDev::read(yarp::os::ConnectionReader& connection)
             reply.addVocab(Vocab::encode("many"));
             reply.addString("set_robot_radius <size_m>");
             reply.addString("get_robot_radius");
+            reply.addString("get_local_map_delta <since_version> [blob]");
+            reply.addString("get_local_map_roi <radius_m> [blob]");
+            reply.addString("stats");
         }
         else if (command.get(0).isString())
         {
@@ -0,0 +1,203 @@
+/*
+ * Copyright (C) 2020 Istituto Italiano di Tecnologia (IIT)
+ * All rights reserved.
+ *
+ * This software may be modified and distributed under the terms of the
+ * GPL-2+ license. See the accompanying LICENSE file for details.
+ */
+
+#include "rosCostmap.h"
+#include <yarp/os/LogStream.h>
+#include <yarp/math/Math.h>
+#include <yarp/math/Quaternion.h>
+#include <cstring>
+
+using namespace yarp::os;
+using namespace yarp::dev::Nav2D;
+
+rosCostmap::rosCostmap(const std::string& name, int free_threshold)
+{
+    m_name = name;
+    m_free_threshold = free_threshold;
+    m_valid = false;
+    m_version = 0;
+    m_full_version = 0;
+}
+
+void rosCostmap::addChange(const map_grid_delta::cell_rect& rect, bool full)
+{
+    const size_t max_stored_changes = 100;
+    m_version++;
+    if (full) m_full_version = m_version;
+    m_changes.push_back(rect);
+    if (m_changes.size() > max_stored_changes) m_changes.pop_front();
+}
+
+void rosCostmap::setMap(const MapGrid2D& map)
+{
+    map_layers::grid_layer occupancy;
+    map_layers::grid_layer flags;
+    map_layers::get_occupancy(map, occupancy);
+    map_layers::get_flags(map, flags);
+
+    std::lock_guard<std::mutex> lock(m_mutex);
+    m_map = map;
+    m_occupancy.data.swap(occupancy.data);
+    m_occupancy.resize(occupancy.width, occupancy.height);
+    m_flags.data.swap(flags.data);
+    m_flags.resize(flags.width, flags.height);
+    m_valid = true;
+    map_grid_delta::cell_rect all;
+    all.w = map.width();
+    all.h = map.height();
+    addChange(all, true);
+}
+
+void rosCostmap::applyFull(const yarp::rosmsg::nav_msgs::OccupancyGrid& grid)
+{
+    //the new map is prepared outside the critical section
+    MapGrid2D map;
+    map.setSize_in_cells(grid.info.width, grid.info.height);
+    map.setResolution(grid.info.resolution);
+    map.setMapName(m_name);
+    yarp::math::Quaternion quat(grid.info.origin.orientation.x,
+        grid.info.origin.orientation.y,
+        grid.info.origin.orientation.z,
+        grid.info.origin.orientation.w);
+    yarp::sig::Matrix mat = quat.toRotationMatrix4x4();
+    yarp::sig::Vector vec = yarp::math::dcm2rpy(mat);
+    double orig_angle = vec[2];
+    map.setOrigin(grid.info.origin.position.x, grid.info.origin.position.y, orig_angle);
+
+    map_layers::grid_layer occupancy;
+    map_layers::grid_layer flags;
+    map_layers::from_ros_occupancy(grid.data, grid.info.width, grid.info.height, m_free_threshold, occupancy, flags);
+    map_layers::set_occupancy(map, occupancy);
+    map_layers::set_flags(map, flags);
+
+    std::lock_guard<std::mutex> lock(m_mutex);
+    m_map = map;
+    m_occupancy.data.swap(occupancy.data);
+    m_occupancy.resize(occupancy.width, occupancy.height);
+    m_flags.data.swap(flags.data);
+    m_flags.resize(flags.width, flags.height);
+    m_valid = true;
+    map_grid_delta::cell_rect all;
+    all.w = grid.info.width;
+    all.h = grid.info.height;
+    addChange(all, true);
+}
+
+bool rosCostmap::applyUpdate(const yarp::rosmsg::map_msgs::OccupancyGridUpdate& update)
+{
+    size_t w = update.width;
+    size_t h = update.height;
+    if (update.x < 0 || update.y < 0 || update.data.size() < w * h)
+    {
+        yError() << "rosCostmap" << m_name << ": invalid update";
+        return false;
+    }
+
+    //the patch is converted outside the critical section
+    map_layers::grid_layer occupancy;
+    map_layers::grid_layer flags;
+    map_layers::from_ros_occupancy(update.data, w, h, m_free_threshold, occupancy, flags);
+
+    std::lock_guard<std::mutex> lock(m_mutex);
+    if (!m_valid)
+    {
+        //an update is meaningful only after a full map
+        return false;
+    }
+    if (update.x + w > m_flags.width || update.y + h > m_flags.height)
+    {
+        yError() << "rosCostmap" << m_name << ": the update is outside the map";
+        return false;
+    }
+
+    //the rows of the ROS grid start from the bottom of the map.
+    //MapGrid2D has no row access to its occupancy, so only the changed cells are written, with
+    //setOccupancyData(), which has the same encoding of from_ros_occupancy()
+    size_t x0 = update.x;
+    size_t y0 = m_flags.height - update.y - h;
+    map_grid_delta::cell_rect changed;
+    for (size_t j = 0; j < h; j++)
+    {
+        unsigned char* occ_dst = m_occupancy.row(y0 + j) + x0;
+        const unsigned char* occ_src = occupancy.row(j);
+        if (std::memcmp(occ_dst, occ_src, w) != 0)
+        {
+            const std::int8_t* ros_src = update.data.data() + (h - 1 - j) * w;
+            for (size_t i = 0; i < w; i++)
+            {
+                if (occ_dst[i] != occ_src[i])
+                {
+                    occ_dst[i] = occ_src[i];
+                    double occ = (ros_src[i] < 0 || ros_src[i] > 100) ? -1 : ros_src[i];
+                    m_map.setOccupancyData(XYCell(x0 + i, y0 + j), occ);
+                    //a change of the cost only (same flag) is still a new version of the map
+                    changed.include(x0 + i, y0 + j);
+                }
+            }
+        }
+        unsigned char* flags_dst = m_flags.row(y0 + j) + x0;
+        const unsigned char* flags_src = flags.row(j);
+        for (size_t i = 0; i < w; i++)
+        {
+            if (flags_dst[i] != flags_src[i])
+            {
+                flags_dst[i] = flags_src[i];
+                m_map.setMapFlag(XYCell(x0 + i, y0 + j), (MapGrid2D::map_flags)flags_src[i]);
+                changed.include(x0 + i, y0 + j);
+            }
+        }
+    }
+    if (!changed.empty())
+    {
+        addChange(changed, false);
+    }
+    return true;
+}
+
+bool rosCostmap::getMap(MapGrid2D& map) const
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+    map = m_map;
+    return m_valid;
+}
+
+size_t rosCostmap::getVersion() const
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+    return m_version;
+}
+
+void rosCostmap::getDelta(size_t since_version, bool pack_as_blob, Bottle& reply) const
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+    reply.addString(m_map.getMapName());
+    reply.addInt64(m_version);
+
+    //the versions stored in m_changes are the last m_changes.size() ones
+    size_t oldest_stored_version = m_version - m_changes.size() + 1;
+    if (since_version == m_version)
+    {
+        reply.addString("none");
+        return;
+    }
+    if (since_version > m_version ||
+        since_version < m_full_version ||
+        since_version + 1 < oldest_stored_version)
+    {
+        reply.addString("full");
+        return;
+    }
+
+    map_grid_delta::cell_rect region;
+    for (size_t i = since_version + 1 - oldest_stored_version; i < m_changes.size(); i++)
+    {
+        region.include(m_changes[i]);
+    }
+    reply.addString("delta");
+    map_grid_delta::encode(m_map, region, pack_as_blob, reply.addList());
+}
@@ -0,0 +1,70 @@
+/*
+ * Copyright (C) 2020 Istituto Italiano di Tecnologia (IIT)
+ * All rights reserved.
+ *
+ * This software may be modified and distributed under the terms of the
+ * GPL-2+ license. See the accompanying LICENSE file for details.
+ */
+
+#ifndef ROS_COSTMAP_H
+#define ROS_COSTMAP_H
+
+#include <yarp/os/Bottle.h>
+#include <yarp/dev/MapGrid2D.h>
+#include <yarp/rosmsg/nav_msgs/OccupancyGrid.h>
+#include <yarp/rosmsg/map_msgs/OccupancyGridUpdate.h>
+#include <map_layers.h>
+#include <map_grid_delta.h>
+#include <deque>
+#include <mutex>
+#include <string>
+
+/**
+* A move_base costmap, received from ROS as a full nav_msgs/OccupancyGrid followed by
+* map_msgs/OccupancyGridUpdate patches, and kept in a MapGrid2D.
+* A patch is applied to the layers of the map, and only the changed cells of the patch are written
+* into the MapGrid2D. Each change increments the version of the map, and the changed regions of the
+* last versions are stored, so that a client can request only the region changed since its own version.
+* The methods are thread safe.
+*/
+class rosCostmap
+{
+    std::string                           m_name;
+    mutable std::mutex                    m_mutex;
+    yarp::dev::Nav2D::MapGrid2D           m_map;
+    map_layers::grid_layer                m_occupancy;
+    map_layers::grid_layer                m_flags;
+    int                                   m_free_threshold;
+    bool                                  m_valid;
+
+    size_t                                m_version;        //incremented every time the map changes
+    size_t                                m_full_version;   //the version of the last full map
+    std::deque<map_grid_delta::cell_rect> m_changes;        //changed regions of the last versions, the last one is the current version
+
+public:
+    rosCostmap(const std::string& name, int free_threshold = 70);
+
+    //replaces the whole map with a map not received from ROS (e.g. from the map server)
+    void setMap(const yarp::dev::Nav2D::MapGrid2D& map);
+
+    //replaces the whole map. Costs <= free_threshold are free cells, higher costs are walls, -1 is unknown.
+    void applyFull(const yarp::rosmsg::nav_msgs::OccupancyGrid& grid);
+
+    //applies a patch. Returns false if no full map has been received yet or if the patch is outside the map.
+    bool applyUpdate(const yarp::rosmsg::map_msgs::OccupancyGridUpdate& update);
+
+    bool   getMap(yarp::dev::Nav2D::MapGrid2D& map) const;
+    size_t getVersion() const;
+
+    /**
+    * Returns the portion of the map which changed after a given version, encoded by map_grid_delta::encode().
+    * The reply contains: map_name version type [x0 y0 w h runs], where type is "none", "delta" or "full"
+    * (the client must request the whole map).
+    */
+    void getDelta(size_t since_version, bool pack_as_blob, yarp::os::Bottle& reply) const;
+
+private:
+    void addChange(const map_grid_delta::cell_rect& rect, bool full);
+};
+
+#endif
@@ -38,7 +38,9 @@ using namespace yarp::dev::Nav2D;
 #define DEG2RAD M_PI/180.0
 #endif
 
-rosNavigator::rosNavigator() : PeriodicThread(DEFAULT_THREAD_PERIOD)
+rosNavigator::rosNavigator() : PeriodicThread(DEFAULT_THREAD_PERIOD),
+    m_local_map("local_map"),
+    m_global_map("global_map")
 {
     m_rosNodeName = "/rosNavigator";
     m_rosTopicName_goal = "/move_base/goal";
@@ -52,6 +54,8 @@ rosNavigator::rosNavigator() : PeriodicThread(DEFAULT_THREAD_PERIOD)
     m_remote_localization = "/localizationServer";
     m_rosTopicName_globalOccupancyGrid = "/move_base/global_costmap/costmap";
     m_rosTopicName_localOccupancyGrid = "/move_base/local_costmap/costmap";
+    m_rosTopicName_globalOccupancyGridUpdates = "/move_base/global_costmap/costmap_updates";
+    m_rosTopicName_localOccupancyGridUpdates = "/move_base/local_costmap/costmap_updates";
 //    m_abs_frame_id = "/odom";
     m_abs_frame_id = "/map";
 }
@@ -83,6 +87,18 @@ bool rosNavigator::open(yarp::os::Searchable& config)
         }
         m_rosTopicName_goal = rosGroup.find("ROS_topicName_goal").asString();
         yInfo() << "rosNavigator: ROS_topicName_goal is " << m_rosTopicName_goal;
+
+        //optional: the costmaps published by move_base, and their updates
+        if (rosGroup.check("ROS_topicName_globalCostmap"))
+        {
+            m_rosTopicName_globalOccupancyGrid = rosGroup.find("ROS_topicName_globalCostmap").asString();
+            m_rosTopicName_globalOccupancyGridUpdates = m_rosTopicName_globalOccupancyGrid + "_updates";
+        }
+        if (rosGroup.check("ROS_topicName_localCostmap"))
+        {
+            m_rosTopicName_localOccupancyGrid = rosGroup.find("ROS_topicName_localCostmap").asString();
+            m_rosTopicName_localOccupancyGridUpdates = m_rosTopicName_localOccupancyGrid + "_updates";
+        }
     }
 
     //open ROS stuff
@@ -132,6 +148,27 @@ bool rosNavigator::open(yarp::os::Searchable& config)
         yError() << " opening " << m_rosTopicName_localOccupancyGrid << " Topic, check your yarp-ROS network configuration\n";
         return false;
     }
+    //the updates are patches of the previous map, so none of them can be dropped
+    m_rosSubscriber_globalOccupancyGridUpdates.setStrict();
+    if (!m_rosSubscriber_globalOccupancyGridUpdates.topic(m_rosTopicName_globalOccupancyGridUpdates))
+    {
+        yError() << " opening " << m_rosTopicName_globalOccupancyGridUpdates << " Topic, check your yarp-ROS network configuration\n";
+        return false;
+    }
+    m_rosSubscriber_localOccupancyGridUpdates.setStrict();
+    if (!m_rosSubscriber_localOccupancyGridUpdates.topic(m_rosTopicName_localOccupancyGridUpdates))
+    {
+        yError() << " opening " << m_rosTopicName_localOccupancyGridUpdates << " Topic, check your yarp-ROS network configuration\n";
+        return false;
+    }
+
+    //the rpc port, used to request the changed portion of the costmaps
+    if (!m_rpcPort.open(m_local_name_prefix + "/rpc"))
+    {
+        yError() << "rosNavigator: unable to open" << m_local_name_prefix + "/rpc";
+        return false;
+    }
+    m_rpcPort.setReader(*this);
 
     this->start();
     return true;
@@ -139,6 +176,8 @@ bool rosNavigator::open(yarp::os::Searchable& config)
 
 bool rosNavigator::close()
 {
+    m_rpcPort.interrupt();
+    m_rpcPort.close();
     if (m_rosNode != nullptr)
     {
         m_rosNode->interrupt();
@@ -186,10 +225,13 @@ bool rosNavigator::threadInit()
 
     //get the map
     yInfo() << "Asking for map 'ros_map'...";
-    bool b = m_iMap->get_map("ros_map",m_global_map);
-    m_global_map.crop(-1,-1,-1,-1);
+    MapGrid2D ros_map;
+    bool b = m_iMap->get_map("ros_map",ros_map);
+    ros_map.crop(-1,-1,-1,-1);
     if (b)
     {
+        //replaced by the global costmap as soon as move_base publishes it
+        m_global_map.setMap(ros_map);
         yInfo() << "'ros_map' received";
     }
     else
@@ -236,69 +278,8 @@ void rosNavigator::run()
 
     bool b1 = m_iLoc->getCurrentPosition(m_current_position);
 
-    if (0)
-    {
-        yarp::rosmsg::nav_msgs::OccupancyGrid* ros_global_map = m_rosSubscriber_globalOccupancyGrid.read(false);
-        if (global_map)
-        {
-            m_global_map.setSize_in_cells(ros_global_map->info.width, ros_global_map->info.height);
-            m_global_map.setResolution(ros_global_map->info.resolution);
-            m_global_map.setMapName("global_map");
-            yarp::math::Quaternion quat(ros_global_map->info.origin.orientation.x,
-                ros_global_map->info.origin.orientation.y,
-                ros_global_map->info.origin.orientation.z,
-                ros_global_map->info.origin.orientation.w);
-            yarp::sig::Matrix mat = quat.toRotationMatrix4x4();
-            yarp::sig::Vector vec = yarp::math::dcm2rpy(mat);
-            double orig_angle = vec[2];
-            m_global_map.setOrigin(ros_global_map->info.origin.position.x, ros_global_map->info.origin.position.y, orig_angle);
-            for (size_t y = 0; y < ros_global_map->info.height; y++)
-            {
-                for (size_t x = 0; x < ros_global_map->info.width; x++)
-                {
-                    XYCell cell(x, ros_global_map->info.height - 1 - y);
-                    double occ = ros_global_map->data[x + y * ros_global_map->info.width];
-                    m_global_map.setOccupancyData(cell, occ);
-
-                    if (occ >= 0 && occ <= 70)         m_global_map.setMapFlag(cell, MapGrid2D::MAP_CELL_FREE);
-                    else if (occ >= 71 && occ <= 100)  m_global_map.setMapFlag(cell, MapGrid2D::MAP_CELL_WALL);
-                    else                               m_global_map.setMapFlag(cell, MapGrid2D::MAP_CELL_UNKNOWN);
-                }
-            }
-        }
-    }
-
-    if (0)
-    {
-        yarp::rosmsg::nav_msgs::OccupancyGrid* ros_local_map = m_rosSubscriber_localOccupancyGrid.read(false);
-        if (local_map)
-        {
-            m_local_map.setSize_in_cells(ros_local_map->info.width, ros_local_map->info.height);
-            m_local_map.setResolution(ros_local_map->info.resolution);
-            m_local_map.setMapName("local_map");
-            yarp::math::Quaternion quat(ros_local_map->info.origin.orientation.x,
-                ros_local_map->info.origin.orientation.y,
-                ros_local_map->info.origin.orientation.z,
-                ros_local_map->info.origin.orientation.w);
-            yarp::sig::Matrix mat = quat.toRotationMatrix4x4();
-            yarp::sig::Vector vec = yarp::math::dcm2rpy(mat);
-            double orig_angle = vec[2];
-            m_local_map.setOrigin(ros_local_map->info.origin.position.x, ros_local_map->info.origin.position.y, orig_angle);
-            for (size_t y = 0; y < ros_local_map->info.height; y++)
-            {
-                for (size_t x = 0; x < ros_local_map->info.width; x++)
-                {
-                    XYCell cell(x, ros_local_map->info.height - 1 - y);
-                    double occ = ros_local_map->data[x + y * ros_local_map->info.width];
-                    m_local_map.setOccupancyData(cell, occ);
-
-                    if (occ >= 0 && occ <= 70)         m_local_map.setMapFlag(cell, MapGrid2D::MAP_CELL_FREE);
-                    else if (occ >= 71 && occ <= 100)  m_local_map.setMapFlag(cell, MapGrid2D::MAP_CELL_WALL);
-                    else                               m_local_map.setMapFlag(cell, MapGrid2D::MAP_CELL_UNKNOWN);
-                }
-            }
-        }
-    }
+    updateCostmap(m_global_map, m_rosSubscriber_globalOccupancyGrid, m_rosSubscriber_globalOccupancyGridUpdates);
+    updateCostmap(m_local_map, m_rosSubscriber_localOccupancyGrid, m_rosSubscriber_localOccupancyGridUpdates);
     
     yarp::rosmsg::move_base_msgs::MoveBaseActionFeedback* feedback = m_rosSubscriber_feedback.read(false);
     if (feedback)
@@ -320,6 +301,55 @@ void rosNavigator::run()
     }
 }
 
+void rosNavigator::updateCostmap(rosCostmap& costmap,
+                                 yarp::os::Subscriber<yarp::rosmsg::nav_msgs::OccupancyGrid>& full_subscriber,
+                                 yarp::os::Subscriber<yarp::rosmsg::map_msgs::OccupancyGridUpdate>& updates_subscriber)
+{
+    //move_base publishes the whole costmap only when it is resized (or at a low rate), otherwise only the changed patches
+    yarp::rosmsg::nav_msgs::OccupancyGrid* full = full_subscriber.read(false);
+    if (full)
+    {
+        costmap.applyFull(*full);
+    }
+    yarp::rosmsg::map_msgs::OccupancyGridUpdate* update = nullptr;
+    while ((update = updates_subscriber.read(false)) != nullptr)
+    {
+        costmap.applyUpdate(*update);
+    }
+}
+
+bool rosNavigator::read(yarp::os::ConnectionReader& connection)
+{
+    yarp::os::Bottle command;
+    yarp::os::Bottle reply;
+    bool ok = command.read(connection);
+    if (!ok) return false;
+    reply.clear();
+
+    std::string cmd = command.get(0).asString();
+    if (cmd == "get_global_map_delta" || cmd == "get_local_map_delta")
+    {
+        size_t since_version = (size_t)(command.get(1).asInt64());
+        bool pack_as_blob = (command.get(2).asString() == "blob");
+        rosCostmap& costmap = (cmd == "get_global_map_delta") ? m_global_map : m_local_map;
+        costmap.getDelta(since_version, pack_as_blob, reply);
+    }
+    else if (cmd == "help")
+    {
+        reply.addVocab(Vocab::encode("many"));
+        reply.addString("get_global_map_delta <since_version> [blob]: the portion of the global costmap changed after since_version");
+        reply.addString("get_local_map_delta <since_version> [blob]: the portion of the local costmap changed after since_version");
+    }
+    else
+    {
+        reply.addString("Unknown command.");
+    }
+
+    yarp::os::ConnectionWriter *returnToSender = connection.getWriter();
+    if (returnToSender != nullptr) reply.write(*returnToSender);
+    return true;
+}
+
 bool rosNavigator::gotoTargetByAbsoluteLocation(Map2DLocation loc)
 {
     if (m_navigation_status == navigation_status_idle)
@@ -475,13 +505,11 @@ bool rosNavigator::getCurrentNavigationMap(NavigationMapTypeEnum map_type, MapGr
 {
     if (map_type == NavigationMapTypeEnum::global_map)
     {
-        map = m_global_map;
-        return true;
+        return m_global_map.getMap(map);
     }
     else if (map_type == NavigationMapTypeEnum::local_map)
     {
-        map = m_local_map;
-        return true;
+        return m_local_map.getMap(map);
     }
     yError() << "rosNavigator::getCurrentNavigationMap invalid type";
     return false;
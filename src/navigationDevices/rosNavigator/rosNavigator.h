@@ -20,6 +20,7 @@
 #include <yarp/os/RFModule.h>
 #include <yarp/os/Time.h>
 #include <yarp/os/Port.h>
+#include <yarp/os/PortReader.h>
 #include <yarp/os/PeriodicThread.h>
 #include <yarp/os/Node.h>
 #include <yarp/os/Publisher.h>
@@ -38,6 +39,8 @@
 #include <yarp/rosmsg/actionlib_msgs/GoalID.h>
 #include <yarp/rosmsg/actionlib_msgs/GoalStatusArray.h>
 #include <yarp/rosmsg/nav_msgs/OccupancyGrid.h>
+#include <yarp/rosmsg/map_msgs/OccupancyGridUpdate.h>
+#include "rosCostmap.h"
 #include <math.h>
 
 #ifndef ROS_NAVIGATOR_H
@@ -48,7 +51,8 @@
 class rosNavigator : public yarp::dev::DeviceDriver,
     public yarp::os::PeriodicThread,
     public yarp::dev::Nav2D::INavigation2DTargetActions,
-    public yarp::dev::Nav2D::INavigation2DControlActions
+    public yarp::dev::Nav2D::INavigation2DControlActions,
+    public yarp::os::PortReader
 {
 protected:
     yarp::dev::PolyDriver              m_pLoc;
@@ -62,6 +66,7 @@ protected:
     std::string                             m_remote_localization;
     yarp::dev::Nav2D::Map2DLocation         m_current_position;
     yarp::dev::Nav2D::Map2DLocation         m_current_goal;
+    yarp::os::Port                          m_rpcPort;
 
     double                            m_stats_time_curr;
     double                            m_stats_time_last;
@@ -69,8 +74,8 @@ protected:
     std::string                       m_rosNodeName;
     yarp::os::Node                    *m_rosNode;                  // add a ROS node
     yarp::os::NetUint32               m_rosMsgCounter;             // incremental counter in the ROS message
-    yarp::dev::Nav2D::MapGrid2D       m_local_map;
-    yarp::dev::Nav2D::MapGrid2D       m_global_map;
+    rosCostmap                        m_local_map;
+    rosCostmap                        m_global_map;
 
     std::string                       m_rosTopicName_goal;
     std::string                       m_rosTopicName_cancel;
@@ -80,6 +85,8 @@ protected:
     std::string                       m_rosTopicName_result;
     std::string                       m_rosTopicName_globalOccupancyGrid;
     std::string                       m_rosTopicName_localOccupancyGrid;
+    std::string                       m_rosTopicName_globalOccupancyGridUpdates;
+    std::string                       m_rosTopicName_localOccupancyGridUpdates;
     yarp::os::Publisher<yarp::rosmsg::move_base_msgs::MoveBaseActionGoal> m_rosPublisher_goal;
     yarp::os::Publisher<yarp::rosmsg::actionlib_msgs::GoalID> m_rosPublisher_cancel;
     yarp::os::Publisher<yarp::rosmsg::geometry_msgs::PoseStamped> m_rosPublisher_simple_goal;
@@ -88,6 +95,8 @@ protected:
     yarp::os::Subscriber<yarp::rosmsg::move_base_msgs::MoveBaseActionResult> m_rosSubscriber_result;
     yarp::os::Subscriber<yarp::rosmsg::nav_msgs::OccupancyGrid> m_rosSubscriber_localOccupancyGrid;
     yarp::os::Subscriber<yarp::rosmsg::nav_msgs::OccupancyGrid> m_rosSubscriber_globalOccupancyGrid;
+    yarp::os::Subscriber<yarp::rosmsg::map_msgs::OccupancyGridUpdate> m_rosSubscriber_localOccupancyGridUpdates;
+    yarp::os::Subscriber<yarp::rosmsg::map_msgs::OccupancyGridUpdate> m_rosSubscriber_globalOccupancyGridUpdates;
 
 public:
     rosNavigator();
@@ -99,9 +108,13 @@ public:
     virtual bool threadInit() override;
     virtual void threadRelease() override;
     virtual void run() override;
+    virtual bool read(yarp::os::ConnectionReader& connection) override;
 
 private:
     std::string getStatusAsString(yarp::dev::Nav2D::NavigationStatusEnum status);
+    void        updateCostmap(rosCostmap& costmap,
+                              yarp::os::Subscriber<yarp::rosmsg::nav_msgs::OccupancyGrid>& full_subscriber,
+                              yarp::os::Subscriber<yarp::rosmsg::map_msgs::OccupancyGridUpdate>& updates_subscriber);
 
 public:
     /**
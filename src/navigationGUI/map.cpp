@@ -167,17 +167,22 @@ bool map_utilites::drawLaserScan(IplImage *map, std::vector <XYCell>& laser_scan
 bool map_utilites::drawLaserMap(IplImage *map, const MapGrid2D& laserMap, const CvScalar& color)
 {
     if (map==0) return false;
-    for (size_t y=0; y<laserMap.height(); y++)
-        for (size_t x=0; x<laserMap.width(); x++)
-        {
-            MapGrid2D::map_flags flag;
-            laserMap.getMapFlag(XYCell (x,y), flag);
-            if (flag==MapGrid2D::MAP_CELL_ENLARGED_OBSTACLE ||
-                flag==MapGrid2D::MAP_CELL_TEMPORARY_OBSTACLE)
-            {
-                cvCircle(map, cvPoint(x,y), 0, color);
-            }
-        }
+    if (laserMap.width() > (size_t)map->width || laserMap.height() > (size_t)map->height)
+    {
+        yError() << "drawLaserMap: the map is larger than the image";
+        return false;
+    }
+    //the obstacle cells are painted with a single masked copy
+    map_layers::grid_layer flags;
+    map_layers::get_flags(laserMap, flags);
+    IplImage* mask = cvCreateImage(cvSize(flags.width, flags.height), IPL_DEPTH_8U, 1);
+    map_layers::flags_to_mask(flags, map_layers::flag_bit(MapGrid2D::MAP_CELL_ENLARGED_OBSTACLE) |
+                                     map_layers::flag_bit(MapGrid2D::MAP_CELL_TEMPORARY_OBSTACLE),
+                              255, 0, (unsigned char*)mask->imageData, mask->widthStep);
+    cvSetImageROI(map, cvRect(0, 0, flags.width, flags.height));
+    cvSet(map, color, mask);
+    cvResetImageROI(map);
+    cvReleaseImage(&mask);
     return true;
 }
 
@@ -26,6 +26,7 @@
 #include <yarp/sig/Image.h>
 #include <yarp/sig/ImageDraw.h>
 #include <yarp/dev/MapGrid2D.h>
+#include <map_layers.h>
 #include <string>
 #include <cv.h>
 #include <highgui.h> 
@@ -243,9 +243,76 @@ bool  NavGuiThread::readMaps()
     return ret;
 }
 
+bool  NavGuiThread::readLocalMapDelta()
+{
+    if (m_port_planner_rpc.getOutputCount() == 0)
+    {
+        return m_iNav->getCurrentNavigationMap(yarp::dev::Nav2D::NavigationMapTypeEnum::local_map, m_temporary_obstacles_map);
+    }
+
+    Bottle cmd, ans;
+    cmd.addString("get_local_map_delta");
+    cmd.addInt64(m_temporary_obstacles_map_version);
+    cmd.addString("blob");
+    if (m_port_planner_rpc.write(cmd, ans) == false || ans.size() < 3)
+    {
+        yError() << "Invalid reply to get_local_map_delta";
+        return false;
+    }
+
+    std::string map_name = ans.get(0).asString();
+    long long version = ans.get(1).asInt64();
+    std::string type = ans.get(2).asString();
+    if (type == "none")
+    {
+        return true;
+    }
+    if (type == "delta" && map_name == m_temporary_obstacles_map.getMapName())
+    {
+        const Bottle* data = ans.get(3).asList();
+        if (data && map_grid_delta::decode(*data, m_temporary_obstacles_map))
+        {
+            m_temporary_obstacles_map_version = version;
+            return true;
+        }
+    }
+
+    //full transfer: the map was switched or the delta is not applicable.
+    //The version is the one received before the full map, so changes occurring in the meantime will be received again.
+    bool ret = m_iNav->getCurrentNavigationMap(yarp::dev::Nav2D::NavigationMapTypeEnum::local_map, m_temporary_obstacles_map);
+    m_temporary_obstacles_map_version = ret ? version : -1;
+    return ret;
+}
+
+bool  NavGuiThread::readEstimatedPoses()
+{
+    if (m_port_particles_input.getInputCount() == 0)
+    {
+        return m_iNav->getEstimatedPoses(m_estimated_poses);
+    }
+
+    //only the last received cloud is used
+    yarp::sig::VectorOf<float>* particles = m_port_particles_input.read(false);
+    if (particles == nullptr)
+    {
+        return true;
+    }
+    size_t count = particles->size() / 4;
+    m_estimated_poses.resize(count);
+    for (size_t i = 0; i < count; i++)
+    {
+        m_estimated_poses[i].x = (*particles)[i * 4 + 0];
+        m_estimated_poses[i].y = (*particles)[i * 4 + 1];
+        m_estimated_poses[i].theta = (*particles)[i * 4 + 2];
+    }
+    return true;
+}
+
 bool  NavGuiThread::readLocalizationData()
 {
-    bool ret = m_iLoc->getCurrentPosition(m_localization_data);
+    //the pose composed locally does not block, the rpc is the fallback
+    bool ret = m_map_odom_stream.getCurrentPosition(m_localization_data) ||
+               m_iLoc->getCurrentPosition(m_localization_data);
     if (ret)
     {
         m_loc_timeout_counter = 0;
@@ -600,14 +667,14 @@ void NavGuiThread::run()
     static double last_drawn_enlarged_obstacles = yarp::os::Time::now();
     if (yarp::os::Time::now() - last_drawn_enlarged_obstacles > m_period_draw_enalarged_obstacles)
     {
-        m_iNav->getCurrentNavigationMap(yarp::dev::Nav2D::NavigationMapTypeEnum::local_map, m_temporary_obstacles_map);
+        readLocalMapDelta();
         last_drawn_enlarged_obstacles = yarp::os::Time::now();
     }
 
     static double last_drawn_estimated_poses = yarp::os::Time::now();
     if (yarp::os::Time::now() - last_drawn_estimated_poses > m_period_draw_estimated_poses)
     {
-        m_iNav->getEstimatedPoses(m_estimated_poses);
+        readEstimatedPoses();
         last_drawn_estimated_poses = yarp::os::Time::now();
     }
     
@@ -46,6 +46,8 @@
 #include <yarp/rosmsg/visualization_msgs/MarkerArray.h>
 
 #include "map.h"
+#include <map_grid_delta.h>
+#include <map_odom_stream.h>
 
 using namespace std;
 using namespace yarp::os;
@@ -94,8 +96,15 @@ class NavGuiThread: public yarp::os::PeriodicThread
     std::string                                            m_remote_map;
     std::string                                            m_remote_laser;
     std::string                                            m_remote_navigation;
+    std::string                                            m_remote_planner_rpc;
     BufferedPort<yarp::os::Bottle>                         m_port_yarpview_target_input;
     BufferedPort<yarp::sig::ImageOf<yarp::sig::PixelRgb> > m_port_map_output;
+    RpcClient                                              m_port_planner_rpc;
+    std::string                                            m_remote_particles;
+    BufferedPort<yarp::sig::VectorOf<float> >              m_port_particles_input;
+    std::string                                            m_remote_map_odom;
+    std::string                                            m_remote_odometry;
+    map_odom_stream_reader                                 m_map_odom_stream;
 
     //internal data
     ResourceFinder                         &m_rf;
@@ -109,6 +118,7 @@ class NavGuiThread: public yarp::os::PeriodicThread
     //storage for the environment map
     yarp::dev::Nav2D::MapGrid2D m_current_map;
     yarp::dev::Nav2D::MapGrid2D m_temporary_obstacles_map;
+    long long                   m_temporary_obstacles_map_version; //-1 if unknown
     std::vector<yarp::dev::Nav2D::XYCell>   m_laser_map_cells;
 
     //statuses of the internal finite-state machine
@@ -194,6 +204,8 @@ class NavGuiThread: public yarp::os::PeriodicThread
     void          readTargetFromYarpView();
     bool          readLocalizationData();
     bool          readMaps();
+    bool          readLocalMapDelta();
+    bool          readEstimatedPoses();
     void          readLaserData();
     bool          readWaypointsAndGoal();
     bool          readNavigationStatus(bool& changed);
@@ -50,6 +50,11 @@ NavGuiThread::NavGuiThread(double _period, ResourceFinder &_rf) :
     m_remote_map = "/mapServer";
     m_remote_laser = "/ikart/laser:o";
     m_remote_navigation = "/navigationServer";
+    m_remote_planner_rpc = "/robotPathPlanner/rpc";
+    m_remote_particles = "";
+    m_remote_map_odom = "";
+    m_remote_odometry = "";
+    m_temporary_obstacles_map_version = -1;
 
     const int button_w = 70;
     const int button_h = 20;
@@ -149,17 +154,59 @@ bool NavGuiThread::threadInit()
     {
         m_remote_map = general_group.find("remote_map").asString();
     }
+    if (general_group.check("remote_planner_rpc"))
+    {
+        m_remote_planner_rpc = general_group.find("remote_planner_rpc").asString();
+    }
+    if (general_group.check("remote_particles"))
+    {
+        m_remote_particles = general_group.find("remote_particles").asString();
+    }
+    if (general_group.check("remote_map_odom"))
+    {
+        m_remote_map_odom = general_group.find("remote_map_odom").asString();
+    }
+    if (general_group.check("remote_odometry"))
+    {
+        m_remote_odometry = general_group.find("remote_odometry").asString();
+    }
     if (laser_group.check("remote_laser"))
     {
         m_remote_laser = laser_group.find("remote_laser").asString();
     }
     ret &= m_port_map_output.open((m_local_name_prefix + "/map:o").c_str());
     ret &= m_port_yarpview_target_input.open((m_local_name_prefix + "/yarpviewTarget:i").c_str());
+    ret &= m_port_planner_rpc.open((m_local_name_prefix + "/plannerRpc").c_str());
     if (ret == false)
     {
         yError() << "Unable to open module ports";
         return false;
     }
+    //the planner rpc port is used to receive only the changed portion of the obstacles map.
+    //If not available, the whole map is periodically requested through the navigation interface.
+    if (m_remote_planner_rpc != "" && 
+        yarp::os::Network::connect(m_port_planner_rpc.getName(), m_remote_planner_rpc) == false)
+    {
+        yWarning() << "Unable to connect to" << m_remote_planner_rpc << ", the full obstacles map will be periodically requested";
+    }
+    //the particles stream (packed x,y,theta,weight float records) is used, if available, instead of getEstimatedPoses()
+    if (m_remote_particles != "")
+    {
+        std::string particles_portname = m_local_name_prefix + "/particles:i";
+        if (m_port_particles_input.open(particles_portname.c_str()) == false ||
+            yarp::os::Network::connect(m_remote_particles, particles_portname, "fast_tcp") == false)
+        {
+            yWarning() << "Unable to connect to" << m_remote_particles << ", the estimated poses will be periodically requested";
+        }
+    }
+    //the map->odom correction composed with the odometry is used, if available, instead of getCurrentPosition()
+    if (m_remote_map_odom != "" && m_remote_odometry != "")
+    {
+        if (m_map_odom_stream.open(m_local_name_prefix, m_remote_map_odom, m_remote_odometry, 0.1) == false)
+        {
+            yWarning() << "Unable to open the map->odom stream ports, the localization will be periodically requested";
+        }
+    }
 
     //localization
     Property loc_options;
@@ -290,6 +337,11 @@ void NavGuiThread:: threadRelease()
     m_port_map_output.close();
     m_port_yarpview_target_input.interrupt();
     m_port_yarpview_target_input.close();
+    m_port_planner_rpc.interrupt();
+    m_port_planner_rpc.close();
+    m_port_particles_input.interrupt();
+    m_port_particles_input.close();
+    m_map_odom_stream.close();
 
     cvReleaseImage(&i1_map);
     cvReleaseImage(&i2_map_menu);
@@ -11,21 +11,120 @@
 #include <yarp/os/Log.h>
 #include <yarp/os/Value.h>
 #include <yarp/os/Bottle.h>
+#include <yarp/os/ConnectionReader.h>
+#include <yarp/os/Time.h>
+#include <navigation_defines.h>
+#include <cmath>
+#include <sstream>
+
+#ifndef M_PI
+#define M_PI 3.14159265358979323846
+#endif
+
+#define DEG2RAD M_PI/180
 
 Joy2vel::Joy2vel()
 {
     this->things.setPortWriter(&this->command);
+    binary_mode = false;
+    coalesce_period = 0;
+    linear_vel_at_full_control = 0.3;
+    angular_vel_at_full_control = 30.0;
+    cmd_format = 0;
+    for (size_t i = 0; i < 4; i++) cmd_data[i] = 0;
+    last_forward_time = 0;
+    last_error_time = 0;
+    suppressed_errors = 0;
+}
+
+bool Joy2vel::create(const yarp::os::Property& options)
+{
+    //the parameters are appended to the carrier name, e.g. tcp+recv.portmonitor+type.dll+file.joy2vel+mode.binary+coalesce.0.02
+    yarp::os::Property params;
+    std::string carrier = options.find("carrier").asString();
+    std::istringstream ss(carrier);
+    std::string token;
+    while (std::getline(ss, token, '+'))
+    {
+        size_t dot = token.find('.');
+        if (dot == std::string::npos) continue;
+        params.put(token.substr(0, dot), yarp::os::Value::makeValue(token.substr(dot + 1)));
+    }
+
+    std::string mode = params.check("mode", yarp::os::Value("bottle")).asString();
+    if (mode == "binary")
+    {
+        binary_mode = true;
+    }
+    else if (mode != "bottle")
+    {
+        yError("Joy2vel: invalid mode %s, expected bottle or binary", mode.c_str());
+        return false;
+    }
+    coalesce_period = params.check("coalesce", yarp::os::Value(0.0)).asDouble();
+    linear_vel_at_full_control = params.check("linear_vel_at_full_control", yarp::os::Value(0.3)).asDouble();
+    angular_vel_at_full_control = params.check("angular_vel_at_full_control", yarp::os::Value(30.0)).asDouble();
+    yDebug("Joy2vel: mode %s, coalesce %.3fs", mode.c_str(), coalesce_period);
+    return true;
 }
 
 bool Joy2vel::accept(yarp::os::Things& thing)
 {
-    yarp::os::Bottle *bot = thing.cast_as<yarp::os::Bottle>();
-    if (bot == NULL) {
-        yWarning("Joy2vel: expected type Bottle but got wrong data type!");
+    bool ok = binary_mode ? decode_binary(thing) : decode_bottle(thing);
+    if (!ok) return false;
+
+    //a port monitor cannot forward a command later, when the burst is over: the newest command is
+    //always forwarded if it changes the velocity, only the repetitions of the last forwarded one are
+    //dropped within the period. A stop is never delayed either.
+    yarp::dev::MobileBaseVelocity last = command;
+    if (!convert()) return false;
+    double now = yarp::os::Time::now();
+    bool repeated = command.vel_x == last.vel_x && command.vel_y == last.vel_y && command.vel_theta == last.vel_theta;
+    bool stop = command.vel_x == 0 && command.vel_y == 0 && command.vel_theta == 0;
+    if (coalesce_period > 0 && repeated && !stop && now - last_forward_time < coalesce_period)
+    {
         return false;
     }
-    if (bot->size() != 5) {
-        yWarning("Joy2vel: expected Bottle of size 5 but got wrong size (%zd)!", bot->size());
+    last_forward_time = now;
+    return true;
+}
+
+bool Joy2vel::decode_bottle(yarp::os::Things& thing)
+{
+    yarp::os::Bottle *bot = thing.cast_as<yarp::os::Bottle>();
+    if (!validate_bot(bot)) return false;
+    cmd_format = bot->get(0).asInt();
+    cmd_data[0] = bot->get(1).asDouble();
+    cmd_data[1] = bot->get(2).asDouble();
+    cmd_data[2] = bot->get(3).asDouble();
+    cmd_data[3] = bot->get(4).asDouble();
+    return true;
+}
+
+bool Joy2vel::decode_binary(yarp::os::Things& thing)
+{
+    yarp::os::ConnectionReader* reader = thing.getConnectionReader();
+    if (reader == nullptr || reader->isTextMode())
+    {
+        //local connections and text mode: nothing to gain, use the Bottle
+        return decode_bottle(thing);
+    }
+
+    //the binary layout of a Bottle (int32, float64, float64, float64, float64):
+    //list tag, size, then a tag and a value for each element
+    bool ok = reader->expectInt32() == BOTTLE_TAG_LIST;
+    ok = ok && reader->expectInt32() == 5;
+    ok = ok && reader->expectInt32() == BOTTLE_TAG_INT32;
+    if (ok) cmd_format = reader->expectInt32();
+    for (size_t i = 0; ok && i < 4; i++)
+    {
+        ok = reader->expectInt32() == BOTTLE_TAG_FLOAT64;
+        if (ok) cmd_data[i] = reader->expectFloat64();
+    }
+    ok = ok && !reader->isError();
+    if (!ok)
+    {
+        report_error("expected a Bottle (int32, float64, float64, float64, float64)");
         return false;
     }
     return true;
@@ -39,27 +138,77 @@ bool Joy2vel::validate_bot(const yarp::os::Bottle* bot)
         bot->get(1).isDouble() &&
         bot->get(2).isDouble() &&
         bot->get(3).isDouble() &&
-        bot->get(0).isDouble())
-    { 
+        bot->get(4).isDouble())
+    {
         return true;
     }
-    yError("Invalid bottle format");
+    report_error("expected a Bottle (int32, float64, float64, float64, float64)");
     return false;
 }
 
-yarp::os::Things& Joy2vel::update(yarp::os::Things& thing)
+bool Joy2vel::convert()
 {
-    yarp::os::Bottle *bot = thing.cast_as<yarp::os::Bottle>();
-    yAssert(bot);
-    validate_bot(bot);
+    double gain = cmd_data[3];
+    gain = (gain < +100) ? gain : +100;
+    gain = (gain > 0) ? gain : 0;
+    double percent = gain / 100.0;
+
+    if (cmd_format == BASECONTROL_COMMAND_VELOCIY_CARTESIAN)
+    {
+        this->command.vel_x = cmd_data[0] * percent;
+        this->command.vel_y = cmd_data[1] * percent;
+        this->command.vel_theta = cmd_data[2] * percent;
+    }
+    else if (cmd_format == BASECONTROL_COMMAND_VELOCIY_POLAR ||
+             cmd_format == BASECONTROL_COMMAND_PERCENT_POLAR)
+    {
+        //direction [deg], linear speed, angular speed
+        double lin_spd = cmd_data[1];
+        double ang_spd = cmd_data[2];
+        if (cmd_format == BASECONTROL_COMMAND_PERCENT_POLAR)
+        {
+            lin_spd = (lin_spd > 100) ? 100 : lin_spd;
+            lin_spd = (lin_spd < -100) ? -100 : lin_spd;
+            ang_spd = (ang_spd > 100) ? 100 : ang_spd;
+            ang_spd = (ang_spd < -100) ? -100 : ang_spd;
+            lin_spd = lin_spd / 100 * linear_vel_at_full_control;
+            ang_spd = ang_spd / 100 * angular_vel_at_full_control;
+        }
+        this->command.vel_x = lin_spd * cos(cmd_data[0] * DEG2RAD) * percent;
+        this->command.vel_y = lin_spd * sin(cmd_data[0] * DEG2RAD) * percent;
+        this->command.vel_theta = ang_spd * percent;
+    }
+    else
+    {
+        report_error("unknown command format");
+        return false;
+    }
+    return true;
+}
 
-    if (bot->get(0).asInt()==3)
+void Joy2vel::report_error(const char* message)
+{
+    //the joystick may send hundreds of invalid messages per second
+    double now = yarp::os::Time::now();
+    if (now - last_error_time < 1.0)
     {
-        double percent = bot->get(4).asFloat64()/100.0;
-        this->command.vel_x = bot->get(1).asFloat64() * percent;
-        this->command.vel_y = bot->get(2).asFloat64() * percent;
-        this->command.vel_theta = bot->get(3).asFloat64() * percent;
+        suppressed_errors++;
+        return;
     }
+    if (suppressed_errors > 0)
+    {
+        yError("Joy2vel: %s (%d similar errors suppressed)", message, suppressed_errors);
+    }
+    else
+    {
+        yError("Joy2vel: %s", message);
+    }
+    last_error_time = now;
+    suppressed_errors = 0;
+}
 
+yarp::os::Things& Joy2vel::update(yarp::os::Things& thing)
+{
+    //the command has been already decoded and converted by accept()
     return this->things;
 }
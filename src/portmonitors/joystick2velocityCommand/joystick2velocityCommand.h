@@ -11,19 +11,51 @@
 
 #include <yarp/os/MonitorObject.h>
 #include <yarp/os/Things.h>
+#include <yarp/os/Property.h>
 #include <yarp/dev/MobileBaseVelocity.h>
 
+/**
+* Converts the commands sent by a joystick (a Bottle: format, x, y, theta, gain, where format is one
+* of the BASECONTROL_COMMAND_* values) into a yarp::dev::MobileBaseVelocity.
+* Options (carrier parameters):
+* - mode.bottle (default): the message is deserialized into a Bottle and the type of each element is checked.
+* - mode.binary: the message is decoded from the binary layout of a Bottle (int32, 4 x float64), with a single
+*   comparison of the type tags. Text mode connections are decoded as in mode.bottle.
+* - coalesce.<s>: forward a repeated command at most once every <s> seconds (0 = all). Commands which change
+*   the velocity, including the stop commands, are always forwarded, so the base always receives the latest one.
+* - linear_vel_at_full_control.<m/s>, angular_vel_at_full_control.<deg/s>: scaling of the BASECONTROL_COMMAND_PERCENT_POLAR commands.
+*/
 class Joy2vel : public yarp::os::MonitorObject
 {
 public:
     Joy2vel();
+    virtual bool create(const yarp::os::Property& options);
     virtual bool accept(yarp::os::Things& thing);
     virtual yarp::os::Things& update(yarp::os::Things& thing);
 private:
     yarp::os::Things things;
     yarp::dev::MobileBaseVelocity command;
 
+    //options
+    bool   binary_mode;
+    double coalesce_period;
+    double linear_vel_at_full_control;
+    double angular_vel_at_full_control;
+
+    //the last decoded command; command holds the last forwarded velocity
+    int    cmd_format;
+    double cmd_data[4];
+    double last_forward_time;
+
+    //diagnostics, printed at most once per second
+    double last_error_time;
+    int    suppressed_errors;
+
     bool validate_bot(const yarp::os::Bottle* bot);
+    bool decode_bottle(yarp::os::Things& thing);
+    bool decode_binary(yarp::os::Things& thing);
+    bool convert();
+    void report_error(const char* message);
 };
 
 #endif
@@ -0,0 +1,212 @@
+/*
+ * Copyright (C) 2020 Istituto Italiano di Tecnologia (IIT)
+ * All rights reserved.
+ *
+ * This software may be modified and distributed under the terms of the
+ * GPL-2+ license. See the accompanying LICENSE file for details.
+ */
+
+// amclMotionBenchmark measures the motion update of the particle filter of amclLocalizer (AMCLOdom::UpdateAction)
+// for each odometry model, with the noise drawn by the xoshiro256+ generator (AMCLRandom, the default)
+// and by drand48 (odom_noise_generator = drand48, the generator of the original implementation).
+// It reports the time per particle for sets of 500, 5000 and 50000 particles, unless --particles is given.
+// Before the measurements, it checks that:
+//   - the gaussian noise of AMCLRandom has zero mean and unit variance
+//   - without noise, every model moves a particle which is at the previous odometry pose to the new one
+// and returns an error otherwise (a check run by ctest). No YARP network (name server) is required.
+//
+// Usage:
+//   amclMotionBenchmark [--particles <n>] [--iterations <n>] [--seed <n>]
+
+#include <yarp/os/Log.h>
+#include <yarp/os/LogStream.h>
+#include <yarp/os/ResourceFinder.h>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <string>
+#include <vector>
+
+#include "amcl/pf/pf.h"
+#include "amcl/sensors/amcl_odom.h"
+#include "amcl/sensors/amcl_random.h"
+
+using namespace yarp::os;
+using namespace amcl;
+
+struct model_desc_t
+{
+    odom_model_t type;
+    const char*  name;
+};
+
+static const model_desc_t models[] = { { ODOM_MODEL_DIFF,           "diff" },
+                                       { ODOM_MODEL_OMNI,           "omni" },
+                                       { ODOM_MODEL_DIFF_CORRECTED, "diff-corrected" },
+                                       { ODOM_MODEL_OMNI_CORRECTED, "omni-corrected" } };
+
+static double now()
+{
+    return std::chrono::duration<double>(std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+//a filter whose particles are all at the given pose
+static pf_t* allocFilter(int particles, const pf_vector_t& pose)
+{
+    pf_t* pf = pf_alloc(particles, particles, 0.001, 0.1, NULL, NULL);
+    pf_init(pf, pose, pf_matrix_zero());
+    pf_sample_set_t* set = pf->sets + pf->current_set;
+    for (int i = 0; i < set->sample_count; i++)
+    {
+        set->samples[i].pose = pose;
+    }
+    return pf;
+}
+
+static bool checkGaussian(uint64_t seed)
+{
+    const int n = 1000000;
+    std::vector<double> samples(n);
+    AMCLRandom random;
+    random.Seed(seed);
+    random.Gaussian(samples.data(), n);
+    double sum = 0;
+    double sum2 = 0;
+    for (int i = 0; i < n; i++)
+    {
+        sum += samples[i];
+        sum2 += samples[i] * samples[i];
+    }
+    double mean = sum / n;
+    double variance = sum2 / n - mean * mean;
+    //the standard error of the mean is 1e-3, the one of the variance about 1.4e-3
+    if (fabs(mean) > 0.01 || fabs(variance - 1.0) > 0.01)
+    {
+        yError("AMCLRandom::Gaussian: mean %f, variance %f over %d samples", mean, variance, n);
+        return false;
+    }
+    return true;
+}
+
+static bool checkNoiseless(const model_desc_t& model)
+{
+    pf_vector_t old_pose = pf_vector_zero();
+    old_pose.v[0] = 1.0;
+    old_pose.v[1] = -2.0;
+    old_pose.v[2] = 0.5;
+    AMCLOdomData data;
+    data.delta = pf_vector_zero();
+    data.delta.v[0] = 0.3;
+    data.delta.v[1] = 0.1;
+    data.delta.v[2] = 0.2;
+    data.pose = pf_vector_add(old_pose, data.delta);
+
+    bool ok = true;
+    for (int use_drand48 = 0; use_drand48 < 2; use_drand48++)
+    {
+        AMCLOdom odom;
+        odom.SetModel(model.type, 0, 0, 0, 0, 0);
+        odom.SetRandomGenerator(use_drand48 != 0, 1);
+        pf_t* pf = allocFilter(10, old_pose);
+        odom.UpdateAction(pf, &data);
+        pf_sample_set_t* set = pf->sets + pf->current_set;
+        for (int i = 0; i < set->sample_count; i++)
+        {
+            pf_vector_t d = pf_vector_sub(set->samples[i].pose, data.pose);
+            if (fabs(d.v[0]) > 1e-9 || fabs(d.v[1]) > 1e-9 || fabs(atan2(sin(d.v[2]), cos(d.v[2]))) > 1e-9)
+            {
+                yError("%s model without noise: particle %d is off by (%g %g %g)", model.name, i, d.v[0], d.v[1], d.v[2]);
+                ok = false;
+                break;
+            }
+        }
+        pf_free(pf);
+    }
+    return ok;
+}
+
+//time per particle of one motion update [s]
+static double measure(const model_desc_t& model, bool use_drand48, int particles, int iterations, uint64_t seed)
+{
+    AMCLOdom odom;
+    odom.SetModel(model.type, 0.2, 0.2, 0.2, 0.2, 0.2);
+    odom.SetRandomGenerator(use_drand48, seed);
+#ifdef WIN32
+    srand((unsigned int)seed);
+#else
+    srand48((long int)seed);
+#endif
+    pf_t* pf = allocFilter(particles, pf_vector_zero());
+
+    AMCLOdomData data;
+    data.delta = pf_vector_zero();
+    data.delta.v[0] = 0.2;
+    data.delta.v[1] = 0.05;
+    data.delta.v[2] = 0.1;
+    data.pose = data.delta;
+
+    //the first update resizes the work buffers
+    odom.UpdateAction(pf, &data);
+    double t_start = now();
+    for (int k = 0; k < iterations; k++)
+    {
+        data.pose = pf_vector_add(data.pose, data.delta);
+        odom.UpdateAction(pf, &data);
+    }
+    double elapsed = now() - t_start;
+    pf_free(pf);
+    return elapsed / iterations / particles;
+}
+
+int main(int argc, char *argv[])
+{
+    ResourceFinder rf;
+    rf.configure(argc, argv);
+    if (rf.check("help"))
+    {
+        yInfo() << "Usage: amclMotionBenchmark [--particles <n>] [--iterations <n>] [--seed <n>]";
+        return 0;
+    }
+
+    int iterations = rf.check("iterations", Value(20)).asInt();
+    uint64_t seed = (uint64_t)rf.check("seed", Value(1)).asInt();
+    std::vector<int> sizes;
+    if (rf.check("particles"))
+    {
+        sizes.push_back(rf.find("particles").asInt());
+    }
+    else
+    {
+        sizes.push_back(500);
+        sizes.push_back(5000);
+        sizes.push_back(50000);
+    }
+    if (iterations <= 0 || sizes[0] <= 0)
+    {
+        yError() << "Invalid iterations or particles";
+        return 1;
+    }
+
+    bool ok = checkGaussian(seed);
+    for (size_t m = 0; m < sizeof(models) / sizeof(models[0]); m++)
+    {
+        ok = checkNoiseless(models[m]) && ok;
+    }
+    if (!ok)
+    {
+        return 1;
+    }
+
+    printf("%-16s %10s %16s %16s\n", "model", "particles", "drand48[ns/p]", "xoshiro[ns/p]");
+    for (size_t m = 0; m < sizeof(models) / sizeof(models[0]); m++)
+    {
+        for (size_t s = 0; s < sizes.size(); s++)
+        {
+            double t_drand48 = measure(models[m], true, sizes[s], iterations, seed);
+            double t_xoshiro = measure(models[m], false, sizes[s], iterations, seed);
+            printf("%-16s %10d %16.1f %16.1f\n", models[m].name, sizes[s], t_drand48 * 1e9, t_xoshiro * 1e9);
+        }
+    }
+    return 0;
+}
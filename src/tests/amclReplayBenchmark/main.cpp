@@ -0,0 +1,303 @@
+/*
+ * Copyright (C) 2020 Istituto Italiano di Tecnologia (IIT)
+ * All rights reserved.
+ *
+ * This software may be modified and distributed under the terms of the
+ * GPL-2+ license. See the accompanying LICENSE file for details.
+ */
+
+// amclReplayBenchmark runs off-line, as fast as possible, the particle filter of amclLocalizer (amcl::AMCLFilter)
+// on a recorded log of odometry and laser scans, with a fixed random seed.
+// It reports the number of filter updates per second, the time spent in each stage of the update
+// and, if the log contains it, the error of the estimated pose respect to the ground truth.
+// With refine_enable, the selected pose is also aligned to the scan (AMCLScanRefiner) and its error is reported too.
+// With cpu_budget_enable, the budget is adapted as in amclLocalizer, assuming one cycle of --period seconds per scan.
+// No YARP network (name server) is required.
+//
+// Usage:
+//   amclReplayBenchmark --map <file.map> --log <log.txt> [--from <amclLocalizer.ini>] [--seed <n>] [--repeat <n>] [--period <s>]
+//
+// The parameters are read from the AMCL and INITIAL_POS groups of the configuration file (same keys and code of amclLocalizer).
+// The period defaults to the one of the configuration file.
+// Log format, one record per line, sorted by time. Lines starting with # are ignored.
+//   odom  <t> <x> <y> <theta_deg>
+//   laser <t> <angle_min_deg> <angle_increment_deg> <range_min> <range_max> <n> <range_0> ... <range_n-1>
+//   truth <t> <x> <y> <theta_deg>
+
+#include <yarp/os/Log.h>
+#include <yarp/os/LogStream.h>
+#include <yarp/os/ResourceFinder.h>
+#include <yarp/os/Property.h>
+#include <yarp/os/Bottle.h>
+#include <yarp/dev/MapGrid2D.h>
+#include <chrono>
+#include <cmath>
+#include <cstdlib>
+#include <cstdio>
+#include <sstream>
+#include <string>
+#include <vector>
+
+#include "amcl/amcl_filter.h"
+#include "amclFilterConfig.h"
+#include <replay_log.h>
+
+using namespace yarp::os;
+using namespace amcl;
+
+#define RAD2DEG 180/M_PI
+#define DEG2RAD M_PI/180
+
+struct log_record_t
+{
+    enum { ODOM, LASER, TRUTH } type;
+    double t;
+    double x, y, theta;           //odom, truth [m, m, rad]
+    double angle_min, angle_inc;  //laser [rad]
+    double range_min, range_max;  //laser [m]
+    std::vector<double> ranges;   //laser [m]
+};
+
+struct stage_timer_t
+{
+    double total;
+    size_t count;
+    stage_timer_t() : total(0), count(0) {}
+    void add(double t) { total += t; count++; }
+};
+
+static double angle_diff(double a, double b)
+{
+    double d = a - b;
+    return atan2(sin(d), cos(d));
+}
+
+static double now()
+{
+    return std::chrono::duration<double>(std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+static bool parseRecord(const std::string& type, double t, std::istringstream& ss, log_record_t& r)
+{
+    r.t = t;
+    if (type == "odom" || type == "truth")
+    {
+        r.type = (type == "odom") ? log_record_t::ODOM : log_record_t::TRUTH;
+        ss >> r.x >> r.y >> r.theta;
+        r.theta *= DEG2RAD;
+    }
+    else if (type == "laser")
+    {
+        r.type = log_record_t::LASER;
+        size_t n = 0;
+        ss >> r.angle_min >> r.angle_inc >> r.range_min >> r.range_max >> n;
+        r.angle_min *= DEG2RAD;
+        r.angle_inc *= DEG2RAD;
+        r.ranges.resize(ss.fail() ? 0 : n);
+        for (size_t i = 0; i < r.ranges.size(); i++) ss >> r.ranges[i];
+    }
+    else
+    {
+        return false;
+    }
+    return true;
+}
+
+int main(int argc, char *argv[])
+{
+    ResourceFinder rf;
+    rf.setDefaultContext("amclLocalizer");
+    rf.configure(argc, argv);
+
+    if (rf.check("help") || !rf.check("map") || !rf.check("log"))
+    {
+        yInfo() << "Usage: amclReplayBenchmark --map <file.map> --log <log.txt> [--from <amclLocalizer.ini>] [--seed <n>] [--repeat <n>] [--period <s>]";
+        return rf.check("help") ? 0 : 1;
+    }
+    std::string map_file = rf.find("map").asString();
+    std::string log_file = rf.find("log").asString();
+    int seed = rf.check("seed", Value(1)).asInt();
+    int repeat = rf.check("repeat", Value(1)).asInt();
+    //the period of amclLocalizer, used by the CPU budget
+    double period = rf.check("period", Value(0.010)).asDouble();
+
+    AMCLFilterParams params;
+    Bottle amcl_group = rf.findGroup("AMCL");
+    Bottle initial_group = rf.findGroup("INITIAL_POS");
+    if (readAmclFilterParams(amcl_group, initial_group, params) == false)
+    {
+        return 1;
+    }
+    pf_vector_t initial_pose = pf_vector_zero();
+    initial_pose.v[0] = initial_group.check("initial_x", Value(0.0)).asDouble();
+    initial_pose.v[1] = initial_group.check("initial_y", Value(0.0)).asDouble();
+    initial_pose.v[2] = initial_group.check("initial_theta", Value(0.0)).asDouble() * DEG2RAD;
+    pf_matrix_t initial_cov = pf_matrix_zero();
+    initial_cov.m[0][0] = params.initial_cov_xx;
+    initial_cov.m[1][1] = params.initial_cov_yy;
+    initial_cov.m[2][2] = params.initial_cov_aa;
+
+    //data
+    yarp::dev::Nav2D::MapGrid2D yarp_map;
+    if (yarp_map.loadFromFile(map_file) == false)
+    {
+        yError() << "Unable to load map" << map_file;
+        return 1;
+    }
+    std::vector<log_record_t> records;
+    if (replay_log::load(log_file, records, parseRecord) == false)
+    {
+        return 1;
+    }
+
+    double t_map = now();
+    map_t* map = convertAmclMap(yarp_map);
+    printf("map %zux%zu converted in %.3fms\n", yarp_map.width(), yarp_map.height(), (now() - t_map) * 1000.0);
+
+    stage_timer_t t_action, t_sensor, t_resample, t_cluster, t_refine;
+    size_t updates = 0;
+    size_t error_samples = 0;
+    double error_sum = 0, error_sq_sum = 0, error_max = 0, error_theta_sum = 0;
+    double refined_error_sum = 0, refined_error_sq_sum = 0, refined_error_max = 0, refined_error_theta_sum = 0;
+    long refined_count = 0, rejected_count = 0;
+    int budget_particles = params.max_particles, budget_beams = params.max_beams;
+    size_t budget_changes = 0;
+    double t_init = 0;
+    double t_run_start = now();
+
+    for (int run = 0; run < repeat; run++)
+    {
+        //the same seed for each repetition: every run must produce the same poses
+        double t0 = now();
+        AMCLFilter filter;
+        if (filter.Init(params, map, (uint64_t)seed) == false)
+        {
+            yError() << "Unable to initialize the filter";
+            map_free(map);
+            return 1;
+        }
+        filter.Initialize(initial_pose, initial_cov);
+        t_init += now() - t0;
+
+        bool odom_received = false;
+        bool truth_received = false;
+        pf_vector_t pose = pf_vector_zero();
+        pf_vector_t truth = pf_vector_zero();
+
+        for (size_t r = 0; r < records.size(); r++)
+        {
+            const log_record_t& rec = records[r];
+            if (rec.type == log_record_t::ODOM)
+            {
+                pose.v[0] = rec.x;
+                pose.v[1] = rec.y;
+                pose.v[2] = rec.theta;
+                odom_received = true;
+                continue;
+            }
+            if (rec.type == log_record_t::TRUTH)
+            {
+                truth.v[0] = rec.x;
+                truth.v[1] = rec.y;
+                truth.v[2] = rec.theta;
+                truth_received = true;
+                continue;
+            }
+            if (!odom_received) continue;
+
+            //one cycle of amclLocalizerThread::run() per scan
+            double t_cycle = now();
+            int result = filter.Update(pose, rec.ranges, rec.angle_min, rec.angle_inc, rec.range_min, rec.range_max);
+            const amcl_filter_timing_t& timing = filter.GetLastTiming();
+            if (result & AMCL_FILTER_UPDATED)
+            {
+                updates++;
+                if (timing.action > 0) t_action.add(timing.action);
+                t_sensor.add(timing.sensor);
+            }
+            if (timing.resample > 0) t_resample.add(timing.resample);
+            if (timing.hypotheses > 0) t_cluster.add(timing.hypotheses);
+
+            if (result & AMCL_FILTER_NEW_POSE)
+            {
+                pf_vector_t best = filter.GetPose();
+                pf_vector_t refined = best;
+                if (params.refine_enable)
+                {
+                    //off-line there is no period to respect
+                    t0 = now();
+                    filter.RefinePose(1e9);
+                    t_refine.add(now() - t0);
+                    refined = filter.GetPose();
+                }
+                if (truth_received)
+                {
+                    double e = sqrt((best.v[0] - truth.v[0]) * (best.v[0] - truth.v[0]) + (best.v[1] - truth.v[1]) * (best.v[1] - truth.v[1]));
+                    error_sum += e;
+                    error_sq_sum += e * e;
+                    error_max = std::max(error_max, e);
+                    error_theta_sum += fabs(angle_diff(best.v[2], truth.v[2]));
+                    error_samples++;
+                    e = sqrt((refined.v[0] - truth.v[0]) * (refined.v[0] - truth.v[0]) + (refined.v[1] - truth.v[1]) * (refined.v[1] - truth.v[1]));
+                    refined_error_sum += e;
+                    refined_error_sq_sum += e * e;
+                    refined_error_max = std::max(refined_error_max, e);
+                    refined_error_theta_sum += fabs(angle_diff(refined.v[2], truth.v[2]));
+                }
+            }
+
+            //the budget is adapted on the time of the log, with the measured duration of the cycle
+            if (params.cpu_budget_enable)
+            {
+                filter.AddCycle(now() - t_cycle, (result & AMCL_FILTER_UPDATED) != 0);
+                if (filter.UpdateCpuBudget(rec.t, period) == CPU_BUDGET_CHANGED) budget_changes++;
+            }
+        }
+        if (filter.GetRefiner())
+        {
+            refined_count += filter.GetRefiner()->GetRefinedCount();
+            rejected_count += filter.GetRefiner()->GetRejectedCount();
+        }
+        budget_particles = filter.GetMaxParticles();
+        budget_beams = filter.GetMaxBeams();
+    }
+    double t_run = now() - t_run_start;
+
+    //report
+    printf("runs: %d, seed: %d, filter updates: %zu, elapsed: %.3fs (initialization %.3fs), updates/s: %.1f\n",
+           repeat, seed, updates, t_run, t_init, (t_run > 0) ? updates / t_run : 0.0);
+    const char* names[] = { "action", "sensor", "resample", "select", "refine" };
+    const stage_timer_t* stages[] = { &t_action, &t_sensor, &t_resample, &t_cluster, &t_refine };
+    const int stage_count = params.refine_enable ? 5 : 4;
+    double t_stages = 0;
+    for (int i = 0; i < stage_count; i++) t_stages += stages[i]->total;
+    for (int i = 0; i < stage_count; i++)
+    {
+        printf("  %-9s calls: %8zu  mean: %9.3fms  total: %8.3fs  (%5.1f%%)\n", names[i], stages[i]->count,
+               stages[i]->count ? stages[i]->total / stages[i]->count * 1000.0 : 0.0, stages[i]->total,
+               t_stages > 0 ? stages[i]->total / t_stages * 100.0 : 0.0);
+    }
+    if (params.cpu_budget_enable)
+    {
+        printf("cpu budget (period %.3fs): %zu changes, final particles %d of %d, beams %d of %d\n", period,
+               budget_changes, budget_particles, params.max_particles, budget_beams, params.max_beams);
+    }
+    if (error_samples > 0)
+    {
+        printf("pose error (%zu samples): mean %.3fm, rms %.3fm, max %.3fm, mean heading %.2fdeg\n", error_samples,
+               error_sum / error_samples, sqrt(error_sq_sum / error_samples), error_max, error_theta_sum / error_samples * RAD2DEG);
+        if (params.refine_enable)
+        {
+            printf("refined pose error: mean %.3fm, rms %.3fm, max %.3fm, mean heading %.2fdeg (refined %ld, rejected %ld)\n",
+                   refined_error_sum / error_samples, sqrt(refined_error_sq_sum / error_samples), refined_error_max,
+                   refined_error_theta_sum / error_samples * RAD2DEG, refined_count, rejected_count);
+        }
+    }
+    else
+    {
+        printf("pose error: no ground truth in the log\n");
+    }
+
+    map_free(map);
+    return 0;
+}
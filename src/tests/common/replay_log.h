@@ -0,0 +1,60 @@
+/*
+ * Copyright (C) 2020 Istituto Italiano di Tecnologia (IIT)
+ * All rights reserved.
+ *
+ * This software may be modified and distributed under the terms of the
+ * GPL-2+ license. See the accompanying LICENSE file for details.
+ */
+
+#ifndef REPLAY_LOG_H
+#define REPLAY_LOG_H
+
+#include <yarp/os/LogStream.h>
+#include <fstream>
+#include <sstream>
+#include <string>
+#include <vector>
+
+//! The text logs replayed by the offline tools in src/tests.
+//! One record per line, sorted by time: <type> <t> <fields...>. Empty lines and lines starting with # are ignored.
+namespace replay_log
+{
+    //reads all the records of a log. For each line, parse(type, t, fields, record) reads the fields of the record
+    //from the stream and returns false if the type is unknown. A record with missing or invalid fields is an error.
+    template <typename record_t, typename parse_t>
+    bool load(const std::string& filename, std::vector<record_t>& records, parse_t parse)
+    {
+        std::ifstream file(filename);
+        if (!file.is_open())
+        {
+            yError() << "Unable to open" << filename;
+            return false;
+        }
+        std::string line;
+        size_t line_number = 0;
+        while (std::getline(file, line))
+        {
+            line_number++;
+            if (line.empty() || line[0] == '#') continue;
+            std::istringstream fields(line);
+            std::string type;
+            double t = 0;
+            fields >> type >> t;
+            record_t r;
+            if (!parse(type, t, fields, r))
+            {
+                yError() << "Unknown record type at line" << line_number << "of" << filename;
+                return false;
+            }
+            if (fields.fail())
+            {
+                yError() << "Invalid record at line" << line_number << "of" << filename;
+                return false;
+            }
+            records.push_back(r);
+        }
+        return true;
+    }
+}
+
+#endif
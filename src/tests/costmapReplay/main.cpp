@@ -0,0 +1,482 @@
+/*
+ * Copyright (C) 2020 Istituto Italiano di Tecnologia (IIT)
+ * All rights reserved.
+ *
+ * This software may be modified and distributed under the terms of the
+ * GPL-2+ license. See the accompanying LICENSE file for details.
+ */
+
+// costmapReplay records, replays and checks the costmaps published by move_base, as received by rosNavigator
+// (a full nav_msgs/OccupancyGrid followed by map_msgs/OccupancyGridUpdate patches).
+//
+// Usage:
+//   costmapReplay --record <file> [--topic /move_base/local_costmap/costmap] [--duration <s>]
+//       records the costmap and its updates (<topic>_updates) from ROS.
+//   costmapReplay --play <file> [--topic /move_base/local_costmap/costmap] [--rate <r>] [--loop]
+//       publishes a recording on ROS, in place of move_base (e.g. to test rosNavigator without move_base).
+//   costmapReplay [--log <file>] [--check_every <n>] [--blob]
+//       applies off-line a recording (or, without --log, a synthetic sequence) to the rosCostmap used by rosNavigator,
+//       checks the result and the deltas sent to the clients against a full conversion of the same costmap, and
+//       reports the time spent for an update respect to the full conversion. No YARP network is required.
+//   Synthetic sequence options: [--width <cells>] [--height <cells>] [--updates <n>] [--patch <cells>] [--seed <n>]
+//
+// Recording format, one record per line. Lines starting with # are ignored.
+//   full   <t> <width> <height> <resolution> <origin_x> <origin_y> <origin_yaw_rad> <data_0> ... <data_n-1>
+//   update <t> <x> <y> <width> <height> <data_0> ... <data_n-1>
+
+#include <yarp/os/Log.h>
+#include <yarp/os/LogStream.h>
+#include <yarp/os/ResourceFinder.h>
+#include <yarp/os/Network.h>
+#include <yarp/os/Node.h>
+#include <yarp/os/Publisher.h>
+#include <yarp/os/Subscriber.h>
+#include <yarp/os/Time.h>
+#include <yarp/os/Bottle.h>
+#include <yarp/dev/MapGrid2D.h>
+#include <yarp/rosmsg/nav_msgs/OccupancyGrid.h>
+#include <yarp/rosmsg/map_msgs/OccupancyGridUpdate.h>
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <fstream>
+#include <sstream>
+#include <random>
+#include <string>
+#include <vector>
+
+#include "rosCostmap.h"
+#include <map_layers.h>
+#include <map_grid_delta.h>
+#include <replay_log.h>
+
+using namespace yarp::os;
+using namespace yarp::dev::Nav2D;
+
+struct costmap_record_t
+{
+    bool   full;
+    double t;
+    int    x, y;                                   //update
+    size_t width, height;
+    double resolution, origin_x, origin_y, origin_yaw;  //full
+    std::vector<std::int8_t> data;
+};
+
+struct stage_timer_t
+{
+    double total;
+    size_t count;
+    stage_timer_t() : total(0), count(0) {}
+    void add(double t) { total += t; count++; }
+};
+
+static double now()
+{
+    return std::chrono::duration<double>(std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+static bool parseRecord(const std::string& type, double t, std::istringstream& ss, costmap_record_t& r)
+{
+    r.t = t;
+    if (type == "full")
+    {
+        r.full = true;
+        r.x = r.y = 0;
+        ss >> r.width >> r.height >> r.resolution >> r.origin_x >> r.origin_y >> r.origin_yaw;
+    }
+    else if (type == "update")
+    {
+        r.full = false;
+        r.resolution = r.origin_x = r.origin_y = r.origin_yaw = 0;
+        ss >> r.x >> r.y >> r.width >> r.height;
+    }
+    else
+    {
+        return false;
+    }
+    r.data.resize(ss.fail() ? 0 : r.width * r.height);
+    for (size_t i = 0; i < r.data.size(); i++)
+    {
+        int v = 0;
+        ss >> v;
+        r.data[i] = (std::int8_t)v;
+    }
+    return true;
+}
+
+static void writeRecord(std::ofstream& file, const costmap_record_t& r)
+{
+    if (r.full)
+    {
+        file << "full " << r.t << " " << r.width << " " << r.height << " " << r.resolution << " "
+             << r.origin_x << " " << r.origin_y << " " << r.origin_yaw;
+    }
+    else
+    {
+        file << "update " << r.t << " " << r.x << " " << r.y << " " << r.width << " " << r.height;
+    }
+    for (size_t i = 0; i < r.data.size(); i++)
+    {
+        file << " " << (int)r.data[i];
+    }
+    file << "\n";
+}
+
+static void toOccupancyGrid(const costmap_record_t& r, yarp::rosmsg::nav_msgs::OccupancyGrid& grid)
+{
+    grid.clear();
+    grid.header.frame_id = "/map";
+    grid.info.width = r.width;
+    grid.info.height = r.height;
+    grid.info.resolution = r.resolution;
+    grid.info.origin.position.x = r.origin_x;
+    grid.info.origin.position.y = r.origin_y;
+    grid.info.origin.position.z = 0;
+    grid.info.origin.orientation.x = 0;
+    grid.info.origin.orientation.y = 0;
+    grid.info.origin.orientation.z = sin(r.origin_yaw / 2);
+    grid.info.origin.orientation.w = cos(r.origin_yaw / 2);
+    grid.data = r.data;
+}
+
+static void toOccupancyGridUpdate(const costmap_record_t& r, yarp::rosmsg::map_msgs::OccupancyGridUpdate& update)
+{
+    update.clear();
+    update.header.frame_id = "/map";
+    update.x = r.x;
+    update.y = r.y;
+    update.width = r.width;
+    update.height = r.height;
+    update.data = r.data;
+}
+
+//a static map with a few walls, followed by obstacles appearing at random positions: each update
+//rewrites a square patch around an inflated obstacle, as done by the costmap of move_base
+static void syntheticRecording(size_t width, size_t height, size_t updates, size_t patch, int seed, std::vector<costmap_record_t>& records)
+{
+    std::mt19937 gen(seed);
+    std::vector<std::int8_t> grid(width * height, 0);
+    for (size_t x = 0; x < width; x++) { grid[x] = 100; grid[(height - 1) * width + x] = 100; }
+    for (size_t y = 0; y < height; y++) { grid[y * width] = 100; grid[y * width + width - 1] = 100; }
+    for (size_t y = height / 4; y < height * 3 / 4; y++) grid[y * width + width / 2] = 100;
+    for (size_t x = 0; x < width / 8; x++) grid[(height / 3) * width + x] = -1;
+
+    costmap_record_t full;
+    full.full = true;
+    full.t = 0;
+    full.x = full.y = 0;
+    full.width = width;
+    full.height = height;
+    full.resolution = 0.05;
+    full.origin_x = -(width * full.resolution) / 2;
+    full.origin_y = -(height * full.resolution) / 2;
+    full.origin_yaw = 0;
+    full.data = grid;
+    records.push_back(full);
+
+    patch = std::max<size_t>(4, std::min(patch, std::min(width, height)));
+    std::uniform_int_distribution<size_t> pos_x(0, width - patch);
+    std::uniform_int_distribution<size_t> pos_y(0, height - patch);
+    std::uniform_int_distribution<int> cost(0, 100);
+    for (size_t u = 0; u < updates; u++)
+    {
+        costmap_record_t r;
+        r.full = false;
+        r.t = (u + 1) * 0.2;
+        r.x = (int)pos_x(gen);
+        r.y = (int)pos_y(gen);
+        r.width = patch;
+        r.height = patch;
+        r.resolution = r.origin_x = r.origin_y = r.origin_yaw = 0;
+        r.data.resize(patch * patch);
+        //an inflated obstacle in the center of the patch, the rest is the static map
+        double c = patch / 2.0;
+        for (size_t j = 0; j < patch; j++)
+        {
+            for (size_t i = 0; i < patch; i++)
+            {
+                double d = sqrt((i - c) * (i - c) + (j - c) * (j - c));
+                std::int8_t value = grid[(r.y + j) * width + r.x + i];
+                if (d < patch / 8.0) value = 100;
+                else if (d < patch / 3.0) value = (std::int8_t)std::max<int>(value, (int)(99 * (1 - d / (patch / 3.0))));
+                else if (value == 0 && cost(gen) > 98) value = (std::int8_t)cost(gen);
+                r.data[j * patch + i] = value;
+            }
+        }
+        records.push_back(r);
+    }
+}
+
+static int record(ResourceFinder& rf, const std::string& filename, const std::string& topic)
+{
+    double duration = rf.check("duration", Value(60.0)).asDouble();
+    std::ofstream file(filename);
+    if (!file.is_open())
+    {
+        yError() << "Unable to open" << filename;
+        return 1;
+    }
+    Network network;
+    Node node("/costmapReplay");
+    Subscriber<yarp::rosmsg::nav_msgs::OccupancyGrid> full_subscriber;
+    Subscriber<yarp::rosmsg::map_msgs::OccupancyGridUpdate> updates_subscriber;
+    updates_subscriber.setStrict();
+    if (!full_subscriber.topic(topic) || !updates_subscriber.topic(topic + "_updates"))
+    {
+        yError() << "Unable to open" << topic << ", check your yarp-ROS network configuration";
+        return 1;
+    }
+
+    size_t fulls = 0;
+    size_t updates = 0;
+    double t_start = Time::now();
+    while (Time::now() - t_start < duration)
+    {
+        costmap_record_t r;
+        yarp::rosmsg::nav_msgs::OccupancyGrid* grid = full_subscriber.read(false);
+        if (grid)
+        {
+            r.full = true;
+            r.t = Time::now() - t_start;
+            r.x = r.y = 0;
+            r.width = grid->info.width;
+            r.height = grid->info.height;
+            r.resolution = grid->info.resolution;
+            r.origin_x = grid->info.origin.position.x;
+            r.origin_y = grid->info.origin.position.y;
+            r.origin_yaw = 2 * atan2(grid->info.origin.orientation.z, grid->info.origin.orientation.w);
+            r.data = grid->data;
+            writeRecord(file, r);
+            fulls++;
+        }
+        yarp::rosmsg::map_msgs::OccupancyGridUpdate* update = nullptr;
+        while ((update = updates_subscriber.read(false)) != nullptr)
+        {
+            r.full = false;
+            r.t = Time::now() - t_start;
+            r.x = update->x;
+            r.y = update->y;
+            r.width = update->width;
+            r.height = update->height;
+            r.resolution = r.origin_x = r.origin_y = r.origin_yaw = 0;
+            r.data = update->data;
+            writeRecord(file, r);
+            updates++;
+        }
+        Time::delay(0.01);
+    }
+    full_subscriber.close();
+    updates_subscriber.close();
+    yInfo("Recorded %zu full maps and %zu updates in %s", fulls, updates, filename.c_str());
+    return 0;
+}
+
+static int play(ResourceFinder& rf, const std::vector<costmap_record_t>& records, const std::string& topic)
+{
+    double rate = rf.check("rate", Value(1.0)).asDouble();
+    bool loop = rf.check("loop");
+    if (rate <= 0) rate = 1.0;
+    Network network;
+    Node node("/costmapReplay");
+    Publisher<yarp::rosmsg::nav_msgs::OccupancyGrid> full_publisher;
+    Publisher<yarp::rosmsg::map_msgs::OccupancyGridUpdate> updates_publisher;
+    if (!full_publisher.topic(topic) || !updates_publisher.topic(topic + "_updates"))
+    {
+        yError() << "Unable to open" << topic << ", check your yarp-ROS network configuration";
+        return 1;
+    }
+
+    do
+    {
+        double t_start = Time::now();
+        for (size_t i = 0; i < records.size(); i++)
+        {
+            const costmap_record_t& r = records[i];
+            double wait = r.t / rate - (Time::now() - t_start);
+            if (wait > 0) Time::delay(wait);
+            if (r.full)
+            {
+                toOccupancyGrid(r, full_publisher.prepare());
+                full_publisher.write();
+            }
+            else
+            {
+                toOccupancyGridUpdate(r, updates_publisher.prepare());
+                updates_publisher.write(true);
+            }
+        }
+        yInfo("Published %zu records", records.size());
+    } while (loop);
+    return 0;
+}
+
+static size_t countDifferences(const map_layers::grid_layer& a, const map_layers::grid_layer& b)
+{
+    if (a.width != b.width || a.height != b.height) return std::max(a.size(), b.size());
+    size_t differences = 0;
+    for (size_t i = 0; i < a.size(); i++) differences += (a.data[i] != b.data[i]);
+    return differences;
+}
+
+static int check(ResourceFinder& rf, const std::vector<costmap_record_t>& records)
+{
+    int  check_every = rf.check("check_every", Value(50)).asInt();
+    bool pack_as_blob = rf.check("blob");
+
+    rosCostmap costmap("costmap");      //the costmap under test, updated with the patches
+    rosCostmap reference("costmap");    //the full conversion of the same costmap
+    yarp::rosmsg::nav_msgs::OccupancyGrid reference_grid;
+    MapGrid2D client_map;               //a client which receives only the deltas
+    size_t client_version = 0;
+
+    stage_timer_t t_full, t_update, t_delta, t_reference;
+    size_t delta_cells = 0;
+    size_t errors = 0;
+    bool valid = false;
+    for (size_t i = 0; i < records.size(); i++)
+    {
+        const costmap_record_t& r = records[i];
+        if (r.full)
+        {
+            toOccupancyGrid(r, reference_grid);
+            double t0 = now();
+            costmap.applyFull(reference_grid);
+            t_full.add(now() - t0);
+            valid = true;
+        }
+        else if (valid)
+        {
+            yarp::rosmsg::map_msgs::OccupancyGridUpdate update;
+            toOccupancyGridUpdate(r, update);
+            double t0 = now();
+            costmap.applyUpdate(update);
+            t_update.add(now() - t0);
+            size_t map_width = reference_grid.info.width;
+            for (size_t y = 0; y < r.height && r.y + y < reference_grid.info.height; y++)
+            {
+                for (size_t x = 0; x < r.width && r.x + x < map_width; x++)
+                {
+                    reference_grid.data[(r.y + y) * map_width + r.x + x] = r.data[y * r.width + x];
+                }
+            }
+        }
+        if (!valid) continue;
+
+        //the client asks for the changes since its version, as the clients of rosNavigator do
+        Bottle reply;
+        double t0 = now();
+        costmap.getDelta(client_version, pack_as_blob, reply);
+        std::string type = reply.get(2).asString();
+        if (type == "full")
+        {
+            costmap.getMap(client_map);
+        }
+        else if (type == "delta")
+        {
+            Bottle* data = reply.get(3).asList();
+            if (data == nullptr || !map_grid_delta::decode(*data, client_map))
+            {
+                yError() << "Invalid delta at record" << i;
+                errors++;
+            }
+            else
+            {
+                delta_cells += data->get(2).asInt() * data->get(3).asInt();
+            }
+        }
+        t_delta.add(now() - t0);
+        client_version = (size_t)reply.get(1).asInt64();
+
+        if ((check_every > 0 && (i % check_every) == 0) || i + 1 == records.size())
+        {
+            t0 = now();
+            reference.applyFull(reference_grid);
+            t_reference.add(now() - t0);
+            MapGrid2D map, reference_map;
+            costmap.getMap(map);
+            reference.getMap(reference_map);
+            map_layers::grid_layer occ, ref_occ, flags, ref_flags, client_flags;
+            map_layers::get_occupancy(map, occ);
+            map_layers::get_occupancy(reference_map, ref_occ);
+            map_layers::get_flags(map, flags);
+            map_layers::get_flags(reference_map, ref_flags);
+            map_layers::get_flags(client_map, client_flags);
+            size_t occ_diff = countDifferences(occ, ref_occ);
+            size_t flags_diff = countDifferences(flags, ref_flags);
+            size_t client_diff = countDifferences(client_flags, ref_flags);
+            if (occ_diff || flags_diff || client_diff)
+            {
+                yError("Record %zu: %zu occupancy, %zu flags, %zu client flags differences", i, occ_diff, flags_diff, client_diff);
+                errors++;
+            }
+        }
+    }
+
+    //report
+    printf("records: %zu, costmap version: %zu, checks failed: %zu\n", records.size(), costmap.getVersion(), errors);
+    const char* names[] = { "full", "update", "delta", "reference" };
+    const stage_timer_t* stages[] = { &t_full, &t_update, &t_delta, &t_reference };
+    for (int i = 0; i < 4; i++)
+    {
+        printf("  %-10s calls: %8zu  mean: %9.3fms  total: %8.3fs\n", names[i], stages[i]->count,
+               stages[i]->count ? stages[i]->total / stages[i]->count * 1000.0 : 0.0, stages[i]->total);
+    }
+    if (t_update.count > 0 && t_reference.count > 0)
+    {
+        double update_mean = t_update.total / t_update.count;
+        double reference_mean = t_reference.total / t_reference.count;
+        printf("update vs full conversion: %.1fx faster, cells sent to the client per delta: %.1f\n",
+               update_mean > 0 ? reference_mean / update_mean : 0.0, t_delta.count ? (double)delta_cells / t_delta.count : 0.0);
+    }
+    return errors ? 1 : 0;
+}
+
+int main(int argc, char *argv[])
+{
+    ResourceFinder rf;
+    rf.configure(argc, argv);
+
+    if (rf.check("help"))
+    {
+        yInfo() << "Usage: costmapReplay --record <file> [--topic <costmap topic>] [--duration <s>]";
+        yInfo() << "       costmapReplay --play <file> [--topic <costmap topic>] [--rate <r>] [--loop]";
+        yInfo() << "       costmapReplay [--log <file>] [--check_every <n>] [--blob]";
+        yInfo() << "                     [--width <cells>] [--height <cells>] [--updates <n>] [--patch <cells>] [--seed <n>]";
+        return 0;
+    }
+    std::string topic = rf.check("topic", Value("/move_base/local_costmap/costmap")).asString();
+
+    if (rf.check("record"))
+    {
+        return record(rf, rf.find("record").asString(), topic);
+    }
+
+    std::vector<costmap_record_t> records;
+    std::string log_file = rf.check("play") ? rf.find("play").asString() : rf.check("log", Value("")).asString();
+    if (!log_file.empty())
+    {
+        if (!replay_log::load(log_file, records, parseRecord)) return 1;
+    }
+    else
+    {
+        size_t width = rf.check("width", Value(400)).asInt();
+        size_t height = rf.check("height", Value(400)).asInt();
+        size_t updates = rf.check("updates", Value(500)).asInt();
+        size_t patch = rf.check("patch", Value(60)).asInt();
+        int seed = rf.check("seed", Value(1)).asInt();
+        syntheticRecording(width, height, updates, patch, seed, records);
+    }
+    if (records.empty() || !records[0].full)
+    {
+        yError() << "The recording must start with a full map";
+        return 1;
+    }
+
+    if (rf.check("play"))
+    {
+        return play(rf, records, topic);
+    }
+    return check(rf, records);
+}
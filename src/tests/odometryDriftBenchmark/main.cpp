@@ -0,0 +1,287 @@
+/*
+ * Copyright (C) 2020 Istituto Italiano di Tecnologia (IIT)
+ * All rights reserved.
+ *
+ * This software may be modified and distributed under the terms of the
+ * GPL-2+ license. See the accompanying LICENSE file for details.
+ */
+
+// odometryDriftBenchmark replays a recorded log of the wheel encoders of a differential drive robot (cer)
+// and computes the odometry with each integration method available in baseControl (odometry_integration).
+// The odometry is compared with a ground truth trajectory (e.g. recorded by a motion capture system)
+// and the drift of each method is reported. No YARP network (name server) is required.
+// The odometry is computed by the same code of baseControl (DiffDriveOdometry).
+//
+// Usage:
+//   odometryDriftBenchmark --log <log.txt> [--from <baseCtrl.ini>] [--geom_r <m>] [--geom_L <m>]
+//   odometryDriftBenchmark --synthetic [--geom_r <m>] [--geom_L <m>]
+//       replays a trajectory made of arcs of constant curvature, sampled at 100Hz, whose exact poses are known.
+//       Returns an error if the arc integration does not reproduce them (a check run by ctest).
+//
+// The robot geometry is read from the ROBOT_GEOMETRY group of the configuration file, or from the command line.
+// Log format, one record per line, sorted by time. Lines starting with # are ignored.
+//   enc   <t> <left_wheel_deg> <right_wheel_deg>
+//   truth <t> <x> <y> <theta_deg>
+// The ground truth is expressed in any fixed frame: it is compared with the odometry after moving
+// its first pose to the origin.
+
+#include <yarp/os/Log.h>
+#include <yarp/os/LogStream.h>
+#include <yarp/os/ResourceFinder.h>
+#include <yarp/os/Bottle.h>
+#include <cmath>
+#include <cstdio>
+#include <sstream>
+#include <string>
+#include <vector>
+
+#include "diffDriveOdometry.h"
+#include <replay_log.h>
+
+using namespace yarp::os;
+
+#ifndef M_PI
+#define M_PI 3.14159265358979323846
+#endif
+
+#define RAD2DEG 180/M_PI
+#define DEG2RAD M_PI/180
+
+struct log_record_t
+{
+    bool   truth;
+    double t;
+    double v[3];  //enc: left, right [rad]; truth: x, y [m], theta [rad]
+};
+
+struct drift_t
+{
+    size_t samples;
+    double error_sum;
+    double error_max;
+    double error_final;
+    double error_theta_final;
+    double distance;
+    drift_t() : samples(0), error_sum(0), error_max(0), error_final(0), error_theta_final(0), distance(0) {}
+};
+
+static double angle_diff(double a, double b)
+{
+    double d = a - b;
+    return atan2(sin(d), cos(d));
+}
+
+static bool parseRecord(const std::string& type, double t, std::istringstream& ss, log_record_t& r)
+{
+    r.t = t;
+    if (type == "enc")
+    {
+        r.truth = false;
+        ss >> r.v[0] >> r.v[1];
+        r.v[0] *= DEG2RAD;
+        r.v[1] *= DEG2RAD;
+    }
+    else if (type == "truth")
+    {
+        r.truth = true;
+        ss >> r.v[0] >> r.v[1] >> r.v[2];
+        r.v[2] *= DEG2RAD;
+    }
+    else
+    {
+        return false;
+    }
+    return true;
+}
+
+//a sequence of arcs at constant wheel speeds, with the exact pose at each encoder sample.
+//The truth starts from a pose different from the origin, to check the change of frame too.
+static void makeSynthetic(double geom_r, double geom_L, std::vector<log_record_t>& records)
+{
+    //wheel speeds [rad/s] and duration [s] of each arc
+    const double arcs[][3] = { { 2.0, 2.0, 3.0 }, { 1.0, 3.0, 4.0 }, { 3.0, 0.5, 5.0 }, { -1.0, 1.0, 2.0 }, { 2.5, 2.0, 6.0 } };
+    const double rate = 100.0;
+    double t = 0;
+    double enc[2] = { 0, 0 };
+    double x = 1.0, y = 2.0, theta = 30.0 * DEG2RAD;
+    //the first truth pose is the origin of the odometry
+    log_record_t origin;
+    origin.truth = true;
+    origin.t = t;
+    origin.v[0] = x;
+    origin.v[1] = y;
+    origin.v[2] = theta;
+    records.push_back(origin);
+    for (size_t a = 0; a < sizeof(arcs) / sizeof(arcs[0]); a++)
+    {
+        double v = geom_r / 2 * (arcs[a][0] + arcs[a][1]);
+        double w = geom_r / geom_L * (arcs[a][1] - arcs[a][0]);
+        size_t steps = (size_t)(arcs[a][2] * rate);
+        for (size_t i = 0; i < steps; i++)
+        {
+            log_record_t e;
+            e.truth = false;
+            e.t = t;
+            e.v[0] = enc[0];
+            e.v[1] = enc[1];
+            records.push_back(e);
+            log_record_t g;
+            g.truth = true;
+            g.t = t;
+            g.v[0] = x;
+            g.v[1] = y;
+            g.v[2] = theta;
+            records.push_back(g);
+
+            double dt = 1.0 / rate;
+            if (fabs(w) < 1e-12)
+            {
+                x += v * dt * cos(theta);
+                y += v * dt * sin(theta);
+            }
+            else
+            {
+                x += v / w * (sin(theta + w * dt) - sin(theta));
+                y -= v / w * (cos(theta + w * dt) - cos(theta));
+            }
+            theta += w * dt;
+            enc[0] += arcs[a][0] * dt;
+            enc[1] += arcs[a][1] * dt;
+            t += dt;
+        }
+    }
+}
+
+//the odometry of CER_Odometry::compute(), computed from the log
+static drift_t replay(const std::vector<log_record_t>& records, double geom_r, double geom_L,
+                      OdometryIntegrator::integration_t integration)
+{
+    drift_t drift;
+    DiffDriveOdometry odometry;
+    odometry.setGeometry(geom_r, geom_L);
+    odometry.setIntegration(integration);
+
+    bool   odom_valid = false;
+    double enc_offset[2] = { 0, 0 };
+    bool   last_valid = false;
+    double last_time = 0;
+
+    bool   truth_valid = false;
+    double truth_origin[3] = { 0, 0, 0 };
+    double prev_truth[2] = { 0, 0 };
+
+    for (size_t i = 0; i < records.size(); i++)
+    {
+        const log_record_t& r = records[i];
+        if (r.truth)
+        {
+            if (!truth_valid)
+            {
+                //the odometry starts from the first truth pose
+                truth_origin[0] = r.v[0];
+                truth_origin[1] = r.v[1];
+                truth_origin[2] = r.v[2];
+                truth_valid = true;
+                continue;
+            }
+            if (!odom_valid) continue;
+            //the truth pose, in the frame of the first one
+            double dx = r.v[0] - truth_origin[0];
+            double dy = r.v[1] - truth_origin[1];
+            double c = cos(truth_origin[2]);
+            double s = sin(truth_origin[2]);
+            double tx = c * dx + s * dy;
+            double ty = -s * dx + c * dy;
+            double ttheta = angle_diff(r.v[2], truth_origin[2]);
+            drift.distance += sqrt((tx - prev_truth[0]) * (tx - prev_truth[0]) + (ty - prev_truth[1]) * (ty - prev_truth[1]));
+            prev_truth[0] = tx;
+            prev_truth[1] = ty;
+
+            double e = sqrt((odometry.x() - tx) * (odometry.x() - tx) + (odometry.y() - ty) * (odometry.y() - ty));
+            drift.samples++;
+            drift.error_sum += e;
+            if (e > drift.error_max) drift.error_max = e;
+            drift.error_final = e;
+            drift.error_theta_final = angle_diff(odometry.theta(), ttheta);
+            continue;
+        }
+
+        if (!truth_valid) continue;
+        if (!odom_valid)
+        {
+            enc_offset[0] = r.v[0];
+            enc_offset[1] = r.v[1];
+            odom_valid = true;
+        }
+        double enc[2] = { r.v[0] - enc_offset[0], r.v[1] - enc_offset[1] };
+        if (last_valid && r.t <= last_time) continue;
+
+        double period = last_valid ? r.t - last_time : 0;
+        odometry.update(enc[0], enc[1], r.t, period);
+        last_time = r.t;
+        last_valid = true;
+    }
+    return drift;
+}
+
+int main(int argc, char *argv[])
+{
+    ResourceFinder rf;
+    rf.setDefaultContext("baseControl");
+    rf.configure(argc, argv);
+
+    bool synthetic = rf.check("synthetic");
+    if (rf.check("help") || (!rf.check("log") && !synthetic))
+    {
+        yInfo() << "Usage: odometryDriftBenchmark --log <log.txt> [--from <baseCtrl.ini>] [--geom_r <m>] [--geom_L <m>]";
+        yInfo() << "       odometryDriftBenchmark --synthetic [--geom_r <m>] [--geom_L <m>]";
+        return rf.check("help") ? 0 : 1;
+    }
+
+    //the synthetic trajectory uses a default geometry, if not given
+    Bottle geometry_group = rf.findGroup("ROBOT_GEOMETRY");
+    double default_r = synthetic ? 0.160 : 0.0;
+    double default_L = synthetic ? 0.540 : 0.0;
+    double geom_r = rf.check("geom_r", geometry_group.check("geom_r", Value(default_r))).asDouble();
+    double geom_L = rf.check("geom_L", geometry_group.check("geom_L", Value(default_L))).asDouble();
+    if (geom_r <= 0 || geom_L <= 0)
+    {
+        yError() << "Missing or invalid geom_r, geom_L";
+        return 1;
+    }
+
+    std::vector<log_record_t> records;
+    if (synthetic)
+    {
+        makeSynthetic(geom_r, geom_L, records);
+    }
+    else if (replay_log::load(rf.find("log").asString(), records, parseRecord) == false)
+    {
+        return 1;
+    }
+
+    printf("%-6s %8s %12s %12s %12s %10s %14s\n", "method", "samples", "mean err[m]", "max err[m]", "final err[m]", "drift[%]", "final th[deg]");
+    OdometryIntegrator::integration_t methods[] = { OdometryIntegrator::INTEGRATION_EULER,
+                                                    OdometryIntegrator::INTEGRATION_ARC,
+                                                    OdometryIntegrator::INTEGRATION_RK4 };
+    for (size_t m = 0; m < sizeof(methods) / sizeof(methods[0]); m++)
+    {
+        drift_t d = replay(records, geom_r, geom_L, methods[m]);
+        if (d.samples == 0)
+        {
+            yError() << "No ground truth in the log";
+            return 1;
+        }
+        printf("%-6s %8zu %12.4f %12.4f %12.4f %10.3f %14.3f\n", OdometryIntegrator::name(methods[m]).c_str(), d.samples,
+               d.error_sum / d.samples, d.error_max, d.error_final,
+               d.distance > 0 ? d.error_final / d.distance * 100.0 : 0.0, d.error_theta_final * RAD2DEG);
+
+        //the arcs of the synthetic trajectory are integrated exactly, up to the rounding errors
+        if (synthetic && methods[m] == OdometryIntegrator::INTEGRATION_ARC && (d.error_max > 1e-6 || fabs(d.error_theta_final) > 1e-9))
+        {
+            yError() << "The arc integration does not reproduce the synthetic trajectory";
+            return 1;
+        }
+    }
+    return 0;
+}
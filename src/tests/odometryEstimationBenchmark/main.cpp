@@ -0,0 +1,192 @@
+/*
+ * Copyright (C) 2020 Istituto Italiano di Tecnologia (IIT)
+ * All rights reserved.
+ *
+ * This software may be modified and distributed under the terms of the
+ * GPL-2+ license. See the accompanying LICENSE file for details.
+ */
+
+// odometryEstimationBenchmark measures the cost of one update of the velocity estimation used by the localization
+// devices (localization_device_with_estimated_odometry), and compares it with the previous implementation:
+// an iCub::ctrl::AWLinEstimator fed with a new yarp::sig::Vector at each pose.
+// The poses are generated along a circle, with gaussian noise and jittered timestamps. The angle is wrapped in
+// (-180, 180] as returned by the localizers, and the estimated velocity in the robot frame is compared with the true one.
+// No YARP network (name server) is required.
+//
+// Usage:
+//   odometryEstimationBenchmark [--samples <n>] [--rate <Hz>] [--speed <m/s>] [--radius <m>] [--noise_xy <m>] [--noise_theta <deg>] [--jitter <s>]
+
+#include <yarp/os/LogStream.h>
+#include <yarp/os/ResourceFinder.h>
+#include <yarp/sig/Vector.h>
+#include <iCub/ctrl/adaptWinPolyEstimator.h>
+#include <localization_device_with_estimated_odometry.h>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <random>
+#include <string>
+#include <vector>
+
+using namespace yarp::os;
+using namespace yarp::dev;
+using namespace yarp::dev::Nav2D;
+
+#ifndef M_PI
+#define M_PI 3.14159265358979323846
+#endif
+
+#define RAD2DEG 180/M_PI
+#define DEG2RAD M_PI/180
+
+struct pose_sample_t
+{
+    double t;             //source timestamp [s]
+    Map2DLocation loc;    //measured pose, theta [deg] in (-180, 180]
+};
+
+struct velocity_error_t
+{
+    size_t samples;
+    double sum_vx;
+    double sum_vy;
+    double sum_w;
+    velocity_error_t() : samples(0), sum_vx(0), sum_vy(0), sum_w(0) {}
+    void add(double dvx, double dvy, double dw) { sum_vx += dvx * dvx; sum_vy += dvy * dvy; sum_w += dw * dw; samples++; }
+};
+
+static double now()
+{
+    return std::chrono::duration<double>(std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+//the velocity estimation block previously copied into amclLocalizer, rosLocalizer and t265Localizer
+class legacy_estimator
+{
+    yarp::sig::Vector            m_odom_vel;
+    yarp::sig::Vector            m_robot_vel;
+    iCub::ctrl::AWLinEstimator*  m_estimator;
+
+public:
+    legacy_estimator(unsigned int window_size, double threshold) { m_estimator = new iCub::ctrl::AWLinEstimator(window_size, threshold); }
+    ~legacy_estimator() { delete m_estimator; }
+
+    OdometryData estimate(const Map2DLocation& loc, double timestamp)
+    {
+        OdometryData odom;
+        iCub::ctrl::AWPolyElement el;
+        el.data = yarp::sig::Vector(3);
+        el.data[0] = odom.odom_x = loc.x;
+        el.data[1] = odom.odom_y = loc.y;
+        el.data[2] = odom.odom_theta = loc.theta;
+        el.time = timestamp;
+        m_odom_vel.resize(3, 0.0);
+        m_odom_vel = m_estimator->estimate(el);
+        odom.odom_vel_x = m_odom_vel[0];
+        odom.odom_vel_y = m_odom_vel[1];
+        odom.odom_vel_theta = m_odom_vel[2];
+        m_robot_vel.resize(3, 0.0);
+        m_robot_vel[0] = m_odom_vel[0] * cos(loc.theta * DEG2RAD) - m_odom_vel[0] * sin(loc.theta * DEG2RAD);
+        m_robot_vel[1] = m_odom_vel[1] * sin(loc.theta * DEG2RAD) + m_odom_vel[1] * cos(loc.theta * DEG2RAD);
+        m_robot_vel[2] = m_odom_vel[2];
+        odom.base_vel_x = m_robot_vel[0];
+        odom.base_vel_y = m_robot_vel[1];
+        odom.base_vel_theta = m_robot_vel[2];
+        return odom;
+    }
+};
+
+static void report(const char* name, size_t samples, double elapsed, const velocity_error_t& err)
+{
+    printf("%-28s %10.1f %12.4f %12.4f %12.3f\n", name, elapsed / samples * 1e9,
+           sqrt(err.sum_vx / err.samples), sqrt(err.sum_vy / err.samples), sqrt(err.sum_w / err.samples));
+}
+
+template <class estimator_t>
+static void run(const char* name, estimator_t& estimator, const std::vector<pose_sample_t>& poses, double speed, double w_deg)
+{
+    //the estimates settle within the first second
+    const size_t skip = 100;
+    std::vector<OdometryData> results(poses.size());
+    double t_start = now();
+    for (size_t i = 0; i < poses.size(); i++)
+    {
+        results[i] = estimator.estimate(poses[i].loc, poses[i].t);
+    }
+    double elapsed = now() - t_start;
+
+    velocity_error_t err;
+    for (size_t i = skip; i < results.size(); i++)
+    {
+        err.add(results[i].base_vel_x - speed, results[i].base_vel_y, results[i].base_vel_theta - w_deg);
+    }
+    report(name, poses.size(), elapsed, err);
+}
+
+int main(int argc, char *argv[])
+{
+    ResourceFinder rf;
+    rf.configure(argc, argv);
+    if (rf.check("help"))
+    {
+        yInfo() << "Usage: odometryEstimationBenchmark [--samples <n>] [--rate <Hz>] [--speed <m/s>] [--radius <m>] [--noise_xy <m>] [--noise_theta <deg>] [--jitter <s>]";
+        return 0;
+    }
+    size_t samples = rf.check("samples", Value(200000)).asInt();
+    double rate = rf.check("rate", Value(100.0)).asDouble();
+    double speed = rf.check("speed", Value(0.5)).asDouble();
+    double radius = rf.check("radius", Value(2.0)).asDouble();
+    double noise_xy = rf.check("noise_xy", Value(0.002)).asDouble();
+    double noise_theta = rf.check("noise_theta", Value(0.2)).asDouble();
+    double jitter = rf.check("jitter", Value(0.002)).asDouble();
+    if (samples < 1000 || rate <= 0 || radius <= 0)
+    {
+        yError() << "Invalid parameters";
+        return 1;
+    }
+
+    //the robot moves forward on a circle, so the velocity in the robot frame is constant
+    std::mt19937 generator(12345);
+    std::normal_distribution<double> n_xy(0, noise_xy);
+    std::normal_distribution<double> n_theta(0, noise_theta);
+    std::uniform_real_distribution<double> n_t(-jitter, jitter);
+    double w = speed / radius;
+    std::vector<pose_sample_t> poses(samples);
+    for (size_t i = 0; i < samples; i++)
+    {
+        //the data is acquired at a fixed rate, but its timestamp is not
+        double t = i / rate;
+        double a = w * t;
+        pose_sample_t& p = poses[i];
+        p.t = 1000.0 + t + n_t(generator);
+        p.loc.map_id = "benchmark";
+        p.loc.x = radius * sin(a) + n_xy(generator);
+        p.loc.y = radius * (1 - cos(a)) + n_xy(generator);
+        double theta = a * RAD2DEG + n_theta(generator);
+        p.loc.theta = atan2(sin(theta * DEG2RAD), cos(theta * DEG2RAD)) * RAD2DEG;
+    }
+
+    printf("%zu poses at %.0fHz, speed %.2fm/s, %.2fdeg/s, noise %.4fm %.2fdeg, jitter %.4fs\n",
+           samples, rate, speed, w * RAD2DEG, noise_xy, noise_theta, jitter);
+    printf("%-28s %10s %12s %12s %12s\n", "estimator", "ns/update", "rms vx[m/s]", "rms vy[m/s]", "rms w[deg/s]");
+
+    legacy_estimator legacy(3, 3.0);
+    run("legacy AWLinEstimator(3,3)", legacy, poses, speed, w * RAD2DEG);
+    legacy_estimator legacy16(16, 3.0);
+    run("legacy AWLinEstimator(16,3)", legacy16, poses, speed, w * RAD2DEG);
+
+    const size_t windows[] = { 3, 8, 16, 32 };
+    for (size_t window : windows)
+    {
+        std::string name = "adaptive " + std::to_string(window);
+        localization_device_with_estimated_odometry adaptive(window, 3.0, true);
+        run(name.c_str(), adaptive, poses, speed, w * RAD2DEG);
+    }
+    for (size_t window : windows)
+    {
+        std::string name = "fixed " + std::to_string(window);
+        localization_device_with_estimated_odometry fixed(window, 3.0, false);
+        run(name.c_str(), fixed, poses, speed, w * RAD2DEG);
+    }
+    return 0;
+}
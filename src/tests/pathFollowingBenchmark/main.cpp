@@ -0,0 +1,409 @@
+/*
+ * Copyright (C) 2020 Istituto Italiano di Tecnologia (IIT)
+ * All rights reserved.
+ *
+ * This software may be modified and distributed under the terms of the
+ * GPL-2+ license. See the accompanying LICENSE file for details.
+ */
+
+// pathFollowingBenchmark drives a simulated robot along a benchmark course with the two navigation modes of
+// robotPathPlanner + robotGoto, and reports the mission time of each one:
+// - waypoints: the planner sends one waypoint at a time, robotGoto reaches each of them (path_following 0)
+// - path: the planner sends the whole path, robotGoto tracks it with the pure pursuit controller (path_following 1)
+// The controllers use the parameters of the robotPathPlanner and robotGoto configuration files.
+// The robot is a kinematic model of baseControl: the commands are limited in acceleration and velocity.
+// No YARP network (name server) is required.
+//
+// Usage:
+//   pathFollowingBenchmark [--from pathFollowingBenchmark_sim_cer.ini] [--context robotPathPlannerExamples]
+//
+// Configuration file:
+//   [GENERAL]         planner_config <robotPathPlanner.ini>, goto_config <robotGoto.ini>
+//   [COURSE]          start (x y theta), waypoints ((x y) ...), goal (x y theta)
+//   [SIMULATED_BASE]  max_linear_vel, max_angular_vel, max_linear_acc, max_angular_acc (as baseControl)
+
+#include <yarp/os/Log.h>
+#include <yarp/os/LogStream.h>
+#include <yarp/os/ResourceFinder.h>
+#include <yarp/os/Property.h>
+#include <yarp/os/Bottle.h>
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <string>
+#include <vector>
+
+#include "pathTracker.h"
+
+using namespace yarp::os;
+
+#ifndef M_PI
+#define M_PI 3.14159265358979323846
+#endif
+
+const double RAD2DEG = 180.0 / M_PI;
+const double DEG2RAD = M_PI / 180.0;
+
+const double GOTO_PERIOD    = 0.010;  //robotGotoDev
+const double PLANNER_PERIOD = 0.020;  //robotPathPlannerDev
+const double TIMEOUT        = 600.0;
+
+struct pose_t
+{
+    double x, y, theta;  //m, m, deg
+};
+
+struct command_t
+{
+    double linear_vel, linear_dir, angular_vel;
+    void zero() { linear_vel = 0; linear_dir = 0; angular_vel = 0; }
+};
+
+//the parameters that robotPathPlanner sends to robotGoto
+struct goto_params_t
+{
+    double tolerance_lin, tolerance_ang;
+    double max_lin_speed, min_lin_speed;
+    double max_ang_speed, min_ang_speed;
+    double gain_lin, gain_ang;
+};
+
+struct result_t
+{
+    bool   completed;
+    double mission_time;
+    double distance;
+    double max_path_error;
+    double final_error_lin;
+    double final_error_ang;
+};
+
+struct config_t
+{
+    //robotPathPlanner
+    goto_params_t waypoint;
+    goto_params_t goal;
+    //robotGoto
+    bool   holonomic;
+    double beta_angle_threshold;
+    double lookahead_min, lookahead_max, lookahead_time, rotate_in_place_angle;
+    //baseControl
+    double max_linear_vel, max_angular_vel, max_linear_acc, max_angular_acc;
+    //course
+    pose_t start;
+    std::vector<PathTracker::point_t> waypoints;
+    pose_t goal_pose;
+    bool   goal_has_angle;
+};
+
+static double normalize_angle(double angle)
+{
+    angle = fmod(angle, 360);
+    if (angle > 180) angle -= 360;
+    if (angle < -180) angle += 360;
+    return angle;
+}
+
+//the same saturation of GotoThread::saturateRobotControls()
+static void saturate(const goto_params_t& p, command_t& c)
+{
+    if (c.angular_vel > 0)      c.angular_vel = std::max(p.min_ang_speed, std::min(c.angular_vel, p.max_ang_speed));
+    else if (c.angular_vel < 0) c.angular_vel = std::max(-p.max_ang_speed, std::min(c.angular_vel, -p.min_ang_speed));
+    if (c.linear_vel > 0)       c.linear_vel = std::max(p.min_lin_speed, std::min(c.linear_vel, p.max_lin_speed));
+    else if (c.linear_vel < 0)  c.linear_vel = std::max(-p.max_lin_speed, std::min(c.linear_vel, -p.min_lin_speed));
+}
+
+//the point to point controller of GotoThread::run(). Returns true when the target is reached.
+static bool goto_point(const config_t& cfg, const goto_params_t& p, const pose_t& robot, const pose_t& target, bool weak_angle, command_t& c)
+{
+    c.zero();
+    double gamma = normalize_angle(target.theta - robot.theta);
+    double beta_world = atan2(target.y - robot.y, target.x - robot.x) * RAD2DEG;
+    double distance = sqrt(pow(target.x - robot.x, 2) + pow(target.y - robot.y, 2));
+    double beta_robot = normalize_angle(beta_world - robot.theta);
+    if (distance < p.tolerance_lin)
+    {
+        if (weak_angle || fabs(gamma) < p.tolerance_ang) return true;
+        c.angular_vel = p.gain_ang * gamma;
+    }
+    else if (fabs(beta_robot) < cfg.beta_angle_threshold)
+    {
+        c.linear_vel = p.gain_lin * distance;
+        c.linear_dir = cfg.holonomic ? beta_robot : 0.0;
+        c.angular_vel = p.gain_ang * beta_robot;
+    }
+    else
+    {
+        c.linear_dir = beta_robot;
+        c.angular_vel = p.gain_ang * beta_robot;
+    }
+    saturate(p, c);
+    return false;
+}
+
+//the acceleration and velocity limits of baseControl, then the kinematics of the robot
+static void move_base(const config_t& cfg, const command_t& c, command_t& actual, pose_t& robot, double dt)
+{
+    double vx = c.linear_vel * cos(c.linear_dir * DEG2RAD);
+    double vy = c.linear_vel * sin(c.linear_dir * DEG2RAD);
+    double w  = c.angular_vel;
+    double avx = actual.linear_vel * cos(actual.linear_dir * DEG2RAD);
+    double avy = actual.linear_vel * sin(actual.linear_dir * DEG2RAD);
+    double max_dv = cfg.max_linear_acc * dt;
+    double max_dw = cfg.max_angular_acc * dt;
+    avx += std::max(-max_dv, std::min(vx - avx, max_dv));
+    avy += std::max(-max_dv, std::min(vy - avy, max_dv));
+    actual.angular_vel += std::max(-max_dw, std::min(w - actual.angular_vel, max_dw));
+    actual.angular_vel = std::max(-cfg.max_angular_vel, std::min(actual.angular_vel, cfg.max_angular_vel));
+    actual.linear_vel = std::min(sqrt(avx * avx + avy * avy), cfg.max_linear_vel);
+    actual.linear_dir = atan2(avy, avx) * RAD2DEG;
+
+    double th = robot.theta * DEG2RAD;
+    double dir = th + actual.linear_dir * DEG2RAD;
+    robot.x += actual.linear_vel * cos(dir) * dt;
+    robot.y += actual.linear_vel * sin(dir) * dt;
+    robot.theta = normalize_angle(robot.theta + actual.angular_vel * dt);
+}
+
+static double distance_from_path(const std::vector<PathTracker::point_t>& path, double x, double y)
+{
+    double best = 1e9;
+    for (size_t i = 0; i + 1 < path.size(); i++)
+    {
+        double sx = path[i + 1].x - path[i].x;
+        double sy = path[i + 1].y - path[i].y;
+        double len2 = sx * sx + sy * sy;
+        double t = (len2 > 0) ? ((x - path[i].x) * sx + (y - path[i].y) * sy) / len2 : 0;
+        t = std::max(0.0, std::min(t, 1.0));
+        best = std::min(best, hypot(x - path[i].x - t * sx, y - path[i].y - t * sy));
+    }
+    return best;
+}
+
+static result_t simulate(const config_t& cfg, bool path_following)
+{
+    result_t r = { false, 0, 0, 0, 0, 0 };
+    pose_t robot = cfg.start;
+    command_t actual;
+    actual.zero();
+
+    //the course, as a polyline from the start, used to compute the path error
+    std::vector<PathTracker::point_t> course;
+    course.push_back(PathTracker::point_t(cfg.start.x, cfg.start.y));
+    course.insert(course.end(), cfg.waypoints.begin(), cfg.waypoints.end());
+    course.push_back(PathTracker::point_t(cfg.goal_pose.x, cfg.goal_pose.y));
+
+    PathTracker tracker;
+    tracker.setParams(cfg.lookahead_min, cfg.lookahead_max, cfg.lookahead_time, cfg.rotate_in_place_angle);
+
+    //robotGoto
+    enum { IDLE, PREPARING, MOVING, REACHED } goto_status = IDLE;
+    bool tracking = false;
+    goto_params_t params = cfg.waypoint;
+    pose_t target = cfg.goal_pose;
+    bool weak_angle = true;
+    //robotPathPlanner
+    size_t next_waypoint = 0;
+    bool   final_goal_sent = false;
+    double next_planner_tick = 0;
+
+    double t = 0;
+    while (t < TIMEOUT)
+    {
+        //the planner reacts to the status of robotGoto at its own rate
+        if (t >= next_planner_tick)
+        {
+            next_planner_tick += PLANNER_PERIOD;
+            if (goto_status == IDLE || goto_status == REACHED)
+            {
+                if (goto_status == REACHED && (path_following || final_goal_sent))
+                {
+                    r.completed = true;
+                    break;
+                }
+                if (path_following)
+                {
+                    params.tolerance_lin = cfg.goal.tolerance_lin;
+                    params.tolerance_ang = cfg.goal.tolerance_ang;
+                    params.gain_lin = cfg.goal.gain_lin;
+                    params.gain_ang = cfg.goal.gain_ang;
+                    std::vector<PathTracker::point_t> path(course);
+                    path[0] = PathTracker::point_t(robot.x, robot.y);
+                    tracker.setPath(path);
+                    tracking = true;
+                    target = cfg.goal_pose;
+                    weak_angle = !cfg.goal_has_angle;
+                }
+                else if (next_waypoint < cfg.waypoints.size())
+                {
+                    if (next_waypoint == 0)
+                    {
+                        params.tolerance_lin = cfg.waypoint.tolerance_lin;
+                        params.tolerance_ang = cfg.waypoint.tolerance_ang;
+                    }
+                    target.x = cfg.waypoints[next_waypoint].x;
+                    target.y = cfg.waypoints[next_waypoint].y;
+                    weak_angle = true;
+                    next_waypoint++;
+                }
+                else
+                {
+                    params = cfg.goal;
+                    target = cfg.goal_pose;
+                    weak_angle = !cfg.goal_has_angle;
+                    final_goal_sent = true;
+                }
+                goto_status = PREPARING;
+            }
+        }
+
+        //robotGoto
+        command_t c;
+        c.zero();
+        if (goto_status == PREPARING)
+        {
+            goto_status = MOVING;
+        }
+        else if (goto_status == MOVING)
+        {
+            PathTracker::output_t out;
+            if (tracking && tracker.compute(robot.x, robot.y, robot.theta, actual.linear_vel, params.tolerance_lin,
+                                            params.gain_lin, params.gain_ang, params.max_lin_speed, params.max_ang_speed,
+                                            cfg.holonomic, out))
+            {
+                c.linear_vel = out.linear_vel;
+                c.linear_dir = out.linear_dir;
+                c.angular_vel = out.angular_vel;
+                saturate(params, c);
+            }
+            else
+            {
+                tracking = false;
+                if (goto_point(cfg, params, robot, target, weak_angle, c)) goto_status = REACHED;
+            }
+        }
+
+        //baseControl
+        double x0 = robot.x, y0 = robot.y;
+        move_base(cfg, c, actual, robot, GOTO_PERIOD);
+        r.distance += hypot(robot.x - x0, robot.y - y0);
+        r.max_path_error = std::max(r.max_path_error, distance_from_path(course, robot.x, robot.y));
+        t += GOTO_PERIOD;
+    }
+
+    r.mission_time = t;
+    r.final_error_lin = hypot(cfg.goal_pose.x - robot.x, cfg.goal_pose.y - robot.y);
+    r.final_error_ang = cfg.goal_has_angle ? normalize_angle(cfg.goal_pose.theta - robot.theta) : 0;
+    return r;
+}
+
+static bool read_params(const Bottle& g, const std::string& prefix, goto_params_t& p)
+{
+    std::string keys[] = { "tolerance_lin", "tolerance_ang", "max_lin_speed", "min_lin_speed",
+                           "max_ang_speed", "min_ang_speed", "lin_speed_gain", "ang_speed_gain" };
+    double* values[] = { &p.tolerance_lin, &p.tolerance_ang, &p.max_lin_speed, &p.min_lin_speed,
+                         &p.max_ang_speed, &p.min_ang_speed, &p.gain_lin, &p.gain_ang };
+    for (size_t i = 0; i < 8; i++)
+    {
+        if (!g.check(prefix + keys[i]))
+        {
+            yError() << "Missing" << prefix + keys[i] << "in NAVIGATION group";
+            return false;
+        }
+        *values[i] = g.find(prefix + keys[i]).asDouble();
+    }
+    return true;
+}
+
+static bool read_pose(const Value& v, pose_t& p, bool& has_angle)
+{
+    Bottle* b = v.asList();
+    if (b == nullptr || b->size() < 2) return false;
+    p.x = b->get(0).asDouble();
+    p.y = b->get(1).asDouble();
+    has_angle = b->size() > 2;
+    p.theta = has_angle ? b->get(2).asDouble() : 0;
+    return true;
+}
+
+int main(int argc, char *argv[])
+{
+    ResourceFinder rf;
+    rf.setDefaultContext("robotPathPlannerExamples");
+    rf.setDefaultConfigFile("pathFollowingBenchmark_sim_cer.ini");
+    rf.configure(argc, argv);
+
+    if (rf.check("help"))
+    {
+        yInfo() << "Usage: pathFollowingBenchmark [--from pathFollowingBenchmark_sim_cer.ini] [--context robotPathPlannerExamples]";
+        return 0;
+    }
+
+    Bottle general_group = rf.findGroup("GENERAL");
+    Property planner_cfg;
+    Property goto_cfg;
+    std::string planner_file = rf.findFileByName(general_group.check("planner_config", Value("robotPathPlanner_sim_cer.ini")).asString());
+    std::string goto_file = rf.findFileByName(general_group.check("goto_config", Value("robotGoto_sim_cer.ini")).asString());
+    if (planner_file == "" || !planner_cfg.fromConfigFile(planner_file) || goto_file == "" || !goto_cfg.fromConfigFile(goto_file))
+    {
+        yError() << "Unable to read the robotPathPlanner/robotGoto configuration files";
+        return 1;
+    }
+
+    config_t cfg;
+    Bottle navigation_group = planner_cfg.findGroup("NAVIGATION");
+    if (!read_params(navigation_group, "waypoint_", cfg.waypoint) || !read_params(navigation_group, "goal_", cfg.goal))
+    {
+        return 1;
+    }
+
+    Bottle trajectory_group = goto_cfg.findGroup("ROBOT_TRAJECTORY");
+    cfg.holonomic = trajectory_group.check("robot_is_holonomic", Value(0)).asInt() == 1;
+    cfg.beta_angle_threshold = trajectory_group.check("max_beta_angle", Value(5.0)).asDouble();
+    cfg.lookahead_min = trajectory_group.check("path_lookahead_min", Value(0.3)).asDouble();
+    cfg.lookahead_max = trajectory_group.check("path_lookahead_max", Value(1.0)).asDouble();
+    cfg.lookahead_time = trajectory_group.check("path_lookahead_time", Value(1.0)).asDouble();
+    cfg.rotate_in_place_angle = trajectory_group.check("path_rotate_in_place_angle", Value(60.0)).asDouble();
+
+    Bottle base_group = rf.findGroup("SIMULATED_BASE");
+    cfg.max_linear_vel = base_group.check("max_linear_vel", Value(0.3)).asDouble();
+    cfg.max_angular_vel = base_group.check("max_angular_vel", Value(30.0)).asDouble();
+    cfg.max_linear_acc = base_group.check("max_linear_acc", Value(0.3)).asDouble();
+    cfg.max_angular_acc = base_group.check("max_angular_acc", Value(80.0)).asDouble();
+
+    Bottle course_group = rf.findGroup("COURSE");
+    bool start_has_angle;
+    if (!read_pose(course_group.find("start"), cfg.start, start_has_angle) ||
+        !read_pose(course_group.find("goal"), cfg.goal_pose, cfg.goal_has_angle))
+    {
+        yError() << "Missing/invalid start or goal in COURSE group";
+        return 1;
+    }
+    Bottle* waypoints = course_group.find("waypoints").asList();
+    for (size_t i = 0; waypoints && i < waypoints->size(); i++)
+    {
+        pose_t p;
+        bool has_angle;
+        if (!read_pose(waypoints->get(i), p, has_angle))
+        {
+            yError() << "Invalid waypoint" << i << "in COURSE group";
+            return 1;
+        }
+        cfg.waypoints.push_back(PathTracker::point_t(p.x, p.y));
+    }
+
+    printf("%-10s %10s %10s %15s %14s %14s\n", "mode", "time[s]", "dist[m]", "max path err[m]", "final err[m]", "final th[deg]");
+    const char* modes[] = { "waypoints", "path" };
+    for (int m = 0; m < 2; m++)
+    {
+        result_t r = simulate(cfg, m == 1);
+        if (!r.completed)
+        {
+            printf("%-10s %10s\n", modes[m], "timeout");
+            continue;
+        }
+        printf("%-10s %10.2f %10.2f %15.3f %14.3f %14.2f\n", modes[m], r.mission_time, r.distance,
+               r.max_path_error, r.final_error_lin, r.final_error_ang);
+    }
+    return 0;
+}
@@ -0,0 +1,270 @@
+/*
+ * Copyright (C) 2020 Istituto Italiano di Tecnologia (IIT)
+ * All rights reserved.
+ *
+ * This software may be modified and distributed under the terms of the
+ * GPL-2+ license. See the accompanying LICENSE file for details.
+ */
+
+// simPoseStreamer publishes at a fixed rate the poses of a set of simulated objects, in the format of sim_pose_stream,
+// so that the clients (gazeboLocalizer, follower) can read the latest pose without a blocking getPose rpc at each cycle.
+//
+// Usage:
+//   simPoseStreamer [--name /simPoseStreamer] [--period <s>] [--objects "(<object> <frame>) ..."] [--world_interface_port <port>] [--duration <s>]
+//
+// Without --world_interface_port it is a mock simulator, to test the clients without gazebo: each object moves on a circle
+// around the origin of its reference frame. The same poses are also returned by "getPose <object> [<frame>]" on the
+// <name>/rpc port, so the rpc mode of the clients can be tested and compared with the streaming mode.
+// With --world_interface_port the poses are requested to the simulator (getPose) by this module only, and published
+// to all the clients.
+// The default objects are (SIM_CER_ROBOT world) (Luca SIM_CER_ROBOT::mobile_base_body_link).
+// Ports:
+//   <name>/poses:o  the stream: a list of (object_name reference_frame x y z roll pitch yaw)
+//   <name>/rpc      getPose <object> [<frame>] (mock simulator only)
+//   <name>/world_rpc connected to --world_interface_port
+
+#include <yarp/os/Network.h>
+#include <yarp/os/LogStream.h>
+#include <yarp/os/ResourceFinder.h>
+#include <yarp/os/PeriodicThread.h>
+#include <yarp/os/BufferedPort.h>
+#include <yarp/os/RpcClient.h>
+#include <yarp/os/Port.h>
+#include <yarp/os/PortReader.h>
+#include <yarp/os/ConnectionReader.h>
+#include <yarp/os/ConnectionWriter.h>
+#include <yarp/os/Bottle.h>
+#include <yarp/os/Stamp.h>
+#include <yarp/os/Time.h>
+#include <cmath>
+#include <mutex>
+#include <string>
+#include <vector>
+#include <sim_pose_stream.h>
+
+using namespace yarp::os;
+
+#ifndef M_PI
+#define M_PI 3.14159265358979323846
+#endif
+
+struct streamed_object_t
+{
+    std::string name;
+    std::string frame;
+    sim_pose_stream::pose_6d pose;
+    bool valid;
+};
+
+class simPoseStreamerThread : public PeriodicThread, public PortReader
+{
+    std::vector<streamed_object_t>  m_objects;
+    std::mutex                      m_mutex;
+    std::string                     m_name;
+    std::string                     m_world_interface_port;
+    BufferedPort<Bottle>            m_port_poses;
+    Port                            m_port_rpc;
+    RpcClient                       m_port_world;
+    Stamp                           m_stamp;
+    double                          m_start_time;
+    size_t                          m_published;
+    double                          m_last_statistics_printed;
+
+public:
+    simPoseStreamerThread(double period, const std::string& name, const std::string& world_interface_port, const std::vector<streamed_object_t>& objects) :
+        PeriodicThread(period), m_objects(objects), m_name(name), m_world_interface_port(world_interface_port),
+        m_start_time(0), m_published(0), m_last_statistics_printed(0)
+    {
+    }
+
+    bool threadInit() override
+    {
+        if (!m_port_poses.open(m_name + "/poses:o"))
+        {
+            yError() << "Unable to open" << m_name + "/poses:o";
+            return false;
+        }
+        if (m_world_interface_port.empty())
+        {
+            if (!m_port_rpc.open(m_name + "/rpc"))
+            {
+                yError() << "Unable to open" << m_name + "/rpc";
+                return false;
+            }
+            m_port_rpc.setReader(*this);
+        }
+        else
+        {
+            if (!m_port_world.open(m_name + "/world_rpc") ||
+                !Network::connect(m_name + "/world_rpc", m_world_interface_port, "tcp"))
+            {
+                yError() << "Unable to connect to" << m_world_interface_port;
+                return false;
+            }
+        }
+        m_start_time = Time::now();
+        m_last_statistics_printed = m_start_time;
+        return true;
+    }
+
+    void threadRelease() override
+    {
+        m_port_poses.interrupt();
+        m_port_poses.close();
+        m_port_rpc.interrupt();
+        m_port_rpc.close();
+        m_port_world.interrupt();
+        m_port_world.close();
+    }
+
+    void run() override
+    {
+        double t = Time::now() - m_start_time;
+        for (size_t i = 0; i < m_objects.size(); i++)
+        {
+            sim_pose_stream::pose_6d pose;
+            bool valid = m_world_interface_port.empty() ? mockPose(i, t, pose) : simulatorPose(i, pose);
+            std::lock_guard<std::mutex> lock(m_mutex);
+            m_objects[i].pose = pose;
+            m_objects[i].valid = valid;
+        }
+
+        Bottle& b = m_port_poses.prepare();
+        b.clear();
+        {
+            std::lock_guard<std::mutex> lock(m_mutex);
+            for (size_t i = 0; i < m_objects.size(); i++)
+            {
+                if (m_objects[i].valid) sim_pose_stream::add_pose(b, m_objects[i].name, m_objects[i].frame, m_objects[i].pose);
+            }
+        }
+        m_stamp.update();
+        m_port_poses.setEnvelope(m_stamp);
+        m_port_poses.write();
+        m_published++;
+
+        double now = Time::now();
+        if (now - m_last_statistics_printed > 10.0)
+        {
+            yInfo("simPoseStreamer: %zu messages published, %.1f msg/s, %d clients", m_published,
+                  m_published / (now - m_start_time), m_port_poses.getOutputCount());
+            m_last_statistics_printed = now;
+        }
+    }
+
+    //getPose <object> [<frame>], with the same reply of the world interface of the simulator
+    bool read(ConnectionReader& connection) override
+    {
+        Bottle command;
+        Bottle reply;
+        if (!command.read(connection)) return false;
+        if (command.get(0).asString() == "getPose")
+        {
+            std::string name = command.get(1).asString();
+            std::string frame = command.size() > 2 ? command.get(2).asString() : sim_pose_stream::world_frame;
+            sim_pose_stream::pose_6d pose;
+            std::lock_guard<std::mutex> lock(m_mutex);
+            for (size_t i = 0; i < m_objects.size(); i++)
+            {
+                if (m_objects[i].name == name && m_objects[i].frame == frame && m_objects[i].valid) pose = m_objects[i].pose;
+            }
+            //as the simulator, an unknown object is returned as a null pose
+            reply.addDouble(pose.x);
+            reply.addDouble(pose.y);
+            reply.addDouble(pose.z);
+            reply.addDouble(pose.roll);
+            reply.addDouble(pose.pitch);
+            reply.addDouble(pose.yaw);
+        }
+        else
+        {
+            reply.addString("Unknown command.");
+        }
+        ConnectionWriter* returnToSender = connection.getWriter();
+        if (returnToSender != nullptr) reply.write(*returnToSender);
+        return true;
+    }
+
+private:
+    //each object moves on a circle of radius 1+i, with a different speed
+    bool mockPose(size_t i, double t, sim_pose_stream::pose_6d& pose)
+    {
+        double radius = 1.0 + i;
+        double w = 0.2 / radius;
+        pose.x = radius * cos(w * t);
+        pose.y = radius * sin(w * t);
+        pose.z = 0;
+        pose.roll = 0;
+        pose.pitch = 0;
+        pose.yaw = atan2(sin(w * t + M_PI / 2), cos(w * t + M_PI / 2));
+        return true;
+    }
+
+    bool simulatorPose(size_t i, sim_pose_stream::pose_6d& pose)
+    {
+        Bottle cmd, ans;
+        cmd.addString("getPose");
+        cmd.addString(m_objects[i].name);
+        if (m_objects[i].frame != sim_pose_stream::world_frame) cmd.addString(m_objects[i].frame);
+        if (!m_port_world.write(cmd, ans)) return false;
+        return sim_pose_stream::parse_get_pose_reply(ans, pose);
+    }
+};
+
+int main(int argc, char *argv[])
+{
+    Network network;
+    if (!network.checkNetwork())
+    {
+        yError() << "yarp server not available";
+        return 1;
+    }
+
+    ResourceFinder rf;
+    rf.configure(argc, argv);
+    if (rf.check("help"))
+    {
+        yInfo() << "Usage: simPoseStreamer [--name /simPoseStreamer] [--period <s>] [--objects \"(<object> <frame>) ...\"] [--world_interface_port <port>] [--duration <s>]";
+        return 0;
+    }
+    std::string name = rf.check("name", Value("/simPoseStreamer")).asString();
+    double period = rf.check("period", Value(0.01)).asDouble();
+    double duration = rf.check("duration", Value(0.0)).asDouble();
+    std::string world_interface_port = rf.check("world_interface_port", Value("")).asString();
+
+    std::vector<streamed_object_t> objects;
+    Bottle default_objects;
+    default_objects.fromString("(SIM_CER_ROBOT world) (Luca SIM_CER_ROBOT::mobile_base_body_link)");
+    Bottle* objects_list = rf.check("objects") ? rf.find("objects").asList() : &default_objects;
+    if (objects_list == nullptr) objects_list = &default_objects;
+    for (size_t i = 0; i < objects_list->size(); i++)
+    {
+        Bottle* o = objects_list->get(i).asList();
+        if (o == nullptr || o->size() < 1) continue;
+        streamed_object_t obj;
+        obj.name = o->get(0).asString();
+        obj.frame = (o->size() > 1) ? o->get(1).asString() : sim_pose_stream::world_frame;
+        obj.valid = false;
+        objects.push_back(obj);
+    }
+    if (objects.empty())
+    {
+        yError() << "No objects to stream";
+        return 1;
+    }
+
+    simPoseStreamerThread thread(period, name, world_interface_port, objects);
+    if (!thread.start())
+    {
+        return 1;
+    }
+    yInfo() << "simPoseStreamer: streaming" << objects.size() << "objects on" << name + "/poses:o" << (world_interface_port.empty() ? "(mock simulator)" : "from " + world_interface_port);
+    //runs until killed, or for the given duration
+    double t_start = Time::now();
+    while (duration <= 0 || Time::now() - t_start < duration)
+    {
+        Time::delay(0.1);
+    }
+    thread.stop();
+    return 0;
+}
@@ -0,0 +1,150 @@
+/*
+ * Copyright (C) 2020 Istituto Italiano di Tecnologia (IIT)
+ * All rights reserved.
+ *
+ * This software may be modified and distributed under the terms of the
+ * GPL-2+ license. See the accompanying LICENSE file for details.
+ */
+
+// t265Replay reads a file of t265 pose samples (the replay_file format of t265Localizer) and converts them
+// into planar poses with the code of t265Localizer (t265_pose), both without and with the camera-to-base
+// rotation (an identity transform between the base and the camera frame). The poses are compared with
+// the expected ones and an error is returned if they differ (a check run by ctest).
+// No YARP network (name server) and no camera are required.
+//
+// Usage:
+//   t265Replay --poses <t265_poses.txt> --expected <t265_expected.txt> [--tolerance <m>] [--tolerance_theta <deg>]
+//
+// Expected poses, one record per line, sorted by time. Lines starting with # are ignored.
+//   pose <t> <x> <y> <theta_deg>
+
+#include <yarp/os/Log.h>
+#include <yarp/os/LogStream.h>
+#include <yarp/os/ResourceFinder.h>
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <fstream>
+#include <sstream>
+#include <string>
+#include <vector>
+
+#include "t265_pose.h"
+#include <replay_log.h>
+
+using namespace yarp::os;
+
+#ifndef M_PI
+#define M_PI 3.14159265358979323846
+#endif
+
+#define DEG2RAD M_PI/180
+
+struct expected_pose_t
+{
+    double t;
+    double x, y, theta;  //m, m, deg
+};
+
+static bool parseRecord(const std::string& type, double t, std::istringstream& ss, expected_pose_t& r)
+{
+    if (type != "pose") return false;
+    r.t = t;
+    ss >> r.x >> r.y >> r.theta;
+    return true;
+}
+
+static bool loadPoses(const std::string& filename, std::vector<t265_pose_sample>& samples)
+{
+    //the same parsing of t265Localizer: empty lines and comments are skipped, invalid lines are an error here
+    std::ifstream file(filename);
+    if (!file.is_open())
+    {
+        yError() << "Unable to open" << filename;
+        return false;
+    }
+    std::string line;
+    while (std::getline(file, line))
+    {
+        if (line.empty() || line[0] == '#') continue;
+        t265_pose_sample s;
+        if (!t265_pose::parse(line, s))
+        {
+            yError() << "Invalid line in" << filename << ":" << line;
+            return false;
+        }
+        samples.push_back(s);
+    }
+    return true;
+}
+
+//returns the max errors of the converted poses
+static bool replay(const std::vector<t265_pose_sample>& samples, const std::vector<expected_pose_t>& expected,
+                   const double (*camera_rotation)[3], double& error_max, double& error_theta_max)
+{
+    error_max = 0;
+    error_theta_max = 0;
+    for (size_t i = 0; i < samples.size(); i++)
+    {
+        if (fabs(samples[i].timestamp - expected[i].t) > 1e-6)
+        {
+            yError("Sample %zu: timestamp %.3f, expected %.3f", i, samples[i].timestamp, expected[i].t);
+            return false;
+        }
+        double x, y, theta;
+        t265_pose::to_planar(samples[i], camera_rotation, x, y, theta);
+        double d = (theta - expected[i].theta) * DEG2RAD;
+        error_max = std::max(error_max, sqrt((x - expected[i].x) * (x - expected[i].x) + (y - expected[i].y) * (y - expected[i].y)));
+        error_theta_max = std::max(error_theta_max, fabs(atan2(sin(d), cos(d))) / (DEG2RAD));
+    }
+    return true;
+}
+
+int main(int argc, char *argv[])
+{
+    ResourceFinder rf;
+    rf.configure(argc, argv);
+    if (rf.check("help") || !rf.check("poses") || !rf.check("expected"))
+    {
+        yInfo() << "Usage: t265Replay --poses <t265_poses.txt> --expected <t265_expected.txt> [--tolerance <m>] [--tolerance_theta <deg>]";
+        return rf.check("help") ? 0 : 1;
+    }
+    double tolerance = rf.check("tolerance", Value(1e-5)).asDouble();
+    double tolerance_theta = rf.check("tolerance_theta", Value(1e-3)).asDouble();
+
+    std::vector<t265_pose_sample> samples;
+    std::vector<expected_pose_t> expected;
+    if (!loadPoses(rf.find("poses").asString(), samples) ||
+        !replay_log::load(rf.find("expected").asString(), expected, parseRecord))
+    {
+        return 1;
+    }
+    if (samples.empty() || samples.size() != expected.size())
+    {
+        yError() << "The files contain" << samples.size() << "samples and" << expected.size() << "expected poses";
+        return 1;
+    }
+
+    //cache_camera_rotation() of t265Localizer, with an identity transform between the base and the camera frame
+    const double camera_rotation[3][3] = { { 0, 0, 1 },
+                                           { 1, 0, 0 },
+                                           { 0, -1, 0 } };
+    const char* names[] = { "camera", "base" };
+    bool ok = true;
+    printf("%-8s %8s %14s %16s\n", "frame", "samples", "max err[m]", "max err[deg]");
+    for (int k = 0; k < 2; k++)
+    {
+        double error_max, error_theta_max;
+        if (!replay(samples, expected, k == 0 ? nullptr : camera_rotation, error_max, error_theta_max))
+        {
+            return 1;
+        }
+        printf("%-8s %8zu %14.7f %16.5f\n", names[k], samples.size(), error_max, error_theta_max);
+        if (error_max > tolerance || error_theta_max > tolerance_theta)
+        {
+            yError() << "The poses converted in the" << names[k] << "frame differ from the expected ones";
+            ok = false;
+        }
+    }
+    return ok ? 0 : 1;
+}